@@ -0,0 +1,49 @@
+/**
+ * @file    allocation_hook.cpp
+ *
+ * @brief   Counting replacement of the global operator new.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "allocation_hook.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+std::atomic<uint64_t> allocation_count(0);
+
+} // namespace
+
+uint64_t heap_allocations()
+{
+    return allocation_count.load(std::memory_order_relaxed);
+}
+
+// The default array and nothrow forms of the operators forward to the
+// replaced ones.
+void* operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(size > 0 ? size : 1))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
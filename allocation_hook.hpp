@@ -0,0 +1,26 @@
+/**
+ * @file    allocation_hook.hpp
+ *
+ * @brief   Counting replacement of the global operator new.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef ALLOCATION_HOOK_HPP
+#define ALLOCATION_HOOK_HPP
+
+#include <cstdint>
+
+/**
+ * Returns the number of the C++ heap allocations made by all threads since
+ * the program started.
+ *
+ * The allocation_hook.cpp source file replaces the global operator new, so it
+ * is linked only into the programs measuring their allocations (see the alloc
+ * suite of the benchmarks), not into the staff library.
+ *
+ * @return The number of the allocations.
+ */
+uint64_t heap_allocations();
+
+#endif // ALLOCATION_HOOK_HPP
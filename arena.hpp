@@ -0,0 +1,72 @@
+/**
+ * @file    arena.hpp
+ *
+ * @brief   Monotonic arena for the per-row and per-query temporaries.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The size of the inline buffer of a scratch arena in bytes.
+constexpr size_t k_scratch_arena_size = 4096;
+
+// The containers allocating from a memory resource (e.g. a scratch arena).
+// Constructed without a resource, they allocate from the heap.
+using arena_string = std::pmr::string;
+template <typename T>
+using arena_vector = std::pmr::vector<T>;
+
+/**
+ * The slices of the fields of a parsed record.
+ */
+using field_list = arena_vector<std::string_view>;
+
+/**
+ * The monotonic arena of the temporaries of a single row, batch or query.
+ *
+ * The memory is bumped from the inline buffer first and from the growing heap
+ * blocks when the buffer is exhausted. Nothing is freed before the arena is
+ * released or destroyed, so the containers allocating from the arena must
+ * not outlive it. The arena is a local variable of the scope owning the
+ * temporaries, it is not synchronized.
+ */
+class scratch_arena
+{
+public:
+    scratch_arena()
+      : resource_(buffer_, sizeof(buffer_))
+    {
+    }
+
+    scratch_arena(const scratch_arena&) = delete;
+    scratch_arena& operator=(const scratch_arena&) = delete;
+
+    std::pmr::memory_resource* resource()
+    {
+        return &resource_;
+    }
+
+    /**
+     * Frees the heap blocks, the next allocation starts in the inline buffer
+     * again. The containers allocated from the arena must be destroyed
+     * before.
+     */
+    void release()
+    {
+        resource_.release();
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char buffer_[k_scratch_arena_size];
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+#endif // ARENA_HPP
@@ -0,0 +1,321 @@
+/**
+ * @file    async_executor.cpp
+ *
+ * @brief   Asynchronous execution of the Staff operations on a connection pool.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "async_executor.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "lookup_cache.hpp"
+#include "staff.hpp"
+
+namespace
+{
+
+// The number of SQLite VM instructions between the cancellation checks.
+constexpr int k_progress_interval = 1000;
+
+/**
+ * The progress handler interrupting the running statement of a cancelled
+ * task.
+ */
+int interrupt_if_cancelled(void* flag)
+{
+    return static_cast<const std::atomic<bool>*>(flag)->load(std::memory_order_relaxed) ? 1 : 0;
+}
+
+} // namespace
+
+async_executor::async_executor()
+  : running_(false), write_generation_(0)
+{
+}
+
+async_executor::~async_executor()
+{
+    stop();
+}
+
+bool async_executor::start(connection_pool& pool, const async_executor_options& options)
+{
+    stop();
+
+    if (pool.reader_count() == 0)
+    {
+        std::cerr << "Error: the executor requires a connection pool with a read-only connection.\n";
+        return false;
+    }
+
+    options_ = options;
+    options_.queue_capacity = std::max<size_t>(options_.queue_capacity, 1);
+
+    std::vector<connection_lease> readers;
+    connection_lease writer = pool.acquire_writer();
+
+    for (size_t i = 0; i < pool.reader_count(); ++i)
+    {
+        readers.push_back(pool.acquire_reader());
+    }
+
+    if (!writer)
+    {
+        std::cerr << "Error: the connection pool has no writer connection.\n";
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+    }
+
+    for (connection_lease& reader : readers)
+    {
+        workers_.emplace_back(&async_executor::run_reader, this, std::move(reader));
+    }
+
+    group_commit_options writer_options;
+    writer_options.window = options_.write_window;
+    writer_options.batch_size = options_.write_batch_size;
+    writer_options.queue_capacity = options_.queue_capacity;
+    writer_options.reject_when_full = options_.reject_when_full;
+    writer_options.on_commit = [this]() { write_generation_.fetch_add(1); };
+
+    writer_lease_ = std::move(writer);
+    writer_.start(writer_lease_.get(), writer_options);
+
+    return true;
+}
+
+void async_executor::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!running_ && workers_.empty())
+        {
+            return;
+        }
+
+        running_ = false;
+    }
+
+    reads_.not_empty.notify_all();
+    reads_.not_full.notify_all();
+
+    for (std::thread& worker : workers_)
+    {
+        worker.join();
+    }
+
+    workers_.clear();
+    writer_.stop();
+    writer_lease_.release();
+
+    std::deque<task> remaining;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        remaining.swap(reads_.tasks);
+    }
+
+    for (task& item : remaining)
+    {
+        if (item.done)
+        {
+            item.done(task_status::cancelled);
+        }
+    }
+}
+
+std::future<task_status> async_executor::submit_read(connection_task task, const cancellation& cancel)
+{
+    auto promise = std::make_shared<std::promise<task_status>>();
+    std::future<task_status> result = promise->get_future();
+
+    submit_read(std::move(task), [promise](task_status status) { promise->set_value(status); }, cancel);
+
+    return result;
+}
+
+std::future<task_status> async_executor::submit_write(connection_task task, const cancellation& cancel)
+{
+    auto promise = std::make_shared<std::promise<task_status>>();
+    std::future<task_status> result = promise->get_future();
+
+    submit_write(std::move(task), [promise](task_status status) { promise->set_value(status); }, cancel);
+
+    return result;
+}
+
+void async_executor::submit_write(connection_task task, task_callback done, const cancellation& cancel)
+{
+    writer_.submit(std::move(task), [done](const write_result& result)
+    {
+        if (done)
+        {
+            done(result.status);
+        }
+    }, cancel);
+}
+
+size_t async_executor::pending_reads() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reads_.tasks.size();
+}
+
+size_t async_executor::pending_writes() const
+{
+    return writer_.pending();
+}
+
+uint64_t async_executor::write_batches() const
+{
+    return writer_.stats().groups;
+}
+
+uint64_t async_executor::writes_committed() const
+{
+    return writer_.stats().writes_committed;
+}
+
+void async_executor::submit_read(connection_task task, task_callback done, const cancellation& cancel)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (!options_.reject_when_full)
+    {
+        reads_.not_full.wait(lock, [this] { return !running_ || reads_.tasks.size() < options_.queue_capacity; });
+    }
+
+    if (!running_ || reads_.tasks.size() >= options_.queue_capacity)
+    {
+        lock.unlock();
+
+        if (done)
+        {
+            done(task_status::rejected);
+        }
+
+        return;
+    }
+
+    reads_.tasks.push_back({std::move(task), std::move(done), cancel});
+    lock.unlock();
+    reads_.not_empty.notify_one();
+}
+
+bool async_executor::pop(task& item)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    reads_.not_empty.wait(lock, [this] { return !running_ || !reads_.tasks.empty(); });
+
+    if (!running_)
+    {
+        return false;
+    }
+
+    item = std::move(reads_.tasks.front());
+    reads_.tasks.pop_front();
+
+    lock.unlock();
+    reads_.not_full.notify_one();
+
+    return true;
+}
+
+void async_executor::run_reader(connection_lease lease)
+{
+    uint64_t generation = write_generation_.load();
+    task item;
+
+    while (pop(item))
+    {
+        task_status status = task_status::cancelled;
+
+        if (!item.cancel.cancelled())
+        {
+            // The cached lookups may be changed by the committed writes.
+            const uint64_t current = write_generation_.load();
+
+            if (current != generation)
+            {
+                lease.lookups().invalidate_all();
+                generation = current;
+            }
+
+            sqlite3_progress_handler(lease.handle(), k_progress_interval, interrupt_if_cancelled,
+                                     const_cast<std::atomic<bool>*>(item.cancel.flag()));
+
+            const bool success = item.work(lease.get());
+
+            sqlite3_progress_handler(lease.handle(), 0, nullptr, nullptr);
+
+            if (success)
+            {
+                status = task_status::completed;
+            }
+            else if (!item.cancel.cancelled())
+            {
+                status = task_status::failed;
+            }
+        }
+
+        if (item.done)
+        {
+            item.done(status);
+        }
+
+        item = task();
+    }
+}
+
+connection_task print_table_task(const std::string& table_name, output_sink& sink)
+{
+    return [table_name, &sink](sqlite3** p_db)
+    {
+        return print_table(table_name, p_db, sink);
+    };
+}
+
+connection_task select_salary_threshold_task(const std::string& table_name, int threshold, output_sink& sink)
+{
+    return [table_name, threshold, &sink](sqlite3** p_db)
+    {
+        return select_salary_threshold(table_name, threshold, p_db, sink);
+    };
+}
+
+connection_task select_by_last_name_task(const std::string& table_name, const std::string& last_name,
+                                         output_sink& sink)
+{
+    return [table_name, last_name, &sink](sqlite3** p_db)
+    {
+        return select_by_last_name(table_name, last_name, p_db, sink);
+    };
+}
+
+connection_task insert_record_task(const std::string& table_name, const std::string& table_columns_names,
+                                   const std::string& columns_values)
+{
+    return [table_name, table_columns_names, columns_values](sqlite3** p_db)
+    {
+        return insert_table_record(table_name, table_columns_names, columns_values, p_db);
+    };
+}
+
+connection_task update_phone_number_task(const std::string& table_name, int person_id,
+                                         const std::string& new_phone_number)
+{
+    return [table_name, person_id, new_phone_number](sqlite3** p_db)
+    {
+        return update_phone_number(table_name, person_id, new_phone_number, p_db);
+    };
+}
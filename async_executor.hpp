@@ -0,0 +1,139 @@
+/**
+ * @file    async_executor.hpp
+ *
+ * @brief   Asynchronous execution of the Staff operations on a connection pool.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef ASYNC_EXECUTOR_HPP
+#define ASYNC_EXECUTOR_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+
+#include "async_task.hpp"
+#include "connection_pool.hpp"
+#include "group_commit_writer.hpp"
+#include "output_sink.hpp"
+
+// The default number of tasks waiting in each queue of the executor.
+constexpr size_t k_default_task_queue_capacity = 1024;
+
+/**
+ * The options of the executor.
+ */
+struct async_executor_options
+{
+    // The maximum number of tasks waiting in the read and in the write queue.
+    size_t queue_capacity = k_default_task_queue_capacity;
+    // If true, a task submitted to a full queue is rejected, otherwise the
+    // submitter waits until the queue has space (backpressure).
+    bool reject_when_full = false;
+    // The maximum number of writes committed in one transaction.
+    size_t write_batch_size = k_default_group_commit_batch_size;
+    // How long the writer waits for more writes to commit them together.
+    std::chrono::microseconds write_window = std::chrono::microseconds(0);
+};
+
+/**
+ * The task queue served by a small worker pool which owns the connections of
+ * a connection pool.
+ *
+ * Every reader worker leases one read-only connection for its lifetime, so
+ * the read tasks run in parallel. The write tasks are serialized on the
+ * group_commit_writer owning the writer connection, which coalesces the
+ * queued writes into group commits. A write is reported as completed only
+ * after its group is committed, so the write tasks must not begin or commit
+ * a transaction themselves.
+ *
+ * A cancelled task which did not start yet is not run. A running read task is
+ * interrupted by the SQLite progress handler.
+ */
+class async_executor
+{
+public:
+    async_executor();
+    ~async_executor();
+
+    async_executor(const async_executor&) = delete;
+    async_executor& operator=(const async_executor&) = delete;
+
+    /**
+     * Starts one reader worker per read-only connection of the pool and the
+     * writer worker. The pool has to stay open until the executor is stopped.
+     *
+     * @param pool    The opened connection pool.
+     * @param options The executor options.
+     * @return        True if the workers were started, false otherwise.
+     */
+    bool start(connection_pool& pool, const async_executor_options& options = async_executor_options());
+
+    /**
+     * Stops the workers. The running tasks are finished, the queued ones are
+     * completed as cancelled.
+     */
+    void stop();
+
+    std::future<task_status> submit_read(connection_task task, const cancellation& cancel = cancellation());
+    std::future<task_status> submit_write(connection_task task, const cancellation& cancel = cancellation());
+    void submit_read(connection_task task, task_callback done, const cancellation& cancel = cancellation());
+    void submit_write(connection_task task, task_callback done, const cancellation& cancel = cancellation());
+
+    size_t pending_reads() const;
+    size_t pending_writes() const;
+    uint64_t write_batches() const;
+    uint64_t writes_committed() const;
+
+private:
+    struct task
+    {
+        connection_task work;
+        task_callback done;
+        cancellation cancel;
+    };
+
+    struct task_queue
+    {
+        std::deque<task> tasks;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+    };
+
+    bool pop(task& item);
+    void run_reader(connection_lease lease);
+
+    async_executor_options options_;
+    bool running_;
+    mutable std::mutex mutex_;
+    task_queue reads_;
+    std::vector<std::thread> workers_;
+    connection_lease writer_lease_;
+    group_commit_writer writer_;
+    // Incremented after every committed write group, the readers invalidate
+    // their lookup caches when it changes.
+    std::atomic<uint64_t> write_generation_;
+};
+
+// The Staff operations as tasks. The printing tasks write into the sink, so
+// a sink must not be shared by the tasks running at the same time.
+connection_task print_table_task(const std::string& table_name, output_sink& sink);
+connection_task select_salary_threshold_task(const std::string& table_name, int threshold, output_sink& sink);
+connection_task select_by_last_name_task(const std::string& table_name, const std::string& last_name,
+                                         output_sink& sink);
+connection_task insert_record_task(const std::string& table_name, const std::string& table_columns_names,
+                                   const std::string& columns_values);
+connection_task update_phone_number_task(const std::string& table_name, int person_id,
+                                         const std::string& new_phone_number);
+
+#endif // ASYNC_EXECUTOR_HPP
@@ -0,0 +1,98 @@
+/**
+ * @file    async_task.hpp
+ *
+ * @brief   The tasks run on the connections owned by the worker threads.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef ASYNC_TASK_HPP
+#define ASYNC_TASK_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sqlite3.h>
+
+/**
+ * The final state of a submitted task.
+ */
+enum class task_status
+{
+    completed,
+    failed,
+    cancelled, // Cancelled before it started or interrupted while running.
+    rejected   // The queue was full (see reject_when_full) or the worker stopped.
+};
+
+/**
+ * The work of a task, it is run with the connection of the worker. It
+ * returns false if the operation failed.
+ */
+using connection_task = std::function<bool(sqlite3** p_db)>;
+
+/**
+ * The error of a task which failed before SQLite reported any error, e.g. a
+ * record with a wrong number of values.
+ */
+struct task_error
+{
+    // The extended SQLite result code describing the failure (e.g.
+    // SQLITE_MISUSE), SQLITE_OK if the task did not set any error.
+    int error_code = SQLITE_OK;
+    std::string error_message;
+};
+
+/**
+ * Returns the error of the task running on the calling thread. The task sets
+ * it before it returns false, so its error is reported instead of the error
+ * state of the connection, which is left from the last SQLite call. The
+ * group commit writer clears it before it runs a write.
+ */
+inline task_error& current_task_error()
+{
+    thread_local task_error error;
+    return error;
+}
+
+/**
+ * The completion callback of a task. It is called by the worker thread.
+ */
+using task_callback = std::function<void(task_status)>;
+
+/**
+ * The shared cancellation flag of one or more tasks. The copies refer to the
+ * same flag.
+ */
+class cancellation
+{
+public:
+    cancellation()
+      : flag_(std::make_shared<std::atomic<bool>>(false))
+    {
+    }
+
+    void cancel()
+    {
+        flag_->store(true, std::memory_order_relaxed);
+    }
+
+    bool cancelled() const
+    {
+        return flag_->load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return The flag polled by the SQLite progress handler.
+     */
+    const std::atomic<bool>* flag() const
+    {
+        return flag_.get();
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+#endif // ASYNC_TASK_HPP
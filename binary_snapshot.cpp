@@ -0,0 +1,726 @@
+/**
+ * @file    binary_snapshot.cpp
+ *
+ * @brief   Versioned binary snapshot file of the Staff table read by mmap.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "binary_snapshot.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "instrumentation.hpp"
+#include "lookup_cache.hpp"
+#include "row_cursor.hpp"
+#include "statement_cache.hpp"
+#include "table_schema.hpp"
+
+namespace
+{
+
+constexpr char k_magic[8] = {'S', 'T', 'A', 'F', 'F', 'B', 'I', 'N'};
+constexpr uint32_t k_byte_order = 0x01020304;
+
+constexpr uint64_t k_prime1 = 0x9e3779b185ebca87ULL;
+constexpr uint64_t k_prime2 = 0xc2b2ae3d27d4eb4fULL;
+// The body is checksummed in blocks chained by the seed.
+constexpr size_t k_checksum_block_size = 1024 * 1024;
+
+/**
+ * The text column of the snapshot, its member of the staff_row and its
+ * position in the table columns (see k_staff_schema).
+ */
+struct text_column
+{
+    std::string_view staff_row::* member;
+    int select_col;
+};
+
+// The text columns in the order of the file sections.
+const text_column k_text_columns[k_binary_snapshot_text_cols] = {
+    {&staff_row::first_name, staff_row::k_first_name_col},
+    {&staff_row::last_name, staff_row::k_last_name_col},
+    {&staff_row::address, staff_row::k_address_col},
+    {&staff_row::email, staff_row::k_email_col},
+    {&staff_row::profile_image, staff_row::k_profile_image_col},
+    {&staff_row::phone_num, staff_row::k_phone_num_col},
+    {&staff_row::time_zone, staff_row::k_time_zone_col}
+};
+
+uint64_t rotate_left(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+size_t null_words(size_t rows)
+{
+    return (rows + 63) / 64;
+}
+
+uint64_t padded_size(uint64_t size)
+{
+    return (size + 7) & ~uint64_t(7);
+}
+
+/**
+ * Function which computes the checksum of a block, the size has to be a
+ * multiple of 8. The words are mixed by four independent lanes (the rounds
+ * of xxHash64), so the checksum runs close to the memory bandwidth.
+ */
+uint64_t checksum_block(const void* data, size_t size, uint64_t seed)
+{
+    const char* bytes = static_cast<const char*>(data);
+    const size_t words = size / 8;
+    uint64_t lanes[4] = {seed + k_prime1 + k_prime2, seed + k_prime2, seed, seed - k_prime1};
+    size_t i = 0;
+
+    for (; i + 4 <= words; i += 4)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + (i + lane) * 8, sizeof(word));
+            lanes[lane] = rotate_left(lanes[lane] + word * k_prime2, 31) * k_prime1;
+        }
+    }
+
+    uint64_t hash = rotate_left(lanes[0], 1) + rotate_left(lanes[1], 7) + rotate_left(lanes[2], 12) +
+                    rotate_left(lanes[3], 18) + size;
+
+    for (; i < words; ++i)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i * 8, sizeof(word));
+        hash = rotate_left(hash ^ (rotate_left(word * k_prime2, 31) * k_prime1), 27) * k_prime1 + k_prime2;
+    }
+
+    hash ^= hash >> 33;
+    hash *= k_prime2;
+    hash ^= hash >> 29;
+
+    return hash;
+}
+
+/**
+ * Function which computes the checksum of the whole body.
+ */
+uint64_t checksum_body(const char* body, size_t size)
+{
+    uint64_t checksum = 0;
+
+    for (size_t offset = 0; offset < size; offset += k_checksum_block_size)
+    {
+        checksum = checksum_block(body + offset, std::min(k_checksum_block_size, size - offset), checksum);
+    }
+
+    return checksum;
+}
+
+/**
+ * The checksum_body of a body written by parts.
+ */
+class body_checksum
+{
+public:
+    body_checksum()
+      : value_(0)
+    {
+    }
+
+    void update(const char* data, size_t size)
+    {
+        while (size > 0)
+        {
+            // The whole blocks are not copied.
+            if (block_.empty() && size >= k_checksum_block_size)
+            {
+                value_ = checksum_block(data, k_checksum_block_size, value_);
+                data += k_checksum_block_size;
+                size -= k_checksum_block_size;
+                continue;
+            }
+
+            const size_t part = std::min(size, k_checksum_block_size - block_.size());
+
+            block_.append(data, part);
+            data += part;
+            size -= part;
+
+            if (block_.size() == k_checksum_block_size)
+            {
+                value_ = checksum_block(block_.data(), block_.size(), value_);
+                block_.clear();
+            }
+        }
+    }
+
+    uint64_t finish()
+    {
+        if (!block_.empty())
+        {
+            value_ = checksum_block(block_.data(), block_.size(), value_);
+            block_.clear();
+        }
+
+        return value_;
+    }
+
+private:
+    std::string block_;
+    uint64_t value_;
+};
+
+/**
+ * The columns of the snapshot collected before the file is written.
+ */
+struct snapshot_columns
+{
+    std::vector<int64_t> ids;
+    std::vector<int64_t> salaries;
+    std::vector<uint64_t> offsets[k_binary_snapshot_text_cols];
+    std::vector<uint64_t> nulls[k_binary_snapshot_text_cols];
+    // The values of every column are stored contiguously, so the value ends
+    // at the start of the next value of the column.
+    std::string heaps[k_binary_snapshot_text_cols];
+
+    snapshot_columns()
+    {
+        for (std::vector<uint64_t>& column_offsets : offsets)
+        {
+            column_offsets.push_back(0);
+        }
+    }
+
+    void add(const staff_row& row)
+    {
+        const size_t index = ids.size();
+
+        ids.push_back(row.id);
+        salaries.push_back(row.salary);
+
+        for (uint32_t c = 0; c < k_binary_snapshot_text_cols; ++c)
+        {
+            const std::string_view value = row.*k_text_columns[c].member;
+
+            if (index % 64 == 0)
+            {
+                nulls[c].push_back(0);
+            }
+
+            if (value.data() == nullptr)
+            {
+                nulls[c].back() |= uint64_t(1) << (index % 64);
+            }
+            else
+            {
+                heaps[c].append(value);
+            }
+
+            offsets[c].push_back(heaps[c].size());
+        }
+    }
+};
+
+/**
+ * Calls the function for every body section in the file order.
+ */
+template <typename Section>
+void for_each_section(const snapshot_columns& columns, Section section)
+{
+    section(columns.ids.data(), columns.ids.size() * sizeof(int64_t));
+    section(columns.salaries.data(), columns.salaries.size() * sizeof(int64_t));
+
+    for (const std::vector<uint64_t>& column_offsets : columns.offsets)
+    {
+        section(column_offsets.data(), column_offsets.size() * sizeof(uint64_t));
+    }
+
+    for (const std::vector<uint64_t>& column_nulls : columns.nulls)
+    {
+        section(column_nulls.data(), column_nulls.size() * sizeof(uint64_t));
+    }
+
+    for (const std::string& column_heap : columns.heaps)
+    {
+        section(column_heap.data(), column_heap.size());
+    }
+}
+
+} // namespace
+
+/**
+ * The function writes all records of the table into the snapshot file. The
+ * columns are collected in memory first, so the file is written sequentially
+ * with the checksum in its header.
+ *
+ * @param table_name The name of a table.
+ * @param filename   The name of the snapshot file.
+ * @param p_db       Database connection pointer.
+ * @param rows       The number of the written records.
+ * @return           True if the snapshot was written successfully, false
+ *                   otherwise.
+ */
+bool write_binary_snapshot(const std::string& table_name, const std::string& filename, sqlite3** p_db,
+                           size_t& rows)
+{
+    cached_statement stmt(get_statement_cache(*p_db),
+                          "SELECT " + get_table_sql(k_staff_schema).select_columns + " FROM " + table_name + \
+                          " ORDER BY ID;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (binary snapshot write).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    snapshot_columns columns;
+    row_cursor<staff_row> cursor(stmt.get());
+
+    for (const staff_row& row : cursor)
+    {
+        columns.add(row);
+    }
+
+    if (!cursor.ok())
+    {
+        std::cerr << "Error: executing SQL statement failed (binary snapshot write).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    binary_snapshot_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, k_magic, sizeof(k_magic));
+    header.version = k_binary_snapshot_version;
+    header.header_size = sizeof(header);
+    header.rows = columns.ids.size();
+    header.text_columns = k_binary_snapshot_text_cols;
+    header.byte_order = k_byte_order;
+
+    // The column heaps are padded and the offsets are rebased to the start of
+    // the whole heap.
+    for (uint32_t c = 0; c < k_binary_snapshot_text_cols; ++c)
+    {
+        columns.heaps[c].resize(padded_size(columns.heaps[c].size()), '\0');
+
+        for (uint64_t& offset : columns.offsets[c])
+        {
+            offset += header.heap_size;
+        }
+
+        header.heap_size += columns.heaps[c].size();
+    }
+
+    body_checksum checksum;
+
+    for_each_section(columns, [&header, &checksum](const void* data, size_t size)
+    {
+        header.body_size += size;
+        checksum.update(static_cast<const char*>(data), size);
+    });
+
+    header.checksum = checksum.finish();
+
+    const std::string temporary_filename = filename + ".tmp";
+    std::ofstream output(temporary_filename, std::ios::binary | std::ios::trunc);
+
+    if (!output.is_open())
+    {
+        std::cerr << "Error: creating the binary snapshot file \"" << temporary_filename << "\" failed.\n";
+        return false;
+    }
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    for_each_section(columns, [&output](const void* data, size_t size)
+    {
+        output.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    });
+
+    output.close();
+
+    if (!output || std::rename(temporary_filename.c_str(), filename.c_str()) != 0)
+    {
+        std::cerr << "Error: writing the binary snapshot file \"" << filename << "\" failed.\n";
+        std::remove(temporary_filename.c_str());
+        return false;
+    }
+
+    rows = columns.ids.size();
+
+    return true;
+}
+
+binary_snapshot::binary_snapshot()
+  : data_(nullptr), size_(0), rows_(0), ids_(nullptr), salaries_(nullptr), offsets_(), nulls_(), heap_(nullptr),
+    heap_size_(0)
+{
+}
+
+binary_snapshot::~binary_snapshot()
+{
+    close();
+}
+
+bool binary_snapshot::open(const std::string& filename, bool verify)
+{
+    close();
+
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat file_stat;
+
+    if (fd < 0 || fstat(fd, &file_stat) != 0)
+    {
+        std::cerr << "Error: opening the binary snapshot file \"" << filename << "\" failed.\n";
+        std::cerr << "Error message: " << std::strerror(errno) << "\n";
+
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+
+        return false;
+    }
+
+    const size_t size = static_cast<size_t>(file_stat.st_size);
+    void* data = (size >= sizeof(binary_snapshot_header)) ?
+        mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+    // The mapping stays valid after the descriptor is closed.
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "Error: mapping the binary snapshot file \"" << filename << "\" failed.\n";
+        return false;
+    }
+
+    data_ = data;
+    size_ = size;
+
+    const binary_snapshot_header* header = static_cast<const binary_snapshot_header*>(data_);
+    const char* reason = nullptr;
+
+    if (std::memcmp(header->magic, k_magic, sizeof(k_magic)) != 0)
+    {
+        reason = "not a binary snapshot file";
+    }
+    else if (header->byte_order != k_byte_order)
+    {
+        reason = "the file was written with another byte order";
+    }
+    else if (header->version != k_binary_snapshot_version)
+    {
+        reason = "unsupported format version";
+    }
+    else if (header->header_size != sizeof(binary_snapshot_header) ||
+             header->text_columns != k_binary_snapshot_text_cols)
+    {
+        reason = "unexpected header layout";
+    }
+    else if (header->rows > size_ / (2 * sizeof(int64_t)) ||
+             header->heap_size > size_ ||
+             header->body_size != size_ - sizeof(binary_snapshot_header) ||
+             header->body_size != (2 + k_binary_snapshot_text_cols) * header->rows * sizeof(int64_t) +
+                                  k_binary_snapshot_text_cols * (sizeof(uint64_t) +
+                                  null_words(header->rows) * sizeof(uint64_t)) + padded_size(header->heap_size))
+    {
+        reason = "the file size does not match the header (truncated file)";
+    }
+
+    if (reason == nullptr)
+    {
+        rows_ = header->rows;
+        heap_size_ = header->heap_size;
+
+        const char* section = static_cast<const char*>(data_) + sizeof(binary_snapshot_header);
+
+        ids_ = reinterpret_cast<const int64_t*>(section);
+        section += rows_ * sizeof(int64_t);
+        salaries_ = reinterpret_cast<const int64_t*>(section);
+        section += rows_ * sizeof(int64_t);
+
+        for (const uint64_t*& column_offsets : offsets_)
+        {
+            column_offsets = reinterpret_cast<const uint64_t*>(section);
+            section += (rows_ + 1) * sizeof(uint64_t);
+        }
+
+        for (const uint64_t*& column_nulls : nulls_)
+        {
+            column_nulls = reinterpret_cast<const uint64_t*>(section);
+            section += null_words(rows_) * sizeof(uint64_t);
+        }
+
+        heap_ = section;
+
+        if (verify && !verify_body())
+        {
+            reason = "checksum mismatch (corrupted file)";
+        }
+    }
+
+    if (reason != nullptr)
+    {
+        std::cerr << "Error: the binary snapshot file \"" << filename << "\" is invalid.\n";
+        std::cerr << "Error message: " << reason << "\n";
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void binary_snapshot::close()
+{
+    if (data_ != nullptr)
+    {
+        munmap(data_, size_);
+    }
+
+    data_ = nullptr;
+    size_ = 0;
+    rows_ = 0;
+}
+
+bool binary_snapshot::is_open() const
+{
+    return data_ != nullptr;
+}
+
+size_t binary_snapshot::rows() const
+{
+    return rows_;
+}
+
+uint64_t binary_snapshot::file_size() const
+{
+    return size_;
+}
+
+void binary_snapshot::read_row(size_t index, staff_row& row) const
+{
+    row.id = ids_[index];
+    row.salary = salaries_[index];
+
+    for (uint32_t c = 0; c < k_binary_snapshot_text_cols; ++c)
+    {
+        row.*k_text_columns[c].member = text(c, index);
+    }
+}
+
+std::string_view binary_snapshot::text(uint32_t column, size_t index) const
+{
+    if ((nulls_[column][index / 64] >> (index % 64)) & 1)
+    {
+        return std::string_view();
+    }
+
+    const uint64_t begin = offsets_[column][index];
+
+    return std::string_view(heap_ + begin, static_cast<size_t>(offsets_[column][index + 1] - begin));
+}
+
+bool binary_snapshot::verify_body() const
+{
+    const binary_snapshot_header* header = static_cast<const binary_snapshot_header*>(data_);
+
+    const uint64_t checksum = checksum_body(reinterpret_cast<const char*>(ids_), header->body_size);
+
+    if (checksum != header->checksum)
+    {
+        return false;
+    }
+
+    // The offsets are bounds checked, so a file with a forged checksum cannot
+    // make a view point outside the heap.
+    for (const uint64_t* column_offsets : offsets_)
+    {
+        for (size_t i = 0; i < rows_; ++i)
+        {
+            if (column_offsets[i] > column_offsets[i + 1])
+            {
+                return false;
+            }
+        }
+
+        if (column_offsets[rows_] > heap_size_)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The function inserts all records of the snapshot into the table by a
+ * prepared INSERT in chunked transactions. The text values are bound
+ * statically from the mapping, so no value is copied before SQLite stores it.
+ *
+ * @param snapshot   The opened snapshot.
+ * @param table_name The name of a table.
+ * @param chunk_size The number of rows committed in one transaction.
+ * @param p_db       Database connection pointer.
+ * @param stats      The statistics of the load.
+ * @return           True if the records were loaded successfully, false
+ *                   otherwise.
+ */
+bool load_binary_snapshot(const binary_snapshot& snapshot,
+                          const std::string& table_name,
+                          size_t chunk_size,
+                          sqlite3** p_db,
+                          bulk_load_stats& stats)
+{
+    scoped_timer timer(operation::bulk_load);
+
+    // Any cached lookup may be changed by the loaded records.
+    get_lookup_cache(*p_db).invalidate_all();
+
+    std::string placeholders = "?";
+
+    for (int i = staff_row::k_first_name_col; i <= staff_row::k_time_zone_col; ++i)
+    {
+        placeholders += ", ?";
+    }
+
+    cached_statement stmt(get_statement_cache(*p_db),
+                          "INSERT INTO " + table_name + " (" + get_table_sql(k_staff_schema).select_columns + \
+                          ") VALUES (" + placeholders + ") ON CONFLICT DO NOTHING;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (binary snapshot load).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    if (chunk_size == 0)
+    {
+        chunk_size = k_default_chunk_size;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    size_t rows_in_chunk = 0;
+    bool success = exec_transaction_statement("BEGIN;", p_db);
+    staff_row row;
+
+    for (size_t i = 0; success && i < snapshot.rows(); ++i)
+    {
+        snapshot.read_row(i, row);
+        ++stats.rows_read;
+
+        sqlite3_bind_int64(stmt.get(), staff_row::k_id_col + 1, row.id);
+        sqlite3_bind_int64(stmt.get(), staff_row::k_salary_col + 1, row.salary);
+
+        for (const text_column& column : k_text_columns)
+        {
+            const std::string_view value = row.*column.member;
+
+            if (value.data() == nullptr)
+            {
+                sqlite3_bind_null(stmt.get(), column.select_col + 1);
+            }
+            else
+            {
+                sqlite3_bind_text(stmt.get(), column.select_col + 1, value.data(), static_cast<int>(value.size()),
+                                  SQLITE_STATIC);
+            }
+        }
+
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE)
+        {
+            std::cerr << "Error: inserting record into the " << table_name << " table (snapshot row " << i \
+                      << ").\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            success = false;
+            break;
+        }
+
+        if (sqlite3_changes(*p_db) > 0)
+        {
+            ++stats.rows_inserted;
+        }
+        else
+        {
+            ++stats.rows_skipped;
+        }
+
+        sqlite3_reset(stmt.get());
+
+        if (++rows_in_chunk == chunk_size)
+        {
+            success = exec_transaction_statement("COMMIT;", p_db) && exec_transaction_statement("BEGIN;", p_db);
+
+            if (success)
+            {
+                ++stats.chunks_committed;
+                rows_in_chunk = 0;
+            }
+        }
+    }
+
+    if (success)
+    {
+        success = exec_transaction_statement("COMMIT;", p_db);
+
+        if (success && rows_in_chunk > 0)
+        {
+            ++stats.chunks_committed;
+        }
+    }
+    else if (!sqlite3_get_autocommit(*p_db))
+    {
+        exec_transaction_statement("ROLLBACK;", p_db);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    stats.elapsed_seconds = elapsed.count();
+
+    return success;
+}
+
+/**
+ * The function prints all records of the snapshot by the print_query_result
+ * function, so the output equals the output of the print_table function.
+ *
+ * @param snapshot The opened snapshot.
+ * @param sink     The sink of the printed records.
+ * @return         True if the records were printed successfully, false
+ *                 otherwise.
+ */
+bool print_binary_snapshot(const binary_snapshot& snapshot, output_sink& sink)
+{
+    scoped_timer timer(operation::print_table);
+
+    query_output output(sink);
+    staff_row row;
+
+    for (size_t i = 0; i < snapshot.rows(); ++i)
+    {
+        snapshot.read_row(i, row);
+        print_query_result(row, output);
+    }
+
+    if (!output.finish())
+    {
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
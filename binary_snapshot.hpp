@@ -0,0 +1,155 @@
+/**
+ * @file    binary_snapshot.hpp
+ *
+ * @brief   Versioned binary snapshot file of the Staff table read by mmap.
+ *
+ * The file consists of the header and the body. All sections are aligned to
+ * 8 bytes and stored in the native (little-endian) byte order:
+ *
+ *     header      binary_snapshot_header (64 bytes)
+ *     ids         int64_t[rows]
+ *     salaries    int64_t[rows]
+ *     offsets     uint64_t[rows + 1] per text column
+ *     nulls       uint64_t[(rows + 63) / 64] per text column (bit set = NULL)
+ *     heap        the text values of every column, padded to 8 bytes
+ *
+ * The text columns are stored in the staff_row order (FirstName, LastName,
+ * Address, Email, ProfileImage, PhoneNum, TimeZone), the value i of a column
+ * is heap[offsets[i], offsets[i + 1]). The checksum covers the whole body.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef BINARY_SNAPSHOT_HPP
+#define BINARY_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <sqlite3.h>
+
+#include "output_sink.hpp"
+#include "staff.hpp"
+
+// The version of the file format, a file of another version is rejected.
+constexpr uint32_t k_binary_snapshot_version = 1;
+// The number of the text columns of a Staff record.
+constexpr uint32_t k_binary_snapshot_text_cols = 7;
+
+/**
+ * The header at the start of the snapshot file.
+ */
+struct binary_snapshot_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t rows;
+    uint32_t text_columns;
+    // The value 0x01020304 written in the byte order of the writer.
+    uint32_t byte_order;
+    uint64_t heap_size;
+    uint64_t body_size;
+    uint64_t checksum;
+    uint64_t reserved;
+};
+
+static_assert(sizeof(binary_snapshot_header) == 64, "unexpected binary snapshot header size");
+
+/**
+ * Function which writes all records of the table into the snapshot file. The
+ * file is written under a temporary name and renamed, so an existing snapshot
+ * is replaced only by a complete one.
+ *
+ * @param table_name The name of a table.
+ * @param filename   The name of the snapshot file.
+ * @param p_db       Database connection pointer.
+ * @param rows       The number of the written records.
+ * @return           True if the snapshot was written successfully, false
+ *                   otherwise.
+ */
+bool write_binary_snapshot(const std::string& table_name, const std::string& filename, sqlite3** p_db,
+                           size_t& rows);
+
+/**
+ * The read-only snapshot file mapped into memory. The records are served
+ * straight from the mapping, nothing is parsed or copied when the file is
+ * opened.
+ */
+class binary_snapshot
+{
+public:
+    binary_snapshot();
+    ~binary_snapshot();
+
+    binary_snapshot(const binary_snapshot&) = delete;
+    binary_snapshot& operator=(const binary_snapshot&) = delete;
+
+    /**
+     * Maps the file and validates its header and section sizes.
+     *
+     * @param filename The name of the snapshot file.
+     * @param verify   If true, the checksum and the text offsets are verified
+     *                 too, which reads the whole file.
+     * @return         True if the file is a valid snapshot, false otherwise.
+     */
+    bool open(const std::string& filename, bool verify = true);
+    void close();
+
+    bool is_open() const;
+    size_t rows() const;
+    uint64_t file_size() const;
+
+    /**
+     * Fills the record with the row of the snapshot. The text views point
+     * into the mapping and are valid until the snapshot is closed.
+     */
+    void read_row(size_t index, staff_row& row) const;
+
+private:
+    std::string_view text(uint32_t column, size_t index) const;
+    bool verify_body() const;
+
+    void* data_;
+    size_t size_;
+    size_t rows_;
+    const int64_t* ids_;
+    const int64_t* salaries_;
+    const uint64_t* offsets_[k_binary_snapshot_text_cols];
+    const uint64_t* nulls_[k_binary_snapshot_text_cols];
+    const char* heap_;
+    uint64_t heap_size_;
+};
+
+/**
+ * Function which inserts all records of the snapshot (including their IDs)
+ * into the table in transactions of chunk_size rows. The records violating
+ * a UNIQUE constraint are skipped like in the bulk loader.
+ *
+ * @param snapshot   The opened snapshot.
+ * @param table_name The name of a table.
+ * @param chunk_size The number of rows committed in one transaction.
+ * @param p_db       Database connection pointer.
+ * @param stats      The statistics of the load.
+ * @return           True if the records were loaded successfully, false
+ *                   otherwise.
+ */
+bool load_binary_snapshot(const binary_snapshot& snapshot,
+                          const std::string& table_name,
+                          size_t chunk_size,
+                          sqlite3** p_db,
+                          bulk_load_stats& stats);
+
+/**
+ * Function which prints all records of the snapshot like the print_table
+ * function prints the table.
+ *
+ * @param snapshot The opened snapshot.
+ * @param sink     The sink of the printed records.
+ * @return         True if the records were printed successfully, false
+ *                 otherwise.
+ */
+bool print_binary_snapshot(const binary_snapshot& snapshot, output_sink& sink);
+
+#endif // BINARY_SNAPSHOT_HPP
@@ -0,0 +1,119 @@
+/**
+ * @file    bounded_queue.hpp
+ *
+ * @brief   Blocking bounded queue shared by producer and consumer threads.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+/**
+ * The bounded multi-producer/multi-consumer queue.
+ *
+ * The push method blocks while the queue is full, so fast producers are held
+ * back by the consumers. After the queue is closed, the push method fails
+ * and the pop method returns the remaining items and then fails.
+ */
+template <typename T>
+class bounded_queue
+{
+public:
+    explicit bounded_queue(size_t capacity)
+      : capacity_(capacity > 0 ? capacity : 1), closed_(false)
+    {
+    }
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    /**
+     * Appends the item, waits while the queue is full.
+     *
+     * @param item The appended item.
+     * @return     True if the item was appended, false if the queue is closed.
+     */
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+
+        if (closed_)
+        {
+            return false;
+        }
+
+        items_.push_back(std::move(item));
+        lock.unlock();
+        not_empty_.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Removes the first item, waits while the queue is empty.
+     *
+     * @param item The removed item.
+     * @return     True if an item was removed, false if the queue is closed
+     *             and empty.
+     */
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+
+        if (items_.empty())
+        {
+            return false;
+        }
+
+        item = std::move(items_.front());
+        items_.pop_front();
+        lock.unlock();
+        not_full_.notify_one();
+
+        return true;
+    }
+
+    /**
+     * Closes the queue and wakes up all waiting threads.
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+        }
+
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return items_.size();
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    const size_t capacity_;
+    bool closed_;
+    std::deque<T> items_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+#endif // BOUNDED_QUEUE_HPP
@@ -0,0 +1,247 @@
+/**
+ * @file    connection_config.cpp
+ *
+ * @brief   Connection configuration profiles applied by SQLite pragmas.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "connection_config.hpp"
+
+#include <cctype>
+#include <iostream>
+
+namespace
+{
+
+// The pragmas managed by the profiles in the order of their application.
+const char* const k_profile_pragmas[] = {
+    "journal_mode",
+    "synchronous",
+    "cache_size",
+    "mmap_size",
+    "temp_store"
+};
+
+/**
+ * Function which reads a single pragma value as a text.
+ */
+bool read_pragma(sqlite3* db, const std::string& pragma, std::string& value)
+{
+    const std::string sql = "PRAGMA " + pragma + ";";
+
+    sqlite3_stmt* stmt;
+    int status = sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
+
+    if (status != SQLITE_OK)
+    {
+        std::cerr << "Error: preparing SQL statement failed (" << sql << ").\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+
+    status = sqlite3_step(stmt);
+
+    if (status == SQLITE_ROW)
+    {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        value = text ? text : "";
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (status != SQLITE_ROW)
+    {
+        std::cerr << "Error: executing SQL statement failed (" << sql << ").\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Function which translates the numeric pragma values to their names.
+ */
+std::string pragma_value_name(const std::string& pragma, const std::string& value)
+{
+    if (pragma == "synchronous")
+    {
+        static const char* const names[] = {"OFF", "NORMAL", "FULL", "EXTRA"};
+
+        if (value.size() == 1 && value[0] >= '0' && value[0] <= '3')
+        {
+            return names[value[0] - '0'];
+        }
+    }
+    else if (pragma == "temp_store")
+    {
+        static const char* const names[] = {"DEFAULT", "FILE", "MEMORY"};
+
+        if (value.size() == 1 && value[0] >= '0' && value[0] <= '2')
+        {
+            return names[value[0] - '0'];
+        }
+    }
+    else if (pragma == "journal_mode")
+    {
+        std::string upper = value;
+
+        for (char& c : upper)
+        {
+            c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+
+        return upper;
+    }
+
+    return value;
+}
+
+} // namespace
+
+connection_profile bulk_load_profile()
+{
+    connection_profile profile;
+    profile.name = "bulk-load";
+    profile.journal_mode = "WAL";
+    profile.synchronous = "OFF";
+    // 256 MiB of the page cache and up to 1 GiB of the file mapped.
+    profile.cache_size = -262144;
+    profile.mmap_size = 1LL << 30;
+    profile.temp_store = "MEMORY";
+
+    return profile;
+}
+
+connection_profile durable_profile()
+{
+    connection_profile profile;
+    profile.name = "durable";
+    profile.journal_mode = "WAL";
+    profile.synchronous = "FULL";
+    // 64 MiB of the page cache and up to 256 MiB of the file mapped.
+    profile.cache_size = -65536;
+    profile.mmap_size = 1LL << 28;
+    profile.temp_store = "MEMORY";
+
+    return profile;
+}
+
+bool find_connection_profile(const std::string& name, connection_profile& profile)
+{
+    if (name == "bulk-load")
+    {
+        profile = bulk_load_profile();
+        return true;
+    }
+
+    if (name == "durable")
+    {
+        profile = durable_profile();
+        return true;
+    }
+
+    return false;
+}
+
+bool checkpoint_database(sqlite3** p_db)
+{
+    std::string journal_mode;
+
+    if (!read_pragma(*p_db, "journal_mode", journal_mode))
+    {
+        return false;
+    }
+
+    if (pragma_value_name("journal_mode", journal_mode) != "WAL")
+    {
+        return true;
+    }
+
+    int wal_frames = 0;
+    int checkpointed_frames = 0;
+    int status = sqlite3_wal_checkpoint_v2(*p_db, nullptr, SQLITE_CHECKPOINT_TRUNCATE,
+                                           &wal_frames, &checkpointed_frames);
+
+    if (status != SQLITE_OK)
+    {
+        std::cerr << "Error: the WAL checkpoint failed.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    std::cout << "Info: WAL checkpointed (" << checkpointed_frames << " of " << wal_frames << " frames).\n";
+
+    return true;
+}
+
+bool apply_connection_profile(const connection_profile& profile, sqlite3** p_db)
+{
+    if (!sqlite3_get_autocommit(*p_db))
+    {
+        std::cerr << "Error: the connection profile can't be switched inside of a transaction.\n";
+        return false;
+    }
+
+    const std::string values[] = {
+        profile.journal_mode,
+        profile.synchronous,
+        std::to_string(profile.cache_size),
+        std::to_string(profile.mmap_size),
+        profile.temp_store
+    };
+
+    std::string applied;
+
+    for (size_t i = 0; i < sizeof(k_profile_pragmas) / sizeof(k_profile_pragmas[0]); ++i)
+    {
+        const std::string pragma = k_profile_pragmas[i];
+        const std::string sql = "PRAGMA " + pragma + " = " + values[i] + ";";
+
+        char* err_msg = nullptr;
+        int status = sqlite3_exec(*p_db, sql.c_str(), nullptr, nullptr, &err_msg);
+
+        if (status != SQLITE_OK)
+        {
+            std::cerr << "Error: executing SQL statement failed (" << sql << ").\n";
+            std::cerr << "Error message: " << err_msg << "\n";
+            sqlite3_free(err_msg);
+            return false;
+        }
+
+        // Read the value back, some pragmas silently keep the previous value
+        // (e.g. WAL is not available for in-memory databases).
+        std::string value;
+
+        if (!read_pragma(*p_db, pragma, value))
+        {
+            return false;
+        }
+
+        applied += (applied.empty() ? "" : ", ") + pragma + "=" + pragma_value_name(pragma, value);
+    }
+
+    std::cout << "Info: Connection profile \"" << profile.name << "\" applied: " << applied << ".\n";
+
+    return checkpoint_database(p_db);
+}
+
+bool read_connection_pragmas(sqlite3** p_db, std::vector<std::pair<std::string, std::string>>& pragmas)
+{
+    pragmas.clear();
+
+    for (const char* pragma : k_profile_pragmas)
+    {
+        std::string value;
+
+        if (!read_pragma(*p_db, pragma, value))
+        {
+            return false;
+        }
+
+        pragmas.emplace_back(pragma, pragma_value_name(pragma, value));
+    }
+
+    return true;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file    connection_config.hpp
+ *
+ * @brief   Connection configuration profiles applied by SQLite pragmas.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef CONNECTION_CONFIG_HPP
+#define CONNECTION_CONFIG_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <sqlite3.h>
+
+/**
+ * The set of pragmas applied to a database connection at once.
+ */
+struct connection_profile
+{
+    std::string name;
+    // DELETE, TRUNCATE, PERSIST, MEMORY, WAL or OFF.
+    std::string journal_mode;
+    // OFF, NORMAL, FULL or EXTRA.
+    std::string synchronous;
+    // The page cache size, a negative value is in KiB, a positive in pages.
+    long long cache_size;
+    // The maximum number of bytes of the database file accessed by mmap.
+    long long mmap_size;
+    // DEFAULT, FILE or MEMORY.
+    std::string temp_store;
+};
+
+/**
+ * The profile for importing large amounts of data. The WAL journal keeps the
+ * readers unblocked by the import and the synchronization is turned off (a
+ * crash may lose the last transactions, but the database stays consistent).
+ */
+connection_profile bulk_load_profile();
+
+/**
+ * The profile for serving the data. The WAL journal keeps the readers and the
+ * writer from blocking each other and every commit is synchronized to disk.
+ */
+connection_profile durable_profile();
+
+/**
+ * Function which looks up a predefined profile by its name ("bulk-load" or
+ * "durable").
+ *
+ * @param name    The name of the profile.
+ * @param profile The found profile.
+ * @return        True if the profile exists, false otherwise.
+ */
+bool find_connection_profile(const std::string& name, connection_profile& profile);
+
+/**
+ * Function which applies the profile to the database connection. The values
+ * in effect are read back and logged to stdout.
+ *
+ * After the pragmas are applied, the WAL (if used) is checkpointed with the
+ * synchronization of the new profile, so the data loaded under a fast profile
+ * are made durable by the switch to a durable one.
+ *
+ * The profile can't be switched inside of an open transaction.
+ *
+ * @param profile The applied profile.
+ * @param p_db    Database connection pointer.
+ * @return        True if all pragmas were applied, false otherwise.
+ */
+bool apply_connection_profile(const connection_profile& profile, sqlite3** p_db);
+
+/**
+ * Function which checkpoints the WAL into the database file and truncates it.
+ * It does nothing if the connection does not use the WAL journal.
+ *
+ * @param p_db Database connection pointer.
+ * @return     True if the checkpoint was done, false if an error occurs.
+ */
+bool checkpoint_database(sqlite3** p_db);
+
+/**
+ * Function which reads the current values of the pragmas managed by the
+ * connection profiles.
+ *
+ * @param p_db    Database connection pointer.
+ * @param pragmas The (pragma name, value) pairs.
+ * @return        True if all values were read, false otherwise.
+ */
+bool read_connection_pragmas(sqlite3** p_db, std::vector<std::pair<std::string, std::string>>& pragmas);
+
+#endif // CONNECTION_CONFIG_HPP
@@ -0,0 +1,327 @@
+/**
+ * @file    connection_pool.cpp
+ *
+ * @brief   Pool of one writer and several read-only database connections.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "connection_pool.hpp"
+
+#include <iostream>
+#include <utility>
+
+#include "lookup_cache.hpp"
+#include "sql_functions.hpp"
+#include "statement_cache.hpp"
+
+namespace
+{
+
+// How long a connection waits for a lock held by another connection.
+constexpr int k_busy_timeout_ms = 5000;
+
+/**
+ * Function which looks up the caches of the opened connection, so the leases
+ * use them directly.
+ */
+void attach_caches(pooled_connection& connection)
+{
+    connection.statements = &get_statement_cache(connection.db);
+    connection.lookups = &get_lookup_cache(connection.db);
+}
+
+/**
+ * Function which finalizes the cached statements, drops the cached lookups
+ * and closes the connection.
+ */
+void close_connection(pooled_connection& connection)
+{
+    if (connection.db != nullptr)
+    {
+        release_statement_cache(connection.db);
+        release_lookup_cache(connection.db);
+        sqlite3_close(connection.db);
+    }
+
+    connection = pooled_connection();
+}
+
+} // namespace
+
+connection_lease::connection_lease()
+  : pool_(nullptr), connection_(nullptr), writer_(false)
+{
+}
+
+connection_lease::connection_lease(connection_pool* pool, pooled_connection* connection, bool writer)
+  : pool_(pool), connection_(connection), writer_(writer)
+{
+}
+
+connection_lease::connection_lease(connection_lease&& other) noexcept
+  : pool_(other.pool_), connection_(other.connection_), writer_(other.writer_)
+{
+    other.pool_ = nullptr;
+    other.connection_ = nullptr;
+}
+
+connection_lease& connection_lease::operator=(connection_lease&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        pool_ = other.pool_;
+        connection_ = other.connection_;
+        writer_ = other.writer_;
+        other.pool_ = nullptr;
+        other.connection_ = nullptr;
+    }
+
+    return *this;
+}
+
+connection_lease::~connection_lease()
+{
+    release();
+}
+
+void connection_lease::release()
+{
+    if (pool_ != nullptr && connection_ != nullptr)
+    {
+        pool_->release(connection_, writer_);
+    }
+
+    pool_ = nullptr;
+    connection_ = nullptr;
+}
+
+connection_pool::connection_pool()
+  : writer_busy_(false)
+{
+}
+
+connection_pool::~connection_pool()
+{
+    close();
+}
+
+bool connection_pool::open(const std::string& db_filename, size_t reader_count, const connection_profile& profile)
+{
+    close();
+
+    int status = sqlite3_open_v2(db_filename.c_str(), &writer_.db,
+                                 SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX, nullptr);
+
+    if (status != SQLITE_OK)
+    {
+        std::cerr << "Error: opening the writer connection to the database \"" << db_filename << "\" failed.\n";
+        close();
+        return false;
+    }
+
+    sqlite3_busy_timeout(writer_.db, k_busy_timeout_ms);
+
+    if (!register_staff_functions(writer_.db) || !apply_connection_profile(profile, &writer_.db))
+    {
+        close();
+        return false;
+    }
+
+    std::vector<std::pair<std::string, std::string>> pragmas;
+
+    if (!read_connection_pragmas(&writer_.db, pragmas) || pragmas.empty() || pragmas[0].second != "WAL")
+    {
+        std::cerr << "Error: the connection pool requires the WAL journal.\n";
+        close();
+        return false;
+    }
+
+    // The mmap and cache sizes are per connection, the rest of the profile is
+    // either persistent (journal mode) or has no effect on readers.
+    const std::string reader_pragmas = "PRAGMA cache_size = " + std::to_string(profile.cache_size) + \
+        "; PRAGMA mmap_size = " + std::to_string(profile.mmap_size) + ";";
+
+    attach_caches(writer_);
+    readers_.assign(reader_count, pooled_connection());
+
+    for (pooled_connection& reader : readers_)
+    {
+        status = sqlite3_open_v2(db_filename.c_str(), &reader.db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                                 nullptr);
+
+        if (status != SQLITE_OK ||
+            sqlite3_exec(reader.db, reader_pragmas.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Error: opening the read-only connection to the database \"" << db_filename \
+                      << "\" failed.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(reader.db) << "\n";
+            close();
+            return false;
+        }
+
+        sqlite3_busy_timeout(reader.db, k_busy_timeout_ms);
+
+        if (!register_staff_functions(reader.db))
+        {
+            close();
+            return false;
+        }
+
+        attach_caches(reader);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (pooled_connection& reader : readers_)
+    {
+        free_readers_.push_back(&reader);
+    }
+
+    return true;
+}
+
+void connection_pool::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (pooled_connection& reader : readers_)
+    {
+        close_connection(reader);
+    }
+
+    close_connection(writer_);
+    readers_.clear();
+    free_readers_.clear();
+    writer_busy_ = false;
+}
+
+connection_lease connection_pool::acquire_reader()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (readers_.empty())
+    {
+        return connection_lease();
+    }
+
+    reader_released_.wait(lock, [this] { return !free_readers_.empty(); });
+
+    pooled_connection* connection = free_readers_.back();
+    free_readers_.pop_back();
+
+    return connection_lease(this, connection, false);
+}
+
+connection_lease connection_pool::acquire_writer()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (writer_.db == nullptr)
+    {
+        return connection_lease();
+    }
+
+    writer_released_.wait(lock, [this] { return !writer_busy_; });
+    writer_busy_ = true;
+
+    return connection_lease(this, &writer_, true);
+}
+
+void connection_pool::release(pooled_connection* connection, bool writer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (writer)
+        {
+            writer_busy_ = false;
+        }
+        else
+        {
+            free_readers_.push_back(connection);
+        }
+    }
+
+    if (writer)
+    {
+        writer_released_.notify_one();
+    }
+    else
+    {
+        reader_released_.notify_one();
+    }
+}
+
+bool connection_pool::query(const std::string& sql, const statement_binder& bind, const row_handler& on_row)
+{
+    connection_lease lease = acquire_reader();
+
+    if (!lease)
+    {
+        std::cerr << "Error: the connection pool has no read-only connection.\n";
+        return false;
+    }
+
+    cached_statement stmt(lease.statements(), sql);
+
+    if (!stmt || (bind && !bind(stmt.get())))
+    {
+        std::cerr << "Error: preparing SQL statement failed (pooled query).\n";
+        return false;
+    }
+
+    int status;
+
+    while ((status = sqlite3_step(stmt.get())) == SQLITE_ROW)
+    {
+        if (on_row && !on_row(stmt.get()))
+        {
+            return true;
+        }
+    }
+
+    if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error: executing SQL statement failed (pooled query).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(lease.handle()) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool connection_pool::execute(const std::string& sql, const statement_binder& bind)
+{
+    connection_lease lease = acquire_writer();
+
+    if (!lease)
+    {
+        std::cerr << "Error: the connection pool has no writer connection.\n";
+        return false;
+    }
+
+    cached_statement stmt(lease.statements(), sql);
+
+    if (!stmt || (bind && !bind(stmt.get())))
+    {
+        std::cerr << "Error: preparing SQL statement failed (pooled statement).\n";
+        return false;
+    }
+
+    int status;
+
+    while ((status = sqlite3_step(stmt.get())) == SQLITE_ROW)
+    {
+    }
+
+    if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error: executing SQL statement failed (pooled statement).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(lease.handle()) << "\n";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file    connection_pool.hpp
+ *
+ * @brief   Pool of one writer and several read-only database connections.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+#include "connection_config.hpp"
+
+class connection_pool;
+class lookup_cache;
+class statement_cache;
+
+/**
+ * A pooled database connection with its caches, which are looked up once
+ * when the connection is opened.
+ */
+struct pooled_connection
+{
+    sqlite3* db = nullptr;
+    statement_cache* statements = nullptr;
+    lookup_cache* lookups = nullptr;
+};
+
+/**
+ * The RAII lease of a pooled connection. The connection is returned to the
+ * pool when the lease goes out of scope. A lease is used by a single thread.
+ */
+class connection_lease
+{
+public:
+    connection_lease();
+    connection_lease(connection_lease&& other) noexcept;
+    connection_lease& operator=(connection_lease&& other) noexcept;
+    ~connection_lease();
+
+    connection_lease(const connection_lease&) = delete;
+    connection_lease& operator=(const connection_lease&) = delete;
+
+    /**
+     * @return The connection pointer accepted by the Staff operations.
+     */
+    sqlite3** get() const
+    {
+        return connection_ ? &connection_->db : nullptr;
+    }
+
+    sqlite3* handle() const
+    {
+        return connection_ ? connection_->db : nullptr;
+    }
+
+    /**
+     * @return The statement cache of the leased connection.
+     */
+    statement_cache& statements() const
+    {
+        return *connection_->statements;
+    }
+
+    /**
+     * @return The lookup cache of the leased connection.
+     */
+    lookup_cache& lookups() const
+    {
+        return *connection_->lookups;
+    }
+
+    explicit operator bool() const
+    {
+        return connection_ != nullptr;
+    }
+
+    /**
+     * Returns the connection to the pool before the lease goes out of scope.
+     */
+    void release();
+
+private:
+    friend class connection_pool;
+
+    connection_lease(connection_pool* pool, pooled_connection* connection, bool writer);
+
+    connection_pool* pool_;
+    pooled_connection* connection_;
+    bool writer_;
+};
+
+/**
+ * Function binding the parameters of a pooled query. It returns false if the
+ * binding fails.
+ */
+using statement_binder = std::function<bool(sqlite3_stmt*)>;
+
+/**
+ * Function called for every row of a pooled query. It returns false to stop
+ * the query.
+ */
+using row_handler = std::function<bool(sqlite3_stmt*)>;
+
+/**
+ * The pool of database connections to a single database file.
+ *
+ * The pool consists of one writer connection and N read-only connections
+ * opened with SQLITE_OPEN_NOMUTEX, because each of them is used by a single
+ * thread at a time under a lease. The database uses the WAL journal, so the
+ * readers are not blocked by the writer and see the last committed state.
+ * All methods are thread-safe.
+ */
+class connection_pool
+{
+public:
+    connection_pool();
+    ~connection_pool();
+
+    connection_pool(const connection_pool&) = delete;
+    connection_pool& operator=(const connection_pool&) = delete;
+
+    /**
+     * Opens the connections. The profile is applied to the writer connection
+     * and must use the WAL journal. The readers get the same cache and mmap
+     * settings. The Staff SQL functions are registered on all connections
+     * (see register_staff_functions).
+     *
+     * @param db_filename  Name of the file containing the database.
+     * @param reader_count The number of read-only connections.
+     * @param profile      The connection profile.
+     * @return             True if all connections were opened, false otherwise.
+     */
+    bool open(const std::string& db_filename, size_t reader_count, const connection_profile& profile);
+
+    /**
+     * Closes all connections. All leases have to be released before.
+     */
+    void close();
+
+    /**
+     * Waits until a read-only connection is available and leases it.
+     */
+    connection_lease acquire_reader();
+
+    /**
+     * Waits until the writer connection is available and leases it.
+     */
+    connection_lease acquire_writer();
+
+    /**
+     * Runs a read query on a leased read-only connection. The statement is
+     * taken from the statement cache held by the pooled connection, so no
+     * global lock is taken.
+     *
+     * @param sql    The SQL text of the query.
+     * @param bind   The function binding the query parameters (may be empty).
+     * @param on_row The function called for every result row.
+     * @return       True if the query was executed successfully, false otherwise.
+     */
+    bool query(const std::string& sql, const statement_binder& bind, const row_handler& on_row);
+
+    /**
+     * Runs a write statement on the leased writer connection.
+     *
+     * @param sql  The SQL text of the statement.
+     * @param bind The function binding the statement parameters (may be empty).
+     * @return     True if the statement was executed successfully, false otherwise.
+     */
+    bool execute(const std::string& sql, const statement_binder& bind);
+
+    size_t reader_count() const
+    {
+        return readers_.size();
+    }
+
+private:
+    friend class connection_lease;
+
+    void release(pooled_connection* connection, bool writer);
+
+    pooled_connection writer_;
+    bool writer_busy_;
+    // The stable storage of the reader connections, the leases point into it.
+    std::vector<pooled_connection> readers_;
+    std::vector<pooled_connection*> free_readers_;
+    std::mutex mutex_;
+    std::condition_variable reader_released_;
+    std::condition_variable writer_released_;
+};
+
+#endif // CONNECTION_POOL_HPP
@@ -0,0 +1,122 @@
+/**
+ * @file    connection_registry.hpp
+ *
+ * @brief   Registry of the caches bound to the database connections.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef CONNECTION_REGISTRY_HPP
+#define CONNECTION_REGISTRY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sqlite3.h>
+
+/**
+ * The registry of the caches of type T bound to the database connections.
+ *
+ * The caches are owned by a map behind a mutex. Every thread remembers the
+ * last few caches it looked up, so the lookups of the connections a thread
+ * keeps using do not touch the mutex. The remembered caches are valid while
+ * no cache was released; every release increments the generation of the
+ * registry, which discards them (the handle of a closed connection may be
+ * reused by the next opened one).
+ */
+template <typename T>
+class connection_registry
+{
+public:
+    /**
+     * Returns the cache of the database connection. The cache is created by
+     * the function create on the first use (called under the mutex).
+     */
+    template <typename Create>
+    T& get(sqlite3* db, Create create)
+    {
+        const uint64_t generation = generation_.load(std::memory_order_acquire);
+
+        for (const memo_entry& entry : memo_)
+        {
+            if (entry.db == db && entry.generation == generation)
+            {
+                return *entry.cache;
+            }
+        }
+
+        T* cache = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::unique_ptr<T>& owned = caches_[db];
+
+            if (!owned)
+            {
+                owned = create();
+            }
+
+            cache = owned.get();
+        }
+
+        memo_[next_memo_] = memo_entry{db, cache, generation};
+        next_memo_ = (next_memo_ + 1) % k_memo_size;
+
+        return *cache;
+    }
+
+    /**
+     * Destroys the cache of the database connection.
+     */
+    void release(sqlite3* db)
+    {
+        std::unique_ptr<T> cache;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = caches_.find(db);
+
+            if (it == caches_.end())
+            {
+                return;
+            }
+
+            cache = std::move(it->second);
+            caches_.erase(it);
+            generation_.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+private:
+    struct memo_entry
+    {
+        sqlite3* db;
+        T* cache;
+        uint64_t generation;
+    };
+
+    // The number of caches remembered by a thread, e.g. a pooled reader, the
+    // writer and a connection of its own.
+    static constexpr size_t k_memo_size = 4;
+
+    // The caches remembered by the thread. The registries are global objects,
+    // so there is one memo per type and thread.
+    static thread_local memo_entry memo_[k_memo_size];
+    static thread_local size_t next_memo_;
+
+    std::mutex mutex_;
+    std::unordered_map<sqlite3*, std::unique_ptr<T>> caches_;
+    // The empty remembered caches have the generation 0.
+    std::atomic<uint64_t> generation_{1};
+};
+
+template <typename T>
+thread_local typename connection_registry<T>::memo_entry connection_registry<T>::memo_[k_memo_size] = {};
+
+template <typename T>
+thread_local size_t connection_registry<T>::next_memo_ = 0;
+
+#endif // CONNECTION_REGISTRY_HPP
@@ -0,0 +1,316 @@
+/**
+ * @file    csv_reader.cpp
+ *
+ * @brief   Streaming CSV reader yielding field slices into its block buffer.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "csv_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool is_quote(char c)
+{
+    return c == '\'' || c == '"';
+}
+
+/**
+ * Function which finds the line break terminating the record starting at
+ * begin. Line breaks inside quoted fields do not terminate the record.
+ *
+ * @param begin      The first character of the record.
+ * @param end        The end of the available data.
+ * @param at_eof     True if no more data follow after end.
+ * @param line_count The number of line breaks inside of the record.
+ * @return           The terminating line break (or end if the record is
+ *                   terminated by the end of the input), nullptr if more data
+ *                   are needed to find the end of the record.
+ */
+const char* find_record_end(const char* begin, const char* end, bool at_eof, size_t& line_count)
+{
+    enum class state { field_start, unquoted, quoted, after_quote };
+
+    state current = state::field_start;
+    char quote = '\0';
+    line_count = 0;
+
+    for (const char* p = begin; p < end; ++p)
+    {
+        const char c = *p;
+
+        switch (current)
+        {
+        case state::field_start:
+            if (is_quote(c))
+            {
+                quote = c;
+                current = state::quoted;
+            }
+            else if (c == '\n')
+            {
+                return p;
+            }
+            else if (c == ',')
+            {
+                // An empty field, the next one starts.
+            }
+            else if (!is_blank(c))
+            {
+                current = state::unquoted;
+            }
+            break;
+        case state::unquoted:
+        case state::after_quote:
+            if (c == ',')
+            {
+                current = state::field_start;
+            }
+            else if (c == '\n')
+            {
+                return p;
+            }
+            break;
+        case state::quoted:
+            if (c == '\n')
+            {
+                ++line_count;
+            }
+            else if (c == quote)
+            {
+                if (p + 1 == end && !at_eof)
+                {
+                    // It can't be decided whether the quote is escaped.
+                    return nullptr;
+                }
+
+                if (p + 1 < end && p[1] == quote)
+                {
+                    ++p;
+                }
+                else
+                {
+                    current = state::after_quote;
+                }
+            }
+            break;
+        }
+    }
+
+    if (!at_eof)
+    {
+        return nullptr;
+    }
+
+    // An unterminated quoted field at the end of the input makes the record
+    // invalid, which is reported by the split_csv_record function.
+    return end;
+}
+
+} // namespace
+
+bool split_csv_record(char* begin, char* end, field_list& fields)
+{
+    fields.clear();
+
+    char* p = begin;
+
+    while (true)
+    {
+        while (p < end && is_blank(*p))
+        {
+            ++p;
+        }
+
+        if (p < end && is_quote(*p))
+        {
+            const char quote = *p++;
+            char* field_begin = p;
+            char* out = p;
+            bool terminated = false;
+
+            while (p < end)
+            {
+                if (*p == quote)
+                {
+                    if (p + 1 < end && p[1] == quote)
+                    {
+                        // The escaped quote, keep only one of them.
+                        *out++ = quote;
+                        p += 2;
+                        continue;
+                    }
+
+                    ++p;
+                    terminated = true;
+                    break;
+                }
+
+                *out++ = *p++;
+            }
+
+            if (!terminated)
+            {
+                return false;
+            }
+
+            fields.emplace_back(field_begin, static_cast<size_t>(out - field_begin));
+
+            // Only blanks may follow the closing quote, any other text would
+            // be lost, so the record is malformed.
+            while (p < end && is_blank(*p))
+            {
+                ++p;
+            }
+
+            if (p < end && *p != ',')
+            {
+                return false;
+            }
+        }
+        else
+        {
+            char* field_begin = p;
+
+            while (p < end && *p != ',')
+            {
+                ++p;
+            }
+
+            char* field_end = p;
+
+            while (field_end > field_begin && is_blank(field_end[-1]))
+            {
+                --field_end;
+            }
+
+            fields.emplace_back(field_begin, static_cast<size_t>(field_end - field_begin));
+        }
+
+        if (p == end)
+        {
+            return true;
+        }
+
+        // Skip the separator.
+        ++p;
+    }
+}
+
+csv_reader::csv_reader(std::istream& input, size_t block_size)
+  : input_(input),
+    buffer_(block_size > 0 ? block_size : k_default_csv_block_size),
+    block_size_(buffer_.size()),
+    begin_(0),
+    end_(0),
+    offset_(0),
+    record_offset_(0),
+    line_(1),
+    record_line_(0),
+    eof_(false),
+    failed_(false)
+{
+}
+
+bool csv_reader::fill()
+{
+    if (eof_)
+    {
+        return false;
+    }
+
+    // Move the unprocessed data to the front of the buffer.
+    if (begin_ > 0)
+    {
+        std::memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+        offset_ += begin_;
+        end_ -= begin_;
+        begin_ = 0;
+    }
+
+    // A single record does not fit into the buffer, grow it.
+    if (buffer_.size() - end_ < block_size_ / 2)
+    {
+        buffer_.resize(buffer_.size() + block_size_);
+    }
+
+    input_.read(buffer_.data() + end_, static_cast<std::streamsize>(buffer_.size() - end_));
+    const std::streamsize count = input_.gcount();
+
+    if (count <= 0 || !input_)
+    {
+        eof_ = true;
+    }
+
+    end_ += static_cast<size_t>(std::max<std::streamsize>(count, 0));
+
+    return count > 0;
+}
+
+bool csv_reader::next(field_list& fields)
+{
+    while (!failed_)
+    {
+        char* data = buffer_.data();
+        size_t line_count = 0;
+        const char* record_end = find_record_end(data + begin_, data + end_, eof_, line_count);
+
+        if (record_end == nullptr)
+        {
+            // The record is not complete, read the next block.
+            fill();
+            continue;
+        }
+
+        char* record_begin = data + begin_;
+        char* record_stop = data + (record_end - data);
+
+        const size_t record_line = line_;
+        const size_t record_offset = offset_ + begin_;
+        line_ += line_count;
+
+        if (record_stop < data + end_)
+        {
+            // Consume the terminating line break.
+            begin_ = static_cast<size_t>(record_stop - data) + 1;
+            ++line_;
+        }
+        else
+        {
+            begin_ = end_;
+        }
+
+        if (std::all_of(record_begin, record_stop, is_blank))
+        {
+            if (record_stop == data + end_ && eof_)
+            {
+                return false;
+            }
+
+            // Skip empty lines.
+            continue;
+        }
+
+        record_line_ = record_line;
+        record_offset_ = record_offset;
+
+        if (!split_csv_record(record_begin, record_stop, fields))
+        {
+            failed_ = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    return false;
+}
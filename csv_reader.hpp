@@ -0,0 +1,113 @@
+/**
+ * @file    csv_reader.hpp
+ *
+ * @brief   Streaming CSV reader yielding field slices into its block buffer.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef CSV_READER_HPP
+#define CSV_READER_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string_view>
+
+#include "arena.hpp"
+
+// The default size of a block read from the input at once.
+constexpr size_t k_default_csv_block_size = 1 << 20;
+
+/**
+ * Function which splits a single complete CSV record into fields in place.
+ *
+ * A field may be quoted by single or double quotes. A quoted field can contain
+ * commas and line breaks, the quote character inside of it is escaped by
+ * doubling. Unquoted fields are trimmed of the surrounding white space. The
+ * escaped quotes are unescaped directly in the record memory, so the returned
+ * slices always point into the [begin, end) range and no field is copied.
+ *
+ * @param begin  The first character of the record.
+ * @param end    The character after the last character of the record (the line
+ *               break is not included).
+ * @param fields The slices of the record fields. The vector is cleared first.
+ * @return       True if the record is valid, false if a quoted field is not
+ *               terminated or its closing quote is followed by anything else
+ *               than blanks and the separator.
+ */
+bool split_csv_record(char* begin, char* end, field_list& fields);
+
+/**
+ * The streaming CSV reader.
+ *
+ * The input is read in large blocks into a reusable buffer and the records are
+ * split in place by the split_csv_record function. The returned field slices
+ * point into the buffer and stay valid until the next call of the next method.
+ * The buffer grows only if a single record is larger than the block size.
+ */
+class csv_reader
+{
+public:
+    explicit csv_reader(std::istream& input, size_t block_size = k_default_csv_block_size);
+
+    csv_reader(const csv_reader&) = delete;
+    csv_reader& operator=(const csv_reader&) = delete;
+
+    /**
+     * Reads the next record. Empty lines are skipped.
+     *
+     * @param fields The slices of the record fields.
+     * @return       True if a record was read, false at the end of the input
+     *               or if the input is malformed (see the failed method).
+     */
+    bool next(field_list& fields);
+
+    /**
+     * @return True if the reading stopped on a malformed record.
+     */
+    bool failed() const
+    {
+        return failed_;
+    }
+
+    /**
+     * @return The number of the input line on which the last read record starts.
+     */
+    size_t line_number() const
+    {
+        return record_line_;
+    }
+
+    /**
+     * @return The offset of the last read record from the position at which
+     *         the reader started to read the input (in bytes).
+     */
+    size_t record_offset() const
+    {
+        return record_offset_;
+    }
+
+private:
+    /**
+     * Moves the unprocessed data to the beginning of the buffer and reads the
+     * next block behind them.
+     *
+     * @return False if no more data can be read.
+     */
+    bool fill();
+
+    std::istream& input_;
+    std::vector<char> buffer_;
+    size_t block_size_;
+    size_t begin_;
+    size_t end_;
+    // The number of input bytes discarded from the front of the buffer.
+    size_t offset_;
+    size_t record_offset_;
+    size_t line_;
+    size_t record_line_;
+    bool eof_;
+    bool failed_;
+};
+
+#endif // CSV_READER_HPP
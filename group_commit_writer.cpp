@@ -0,0 +1,344 @@
+/**
+ * @file    group_commit_writer.cpp
+ *
+ * @brief   Single writer thread committing the concurrent writes in groups.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "group_commit_writer.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string_view>
+#include <utility>
+
+#include "arena.hpp"
+#include "lookup_cache.hpp"
+#include "staff.hpp"
+#include "statement_cache.hpp"
+#include "table_schema.hpp"
+
+group_commit_writer::group_commit_writer()
+  : p_db_(nullptr), running_(false)
+{
+}
+
+group_commit_writer::~group_commit_writer()
+{
+    stop();
+}
+
+void group_commit_writer::start(sqlite3** p_db, const group_commit_options& options)
+{
+    stop();
+
+    options_ = options;
+    options_.batch_size = std::max<size_t>(options_.batch_size, 1);
+    options_.queue_capacity = std::max<size_t>(options_.queue_capacity, 1);
+    p_db_ = p_db;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = true;
+        stats_ = group_commit_stats();
+    }
+
+    thread_ = std::thread(&group_commit_writer::run, this);
+}
+
+void group_commit_writer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!running_ && !thread_.joinable())
+        {
+            return;
+        }
+
+        running_ = false;
+    }
+
+    not_empty_.notify_all();
+    not_full_.notify_all();
+
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+
+    std::deque<request> remaining;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        remaining.swap(queue_);
+        stats_.writes_cancelled += remaining.size();
+    }
+
+    for (request& item : remaining)
+    {
+        item.result.status = task_status::cancelled;
+
+        if (item.done)
+        {
+            item.done(item.result);
+        }
+    }
+}
+
+void group_commit_writer::submit(connection_task write, write_callback done, const cancellation& cancel)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    if (!options_.reject_when_full)
+    {
+        not_full_.wait(lock, [this] { return !running_ || queue_.size() < options_.queue_capacity; });
+    }
+
+    if (!running_ || queue_.size() >= options_.queue_capacity)
+    {
+        lock.unlock();
+
+        if (done)
+        {
+            write_result result;
+            result.status = task_status::rejected;
+            done(result);
+        }
+
+        return;
+    }
+
+    queue_.push_back({std::move(write), std::move(done), cancel, write_result()});
+    lock.unlock();
+    not_empty_.notify_one();
+}
+
+std::future<write_result> group_commit_writer::submit(connection_task write, const cancellation& cancel)
+{
+    auto promise = std::make_shared<std::promise<write_result>>();
+    std::future<write_result> result = promise->get_future();
+
+    submit(std::move(write), [promise](const write_result& done) { promise->set_value(done); }, cancel);
+
+    return result;
+}
+
+write_result group_commit_writer::execute(connection_task write)
+{
+    return submit(std::move(write)).get();
+}
+
+write_result group_commit_writer::insert_record(const table_schema& schema, std::vector<std::string> values)
+{
+    return execute(insert_values_task(schema, std::move(values)));
+}
+
+size_t group_commit_writer::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+group_commit_stats group_commit_writer::stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void group_commit_writer::run()
+{
+    std::vector<request> group;
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true)
+    {
+        not_empty_.wait(lock, [this] { return !running_ || !queue_.empty(); });
+
+        if (!running_)
+        {
+            break;
+        }
+
+        // The group is collected until the window after its first write ends
+        // or the group is full.
+        if (options_.window.count() > 0 && queue_.size() < options_.batch_size)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + options_.window;
+
+            not_empty_.wait_until(lock, deadline, [this]
+            {
+                return !running_ || queue_.size() >= options_.batch_size;
+            });
+        }
+
+        while (!queue_.empty() && group.size() < options_.batch_size)
+        {
+            group.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+
+        lock.unlock();
+        not_full_.notify_all();
+
+        commit_group(group);
+        group.clear();
+
+        lock.lock();
+    }
+}
+
+void group_commit_writer::commit_group(std::vector<request>& group)
+{
+    bool success = exec_transaction_statement("BEGIN;", p_db_);
+
+    for (size_t i = 0; i < group.size() && success; ++i)
+    {
+        write_result& result = group[i].result;
+
+        if (group[i].cancel.cancelled())
+        {
+            result.status = task_status::cancelled;
+            continue;
+        }
+
+        success = exec_transaction_statement("SAVEPOINT group_write;", p_db_);
+        current_task_error() = task_error();
+
+        if (success && group[i].write(p_db_))
+        {
+            result.status = task_status::completed;
+            success = exec_transaction_statement("RELEASE group_write;", p_db_);
+        }
+        else if (success)
+        {
+            const task_error& own_error = current_task_error();
+
+            // Only the changes of the failed write are rolled back.
+            result.status = task_status::failed;
+
+            if (own_error.error_code != SQLITE_OK)
+            {
+                result.error_code = own_error.error_code;
+                result.error_message = own_error.error_message;
+            }
+            else if (sqlite3_extended_errcode(*p_db_) != SQLITE_OK)
+            {
+                result.error_code = sqlite3_extended_errcode(*p_db_);
+                result.error_message = sqlite3_errmsg(*p_db_);
+            }
+            else
+            {
+                result.error_code = SQLITE_ERROR;
+                result.error_message = "the write failed without any error";
+            }
+
+            success = exec_transaction_statement("ROLLBACK TO group_write;", p_db_) &&
+                      exec_transaction_statement("RELEASE group_write;", p_db_);
+        }
+    }
+
+    success = success && exec_transaction_statement("COMMIT;", p_db_);
+
+    if (!success)
+    {
+        const int error_code = sqlite3_extended_errcode(*p_db_);
+        const std::string error_message = sqlite3_errmsg(*p_db_);
+
+        if (!sqlite3_get_autocommit(*p_db_))
+        {
+            exec_transaction_statement("ROLLBACK;", p_db_);
+        }
+
+        // The lookups cached by the rolled back writes are dropped.
+        get_lookup_cache(*p_db_).invalidate_all();
+
+        // None of the writes of the group is durable.
+        for (request& item : group)
+        {
+            write_result& result = item.result;
+
+            // The writes which failed by themselves keep their own error.
+            const bool own_failure = (result.status == task_status::failed && !result.error_message.empty());
+
+            if (result.status != task_status::cancelled && !own_failure)
+            {
+                result.status = task_status::failed;
+                result.error_code = error_code;
+                result.error_message = "group commit failed: " + error_message;
+            }
+        }
+    }
+    else if (options_.on_commit)
+    {
+        options_.on_commit();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        stats_.groups += success ? 1 : 0;
+        stats_.largest_group = std::max(stats_.largest_group, group.size());
+
+        for (const request& item : group)
+        {
+            switch (item.result.status)
+            {
+                case task_status::completed:
+                    ++stats_.writes_committed;
+                    break;
+                case task_status::cancelled:
+                    ++stats_.writes_cancelled;
+                    break;
+                default:
+                    ++stats_.writes_failed;
+                    break;
+            }
+        }
+    }
+
+    for (request& item : group)
+    {
+        if (item.done)
+        {
+            item.done(item.result);
+        }
+    }
+}
+
+/**
+ * The function creates the task inserting the record by the prepared INSERT
+ * statement of the table (see table_sql::insert) from the statement cache of
+ * the writer connection. The values are bound by the bind_record function.
+ *
+ * @param schema The table schema.
+ * @param values The values in the order of the record columns.
+ * @return       The insert task.
+ */
+connection_task insert_values_task(const table_schema& schema, std::vector<std::string> values)
+{
+    return [&schema, values = std::move(values)](sqlite3** p_db)
+    {
+        if (values.size() != schema.record_column_count)
+        {
+            current_task_error() = task_error{SQLITE_MISUSE, "the record has " + std::to_string(values.size()) + \
+                                              " values, expected " + std::to_string(schema.record_column_count)};
+            return false;
+        }
+
+        cached_statement stmt(get_statement_cache(*p_db), get_table_sql(schema).insert);
+
+        if (!stmt)
+        {
+            return false;
+        }
+
+        scratch_arena arena;
+        const field_list cols(values.begin(), values.end(), arena.resource());
+
+        bind_record(stmt.get(), schema, cols);
+
+        return sqlite3_step(stmt.get()) == SQLITE_DONE;
+    };
+}
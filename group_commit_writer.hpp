@@ -0,0 +1,172 @@
+/**
+ * @file    group_commit_writer.hpp
+ *
+ * @brief   Single writer thread committing the concurrent writes in groups.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef GROUP_COMMIT_WRITER_HPP
+#define GROUP_COMMIT_WRITER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sqlite3.h>
+
+#include "async_task.hpp"
+
+struct table_schema;
+
+// The default maximum number of writes committed in one transaction.
+constexpr size_t k_default_group_commit_batch_size = 256;
+// The default number of writes waiting for the writer thread.
+constexpr size_t k_default_group_commit_queue_capacity = 4096;
+
+/**
+ * The result of a single write.
+ */
+struct write_result
+{
+    task_status status = task_status::failed;
+    // The extended SQLite result code of the failed write (e.g.
+    // SQLITE_CONSTRAINT_UNIQUE) or the code set by the write itself (see
+    // current_task_error), SQLITE_OK otherwise.
+    int error_code = SQLITE_OK;
+    std::string error_message;
+};
+
+/**
+ * The completion callback of a write. It is called by the writer thread.
+ */
+using write_callback = std::function<void(const write_result&)>;
+
+/**
+ * The options of the group commit writer.
+ */
+struct group_commit_options
+{
+    // How long the writer waits for more writes after the first write of a
+    // group arrived. Zero commits the writes queued at that moment.
+    std::chrono::microseconds window = std::chrono::microseconds(0);
+    // The maximum number of writes committed in one transaction.
+    size_t batch_size = k_default_group_commit_batch_size;
+    // The maximum number of writes waiting for the writer thread.
+    size_t queue_capacity = k_default_group_commit_queue_capacity;
+    // If true, a write submitted to a full queue is rejected, otherwise the
+    // submitter waits until the queue has space.
+    bool reject_when_full = false;
+    // Called by the writer thread after every committed group, before the
+    // writes of the group are completed.
+    std::function<void()> on_commit;
+};
+
+/**
+ * The statistics of the group commit writer.
+ */
+struct group_commit_stats
+{
+    uint64_t groups = 0;
+    uint64_t writes_committed = 0;
+    uint64_t writes_failed = 0;
+    uint64_t writes_cancelled = 0;
+    size_t largest_group = 0;
+};
+
+/**
+ * The writer thread which owns the writer connection and commits the writes
+ * of the concurrent submitters in groups.
+ *
+ * The writer collects the writes arrived within the window (or until the
+ * group has batch_size writes) and commits them in one transaction, so the
+ * group pays a single journal sync. Every write runs in its own savepoint,
+ * so a failed write (e.g. violating the UNIQUE Email constraint) is rolled
+ * back alone and the rest of the group is committed. A write is completed
+ * after the commit of its group, so it is durable when its submitter is
+ * notified. The writes must not begin or commit a transaction themselves.
+ */
+class group_commit_writer
+{
+public:
+    group_commit_writer();
+    ~group_commit_writer();
+
+    group_commit_writer(const group_commit_writer&) = delete;
+    group_commit_writer& operator=(const group_commit_writer&) = delete;
+
+    /**
+     * Starts the writer thread. The connection is used only by the writer
+     * thread until the writer is stopped.
+     *
+     * @param p_db    Database connection pointer.
+     * @param options The writer options.
+     */
+    void start(sqlite3** p_db, const group_commit_options& options = group_commit_options());
+
+    /**
+     * Stops the writer thread. The running group is committed, the queued
+     * writes are completed as cancelled.
+     */
+    void stop();
+
+    void submit(connection_task write, write_callback done, const cancellation& cancel = cancellation());
+    std::future<write_result> submit(connection_task write, const cancellation& cancel = cancellation());
+
+    /**
+     * Submits the write and waits until its group is committed.
+     */
+    write_result execute(connection_task write);
+
+    /**
+     * Inserts a record by a prepared INSERT without any conflict clause, so
+     * a record violating a constraint fails with the SQLite error. A record
+     * with a wrong number of values fails with SQLITE_MISUSE.
+     *
+     * @param schema The table schema.
+     * @param values The values in the order of the record columns.
+     * @return       The result of the write.
+     */
+    write_result insert_record(const table_schema& schema, std::vector<std::string> values);
+
+    size_t pending() const;
+    group_commit_stats stats() const;
+
+private:
+    struct request
+    {
+        connection_task write;
+        write_callback done;
+        cancellation cancel;
+        write_result result;
+    };
+
+    void run();
+    void commit_group(std::vector<request>& group);
+
+    group_commit_options options_;
+    sqlite3** p_db_;
+    bool running_;
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<request> queue_;
+    std::thread thread_;
+    group_commit_stats stats_;
+};
+
+/**
+ * Function which creates the insert task of a record of the table. The values
+ * are validated against and bound by the table schema, which is referenced by
+ * the task (the schemas are static objects, see schemas.hpp).
+ */
+connection_task insert_values_task(const table_schema& schema, std::vector<std::string> values);
+
+#endif // GROUP_COMMIT_WRITER_HPP
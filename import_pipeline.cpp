@@ -0,0 +1,456 @@
+/**
+ * @file    import_pipeline.cpp
+ *
+ * @brief   Parallel CSV parse/validate pipeline feeding a single writer.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "import_pipeline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "bounded_queue.hpp"
+#include "csv_reader.hpp"
+#include "lookup_cache.hpp"
+#include "staff.hpp"
+#include "statement_cache.hpp"
+
+namespace
+{
+
+// The maximum number of rejected records reported one by one.
+constexpr size_t k_max_reported_rejects = 10;
+
+using steady_clock = std::chrono::steady_clock;
+
+/**
+ * The batch of validated rows handed over from a parser to the writer. The
+ * field values are copied into a single buffer, which is reused when the
+ * batch is recycled. A new batch reserves its buffers for the batch rows by
+ * the size of its first row, so the buffers do not grow row by row.
+ */
+struct row_batch
+{
+    std::string data;
+    // The offset and the length of each field in the data buffer.
+    std::vector<std::pair<uint32_t, uint32_t>> fields;
+    size_t cols = 0;
+    size_t rows = 0;
+
+    void reserve(size_t batch_rows, const field_list& first_row)
+    {
+        size_t row_size = 0;
+
+        for (const std::string_view& field : first_row)
+        {
+            row_size += field.size();
+        }
+
+        // The rows of a batch vary in length, so twice the first one is kept.
+        data.reserve(2 * row_size * batch_rows);
+        fields.reserve(first_row.size() * batch_rows);
+    }
+
+    void clear()
+    {
+        data.clear();
+        fields.clear();
+        cols = 0;
+        rows = 0;
+    }
+};
+
+using batch_ptr = std::unique_ptr<row_batch>;
+
+/**
+ * The shared state of the pipeline threads.
+ */
+struct pipeline_context
+{
+    pipeline_context(size_t queue_depth)
+      : queue(queue_depth), failed(false), reported_rejects(0)
+    {
+    }
+
+    bounded_queue<batch_ptr> queue;
+    std::atomic<bool> failed;
+    std::atomic<size_t> reported_rejects;
+
+    // The recycled batches.
+    std::mutex pool_mutex;
+    std::vector<batch_ptr> pool;
+
+    // Serializes the messages of the parser threads.
+    std::mutex output_mutex;
+
+    batch_ptr take_batch()
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+
+        if (pool.empty())
+        {
+            return batch_ptr(new row_batch());
+        }
+
+        batch_ptr batch = std::move(pool.back());
+        pool.pop_back();
+
+        return batch;
+    }
+
+    void return_batch(batch_ptr batch)
+    {
+        batch->clear();
+
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pool.push_back(std::move(batch));
+    }
+};
+
+/**
+ * The statistics of a single parser thread.
+ */
+struct parser_result
+{
+    size_t rows_parsed = 0;
+    size_t rows_rejected = 0;
+    steady_clock::time_point finished;
+};
+
+/**
+ * Function run by a parser thread. It parses the records starting in the
+ * [start, end) byte range of the file.
+ */
+void parse_range(pipeline_context& context,
+                 const std::string& filename,
+                 size_t start,
+                 size_t end,
+                 const record_validator& validate,
+                 const import_pipeline_options& options,
+                 parser_result& result)
+{
+    std::ifstream input(filename, std::ios::binary);
+
+    if (!input.is_open())
+    {
+        std::lock_guard<std::mutex> lock(context.output_mutex);
+        std::cerr << "Error: CSV file opening failed (parser thread).\n";
+        context.failed = true;
+        context.queue.close();
+        result.finished = steady_clock::now();
+        return;
+    }
+
+    size_t aligned = start;
+
+    if (start > 0)
+    {
+        // Skip the record started in the previous range, unless the range
+        // starts right after a line break.
+        input.seekg(static_cast<std::streamoff>(start - 1));
+
+        if (input.get() != '\n')
+        {
+            input.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+
+        const std::streamoff position = input.tellg();
+        aligned = (position < 0) ? end : static_cast<size_t>(position);
+    }
+
+    if (aligned < end)
+    {
+        const size_t length = end - aligned;
+        csv_reader reader(input);
+        field_list fields;
+        std::string reason;
+        batch_ptr batch = context.take_batch();
+
+        while (!context.failed && reader.next(fields))
+        {
+            if (reader.record_offset() >= length)
+            {
+                // The record belongs to the next range.
+                break;
+            }
+
+            ++result.rows_parsed;
+
+            if (!validate(fields, reason))
+            {
+                ++result.rows_rejected;
+
+                if (context.reported_rejects++ < k_max_reported_rejects)
+                {
+                    std::lock_guard<std::mutex> lock(context.output_mutex);
+                    std::cerr << "Warning: the record at the input offset " << aligned + reader.record_offset() \
+                              << " was rejected (" << reason << ").\n";
+                }
+
+                continue;
+            }
+
+            if (batch->fields.capacity() == 0)
+            {
+                batch->reserve(options.batch_rows, fields);
+            }
+
+            batch->cols = fields.size();
+
+            for (const std::string_view& field : fields)
+            {
+                batch->fields.emplace_back(static_cast<uint32_t>(batch->data.size()),
+                                           static_cast<uint32_t>(field.size()));
+                batch->data.append(field.data(), field.size());
+            }
+
+            if (++batch->rows == options.batch_rows)
+            {
+                if (!context.queue.push(std::move(batch)))
+                {
+                    break;
+                }
+
+                batch = context.take_batch();
+            }
+        }
+
+        if (reader.failed())
+        {
+            std::lock_guard<std::mutex> lock(context.output_mutex);
+            std::cerr << "Error: malformed quoted value in the record at the input offset " \
+                      << aligned + reader.record_offset() << ".\n";
+            context.failed = true;
+        }
+        else if (batch && batch->rows > 0)
+        {
+            context.queue.push(std::move(batch));
+        }
+    }
+
+    result.finished = steady_clock::now();
+}
+
+double seconds_between(steady_clock::time_point from, steady_clock::time_point to)
+{
+    return std::chrono::duration<double>(to - from).count();
+}
+
+} // namespace
+
+bool run_import_pipeline(const std::string& filename,
+                         const std::string& insert_sql,
+                         const record_validator& validate,
+                         const record_binder& bind,
+                         const import_pipeline_options& options,
+                         sqlite3** p_db,
+                         import_pipeline_stats& stats)
+{
+    boost::system::error_code ec;
+    const size_t file_size = static_cast<size_t>(boost::filesystem::file_size(filename, ec));
+
+    if (ec)
+    {
+        std::cerr << "Error: reading the size of the file \"" << filename << "\" failed.\n";
+        return false;
+    }
+
+    size_t thread_count = options.parser_threads;
+
+    if (thread_count == 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    import_pipeline_options effective = options;
+    effective.batch_rows = std::max<size_t>(options.batch_rows, 1);
+    effective.chunk_size = std::max<size_t>(options.chunk_size, 1);
+
+    cached_statement stmt(get_statement_cache(*p_db), insert_sql);
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (pipeline insert).\n";
+        return false;
+    }
+
+    if (!exec_transaction_statement("BEGIN;", p_db))
+    {
+        return false;
+    }
+
+    // Any cached lookup may be changed by the imported records.
+    get_lookup_cache(*p_db).invalidate_all();
+
+    pipeline_context context(options.queue_depth);
+    std::vector<parser_result> results(thread_count);
+    std::vector<std::thread> parsers;
+    const steady_clock::time_point start_time = steady_clock::now();
+
+    for (size_t i = 0; i < thread_count; ++i)
+    {
+        const size_t range_start = file_size * i / thread_count;
+        const size_t range_end = file_size * (i + 1) / thread_count;
+
+        parsers.emplace_back(parse_range, std::ref(context), std::cref(filename), range_start, range_end,
+                             std::cref(validate), std::cref(effective), std::ref(results[i]));
+    }
+
+    // Close the queue after all parsers are done, so the writer stops after
+    // the last batch.
+    std::thread closer([&parsers, &context]()
+    {
+        for (std::thread& parser : parsers)
+        {
+            parser.join();
+        }
+
+        context.queue.close();
+    });
+
+    bool success = true;
+    size_t rows_in_chunk = 0;
+    field_list fields;
+    batch_ptr batch;
+
+    while (true)
+    {
+        const steady_clock::time_point wait_start = steady_clock::now();
+
+        if (!context.queue.pop(batch))
+        {
+            stats.write_wait_seconds += seconds_between(wait_start, steady_clock::now());
+            break;
+        }
+
+        const steady_clock::time_point busy_start = steady_clock::now();
+        stats.write_wait_seconds += seconds_between(wait_start, busy_start);
+        ++stats.batches;
+
+        for (size_t row = 0; success && row < batch->rows; ++row)
+        {
+            fields.clear();
+
+            for (size_t col = 0; col < batch->cols; ++col)
+            {
+                const std::pair<uint32_t, uint32_t>& field = batch->fields[row * batch->cols + col];
+                fields.emplace_back(batch->data.data() + field.first, field.second);
+            }
+
+            bind(stmt.get(), fields);
+
+            if (sqlite3_step(stmt.get()) != SQLITE_DONE)
+            {
+                std::cerr << "Error: inserting record failed (pipeline writer).\n";
+                std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+                success = false;
+                break;
+            }
+
+            if (sqlite3_changes(*p_db) > 0)
+            {
+                ++stats.rows_inserted;
+            }
+            else
+            {
+                ++stats.rows_skipped;
+            }
+
+            sqlite3_reset(stmt.get());
+
+            if (++rows_in_chunk == effective.chunk_size)
+            {
+                success = exec_transaction_statement("COMMIT;", p_db) && exec_transaction_statement("BEGIN;", p_db);
+
+                if (success)
+                {
+                    ++stats.chunks_committed;
+                    rows_in_chunk = 0;
+                }
+            }
+        }
+
+        context.return_batch(std::move(batch));
+        stats.write_busy_seconds += seconds_between(busy_start, steady_clock::now());
+
+        if (!success)
+        {
+            // Stop the parsers, they are waiting on the full queue.
+            context.failed = true;
+            context.queue.close();
+            break;
+        }
+    }
+
+    closer.join();
+
+    success = success && !context.failed;
+
+    if (success)
+    {
+        const steady_clock::time_point commit_start = steady_clock::now();
+        success = exec_transaction_statement("COMMIT;", p_db);
+        stats.write_busy_seconds += seconds_between(commit_start, steady_clock::now());
+
+        if (success && rows_in_chunk > 0)
+        {
+            ++stats.chunks_committed;
+        }
+    }
+    else if (!sqlite3_get_autocommit(*p_db))
+    {
+        exec_transaction_statement("ROLLBACK;", p_db);
+    }
+
+    stats.parser_threads = thread_count;
+    steady_clock::time_point parse_end = start_time;
+
+    for (const parser_result& result : results)
+    {
+        stats.rows_parsed += result.rows_parsed;
+        stats.rows_rejected += result.rows_rejected;
+        parse_end = std::max(parse_end, result.finished);
+    }
+
+    stats.parse_seconds = seconds_between(start_time, parse_end);
+    stats.elapsed_seconds = seconds_between(start_time, steady_clock::now());
+
+    return success;
+}
+
+void print_import_pipeline_stats(const import_pipeline_stats& stats)
+{
+    const auto per_second = [](size_t rows, double seconds) -> size_t
+    {
+        return (seconds > 0.0) ? static_cast<size_t>(static_cast<double>(rows) / seconds) : 0;
+    };
+
+    const size_t rows_written = stats.rows_inserted + stats.rows_skipped;
+
+    std::cout << "Info: Pipeline import finished. Rows parsed: " << stats.rows_parsed \
+              << ", rejected: " << stats.rows_rejected \
+              << ", inserted: " << stats.rows_inserted \
+              << ", skipped (already exist): " << stats.rows_skipped \
+              << ", batches: " << stats.batches \
+              << ", committed chunks: " << stats.chunks_committed << ".\n";
+    std::cout << "Info: Parse stage (" << stats.parser_threads << " threads): " << stats.parse_seconds << " s (" \
+              << per_second(stats.rows_parsed, stats.parse_seconds) << " rows/s).\n";
+    std::cout << "Info: Write stage: " << stats.write_busy_seconds << " s busy (" \
+              << per_second(rows_written, stats.write_busy_seconds) << " rows/s), " \
+              << stats.write_wait_seconds << " s waiting for parsers.\n";
+    std::cout << "Info: Pipeline import took " << stats.elapsed_seconds << " s (" \
+              << per_second(stats.rows_parsed, stats.elapsed_seconds) << " rows/s).\n";
+    std::cout << "-----------------------------------------------------------------------\n";
+}
@@ -0,0 +1,112 @@
+/**
+ * @file    import_pipeline.hpp
+ *
+ * @brief   Parallel CSV parse/validate pipeline feeding a single writer.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef IMPORT_PIPELINE_HPP
+#define IMPORT_PIPELINE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sqlite3.h>
+
+#include "arena.hpp"
+
+// The default number of row batches waiting for the writer.
+constexpr size_t k_default_queue_depth = 16;
+// The default number of rows in a batch handed over from a parser to the writer.
+constexpr size_t k_default_batch_rows = 1024;
+
+/**
+ * Function validating a parsed record. If the record is not valid, the reason
+ * is stored into the second parameter.
+ */
+using record_validator = std::function<bool(const field_list&, std::string&)>;
+
+/**
+ * Function binding a parsed record to the parameters of the INSERT statement.
+ */
+using record_binder = std::function<void(sqlite3_stmt*, const field_list&)>;
+
+/**
+ * The options of the import pipeline.
+ */
+struct import_pipeline_options
+{
+    // The number of parser threads, zero means the number of hardware threads.
+    size_t parser_threads = 0;
+    // The maximum number of row batches waiting for the writer.
+    size_t queue_depth = k_default_queue_depth;
+    // The number of rows in a batch handed over from a parser to the writer.
+    size_t batch_rows = k_default_batch_rows;
+    // The number of rows committed in one transaction.
+    size_t chunk_size = 10000;
+};
+
+/**
+ * The statistics of the import pipeline stages.
+ */
+struct import_pipeline_stats
+{
+    size_t parser_threads = 0;
+    size_t rows_parsed = 0;
+    size_t rows_rejected = 0;
+    size_t rows_inserted = 0;
+    size_t rows_skipped = 0;
+    size_t batches = 0;
+    size_t chunks_committed = 0;
+    // The time from the start until the last parser finished.
+    double parse_seconds = 0.0;
+    // The time the writer spent inserting and committing rows.
+    double write_busy_seconds = 0.0;
+    // The time the writer spent waiting for the parsers.
+    double write_wait_seconds = 0.0;
+    double elapsed_seconds = 0.0;
+};
+
+/**
+ * Function which imports the CSV file by a parallel pipeline.
+ *
+ * The file is split into byte ranges aligned to line breaks, one range per
+ * parser thread. The parsers validate the records and pass them in batches
+ * through a bounded queue to the writer, which runs in the calling thread
+ * (the only thread touching the database connection). The writer inserts the
+ * rows by a single prepared statement in transactions of chunk_size rows.
+ * Rejected records are reported to stderr and skipped. The lookup cache of
+ * the connection is invalidated before the first insert.
+ *
+ * Because the ranges are aligned to line breaks, the quoted values of the
+ * imported file must not contain line breaks. The order of the inserted rows
+ * is not the order of the file.
+ *
+ * @param filename   The imported CSV file.
+ * @param insert_sql The INSERT statement with one parameter per column.
+ * @param validate   The record validation function.
+ * @param bind       The function binding a record to the INSERT statement.
+ * @param options    The pipeline options.
+ * @param p_db       Database connection pointer.
+ * @param stats      The collected statistics of the import.
+ * @return           True if the import was done successfully, false if an
+ *                   error occurs.
+ */
+bool run_import_pipeline(const std::string& filename,
+                         const std::string& insert_sql,
+                         const record_validator& validate,
+                         const record_binder& bind,
+                         const import_pipeline_options& options,
+                         sqlite3** p_db,
+                         import_pipeline_stats& stats);
+
+/**
+ * Function which prints the statistics of the import pipeline to stdout.
+ *
+ * @param stats The statistics collected by the run_import_pipeline function.
+ */
+void print_import_pipeline_stats(const import_pipeline_stats& stats);
+
+#endif // IMPORT_PIPELINE_HPP
@@ -0,0 +1,636 @@
+/**
+ * @file    incremental_import.cpp
+ *
+ * @brief   Resumable CSV import applying only the changed chunks of the input.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "incremental_import.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "arena.hpp"
+#include "csv_reader.hpp"
+#include "instrumentation.hpp"
+#include "lookup_cache.hpp"
+#include "staff.hpp"
+#include "statement_cache.hpp"
+
+namespace
+{
+
+// The maximum number of rejected records reported one by one.
+constexpr size_t k_max_reported_rejects = 10;
+// A chunk ends at the latest after this multiple of the average records.
+constexpr size_t k_max_chunk_factor = 4;
+
+// The 64-bit FNV-1a hash of the record values.
+constexpr uint64_t k_fnv_offset_basis = 14695981039346656037ULL;
+constexpr uint64_t k_fnv_prime = 1099511628211ULL;
+// The separators hashed behind a value and behind a record.
+constexpr char k_value_separator = '\x1f';
+constexpr char k_record_separator = '\x1e';
+
+// The state of the last import run of every table and the chunks
+// checkpointed by the runs.
+const char* const k_checkpoint_tables_sql =
+    "CREATE TABLE IF NOT EXISTS ImportRun ("
+    "TableName VARCHAR(255) PRIMARY KEY, "
+    "Generation INTEGER NOT NULL, "
+    "Completed INTEGER NOT NULL);"
+    "CREATE TABLE IF NOT EXISTS ImportCheckpoint ("
+    "TableName VARCHAR(255) NOT NULL, "
+    "Generation INTEGER NOT NULL, "
+    "ChunkOffset INTEGER NOT NULL, "
+    "RowCount INTEGER NOT NULL, "
+    "ChunkHash INTEGER NOT NULL, "
+    "PRIMARY KEY (TableName, Generation, ChunkOffset)) WITHOUT ROWID;";
+
+uint64_t hash_bytes(uint64_t hash, const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * k_fnv_prime;
+    }
+
+    return hash;
+}
+
+/**
+ * The chunk of the input. The record values are copied into a single buffer,
+ * which is reused by the next chunk.
+ */
+struct input_chunk
+{
+    uint64_t offset = 0;
+    uint64_t hash = 0;
+    size_t rows = 0;
+    std::string values;
+    // The end of every value in the values buffer.
+    std::vector<size_t> value_ends;
+    // The number of the values read behind every record.
+    std::vector<size_t> row_ends;
+
+    void clear()
+    {
+        hash = k_fnv_offset_basis;
+        rows = 0;
+        values.clear();
+        value_ends.clear();
+        row_ends.clear();
+    }
+
+    /**
+     * Returns the slices of the values of the record.
+     */
+    void record(size_t row, field_list& cols) const
+    {
+        size_t value = (row > 0) ? row_ends[row - 1] : 0;
+        size_t begin = (value > 0) ? value_ends[value - 1] : 0;
+
+        cols.clear();
+
+        for (; value < row_ends[row]; ++value)
+        {
+            cols.emplace_back(values.data() + begin, value_ends[value] - begin);
+            begin = value_ends[value];
+        }
+    }
+};
+
+/**
+ * The reader splitting the CSV input into the chunks by the content of the
+ * records, see the incremental_import function.
+ */
+class chunk_reader
+{
+public:
+    chunk_reader(std::istream& input, uint64_t start_offset, size_t chunk_rows)
+      : reader_(input), start_offset_(start_offset), chunk_rows_(std::max<size_t>(chunk_rows, 1))
+    {
+    }
+
+    /**
+     * Reads the next chunk.
+     *
+     * @return False at the end of the input or if the input is malformed
+     *         (see the failed method).
+     */
+    bool read(input_chunk& chunk)
+    {
+        chunk.clear();
+
+        while (reader_.next(fields_))
+        {
+            if (chunk.rows == 0)
+            {
+                chunk.offset = start_offset_ + reader_.record_offset();
+            }
+
+            uint64_t record_hash = k_fnv_offset_basis;
+
+            for (const std::string_view& field : fields_)
+            {
+                record_hash = hash_bytes(record_hash, field.data(), field.size());
+                record_hash = hash_bytes(record_hash, &k_value_separator, 1);
+                chunk.values.append(field.data(), field.size());
+                chunk.value_ends.push_back(chunk.values.size());
+            }
+
+            record_hash = hash_bytes(record_hash, &k_record_separator, 1);
+            chunk.hash = hash_bytes(chunk.hash, reinterpret_cast<const char*>(&record_hash), sizeof(record_hash));
+            chunk.row_ends.push_back(chunk.value_ends.size());
+            ++chunk.rows;
+
+            if (record_hash % chunk_rows_ == 0 || chunk.rows == k_max_chunk_factor * chunk_rows_)
+            {
+                break;
+            }
+        }
+
+        return chunk.rows > 0;
+    }
+
+    bool failed() const
+    {
+        return reader_.failed();
+    }
+
+    size_t line_number() const
+    {
+        return reader_.line_number();
+    }
+
+private:
+    csv_reader reader_;
+    uint64_t start_offset_;
+    size_t chunk_rows_;
+    field_list fields_;
+};
+
+/**
+ * The last import run of a table.
+ */
+struct import_run
+{
+    bool exists = false;
+    int64_t generation = 0;
+    bool completed = false;
+};
+
+/**
+ * The last checkpointed chunk of an import run.
+ */
+struct import_checkpoint
+{
+    bool exists = false;
+    uint64_t offset = 0;
+    uint64_t hash = 0;
+    size_t rows = 0;
+};
+
+/**
+ * Function which binds the table name and the generation to the first two
+ * parameters of the statement.
+ */
+void bind_run(sqlite3_stmt* stmt, std::string_view table_name, int64_t generation)
+{
+    sqlite3_bind_text(stmt, 1, table_name.data(), static_cast<int>(table_name.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, generation);
+}
+
+bool read_import_run(std::string_view table_name, sqlite3** p_db, import_run& run)
+{
+    cached_statement stmt(get_statement_cache(*p_db),
+                          "SELECT Generation, Completed FROM ImportRun WHERE TableName = ?;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (import run).\n";
+        return false;
+    }
+
+    sqlite3_bind_text(stmt.get(), 1, table_name.data(), static_cast<int>(table_name.size()), SQLITE_STATIC);
+
+    const int status = sqlite3_step(stmt.get());
+
+    if (status == SQLITE_ROW)
+    {
+        run.exists = true;
+        run.generation = sqlite3_column_int64(stmt.get(), 0);
+        run.completed = sqlite3_column_int(stmt.get(), 1) != 0;
+    }
+    else if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error: executing SQL statement failed (import run).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool write_import_run(std::string_view table_name, int64_t generation, bool completed, sqlite3** p_db)
+{
+    cached_statement stmt(get_statement_cache(*p_db),
+                          "INSERT OR REPLACE INTO ImportRun (TableName, Generation, Completed) VALUES (?, ?, ?);");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (import run).\n";
+        return false;
+    }
+
+    bind_run(stmt.get(), table_name, generation);
+    sqlite3_bind_int(stmt.get(), 3, completed ? 1 : 0);
+
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE)
+    {
+        std::cerr << "Error: executing SQL statement failed (import run).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Function which reads the hashes of the chunks checkpointed by the run.
+ */
+bool read_chunk_hashes(std::string_view table_name, int64_t generation, sqlite3** p_db,
+                       std::unordered_set<uint64_t>& hashes)
+{
+    cached_statement stmt(get_statement_cache(*p_db),
+                          "SELECT ChunkHash FROM ImportCheckpoint WHERE TableName = ? AND Generation = ?;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (import checkpoints).\n";
+        return false;
+    }
+
+    bind_run(stmt.get(), table_name, generation);
+
+    int status;
+
+    while ((status = sqlite3_step(stmt.get())) == SQLITE_ROW)
+    {
+        hashes.insert(static_cast<uint64_t>(sqlite3_column_int64(stmt.get(), 0)));
+    }
+
+    if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error: executing SQL statement failed (import checkpoints).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool read_last_checkpoint(std::string_view table_name, int64_t generation, sqlite3** p_db,
+                          import_checkpoint& checkpoint)
+{
+    cached_statement stmt(get_statement_cache(*p_db),
+                          "SELECT ChunkOffset, ChunkHash, RowCount FROM ImportCheckpoint "
+                          "WHERE TableName = ? AND Generation = ? ORDER BY ChunkOffset DESC LIMIT 1;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (import checkpoints).\n";
+        return false;
+    }
+
+    bind_run(stmt.get(), table_name, generation);
+
+    const int status = sqlite3_step(stmt.get());
+
+    if (status == SQLITE_ROW)
+    {
+        checkpoint.exists = true;
+        checkpoint.offset = static_cast<uint64_t>(sqlite3_column_int64(stmt.get(), 0));
+        checkpoint.hash = static_cast<uint64_t>(sqlite3_column_int64(stmt.get(), 1));
+        checkpoint.rows = static_cast<size_t>(sqlite3_column_int64(stmt.get(), 2));
+    }
+    else if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error: executing SQL statement failed (import checkpoints).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Function which deletes the checkpoints of the runs older than the
+ * generation (or of the generation itself if the last parameter is true).
+ */
+bool delete_checkpoints(std::string_view table_name, int64_t generation, bool including, sqlite3** p_db)
+{
+    cached_statement stmt(get_statement_cache(*p_db), including ?
+        "DELETE FROM ImportCheckpoint WHERE TableName = ? AND Generation <= ?;" :
+        "DELETE FROM ImportCheckpoint WHERE TableName = ? AND Generation < ?;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (import checkpoints).\n";
+        return false;
+    }
+
+    bind_run(stmt.get(), table_name, generation);
+
+    if (sqlite3_step(stmt.get()) != SQLITE_DONE)
+    {
+        std::cerr << "Error: executing SQL statement failed (import checkpoints).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool write_checkpoint(sqlite3_stmt* stmt, std::string_view table_name, int64_t generation,
+                      const input_chunk& chunk, sqlite3** p_db)
+{
+    bind_run(stmt, table_name, generation);
+    sqlite3_bind_int64(stmt, 3, static_cast<int64_t>(chunk.offset));
+    sqlite3_bind_int64(stmt, 4, static_cast<int64_t>(chunk.rows));
+    sqlite3_bind_int64(stmt, 5, static_cast<int64_t>(chunk.hash));
+
+    const int status = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+
+    if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error: checkpointing the chunk at the offset " << chunk.offset << " failed.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Function which applies the records of the chunk by the upsert statement.
+ * The records violating a constraint other than the key are rejected, the
+ * rest of the chunk is applied.
+ */
+bool apply_chunk(sqlite3_stmt* stmt, const table_schema& schema, const input_chunk& chunk, sqlite3** p_db,
+                 field_list& cols, incremental_import_stats& stats)
+{
+    for (size_t row = 0; row < chunk.rows; ++row)
+    {
+        chunk.record(row, cols);
+
+        if (cols.size() != schema.record_column_count)
+        {
+            std::cerr << "Error: unexpected number of columns in the record " << row + 1 \
+                      << " of the chunk at the offset " << chunk.offset << ".\n";
+            return false;
+        }
+
+        bind_record(stmt, schema, cols);
+
+        // An updated record does not change the last inserted row ID, the
+        // inserted one gets a positive ID.
+        sqlite3_set_last_insert_rowid(*p_db, 0);
+
+        const int status = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+
+        if (status == SQLITE_DONE)
+        {
+            if (sqlite3_changes(*p_db) == 0)
+            {
+                ++stats.rows_unchanged;
+            }
+            else if (sqlite3_last_insert_rowid(*p_db) > 0)
+            {
+                ++stats.rows_inserted;
+            }
+            else
+            {
+                ++stats.rows_updated;
+            }
+        }
+        else if ((status & 0xff) == SQLITE_CONSTRAINT)
+        {
+            // Only the failed record is rolled back by SQLite.
+            if (++stats.rows_rejected <= k_max_reported_rejects)
+            {
+                std::cerr << "Error: record " << row + 1 << " of the chunk at the offset " << chunk.offset \
+                          << " rejected.\n";
+                std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            }
+        }
+        else
+        {
+            std::cerr << "Error: applying the record " << row + 1 << " of the chunk at the offset " \
+                      << chunk.offset << " into the " << schema.name << " table failed.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool incremental_import(const table_schema& schema,
+                        const std::string& filename,
+                        const incremental_import_options& options,
+                        sqlite3** p_db,
+                        incremental_import_stats& stats)
+{
+    scoped_timer timer(operation::incremental_import);
+
+    const auto start_time = std::chrono::steady_clock::now();
+    std::ifstream input(filename, std::ios::binary);
+
+    if (!input.is_open())
+    {
+        std::cerr << "Error: opening the imported file \"" << filename << "\" failed.\n";
+        return false;
+    }
+
+    char* err_msg = nullptr;
+
+    if (sqlite3_exec(*p_db, k_checkpoint_tables_sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+    {
+        std::cerr << "Error: executing SQL statement failed (import checkpoint tables).\n";
+        std::cerr << "Error message: " << err_msg << "\n";
+        sqlite3_free(err_msg);
+        return false;
+    }
+
+    const std::string_view table_name = schema.name;
+    import_run run;
+    std::unordered_set<uint64_t> known_hashes;
+
+    if (!read_import_run(table_name, p_db, run))
+    {
+        return false;
+    }
+
+    // An interrupted run is continued, otherwise a new run compares the
+    // chunks with the last completed one.
+    const bool continued = run.exists && !run.completed;
+    stats.generation = continued ? run.generation : run.generation + 1;
+
+    if (stats.generation > 1 && !read_chunk_hashes(table_name, stats.generation - 1, p_db, known_hashes))
+    {
+        return false;
+    }
+
+    std::unique_ptr<chunk_reader> reader(new chunk_reader(input, 0, options.chunk_rows));
+    input_chunk chunk;
+    import_checkpoint checkpoint;
+
+    if (continued && !read_last_checkpoint(table_name, stats.generation, p_db, checkpoint))
+    {
+        return false;
+    }
+
+    if (checkpoint.exists)
+    {
+        // The last checkpointed chunk is read again. If the input still
+        // contains it, the reading continues behind it.
+        input.seekg(static_cast<std::streamoff>(checkpoint.offset));
+        reader.reset(new chunk_reader(input, checkpoint.offset, options.chunk_rows));
+
+        stats.resumed = input.good() && reader->read(chunk) && chunk.offset == checkpoint.offset &&
+                        chunk.hash == checkpoint.hash && chunk.rows == checkpoint.rows;
+
+        if (stats.resumed)
+        {
+            stats.start_offset = checkpoint.offset;
+        }
+        else
+        {
+            input.clear();
+            input.seekg(0);
+            reader.reset(new chunk_reader(input, 0, options.chunk_rows));
+        }
+    }
+
+    // The checkpoints of the run are replaced unless the run is resumed.
+    if (!stats.resumed && (!delete_checkpoints(table_name, stats.generation, true, p_db) ||
+                           !write_import_run(table_name, stats.generation, false, p_db)))
+    {
+        return false;
+    }
+
+    // Any cached lookup may be changed by the applied records.
+    get_lookup_cache(*p_db).invalidate_all();
+
+    const table_sql& sql = get_table_sql(schema);
+    cached_statement upsert_stmt(get_statement_cache(*p_db), sql.upsert + ";");
+    cached_statement checkpoint_stmt(get_statement_cache(*p_db),
+        "INSERT OR REPLACE INTO ImportCheckpoint (TableName, Generation, ChunkOffset, RowCount, ChunkHash) "
+        "VALUES (?, ?, ?, ?, ?);");
+
+    if (!upsert_stmt || !checkpoint_stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (incremental import).\n";
+        return false;
+    }
+
+    // The checkpoints of the skipped chunks are committed together with the
+    // next applied chunk, so only the applied chunks pay a commit.
+    bool success = exec_transaction_statement("BEGIN;", p_db);
+    field_list cols;
+
+    while (success && reader->read(chunk))
+    {
+        const bool changed = (known_hashes.count(chunk.hash) == 0);
+
+        if (changed && options.max_applied_chunks > 0 && stats.chunks_applied == options.max_applied_chunks)
+        {
+            stats.interrupted = true;
+            break;
+        }
+
+        ++stats.chunks_read;
+        stats.rows_read += chunk.rows;
+
+        if (!changed)
+        {
+            ++stats.chunks_skipped;
+            success = write_checkpoint(checkpoint_stmt.get(), table_name, stats.generation, chunk, p_db);
+            continue;
+        }
+
+        success = apply_chunk(upsert_stmt.get(), schema, chunk, p_db, cols, stats) &&
+                  write_checkpoint(checkpoint_stmt.get(), table_name, stats.generation, chunk, p_db) &&
+                  exec_transaction_statement("COMMIT;", p_db) &&
+                  exec_transaction_statement("BEGIN;", p_db);
+
+        if (success)
+        {
+            ++stats.chunks_applied;
+        }
+    }
+
+    if (success && reader->failed())
+    {
+        std::cerr << "Error: malformed quoted value in the record on the input line " \
+                  << reader->line_number() << ".\n";
+        success = false;
+    }
+
+    // The completed run replaces the checkpoints of the previous one.
+    if (success && !stats.interrupted)
+    {
+        success = write_import_run(table_name, stats.generation, true, p_db) &&
+                  delete_checkpoints(table_name, stats.generation, false, p_db);
+    }
+
+    if (success)
+    {
+        success = exec_transaction_statement("COMMIT;", p_db);
+    }
+    else if (!sqlite3_get_autocommit(*p_db))
+    {
+        exec_transaction_statement("ROLLBACK;", p_db);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    stats.elapsed_seconds = elapsed.count();
+
+    return success;
+}
+
+void print_incremental_import_stats(const incremental_import_stats& stats)
+{
+    const double rows_per_second = (stats.elapsed_seconds > 0.0) ?
+        static_cast<double>(stats.rows_read) / stats.elapsed_seconds : 0.0;
+
+    std::cout << "Info: Incremental import run " << stats.generation;
+
+    if (stats.resumed)
+    {
+        std::cout << " (resumed from the offset " << stats.start_offset << ")";
+    }
+
+    std::cout << (stats.interrupted ? " stopped" : " finished") << ". Chunks read: " << stats.chunks_read \
+              << ", skipped (unchanged): " << stats.chunks_skipped \
+              << ", applied: " << stats.chunks_applied << ".\n";
+    std::cout << "Info: Rows read: " << stats.rows_read \
+              << ", inserted: " << stats.rows_inserted \
+              << ", updated: " << stats.rows_updated \
+              << ", unchanged: " << stats.rows_unchanged \
+              << ", rejected: " << stats.rows_rejected << ".\n";
+    std::cout << "Info: Incremental import took " << stats.elapsed_seconds << " s (" \
+              << static_cast<size_t>(rows_per_second) << " rows/s).\n";
+    std::cout << "-----------------------------------------------------------------------\n";
+}
@@ -0,0 +1,102 @@
+/**
+ * @file    incremental_import.hpp
+ *
+ * @brief   Resumable CSV import applying only the changed chunks of the input.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef INCREMENTAL_IMPORT_HPP
+#define INCREMENTAL_IMPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sqlite3.h>
+
+#include "table_schema.hpp"
+
+// The default average number of records in a checkpointed chunk.
+constexpr size_t k_default_checkpoint_rows = 1024;
+
+/**
+ * The options of the incremental import.
+ */
+struct incremental_import_options
+{
+    // The average number of records in a chunk. A chunk is at most four
+    // times longer.
+    size_t chunk_rows = k_default_checkpoint_rows;
+    // The import stops after this number of applied chunks as if it was
+    // interrupted, zero means no limit.
+    size_t max_applied_chunks = 0;
+};
+
+/**
+ * The statistics of the incremental import.
+ */
+struct incremental_import_stats
+{
+    // The number of the import run, the chunks are checkpointed per run.
+    int64_t generation = 0;
+    // True if the import continued the interrupted run.
+    bool resumed = false;
+    // The input offset from which the records were read (in bytes).
+    uint64_t start_offset = 0;
+    size_t chunks_read = 0;
+    // The chunks found unchanged in the last completed run.
+    size_t chunks_skipped = 0;
+    size_t chunks_applied = 0;
+    size_t rows_read = 0;
+    size_t rows_inserted = 0;
+    size_t rows_updated = 0;
+    // The rows of the applied chunks equal to the stored records.
+    size_t rows_unchanged = 0;
+    // The rows violating a constraint other than the key (e.g. a phone
+    // number of another person).
+    size_t rows_rejected = 0;
+    // True if the import stopped before the end of the input.
+    bool interrupted = false;
+    double elapsed_seconds = 0.0;
+};
+
+/**
+ * Function which imports the CSV file into the table incrementally.
+ *
+ * The input is split into chunks by the content of the records (a record
+ * whose hash matches the chunk_rows modulus ends a chunk), so a record
+ * inserted into or removed from the input changes only the chunk containing
+ * it. The offset, the length and the content hash of every chunk are
+ * checkpointed in the ImportCheckpoint table in the same transaction which
+ * applies the chunk. A chunk whose hash was checkpointed by the last
+ * completed run is skipped without touching the table, the records of the
+ * other chunks are applied by the upsert of the schema (see table_sql::upsert),
+ * so only the new and changed records are written.
+ *
+ * If the previous run was interrupted, the import continues behind its last
+ * checkpointed chunk, provided the chunk is still the same in the input.
+ * Otherwise the run starts from the beginning of the input again. Records
+ * removed from the input are not deleted from the table.
+ *
+ * @param schema   The schema of the table, its key identifies the records.
+ * @param filename The imported CSV file.
+ * @param options  The import options.
+ * @param p_db     Database connection pointer.
+ * @param stats    The collected statistics of the import.
+ * @return         True if the import was done successfully (or stopped by
+ *                 the max_applied_chunks option), false if an error occurs.
+ */
+bool incremental_import(const table_schema& schema,
+                        const std::string& filename,
+                        const incremental_import_options& options,
+                        sqlite3** p_db,
+                        incremental_import_stats& stats);
+
+/**
+ * Function which prints the statistics of the incremental import to stdout.
+ *
+ * @param stats The statistics collected by the incremental_import function.
+ */
+void print_incremental_import_stats(const incremental_import_stats& stats);
+
+#endif // INCREMENTAL_IMPORT_HPP
@@ -0,0 +1,447 @@
+/**
+ * @file    instrumentation.cpp
+ *
+ * @brief   Latency histograms of the Staff operations and SQL statements.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "instrumentation.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace
+{
+
+const char* const k_operation_names[k_operation_count] = {
+    "insert_record",
+    "person_exists",
+    "bulk_load",
+    "print_table",
+    "select_salary",
+    "select_last_name",
+    "update_phone",
+    "incremental_import",
+    "parallel_scan",
+    "search",
+    "page_query"
+};
+
+/**
+ * Function which increments the counter written only by the calling thread.
+ */
+inline void add_relaxed(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+/**
+ * The profile of a statement recorded by a single thread.
+ */
+struct statement_profile
+{
+    explicit statement_profile(const char* sql_text)
+      : sql(sql_text), full_scan_steps(0), sorts(0), vm_steps(0)
+    {
+    }
+
+    const std::string sql;
+    latency_histogram latency;
+    std::atomic<uint64_t> full_scan_steps;
+    std::atomic<uint64_t> sorts;
+    std::atomic<uint64_t> vm_steps;
+};
+
+/**
+ * The running execution of a statement handle.
+ */
+struct statement_run
+{
+    statement_profile* profile = nullptr;
+    std::chrono::steady_clock::time_point start;
+    bool started = false;
+};
+
+/**
+ * The instruments of a single thread. The histograms and counters are
+ * written only by the owning thread. The list of the statement profiles is
+ * guarded by the mutex, because it is iterated by the snapshots, the lookup
+ * maps are touched only by the owning thread.
+ */
+struct thread_instruments
+{
+    std::array<latency_histogram, k_operation_count> operations;
+
+    std::mutex statements_mutex;
+    std::list<statement_profile> statements;
+
+    // The statement handles may be reused for a different SQL text after a
+    // finalization, so the SQL text of a found profile is compared.
+    std::unordered_map<sqlite3_stmt*, statement_run> by_stmt;
+    std::unordered_map<std::string, statement_profile*> by_sql;
+};
+
+/**
+ * The instruments of all threads. They are kept until the program exits, so
+ * the latencies recorded by finished threads are not lost.
+ */
+struct instruments_registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<thread_instruments>> threads;
+};
+
+instruments_registry& get_registry()
+{
+    static instruments_registry registry;
+    return registry;
+}
+
+thread_instruments& local_instruments()
+{
+    thread_local thread_instruments* instruments = nullptr;
+
+    if (instruments == nullptr)
+    {
+        instruments_registry& registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+
+        registry.threads.push_back(std::make_unique<thread_instruments>());
+        instruments = registry.threads.back().get();
+    }
+
+    return *instruments;
+}
+
+statement_run& find_statement_run(thread_instruments& instruments, sqlite3_stmt* stmt, const char* sql)
+{
+    statement_run& run = instruments.by_stmt[stmt];
+
+    if (run.profile != nullptr && run.profile->sql == sql)
+    {
+        return run;
+    }
+
+    statement_profile*& profile = instruments.by_sql[sql];
+
+    if (profile == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(instruments.statements_mutex);
+
+        instruments.statements.emplace_back(sql);
+        profile = &instruments.statements.back();
+    }
+
+    run.profile = profile;
+    run.started = false;
+
+    return run;
+}
+
+/**
+ * The SQLITE_TRACE_STMT and SQLITE_TRACE_PROFILE callback.
+ * 
+ * The profile event carries the execution time measured by the VFS clock,
+ * which has only a millisecond resolution on Unix, so the execution is timed
+ * from the statement event by the steady clock when it was observed.
+ */
+int profile_callback(unsigned type, void*, void* p, void* x)
+{
+    sqlite3_stmt* stmt = static_cast<sqlite3_stmt*>(p);
+    const char* sql = sqlite3_sql(stmt);
+
+    if (sql == nullptr)
+    {
+        return 0;
+    }
+
+    if (type == SQLITE_TRACE_STMT)
+    {
+        // The trigger programs are reported with a "--" comment, they are a 
+        // part of the running statement.
+        const char* text = static_cast<const char*>(x);
+
+        if (text == nullptr || text[0] != '-' || text[1] != '-')
+        {
+            statement_run& run = find_statement_run(local_instruments(), stmt, sql);
+            run.start = std::chrono::steady_clock::now();
+            run.started = true;
+        }
+
+        return 0;
+    }
+
+    if (type != SQLITE_TRACE_PROFILE)
+    {
+        return 0;
+    }
+
+    statement_run& run = find_statement_run(local_instruments(), stmt, sql);
+    uint64_t latency_ns = static_cast<uint64_t>(*static_cast<sqlite3_int64*>(x));
+
+    if (run.started)
+    {
+        latency_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - run.start).count());
+        run.started = false;
+    }
+
+    statement_profile& profile = *run.profile;
+
+    profile.latency.record(latency_ns);
+
+    // The counters are reset, so they cover the finished execution only.
+    add_relaxed(profile.full_scan_steps,
+                static_cast<uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1)));
+    add_relaxed(profile.sorts, static_cast<uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1)));
+    add_relaxed(profile.vm_steps, static_cast<uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1)));
+
+    return 0;
+}
+
+/**
+ * Function which formats the latency summary of the histogram in
+ * microseconds.
+ */
+std::string format_latency(const histogram_snapshot& snapshot)
+{
+    std::ostringstream ss;
+
+    ss << std::fixed << std::setprecision(1) \
+       << snapshot.count << " calls, mean " << snapshot.mean() / 1e3 \
+       << " us, p50 " << snapshot.percentile(50.0) / 1e3 \
+       << " us, p99 " << snapshot.percentile(99.0) / 1e3 \
+       << " us, max " << snapshot.max / 1e3 << " us";
+
+    return ss.str();
+}
+
+} // namespace
+
+const char* operation_name(operation op)
+{
+    return k_operation_names[static_cast<size_t>(op)];
+}
+
+latency_histogram::latency_histogram()
+  : count_(0), sum_(0), min_(std::numeric_limits<uint64_t>::max()), max_(0)
+{
+    for (std::atomic<uint64_t>& bucket : buckets_)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void latency_histogram::record(uint64_t value)
+{
+    add_relaxed(buckets_[bucket_index(value)], 1);
+    add_relaxed(count_, 1);
+    add_relaxed(sum_, value);
+
+    if (value < min_.load(std::memory_order_relaxed))
+    {
+        min_.store(value, std::memory_order_relaxed);
+    }
+
+    if (value > max_.load(std::memory_order_relaxed))
+    {
+        max_.store(value, std::memory_order_relaxed);
+    }
+}
+
+uint64_t latency_histogram::bucket_value(size_t index)
+{
+    if (index < k_exact_values)
+    {
+        return index;
+    }
+
+    const unsigned shift = static_cast<unsigned>(index / k_sub_buckets - 1);
+    const uint64_t lowest = (k_sub_buckets + index % k_sub_buckets) << shift;
+
+    return lowest + ((uint64_t(1) << shift) >> 1);
+}
+
+void histogram_snapshot::merge(const latency_histogram& histogram)
+{
+    const uint64_t histogram_count = histogram.count_.load(std::memory_order_relaxed);
+
+    if (histogram_count == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < latency_histogram::k_bucket_count; ++i)
+    {
+        buckets[i] += histogram.buckets_[i].load(std::memory_order_relaxed);
+    }
+
+    const uint64_t histogram_min = histogram.min_.load(std::memory_order_relaxed);
+    const uint64_t histogram_max = histogram.max_.load(std::memory_order_relaxed);
+
+    min = (count == 0) ? histogram_min : std::min(min, histogram_min);
+    max = std::max(max, histogram_max);
+    count += histogram_count;
+    sum += histogram.sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t histogram_snapshot::percentile(double percentile) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // The nearest rank of the percentile.
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(percentile / 100.0 * count + 0.5));
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < buckets.size(); ++i)
+    {
+        seen += buckets[i];
+
+        if (seen >= rank)
+        {
+            return std::min(std::max(latency_histogram::bucket_value(i), min), max);
+        }
+    }
+
+    return max;
+}
+
+double histogram_snapshot::mean() const
+{
+    return (count > 0) ? static_cast<double>(sum) / count : 0.0;
+}
+
+void set_instrumentation_enabled(bool enabled)
+{
+    instrumentation_flag().store(enabled, std::memory_order_relaxed);
+}
+
+void record_operation_latency(operation op, uint64_t latency_ns)
+{
+    local_instruments().operations[static_cast<size_t>(op)].record(latency_ns);
+}
+
+bool enable_statement_profiling(sqlite3* db)
+{
+    if (sqlite3_trace_v2(db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, profile_callback, nullptr) != SQLITE_OK)
+    {
+        std::cerr << "Error: registering the statement profiling failed.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+void disable_statement_profiling(sqlite3* db)
+{
+    sqlite3_trace_v2(db, 0, nullptr, nullptr);
+}
+
+histogram_snapshot snapshot_operation(operation op)
+{
+    instruments_registry& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    histogram_snapshot snapshot;
+
+    for (const auto& instruments : registry.threads)
+    {
+        snapshot.merge(instruments->operations[static_cast<size_t>(op)]);
+    }
+
+    return snapshot;
+}
+
+std::vector<statement_snapshot> snapshot_statements()
+{
+    instruments_registry& registry = get_registry();
+    std::lock_guard<std::mutex> registry_lock(registry.mutex);
+
+    std::map<std::string, statement_snapshot> merged;
+
+    for (const auto& instruments : registry.threads)
+    {
+        std::lock_guard<std::mutex> lock(instruments->statements_mutex);
+
+        for (const statement_profile& profile : instruments->statements)
+        {
+            statement_snapshot& snapshot = merged[profile.sql];
+
+            snapshot.sql = profile.sql;
+            snapshot.latency.merge(profile.latency);
+            snapshot.full_scan_steps += profile.full_scan_steps.load(std::memory_order_relaxed);
+            snapshot.sorts += profile.sorts.load(std::memory_order_relaxed);
+            snapshot.vm_steps += profile.vm_steps.load(std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<statement_snapshot> statements;
+
+    for (auto& entry : merged)
+    {
+        statements.push_back(std::move(entry.second));
+    }
+
+    // The statements taking the most time in total are first.
+    std::sort(statements.begin(), statements.end(),
+              [](const statement_snapshot& a, const statement_snapshot& b)
+              {
+                  return a.latency.sum > b.latency.sum;
+              });
+
+    return statements;
+}
+
+void dump_instrumentation(std::ostream& output)
+{
+    output << "Info: Operation latencies:\n";
+
+    for (size_t i = 0; i < k_operation_count; ++i)
+    {
+        const histogram_snapshot snapshot = snapshot_operation(static_cast<operation>(i));
+
+        if (snapshot.count > 0)
+        {
+            output << "  " << k_operation_names[i] << ": " << format_latency(snapshot) << "\n";
+        }
+    }
+
+    output << "Info: Statement profiles:\n";
+
+    for (const statement_snapshot& statement : snapshot_statements())
+    {
+        output << "  " << statement.sql << "\n" \
+               << "    " << format_latency(statement.latency) \
+               << ", full scan steps " << statement.full_scan_steps \
+               << ", sorts " << statement.sorts \
+               << ", VM steps " << statement.vm_steps << "\n";
+    }
+
+    output << "-----------------------------------------------------------------------\n";
+}
+
+void dump_instrumentation_at_exit()
+{
+    // The registry is created before the handler is registered, so it is
+    // destroyed after the handler runs.
+    get_registry();
+
+    std::atexit([]()
+    {
+        dump_instrumentation(std::cerr);
+    });
+}
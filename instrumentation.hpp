@@ -0,0 +1,235 @@
+/**
+ * @file    instrumentation.hpp
+ *
+ * @brief   Latency histograms of the Staff operations and SQL statements.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+/**
+ * The instrumented operations.
+ */
+enum class operation
+{
+    insert_record,
+    person_exists,
+    bulk_load,
+    print_table,
+    select_salary,
+    select_last_name,
+    update_phone,
+    incremental_import,
+    parallel_scan,
+    search,
+    page_query,
+    count
+};
+
+constexpr size_t k_operation_count = static_cast<size_t>(operation::count);
+
+/**
+ * Function which returns the name of the operation used in the reports.
+ */
+const char* operation_name(operation op);
+
+/**
+ * The log-linear (HDR-style) histogram of latencies in nanoseconds.
+ *
+ * The values below 16 ns have their own buckets, every larger power of two
+ * is split into 8 buckets, so the relative error of a reported value is at
+ * most 1/16. The histogram has a single writer (its thread), so the counters
+ * are updated by relaxed loads and stores without any lock or atomic
+ * read-modify-write. The readers may observe a histogram in the middle of an
+ * update, which only skews a snapshot by a single value.
+ */
+class latency_histogram
+{
+public:
+    static constexpr size_t k_exact_values = 16;
+    static constexpr size_t k_sub_buckets = 8;
+    // The exact values take the first two groups of sub-buckets, every most
+    // significant bit from 4 to 63 one group.
+    static constexpr size_t k_bucket_count = (64 - 2) * k_sub_buckets;
+
+    latency_histogram();
+
+    latency_histogram(const latency_histogram&) = delete;
+    latency_histogram& operator=(const latency_histogram&) = delete;
+
+    void record(uint64_t value);
+
+    static constexpr size_t bucket_index(uint64_t value)
+    {
+        if (value < k_exact_values)
+        {
+            return static_cast<size_t>(value);
+        }
+
+        // The three bits below the most significant one select the sub-bucket.
+        const unsigned msb = 63 - static_cast<unsigned>(__builtin_clzll(value));
+        const unsigned shift = msb - 3;
+
+        return (shift + 1) * k_sub_buckets + static_cast<size_t>((value >> shift) - k_sub_buckets);
+    }
+
+    // The middle of the range of values stored in the bucket.
+    static uint64_t bucket_value(size_t index);
+
+private:
+    friend struct histogram_snapshot;
+
+    std::array<std::atomic<uint64_t>, k_bucket_count> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+static_assert(latency_histogram::bucket_index(UINT64_MAX) < latency_histogram::k_bucket_count,
+              "the largest value has to fall into a bucket");
+
+/**
+ * The merged copy of histograms.
+ */
+struct histogram_snapshot
+{
+    std::vector<uint64_t> buckets = std::vector<uint64_t>(latency_histogram::k_bucket_count, 0);
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = 0;
+    uint64_t max = 0;
+
+    void merge(const latency_histogram& histogram);
+
+    /**
+     * @param percentile The percentile in the range 0-100.
+     * @return           The latency of the percentile in nanoseconds.
+     */
+    uint64_t percentile(double percentile) const;
+    double mean() const;
+};
+
+/**
+ * The execution profile of a single SQL statement.
+ */
+struct statement_snapshot
+{
+    std::string sql;
+    histogram_snapshot latency;
+    uint64_t full_scan_steps = 0;
+    uint64_t sorts = 0;
+    uint64_t vm_steps = 0;
+};
+
+/**
+ * Enables or disables the recording of the operation latencies. The disabled
+ * timers do not read the clock. The statement profiling is enabled per
+ * connection by enable_statement_profiling.
+ */
+void set_instrumentation_enabled(bool enabled);
+
+inline std::atomic<bool>& instrumentation_flag()
+{
+    static std::atomic<bool> enabled(false);
+    return enabled;
+}
+
+inline bool instrumentation_enabled()
+{
+    return instrumentation_flag().load(std::memory_order_relaxed);
+}
+
+/**
+ * Records the latency of the operation into the histogram of the calling
+ * thread.
+ *
+ * @param op         The operation.
+ * @param latency_ns The latency in nanoseconds.
+ */
+void record_operation_latency(operation op, uint64_t latency_ns);
+
+/**
+ * The RAII timer which records the latency of the enclosing scope. The
+ * timer created while the instrumentation is disabled does nothing.
+ */
+class scoped_timer
+{
+public:
+    explicit scoped_timer(operation op)
+      : op_(op), enabled_(instrumentation_enabled())
+    {
+        if (enabled_)
+        {
+            start_ = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~scoped_timer()
+    {
+        if (enabled_)
+        {
+            const auto elapsed = std::chrono::steady_clock::now() - start_;
+            record_operation_latency(op_, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+
+private:
+    operation op_;
+    bool enabled_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * Registers the SQLITE_TRACE_STMT and SQLITE_TRACE_PROFILE callback on the
+ * connection. The callback records the execution time of every statement
+ * together with its sqlite3_stmt_status counters (full scan steps, sorts and
+ * VM steps).
+ *
+ * @param db Database connection.
+ * @return   True if the callback was registered, false otherwise.
+ */
+bool enable_statement_profiling(sqlite3* db);
+
+/**
+ * Removes the profiling callback from the connection.
+ *
+ * @param db Database connection.
+ */
+void disable_statement_profiling(sqlite3* db);
+
+/**
+ * Functions which merge the histograms of all threads.
+ */
+histogram_snapshot snapshot_operation(operation op);
+std::vector<statement_snapshot> snapshot_statements();
+
+/**
+ * Prints the latencies of the operations and statements recorded so far.
+ *
+ * @param output The stream of the report.
+ */
+void dump_instrumentation(std::ostream& output);
+
+/**
+ * Prints the report to stderr when the program exits.
+ */
+void dump_instrumentation_at_exit();
+
+#endif // INSTRUMENTATION_HPP
@@ -0,0 +1,295 @@
+/**
+ * @file    lookup_cache.cpp
+ *
+ * @brief   Connection-scoped read-through cache of the Staff lookups.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "lookup_cache.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include "connection_registry.hpp"
+
+namespace
+{
+
+// The initial number of slots, it has to be a power of two.
+constexpr size_t k_initial_slots = 64;
+// The fixed memory accounted for every entry besides its key and value.
+constexpr size_t k_entry_overhead = 64;
+
+// The caches of all opened connections.
+connection_registry<lookup_cache> registry;
+std::atomic<size_t> registry_budget(k_default_lookup_cache_budget);
+
+uint64_t hash_key(std::string_view key)
+{
+    return std::hash<std::string_view>()(key);
+}
+
+} // namespace
+
+lookup_cache::lookup_cache(size_t budget)
+  : slots_(k_initial_slots), size_(0), bytes_(0), budget_(budget), hand_(0), epoch_(0), hits_(0), misses_(0),
+    evictions_(0), invalidations_(0)
+{
+}
+
+const std::string* lookup_cache::find(std::string_view key)
+{
+    const size_t index = find_slot(key, hash_key(key));
+
+    if (!slots_[index].used)
+    {
+        ++misses_;
+        return nullptr;
+    }
+
+    if (slots_[index].epoch != epoch_)
+    {
+        // The entry was invalidated by a write.
+        remove_at(index);
+        ++misses_;
+        return nullptr;
+    }
+
+    ++hits_;
+    slots_[index].referenced = true;
+
+    return &slots_[index].value;
+}
+
+void lookup_cache::insert(std::string_view key, std::string value)
+{
+    const size_t needed = key.size() + value.size() + k_entry_overhead;
+
+    if (needed > budget_)
+    {
+        erase(key);
+        return;
+    }
+
+    const uint64_t hash = hash_key(key);
+    size_t index = find_slot(key, hash);
+
+    if (slots_[index].used)
+    {
+        // Replace the previous value.
+        remove_at(index);
+    }
+
+    while (size_ > 0 && bytes_ + needed > budget_)
+    {
+        evict_one();
+    }
+
+    // The load factor is kept under one half, so the probes stay short.
+    if ((size_ + 1) * 2 > slots_.size())
+    {
+        grow();
+    }
+
+    index = find_slot(key, hash);
+
+    slot& entry = slots_[index];
+    entry.used = true;
+    entry.referenced = false;
+    entry.hash = hash;
+    entry.epoch = epoch_;
+    entry.key.assign(key.data(), key.size());
+    entry.value = std::move(value);
+
+    ++size_;
+    bytes_ += entry_bytes(entry);
+}
+
+void lookup_cache::erase(std::string_view key)
+{
+    const size_t index = find_slot(key, hash_key(key));
+
+    if (slots_[index].used)
+    {
+        remove_at(index);
+        ++invalidations_;
+    }
+}
+
+void lookup_cache::invalidate_all()
+{
+    if (size_ > 0)
+    {
+        ++epoch_;
+        ++invalidations_;
+    }
+}
+
+void lookup_cache::clear()
+{
+    slots_.assign(k_initial_slots, slot());
+    size_ = 0;
+    bytes_ = 0;
+    hand_ = 0;
+}
+
+void lookup_cache::set_budget(size_t budget)
+{
+    budget_ = budget;
+
+    while (size_ > 0 && bytes_ > budget_)
+    {
+        evict_one();
+    }
+}
+
+size_t lookup_cache::size() const
+{
+    return size_;
+}
+
+size_t lookup_cache::bytes() const
+{
+    return bytes_;
+}
+
+size_t lookup_cache::budget() const
+{
+    return budget_;
+}
+
+uint64_t lookup_cache::hits() const
+{
+    return hits_;
+}
+
+uint64_t lookup_cache::misses() const
+{
+    return misses_;
+}
+
+uint64_t lookup_cache::evictions() const
+{
+    return evictions_;
+}
+
+uint64_t lookup_cache::invalidations() const
+{
+    return invalidations_;
+}
+
+size_t lookup_cache::find_slot(std::string_view key, uint64_t hash) const
+{
+    const size_t mask = slots_.size() - 1;
+    size_t index = home(hash);
+
+    while (slots_[index].used && (slots_[index].hash != hash || slots_[index].key != key))
+    {
+        index = (index + 1) & mask;
+    }
+
+    return index;
+}
+
+size_t lookup_cache::home(uint64_t hash) const
+{
+    return static_cast<size_t>(hash) & (slots_.size() - 1);
+}
+
+size_t lookup_cache::entry_bytes(const slot& entry) const
+{
+    return entry.key.size() + entry.value.size() + k_entry_overhead;
+}
+
+void lookup_cache::remove_at(size_t index)
+{
+    const size_t mask = slots_.size() - 1;
+
+    bytes_ -= entry_bytes(slots_[index]);
+    --size_;
+
+    // Shift the following entries of the probe sequence back, so no
+    // tombstone is needed.
+    size_t next = (index + 1) & mask;
+
+    while (slots_[next].used)
+    {
+        const size_t next_home = home(slots_[next].hash);
+
+        // The entry can move to the free slot if its home is not in the
+        // cyclic range (index, next].
+        const bool movable = (index <= next) ? (next_home <= index || next_home > next)
+                                             : (next_home <= index && next_home > next);
+
+        if (movable)
+        {
+            slots_[index] = std::move(slots_[next]);
+            index = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+
+    slots_[index] = slot();
+}
+
+void lookup_cache::evict_one()
+{
+    const size_t mask = slots_.size() - 1;
+
+    // Every referenced entry is skipped at most once, so an entry is found in
+    // two sweeps.
+    for (size_t i = 0; i < 2 * slots_.size(); ++i)
+    {
+        slot& entry = slots_[hand_];
+
+        if (entry.used)
+        {
+            if (entry.referenced && entry.epoch == epoch_)
+            {
+                entry.referenced = false;
+            }
+            else
+            {
+                // The hand stays, the slot may receive a shifted entry.
+                remove_at(hand_);
+                ++evictions_;
+                return;
+            }
+        }
+
+        hand_ = (hand_ + 1) & mask;
+    }
+}
+
+void lookup_cache::grow()
+{
+    std::vector<slot> previous(slots_.size() * 2);
+    previous.swap(slots_);
+    hand_ = 0;
+
+    for (slot& entry : previous)
+    {
+        if (entry.used)
+        {
+            slots_[find_slot(entry.key, entry.hash)] = std::move(entry);
+        }
+    }
+}
+
+void set_lookup_cache_budget(size_t budget)
+{
+    registry_budget = budget;
+}
+
+lookup_cache& get_lookup_cache(sqlite3* db)
+{
+    return registry.get(db, [] { return std::make_unique<lookup_cache>(registry_budget.load()); });
+}
+
+void release_lookup_cache(sqlite3* db)
+{
+    registry.release(db);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file    lookup_cache.hpp
+ *
+ * @brief   Connection-scoped read-through cache of the Staff lookups.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef LOOKUP_CACHE_HPP
+#define LOOKUP_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sqlite3.h>
+
+// The default memory budget of the cache of a connection in bytes.
+constexpr size_t k_default_lookup_cache_budget = 16 * 1024 * 1024;
+
+/**
+ * The cache of the lookup results keyed by the lookup key (e.g. the last
+ * name of the last name query).
+ *
+ * The entries are stored in an open-addressing hash table with linear probing
+ * and backward-shift deletion. The memory of the keys and values is limited by
+ * the budget, the entries over the budget are evicted by the CLOCK algorithm
+ * (an entry found since the last sweep survives it).
+ *
+ * The writes invalidate either the exact keys they affect (erase) or all
+ * entries at once (invalidate_all), which only increments the epoch, so the
+ * stale entries are dropped lazily when they are looked up or swept.
+ *
+ * The cache is not synchronized, it is used only by the owner of its
+ * connection. The writes made by other connections are not observed.
+ */
+class lookup_cache
+{
+public:
+    explicit lookup_cache(size_t budget);
+
+    lookup_cache(const lookup_cache&) = delete;
+    lookup_cache& operator=(const lookup_cache&) = delete;
+
+    /**
+     * Finds the value of the key.
+     *
+     * @param key The lookup key.
+     * @return    The cached value, nullptr if the key is not cached. The value
+     *            is valid until the cache is modified.
+     */
+    const std::string* find(std::string_view key);
+
+    /**
+     * Inserts or replaces the value of the key. The value larger than the
+     * whole budget is not cached.
+     */
+    void insert(std::string_view key, std::string value);
+
+    void erase(std::string_view key);
+    void invalidate_all();
+    void clear();
+
+    /**
+     * Changes the budget, the entries over the new budget are evicted. The
+     * budget of zero disables the cache.
+     */
+    void set_budget(size_t budget);
+
+    size_t size() const;
+    size_t bytes() const;
+    size_t budget() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+    uint64_t evictions() const;
+    uint64_t invalidations() const;
+
+private:
+    struct slot
+    {
+        bool used = false;
+        bool referenced = false;
+        uint64_t hash = 0;
+        uint64_t epoch = 0;
+        std::string key;
+        std::string value;
+    };
+
+    size_t find_slot(std::string_view key, uint64_t hash) const;
+    size_t home(uint64_t hash) const;
+    size_t entry_bytes(const slot& entry) const;
+    void remove_at(size_t index);
+    void evict_one();
+    void grow();
+
+    std::vector<slot> slots_;
+    size_t size_;
+    size_t bytes_;
+    size_t budget_;
+    size_t hand_;
+    uint64_t epoch_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t evictions_;
+    uint64_t invalidations_;
+};
+
+/**
+ * Sets the budget used for the lookup caches created from now on.
+ *
+ * @param budget The memory budget of the cache of a connection in bytes.
+ */
+void set_lookup_cache_budget(size_t budget);
+
+/**
+ * Returns the lookup cache of the database connection. The cache is created
+ * on the first use. The caches recently looked up by the thread are returned
+ * without a lock (see connection_registry).
+ *
+ * @param db Database connection.
+ * @return   The lookup cache bound to the connection.
+ */
+lookup_cache& get_lookup_cache(sqlite3* db);
+
+/**
+ * Destroys the lookup cache of the database connection. It has to be called
+ * before the connection is closed.
+ *
+ * @param db Database connection.
+ */
+void release_lookup_cache(sqlite3* db);
+
+#endif // LOOKUP_CACHE_HPP
@@ -6,24 +6,27 @@
  * @author  David Chocholaty
  */
 
-#include <boost/filesystem.hpp>
-#include <cstdlib> // std::remove
+#include <cstdlib> // std::strtoull
+#include <cstring> // std::strcmp
 #include <fstream>
 #include <iostream>
-#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 #include <sqlite3.h>
 
-// The expected number of provided columns to save record into a table.
-constexpr int k_expected_cols = 8;
-// Indexes of the columns containing the specific attributes.
-constexpr int k_first_name_idx = 0;
-constexpr int k_last_name_idx = 3;
-constexpr int k_phone_num_idx = 6;
-
-// A flag which handles print of the table header only before the first table 
-// record is printed.
-bool headers_printed_flag = false;
+#include "binary_snapshot.hpp"
+#include "connection_config.hpp"
+#include "import_pipeline.hpp"
+#include "incremental_import.hpp"
+#include "instrumentation.hpp"
+#include "lookup_cache.hpp"
+#include "online_backup.hpp"
+#include "output_sink.hpp"
+#include "staff.hpp"
+#include "statement_cache.hpp"
+#include "table_schema.hpp"
 
 /**
  * The error codes enumeration for the whole program.
@@ -37,568 +40,79 @@ enum error_code
     sqlite_generic_error = 4,
     table_deletion_error = 5,
     file_open_error = 6,
-    unknown_error = 7
+    unknown_error = 7,
+    argument_error = 8,
+    query_plan_error = 9,
+    snapshot_error = 10,
+    backup_error = 11
 };
 
 /**
- * Function check if the file containing the database scheme already exists.
- * 
- * @param db_filename Name of the file containing the database scheme.
- * @return            True if the database exists, false otherwise.
- */
-bool database_exists(const std::string& db_filename)
-{
-    boost::filesystem::path path_to_db(db_filename);
-
-    return boost::filesystem::exists(path_to_db);
-}
-
-/**
- * Function which creates the database scheme.
- * 
- * If the file containing the scheme already exists, this database is used 
- * instead of creating a new one.
- * 
- * @param db_filename Name of the file containing the database scheme.
- * @param p_db        Database connection pointer.
- * @return            True if all sub-tasks were done successfully, false if 
- *                    an error occurs.
+ * The program options obtained from the command line arguments.
  */
-bool create_database(const std::string& db_filename, sqlite3** p_db)
+struct program_options
 {
-    // Check if the database already exists. If yes, load the database from the file.
-    if (database_exists(db_filename))
-    {
-        std::cout << "The database \"" << db_filename << "\" already exists. Loading an existing database.\n";
-
-        int status = sqlite3_open(db_filename.c_str(), p_db);
-
-        if (status != SQLITE_OK)
-        {
-            std::cerr << "Error: loading the database \"" << db_filename << "\" failed.\n";
-            return false;
-        }
-
-        std::cout << "Info: The database \"" << db_filename << "\" loaded successfully.\n";
-    }
-    else
-    {
-        // The database does not exist. Create a new one.
-        int status = sqlite3_open(db_filename.c_str(), p_db);
-    
-        if (status != SQLITE_OK)
-        {
-            std::cerr << "Error: creating the database \"" << db_filename << "\" failed.\n";
-            return false;
-        }
-
-        std::cout << "Info: The database \"" << db_filename << "\" created successfully.\n";
-    }
-
-    std::cout << "-----------------------------------------------------------------------\n";
-
-    return true;
-}
-
-/**
- * Function which creates the chosen custom table.
- * 
- * If the table already exists in the database, do not create a new one.
- * 
- * @param table_name    The name of a table to create.
- * @param table_columns Comma-separated list of table columns headers.
- * @param p_db          Database connection pointer.
- * @return              True if all sub-tasks were done successfully, false if 
- *                      an error occurs.
- */
-bool create_table(const std::string table_name, const std::string table_columns, sqlite3** p_db)
-{
-    char* err_msg = nullptr;    
-
-    sqlite3_stmt* stmt;
-    const std::string table_exists_sql = "SELECT name FROM sqlite_master WHERE type='table' AND name=?;";
-
-    int status = sqlite3_prepare_v2(*p_db, table_exists_sql.c_str(), -1, &stmt, nullptr);
-
-    if (status != SQLITE_OK)
-    {
-        std::cerr << "Error: preparing SQL statement failed (table existence check).\n";
-        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
-        return false;
-    }
-
-    sqlite3_bind_text(stmt, 1, table_name.c_str(), -1, SQLITE_STATIC);
-
-    status = sqlite3_step(stmt);
-
-    if (status == SQLITE_ROW)
-    {
-        // The table already exists. Use this table instead of creating a new one.
-        sqlite3_finalize(stmt);
-        std::cout << "The table \"" << table_name << "\" already exists. The new table was not created.\n";
-    }
-    else if (status == SQLITE_DONE)
-    {
-        // The table does not exist: create it.
-        sqlite3_finalize(stmt);
-
-        std::string create_table_sql = "CREATE TABLE " + table_name + " (" + table_columns +  ");";
-
-        status = sqlite3_exec(*p_db, create_table_sql.c_str(), nullptr, 0, &err_msg);
-
-        if (status != SQLITE_OK)
-        {
-            std::cerr << "Error: executing SQL statement failed (table creation).\n";
-            std::cerr << "Error message: " << err_msg << "\n";
-            sqlite3_free(err_msg);
-            return false;
-        }
-
-        std::cout << "Info: The table was created successfully.\n";
-    }
-    else
-    {
-        std::cerr << "Error: executing SQL statement failed (table existence check).\n";
-        return false;
-    }
-
-    std::cout << "-----------------------------------------------------------------------\n";
-    
-    return true;
-}
-
-/**
- * Function which parses the comma-separated list of values from a single line.
- * 
- * @param line The line which contains a comma-separated list of values.
- * @return     Returns the input line parsed into a vector.
- */
-std::vector<std::string> parse_csv_line(const std::string& line)
-{
-    std::vector<std::string> cols;
-    std::stringstream ss(line);
-    std::string col;
-
-    while (std::getline(ss, col, ','))
-    {
-        size_t start = col.find_first_not_of(" \t\n\r'");
-        size_t end = col.find_last_not_of(" \t\n\r'");
-
-        if (start != std::string::npos && end != std::string::npos) {
-            cols.push_back(col.substr(start, end - start + 1));
-        } else {
-            cols.push_back("");
-        }
-    }
-
-    return cols;
-}
-
-/**
- * The function checks if the records with a person already exist in the table.
- * 
- * The person is checked based on the FirstName, LastName and PhoneNum which 
- * has to be unique in the table, so the person too.
- * 
- * @param table_name     The name of a table in which the person will be searched.
- * @param columns_values Comma-separated list of values in the same order as 
- *                       table headers.
- * @param p_db           Database connection pointer.
- * @return               True if a person already exists, false otherwise.
- */
-bool person_exists(const std::string table_name,
-                   const std::string columns_values,
-                   sqlite3** p_db)
-{
-    const std::string select_person_sql = "SELECT COUNT(*) FROM " + table_name + \
-        " WHERE FirstName = ? AND LastName = ? AND PhoneNum = ?;";
-    
-    sqlite3_stmt* stmt;
-    int status = sqlite3_prepare_v2(*p_db, select_person_sql.c_str(), -1, &stmt, nullptr);
-
-    if (status != SQLITE_OK)
-    {
-        std::cerr << "Error: preparing SQL statement failed (person existence check).\n";
-        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
-        return false;
-    }
-
-    std::vector<std::string> cols = parse_csv_line(columns_values);
-
-    if (cols.size() != k_expected_cols) {
-        std::cerr << "Error: unexpected number of columns.\n";
-        return false;
-    }
-
-    const std::string first_name = cols[k_first_name_idx];
-    const std::string last_name = cols[k_last_name_idx];
-    const std::string phone_num = cols[k_phone_num_idx];
-
-    // Bind parameters.
-    sqlite3_bind_text(stmt, 1, first_name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, last_name.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 3, phone_num.c_str(), -1, SQLITE_STATIC);
-
-    status = sqlite3_step(stmt);
-
-    if (status != SQLITE_ROW) {
-        std::cerr << "Error: executing SQL statement failed (person existence check).\n";
-        return false;
-    }
-
-    int person_count = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-
-    return (person_count > 0);
-}
-
-/**
- * The function inserts a record with a person into the table.
- * 
- * If the person already exists in the table, nothing is done.
- * @param table_name           The name of a table into which the person will 
- *                             be inserted.
- * @param table_columns_values Comma-separated list of table headers.
- * @param columns_values       Comma-separated list of values in the same order
- *                             as table headers.
- * @param p_db                 Database connection pointer.
- * @return                     True if all sub-tasks were done successfully, false if 
- *                             an error occurs.
- */
-bool insert_table_record(const std::string table_name, const std::string table_columns_names,
-                         const std::string columns_values, sqlite3** p_db)
-{
-    // Check if the person exists in the table.
-    if (person_exists(table_name, columns_values, p_db))
-    {
-        std::cout << "The inserted person already exists.\n";
-    }
-    else
-    {
-        // The person is not in the table, insert the record.
-        char* err_msg = nullptr;
-        const std::string insert_record_sql = "INSERT INTO " + table_name + " (" + table_columns_names + \
-            ") VALUES (" + columns_values + ");";
-
-        int status = sqlite3_exec(*p_db, insert_record_sql.c_str(), nullptr, nullptr, &err_msg);
-
-        if (status != SQLITE_OK) {
-            std::cerr << "Error: inserting record into the " << table_name << " table.\n";
-            std::cerr << "Error message: " << err_msg << "\n";
-            sqlite3_free(err_msg);
-            return false;
-        }
-
-        std::cout << "Info: The record was inserted successfully into the " << table_name << " table.\n";
-    }
-    
-    std::cout << "-----------------------------------------------------------------------\n";
-
-    return true;
-}
-
-/**
- * The function which prints the results of a query.
- * 
- * It is expected that this function is called only from the callbacks 
- * functions. This function prints before the first record of the table headers
- * and then the table records one by one.
- * 
- * @param argc        Number of arguments.
- * @param argv        The obtained data from the table query (table records).
- * @param az_col_name The list of column headers.
- */
-void print_query_result(int argc, char** argv, char** az_col_name)
-{
-    // Print column names.
-    if (!headers_printed_flag)
-    {
-        for (int i = 0; i < argc; ++i)
-        {
-            std::cout << az_col_name[i] << " | ";
-        }
-
-        std::cout << "\n\n";        
-
-        headers_printed_flag = true;
-    }
-
-    // Print each row.
-    for (int i = 0; i < argc; ++i)
-    {
-        std::cout << (argv[i] ? argv[i] : "NULL") << " | ";
-    }
-
-    std::cout << "\n";
-}
-
-/**
- * Callback function for the SQL execution in the print_table function.
- * 
- * @param data        Generic void pointer. For now, it is unused.
- * @param argc        Number of arguments.
- * @param argv        The obtained data from the table query (table records).
- * @param az_col_name The list of column headers.
- * @return            Returns zero status after all sub-tasks are done.
- */
-int callback_print(void* data, int argc, char** argv, char** az_col_name)
-{
-    print_query_result(argc, argv, az_col_name);
-    
-    return 0;
-}
-
-/**
- * The function executes the SQL statement for printing the complete table to stdout.
- * 
- * @param table_name    The name of a table to print.
- * @param p_db          Database connection pointer.
- */
-bool print_table(const std::string table_name, sqlite3** p_db)
-{
-    char* err_msg = nullptr;
-
-    const std::string table_select_sql = "SELECT * FROM Staff";
-
-    int status = sqlite3_exec(*p_db, table_select_sql.c_str(), callback_print, nullptr, &err_msg);
-    if (status != SQLITE_OK)
-    {
-        std::cerr << "Error: table " << table_name << " select failed.\n";
-        std::cerr << "Error message: " << err_msg << "\n";
-        sqlite3_free(err_msg);
-        return false;
-    }
-
-    std::cout << "-----------------------------------------------------------------------\n";
-
-    return true;
-}
-
-/**
- * Callback function for the SQL execution in the select_salary_threshold 
- * function.
- * 
- * @param data        Generic void pointer. For now, it is unused.
- * @param argc        Number of arguments.
- * @param argv        The obtained data from the table query (table records).
- * @param az_col_name The list of column headers.
- * @return            Returns zero status after all sub-tasks are done.
- */
-int callback_salary(void* data, int argc, char** argv, char** az_col_name)
-{   
-    // Print column names.
-    print_query_result(argc, argv, az_col_name);
-
-    return 0;
-}
-
-/**
- * The function executes the query to obtain records with people, who have a 
- * salary greater or equal to a specific threshold provided by the parameter.
- * 
- * @param table_name    The name of a table.
- * @param threshold     Salary threshold value.
- * @param p_db          Database connection pointer.
- */
-bool select_salary_threshold(const std::string table_name, int threshold, sqlite3** p_db)
-{
-    char* err_msg = nullptr;
-    const std::string select_salary_sql = "SELECT * FROM " + table_name + " WHERE Salary >= " + std::to_string(threshold) + ";";    
-
-    int status = sqlite3_exec(*p_db, select_salary_sql.c_str(), callback_salary, nullptr, &err_msg);
-
-    if (status != SQLITE_OK)
-    {
-        std::cerr << "Error: executing SQL statement failed (salaries query).\n";
-        std::cerr << "Error message: " << err_msg << "\n";
-        sqlite3_free(err_msg);
-        return false;
-    }
-
-    std::cout << "-----------------------------------------------------------------------\n";
-
-    return true;
-}
-
-/**
- * Callback for the select_by_last_name function. It prints the result to stdout.
- * 
- * @param data        Generic void pointer. For now, it is unused.
- * @param argc        Number of arguments.
- * @param argv        The obtained data from the table query (table records).
- * @param az_col_name The list of column headers.
- * @return            Returns zero status after all sub-tasks are done.
- */
-int callback_last_name(void* data, int argc, char** argv, char** az_col_name)
-{
-    // Print column names.
-    print_query_result(argc, argv, az_col_name);
-
-    return 0;
-}
-
-/**
- * The function runs a query to obtain people who have a specific last name.
- * 
- * @param table_name Name of a table in which the people will be searched.
- * @param last_name  Searched last name.
- * @param p_db       Database connection pointer.
-*/
-bool select_by_last_name(const std::string table_name, const std::string last_name, sqlite3** p_db)
-{
-    char* err_msg = nullptr;
-    const std::string select_name_sql = "SELECT * FROM " + table_name + " WHERE LastName = '" + last_name + "';";
-
-    int status = sqlite3_exec(*p_db, select_name_sql.c_str(), callback_last_name, nullptr, &err_msg);
-
-    if (status != SQLITE_OK)
-    {
-        std::cerr << "Error: executing SQL statement failed (last name query).\n";
-        std::cerr << "Error message: " << err_msg << "\n";
-        sqlite3_free(err_msg);
-        return false;
-    }
-
-    std::cout << "-----------------------------------------------------------------------\n";
-
-    return true;
-}
-
-/**
- * Callback for the update_phone_number function.
- * 
- * This function returns the count of the people with the phone number. Because
- * the phone number has to be always unique in the database, it can be zero or 
- * just one.
- * 
- * @param data        Generic void pointer. It is used to propagate the count value.
- * @param argc        Number of arguments.
- * @param argv        The obtained data from the table query (table records).
- * @param az_col_name The list of column headers. For now, it is unused.
- * @return            Returns zero status after all sub-tasks are done.
- */
-int callback_phone_number(void* data, int argc, char** argv, char** az_col_name)
-{
-    if (argc > 0 && argv[0] != nullptr)
-    {
-        *static_cast<int*>(data) = std::stoi(argv[0]);
-    }
-
-    return 0;
-}
+    std::string input_filename = "../people.csv";
+    std::string snapshot_in;
+    std::string snapshot_out;
+    std::string backup_filename;
+    std::string export_filename;
+    bool bulk_load = false;
+    // The incremental import keeps the database for the next run.
+    bool incremental = false;
+    size_t chunk_size = k_default_chunk_size;
+    size_t parser_threads = 0;
+    size_t queue_depth = k_default_queue_depth;
+    std::string profile;
+    std::string load_profile;
+    size_t statement_cache_capacity = k_default_statement_cache_capacity;
+    size_t lookup_cache_budget = k_default_lookup_cache_budget;
+    bool print_stats = false;
+    bool check_plans = false;
+    output_format format = output_format::table;
+};
 
 /**
- * Function for executing a query which updates a phone number to a specific 
- * person identified by the primary key (ID).
- * 
- * It is checked if the new phone number is not already in the table. If yes, 
- * the phone number can't be updated because the phone number has to be unique 
- * in the table for each person.
+ * The function prints the runtime statistics of the database connection to 
+ * stdout.
  * 
- * @param table_name       Name of a table in which the person will be searched and 
- *                         in which will be the phone number updated.
- * @param person_id        The identifier of a person in the table.
- * @param new_phone_number The new phone number which replaces the previous one.
- * @param p_db             Database connection pointer.
+ * @param p_db Database connection pointer.
+ * @param sink The sink of the printed records.
  */
-bool update_phone_number(const std::string table_name,
-                         const int person_id,
-                         const std::string new_phone_number,
-                         sqlite3** p_db)
+void print_statistics(sqlite3** p_db, const output_sink& sink)
 {
-    char* err_msg = nullptr;
+    const statement_cache& cache = get_statement_cache(*p_db);
 
-    const std::string check_phone_sql = "SELECT COUNT(*) FROM " + table_name + \
-        " WHERE PhoneNum = '" + new_phone_number + "';";
-    int count = 0;
+    std::cout << "Info: Statement cache: " << cache.size() << "/" << cache.capacity() << " statements, " \
+              << cache.hits() << " hits, " << cache.misses() << " misses.\n";
+    const lookup_cache& lookups = get_lookup_cache(*p_db);
+    const uint64_t lookups_count = lookups.hits() + lookups.misses();
 
-    int status = sqlite3_exec(*p_db, check_phone_sql.c_str(), callback_phone_number, &count, &err_msg);
+    std::cout << "Info: Lookup cache: " << lookups.size() << " entries, " << lookups.bytes() << "/" \
+              << lookups.budget() << " bytes, " << lookups.hits() << " hits, " << lookups.misses() << " misses (" \
+              << (lookups_count > 0 ? 100.0 * lookups.hits() / lookups_count : 0.0) << " % hit rate), " \
+              << lookups.evictions() << " evictions, " << lookups.invalidations() << " invalidations.\n";
+    std::cout << "Info: Query output: " << sink.bytes_written() << " bytes in " << sink.write_calls() \
+              << " write calls.\n";
 
-    if (status != SQLITE_OK)
-    {
-        std::cerr << "Error: executing SQL statement failed (phone number check).\n";
-        std::cerr << "Error message: " << err_msg << "\n";
-        sqlite3_free(err_msg);
-        return false;
-    }
+    std::vector<std::pair<std::string, std::string>> pragmas;
 
-    if (count == 0)
+    if (read_connection_pragmas(p_db, pragmas))
     {
-        // The new phone number does not exist in the table, perform the update.
-        std::string update_sql = "UPDATE " + table_name + " SET PhoneNum = '" + new_phone_number + \
-            "' WHERE ID = " + std::to_string(person_id) + ";";
+        std::cout << "Info: Connection pragmas:";
 
-        status = sqlite3_exec(*p_db, update_sql.c_str(), nullptr, nullptr, &err_msg);
-
-        if (status != SQLITE_OK)
+        for (const auto& pragma : pragmas)
         {
-            std::cerr << "Error: executing SQL statement failed (phone number update).\n";
-            std::cerr << "Error message: " << err_msg << "\n";
-            sqlite3_free(err_msg);
-            return false;
+            std::cout << " " << pragma.first << "=" << pragma.second;
         }
 
-        std::cout << "Info: phone number updated successfully.\n";
-    }
-    else
-    {
-        // The phone number is already in the table.
-        std::cout << "Phone number already exists in the table. Update aborted." << std::endl;
+        std::cout << ".\n";
     }
-
     std::cout << "-----------------------------------------------------------------------\n";
 
-    return true;
+    dump_instrumentation(std::cout);
 }
 
-/**
- * The function which deletes the table from the database.
- *
- * @param table_name Name of a table to delete.
- * @param p_db       Database connection pointer. 
- */
-bool drop_table(const std::string table_name, sqlite3** p_db)
-{
-    char* err_msg = nullptr;
-    const std::string drop_sql = "DROP TABLE IF EXISTS " + table_name + ";";
-
-    int status = sqlite3_exec(*p_db, drop_sql.c_str(), nullptr, nullptr, &err_msg);
-
-    if (status != SQLITE_OK)
-    {
-        std::cerr << "Error: executing SQL statement failed (table drop).\n";
-        std::cerr << "Error message: " << err_msg << "\n";
-        sqlite3_free(err_msg);
-        return false;
-    }
-
-    std::cout << "Info: Table dropped successfully.\n";
-    std::cout << "-----------------------------------------------------------------------\n";
-
-    return true;
-}
-
-/**
- * The function which deletes the whole database (the file *.db from the system).
- * 
- * @param db_filename The name of a file containing the database including the .db extension.
- */
-bool delete_database(const std::string db_filename)
-{
-    if (std::remove(db_filename.c_str()) == 0)
-    {
-        std::cout << "Info: Database file '" << db_filename << "' deleted successfully.\n";
-    }
-    else
-    {
-        std::cerr << "Error: deleting database file '" << db_filename << "' failed.\n";
-        return false;
-    }
-
-    std::cout << "-----------------------------------------------------------------------\n";
-
-    return true;
-}
 
 /**
  * The primary function for running the custom-created queries.
@@ -612,10 +126,12 @@ bool delete_database(const std::string db_filename)
  * 4. Update the phone number for the person with a specific identifier (ID = 1).
  * 
  * @param table_name
+ * @param sink       The sink of the printed records.
  */
-int run_queries(const std::string table_name,
-                const std::string table_columns_names,
-                sqlite3** p_db)
+int run_queries(std::string_view table_name,
+                std::string_view table_columns_names,
+                sqlite3** p_db,
+                output_sink& sink)
 {
     std::cout << "************\n";
     std::cout << "  QUERIES   \n";
@@ -627,13 +143,10 @@ int run_queries(const std::string table_name,
     // *********************************************************************
     int threshold = 3500;
 
-    // Set the flag to false so the table headers will be printed for the first time.
-    headers_printed_flag = false;
-
     std::cout << "*******************************************************\n";
     std::cout << "1. The staff with a salary greater or equal to " << threshold << ":\n";
     std::cout << "*******************************************************\n\n";
-    int success = select_salary_threshold(table_name, threshold, p_db);
+    int success = select_salary_threshold(table_name, threshold, p_db, sink);
 
     if (!success)
     {
@@ -663,10 +176,7 @@ int run_queries(const std::string table_name,
         return error_code::table_insert_error;
     }
 
-    // Set the flag to false so the table headers will be printed for the first time.
-    headers_printed_flag = false;
-
-    success = print_table(table_name, p_db);
+    success = print_table(table_name, p_db, sink);
 
     if (!success)
     {
@@ -678,15 +188,12 @@ int run_queries(const std::string table_name,
     //    the previous point (LastName = Sloan).
     // *********************************************************************
 
-    // Set the flag to false so the table headers will be printed for the first time.
-    headers_printed_flag = false;
-
     std::cout << "*******************************************************\n";
     std::cout << "3. The staff with a \"Sloan\" last name:\n";
     std::cout << "*******************************************************\n\n";
 
     const std::string last_name = "Sloan";
-    success = select_by_last_name(table_name, last_name, p_db);
+    success = select_by_last_name(table_name, last_name, p_db, sink);
 
     if (!success)
     {
@@ -707,10 +214,7 @@ int run_queries(const std::string table_name,
         return error_code::sqlite_generic_error;
     }
 
-    // Set the flag to false so the table headers will be printed for the first time.
-    headers_printed_flag = false;
-
-    success = print_table(table_name, p_db);
+    success = print_table(table_name, p_db, sink);
 
     if (!success)
     {
@@ -724,24 +228,33 @@ int run_queries(const std::string table_name,
  * The function which deletes the table and database validly closes the 
  * database connection and the input file.
  * 
- * @param db_filename Database file name including the .db extension.
- * @param table_name  The name of a table to delete.
- * @param file        The input file.
- * @param p_db        Database connection pointer.
+ * @param db_filename   Database file name including the .db extension.
+ * @param table_name    The name of a table to delete.
+ * @param file          The input file.
+ * @param p_db          Database connection pointer.
+ * @param keep_database If true, the table and the database are kept (e.g.
+ *                      for the next incremental import).
  */
-int cleanup(const std::string db_filename,
-            const std::string table_name,
+int cleanup(const std::string& db_filename,
+            std::string_view table_name,
             std::ifstream& file,
-            sqlite3** p_db)
+            sqlite3** p_db,
+            bool keep_database = false)
 {
     bool success = false;    
 
+    if (keep_database)
+    {
+        close_database(p_db);
+        file.close();
+        return error_code::no_error;
+    }
+
     if (table_name.compare("") != 0)
     {
         success = drop_table(table_name, p_db);    
 
-        sqlite3_close(*p_db);
-        p_db = nullptr;
+        close_database(p_db);
 
         if (!success)
         {
@@ -753,8 +266,7 @@ int cleanup(const std::string db_filename,
     }
     else
     {
-        sqlite3_close(*p_db);
-        p_db = nullptr;
+        close_database(p_db);
     }
     
     success = delete_database(db_filename);
@@ -770,6 +282,196 @@ int cleanup(const std::string db_filename,
     return error_code::no_error;
 }
 
+/**
+ * The function prints the program usage to stderr.
+ * 
+ * @param program_name The name of the program executable.
+ */
+void print_usage(const char* program_name)
+{
+    std::cerr << "Usage: " << program_name << " [options]\n\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --input <file>      The CSV file with the table records (default: ../people.csv).\n";
+    std::cerr << "  --snapshot-in <file>\n";
+    std::cerr << "                      Load the table from the binary snapshot file instead of the CSV file.\n";
+    std::cerr << "  --snapshot-out <file>\n";
+    std::cerr << "                      Write the loaded table into the binary snapshot file.\n";
+    std::cerr << "  --backup <file>     Copy the database into the file by the online backup before the\n";
+    std::cerr << "                      cleanup.\n";
+    std::cerr << "  --export <file>     Export the snapshot of the database into the file by VACUUM INTO\n";
+    std::cerr << "                      before the cleanup.\n";
+    std::cerr << "  --bulk-load         Load the records in chunked transactions by a prepared INSERT.\n";
+    std::cerr << "  --incremental       Apply only the records of the changed input chunks (a resumable\n";
+    std::cerr << "                      import checkpointed in the database) and keep the database.\n";
+    std::cerr << "  --chunk-size <n>    The number of rows committed in one bulk load transaction\n";
+    std::cerr << "                      (default: " << k_default_chunk_size << ").\n";
+    std::cerr << "  --threads <n>       Bulk load by a pipeline of n parser threads and a single writer\n";
+    std::cerr << "                      (0 means the number of hardware threads).\n";
+    std::cerr << "  --queue-depth <n>   The number of row batches waiting for the pipeline writer\n";
+    std::cerr << "                      (default: " << k_default_queue_depth << ").\n";
+    std::cerr << "  --profile <name>    The connection profile (bulk-load or durable, default: none).\n";
+    std::cerr << "  --load-profile <name>\n";
+    std::cerr << "                      The connection profile used during the import. The connection\n";
+    std::cerr << "                      is switched to --profile (or durable) after the import.\n";
+    std::cerr << "  --statement-cache-size <n>\n";
+    std::cerr << "                      The number of prepared statements cached per connection\n";
+    std::cerr << "                      (default: " << k_default_statement_cache_capacity << ").\n";
+    std::cerr << "  --lookup-cache-size <bytes>\n";
+    std::cerr << "                      The memory budget of the cached lookup results per connection,\n";
+    std::cerr << "                      0 disables the cache (default: " << k_default_lookup_cache_budget << ").\n";
+    std::cerr << "  --stats             Record the latencies of the operations and statements and print\n";
+    std::cerr << "                      the runtime statistics before the cleanup.\n";
+    std::cerr << "  --check-plans       Check that the built-in queries use an index (EXPLAIN QUERY PLAN).\n";
+    std::cerr << "  --format <name>     The format of the printed records: table, csv, tsv or jsonl\n";
+    std::cerr << "                      (default: table).\n";
+}
+
+/**
+ * The function parses the program arguments.
+ * 
+ * @param argc    The number of program arguments.
+ * @param argv    The list of program arguments.
+ * @param options The parsed program options.
+ * @return        True if all arguments are valid, false otherwise.
+ */
+bool parse_arguments(int argc, char** argv, program_options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--bulk-load") == 0)
+        {
+            options.bulk_load = true;
+        }
+        else if (std::strcmp(argv[i], "--incremental") == 0)
+        {
+            options.incremental = true;
+        }
+        else if (std::strcmp(argv[i], "--check-plans") == 0)
+        {
+            options.check_plans = true;
+        }
+        else if (std::strcmp(argv[i], "--stats") == 0)
+        {
+            options.print_stats = true;
+        }
+        else if (std::strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+        {
+            options.input_filename = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--snapshot-in") == 0 && i + 1 < argc)
+        {
+            options.snapshot_in = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--snapshot-out") == 0 && i + 1 < argc)
+        {
+            options.snapshot_out = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--backup") == 0 && i + 1 < argc)
+        {
+            options.backup_filename = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--export") == 0 && i + 1 < argc)
+        {
+            options.export_filename = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            const unsigned long long value = std::strtoull(argv[++i], &end, 10);
+
+            if (*end != '\0' || value == 0)
+            {
+                std::cerr << "Error: invalid chunk size \"" << argv[i] << "\".\n";
+                return false;
+            }
+
+            options.chunk_size = static_cast<size_t>(value);
+        }
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            const unsigned long long value = std::strtoull(argv[++i], &end, 10);
+
+            if (*end != '\0')
+            {
+                std::cerr << "Error: invalid number of threads \"" << argv[i] << "\".\n";
+                return false;
+            }
+
+            options.bulk_load = true;
+            options.parser_threads = (value > 0) ? static_cast<size_t>(value) : std::thread::hardware_concurrency();
+        }
+        else if (std::strcmp(argv[i], "--queue-depth") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            const unsigned long long value = std::strtoull(argv[++i], &end, 10);
+
+            if (*end != '\0' || value == 0)
+            {
+                std::cerr << "Error: invalid queue depth \"" << argv[i] << "\".\n";
+                return false;
+            }
+
+            options.queue_depth = static_cast<size_t>(value);
+        }
+        else if ((std::strcmp(argv[i], "--profile") == 0 || std::strcmp(argv[i], "--load-profile") == 0) &&
+                 i + 1 < argc)
+        {
+            connection_profile profile;
+            const bool load_profile = (std::strcmp(argv[i], "--load-profile") == 0);
+
+            if (!find_connection_profile(argv[++i], profile))
+            {
+                std::cerr << "Error: unknown connection profile \"" << argv[i] << "\".\n";
+                return false;
+            }
+
+            (load_profile ? options.load_profile : options.profile) = profile.name;
+        }
+        else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            if (!find_output_format(argv[++i], options.format))
+            {
+                std::cerr << "Error: unknown output format \"" << argv[i] << "\".\n";
+                return false;
+            }
+        }
+        else if (std::strcmp(argv[i], "--lookup-cache-size") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            const unsigned long long value = std::strtoull(argv[++i], &end, 10);
+
+            if (*end != '\0')
+            {
+                std::cerr << "Error: invalid lookup cache size \"" << argv[i] << "\".\n";
+                return false;
+            }
+
+            options.lookup_cache_budget = static_cast<size_t>(value);
+        }
+        else if (std::strcmp(argv[i], "--statement-cache-size") == 0 && i + 1 < argc)
+        {
+            char* end = nullptr;
+            const unsigned long long value = std::strtoull(argv[++i], &end, 10);
+
+            if (*end != '\0' || value == 0)
+            {
+                std::cerr << "Error: invalid statement cache size \"" << argv[i] << "\".\n";
+                return false;
+            }
+
+            options.statement_cache_capacity = static_cast<size_t>(value);
+        }
+        else
+        {
+            std::cerr << "Error: unknown or incomplete argument \"" << argv[i] << "\".\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
 /**
  * Main function of the program.
  * 
@@ -780,98 +482,262 @@ int cleanup(const std::string db_filename,
 */
 int main(int argc, char** argv)
 {
+    program_options options;
+
+    if (!parse_arguments(argc, argv, options))
+    {
+        print_usage(argv[0]);
+        return error_code::argument_error;
+    }
+
+    set_statement_cache_capacity(options.statement_cache_capacity);
+    set_lookup_cache_budget(options.lookup_cache_budget);
+    set_instrumentation_enabled(options.print_stats);
+
     sqlite3* p_db = nullptr;
     const std::string db_filename = "dbschema.db";
-    std::ifstream file("../people.csv");
+    std::ifstream file;
+
+    // The CSV file is not needed if the table is loaded from a snapshot.
+    if (options.snapshot_in.empty())
+    {
+        file.open(options.input_filename);
+    }
 
-    if (!file.is_open())
+    if (options.snapshot_in.empty() && !file.is_open())
     {
         std::cerr << "Error: CSV file opening failed.\n";
         return error_code::file_open_error;
     }
 
-    bool success = create_database(db_filename, &p_db);
+    // The import profile replaces the serving one until the import is done.
+    bool success = create_database(db_filename,
+                                   options.load_profile.empty() ? options.profile : options.load_profile,
+                                   &p_db);
 
     if (!success)
     {
         // Because of the error ignore the cleanup return code.
-        cleanup(db_filename, "", file, &p_db);
+        cleanup(db_filename, "", file, &p_db, options.incremental);
         return error_code::db_create_error;
     }
 
-    // Email can have a total length of 320 characters, so VARCHAR(320) data 
-    // type is used instead of VARCHAR(255) for the Email column.
-    // https://www.mindbaz.com/en/email-deliverability/what-is-the-maximum-size-of-an-mail-address/
-
-    // Linux's maximum path length is 4096 characters, so the VARCHAR(4096) 
-    // data type is used instead of VARCHAR(255) for the ProfileImage column.
-    // https://unix.stackexchange.com/questions/32795/what-is-the-maximum-allowed-filename-and-folder-size-with-ecryptfs
-
-    // The longest phone number is 15 characters, so the VARCHAR(20) data type 
-    // is used including reserving for spaces between numbers.
-    // https://www.oreilly.com/library/view/regular-expressions-cookbook/9781449327453/ch04s03.html
-    const std::string table_name = "Staff";
-    const std::string table_columns =
-        "ID INTEGER PRIMARY KEY           AUTOINCREMENT  ," \
-        "FirstName          VARCHAR(255)  NOT NULL       ," \
-        "LastName           VARCHAR(255)  NOT NULL       ," \
-        "Address            VARCHAR(255)  NOT NULL       ," \
-        "Salary             INTEGER       NOT NULL       ," \
-        "Email              VARCHAR(320)  NOT NULL UNIQUE," \
-        "ProfileImage       VARCHAR(4096)          UNIQUE," \
-        "PhoneNum           VARCHAR(20)   NOT NULL UNIQUE," \
-        "TimeZone           VARCHAR(50)                   ";
-
-    success = create_table(table_name, table_columns, &p_db);
+    if (options.print_stats && !enable_statement_profiling(p_db))
+    {
+        // Because of the error ignore the cleanup return code.
+        cleanup(db_filename, "", file, &p_db, options.incremental);
+        return error_code::db_create_error;
+    }
+
+    const std::string table_name = k_staff_table_name;
+
+    success = create_table(k_staff_schema, &p_db);
 
     if (!success)
     {
         // Because of the error ignore the cleanup return code.
-        cleanup(db_filename, "", file, &p_db);
+        cleanup(db_filename, "", file, &p_db, options.incremental);
         return error_code::table_create_error;
     }
 
-    const std::string table_columns_names =
-        "FirstName, Address, Salary, LastName, Email, ProfileImage, PhoneNum, TimeZone";
+    const std::string table_columns_names = get_table_sql(k_staff_schema).record_columns;
+
+    if (!options.snapshot_in.empty())
+    {
+        binary_snapshot snapshot;
+        bulk_load_stats stats;
+
+        if (!snapshot.open(options.snapshot_in))
+        {
+            // Because of the error ignore the cleanup return code.
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
+            return error_code::snapshot_error;
+        }
+
+        success = load_binary_snapshot(snapshot, table_name, options.chunk_size, &p_db, stats);
+
+        if (!success)
+        {
+            // Because of the error ignore the cleanup return code.
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
+            return error_code::table_insert_error;
+        }
+
+        print_bulk_load_stats(stats);
+    }
+    else if (options.incremental)
+    {
+        incremental_import_options import_options;
+        incremental_import_stats stats;
+
+        success = incremental_import(k_staff_schema, options.input_filename, import_options, &p_db, stats);
+
+        if (!success)
+        {
+            // The checkpoints are kept, so the next run resumes the import.
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
+            return error_code::table_insert_error;
+        }
+
+        print_incremental_import_stats(stats);
+    }
+    else if (options.parser_threads > 0)
+    {
+        import_pipeline_options pipeline_options;
+        pipeline_options.parser_threads = options.parser_threads;
+        pipeline_options.queue_depth = options.queue_depth;
+        pipeline_options.chunk_size = options.chunk_size;
+
+        import_pipeline_stats stats;
+
+        success = run_import_pipeline(options.input_filename,
+                                      build_insert_sql(table_name, table_columns_names, "ON CONFLICT DO NOTHING"),
+                                      validate_staff_record, bind_record_values, pipeline_options, &p_db, stats);
+
+        if (!success)
+        {
+            // Because of the error ignore the cleanup return code.
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
+            return error_code::table_insert_error;
+        }
 
-    std::string table_record;
-    while (std::getline(file, table_record))
+        print_import_pipeline_stats(stats);
+    }
+    else if (options.bulk_load)
     {
-        std::cout << "Record: " << table_record << "\n";
+        bulk_load_stats stats;
 
-        success = insert_table_record(table_name, table_columns_names, table_record, &p_db);
+        success = bulk_load_table(k_staff_schema, file, options.chunk_size, &p_db, stats);
 
         if (!success)
         {
             // Because of the error ignore the cleanup return code.
-            cleanup(db_filename, table_name, file, &p_db);
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
             return error_code::table_insert_error;
         }
+
+        print_bulk_load_stats(stats);
+    }
+    else
+    {
+        std::string table_record;
+        while (std::getline(file, table_record))
+        {
+            std::cout << "Record: " << table_record << "\n";
+
+            success = insert_table_record(table_name, table_columns_names, table_record, &p_db);
+
+            if (!success)
+            {
+                // Because of the error ignore the cleanup return code.
+                cleanup(db_filename, table_name, file, &p_db, options.incremental);
+                return error_code::table_insert_error;
+            }
+        }
+    }
+
+    if (!options.load_profile.empty())
+    {
+        // Switch from the import profile, the switch makes the loaded data 
+        // durable by a checkpoint.
+        connection_profile profile = durable_profile();
+
+        success = (options.profile.empty() || find_connection_profile(options.profile, profile)) &&
+                  apply_connection_profile(profile, &p_db);
+
+        if (!success)
+        {
+            // Because of the error ignore the cleanup return code.
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
+            return error_code::db_create_error;
+        }
+
+        std::cout << "-----------------------------------------------------------------------\n";
+    }
+
+    if (!options.snapshot_out.empty())
+    {
+        size_t rows = 0;
+
+        if (!write_binary_snapshot(table_name, options.snapshot_out, &p_db, rows))
+        {
+            // Because of the error ignore the cleanup return code.
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
+            return error_code::snapshot_error;
+        }
+
+        std::cout << "Info: The binary snapshot " << options.snapshot_out << " was written (" << rows \
+                  << " rows).\n";
+        std::cout << "-----------------------------------------------------------------------\n";
+    }
+
+    if (options.check_plans && !check_query_plans(table_name, &p_db))
+    {
+        // Because of the error ignore the cleanup return code.
+        cleanup(db_filename, table_name, file, &p_db, options.incremental);
+        return error_code::query_plan_error;
     }
 
     std::cout << "The created table print: \n\n";
 
-    success = print_table(table_name, &p_db);
+    output_sink sink(STDOUT_FILENO, options.format);
+
+    success = print_table(table_name, &p_db, sink);
 
     if (!success)
     {
         // Because of the error ignore the cleanup return code.
-        cleanup(db_filename, table_name, file, &p_db);
+        cleanup(db_filename, table_name, file, &p_db, options.incremental);
         return error_code::sqlite_generic_error;
     }
 
     // Run queries.
-    int err = run_queries(table_name, table_columns_names, &p_db);
+    int err = run_queries(table_name, table_columns_names, &p_db, sink);
 
     if (err != error_code::no_error)
     {
         // Because of the error ignore the cleanup return code.
-        cleanup(db_filename, table_name, file, &p_db);
+        cleanup(db_filename, table_name, file, &p_db, options.incremental);
         return error_code::sqlite_generic_error;
     }
 
+    if (!options.backup_filename.empty() || !options.export_filename.empty())
+    {
+        backup_stats stats;
+
+        // The copies are read by their own connections, which see all
+        // committed records.
+        success = (options.backup_filename.empty() ||
+                   backup_database(db_filename, options.backup_filename, backup_options(), stats));
+
+        if (success && !options.backup_filename.empty())
+        {
+            print_backup_stats(options.backup_filename, stats);
+        }
+
+        success = success && (options.export_filename.empty() ||
+                              export_database(db_filename, options.export_filename, stats));
+
+        if (success && !options.export_filename.empty())
+        {
+            print_backup_stats(options.export_filename, stats);
+        }
+
+        if (!success)
+        {
+            // Because of the error ignore the cleanup return code.
+            cleanup(db_filename, table_name, file, &p_db, options.incremental);
+            return error_code::backup_error;
+        }
+    }
+
+    if (options.print_stats)
+    {
+        print_statistics(&p_db, sink);
+    }
+
     // Final cleanup.
-    int status = cleanup(db_filename, table_name, file, &p_db);
+    int status = cleanup(db_filename, table_name, file, &p_db, options.incremental);
 
     if (status != error_code::no_error)
     {
@@ -0,0 +1,312 @@
+/**
+ * @file    online_backup.cpp
+ *
+ * @brief   Online backup and snapshot export of the database.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "online_backup.hpp"
+
+#include <algorithm>
+#include <cstdio> // std::remove, std::rename
+#include <iostream>
+#include <thread>
+#include <sqlite3.h>
+
+#include "sql_functions.hpp"
+
+namespace
+{
+
+using steady_clock = std::chrono::steady_clock;
+
+constexpr int k_busy_timeout_ms = 5000;
+// The pause before a step retried because the source database was locked.
+constexpr std::chrono::microseconds k_busy_pause = std::chrono::microseconds(1000);
+
+/**
+ * Function which removes the database file together with its journals.
+ */
+void remove_database_files(const std::string& filename)
+{
+    std::remove(filename.c_str());
+    std::remove((filename + "-journal").c_str());
+    std::remove((filename + "-wal").c_str());
+    std::remove((filename + "-shm").c_str());
+}
+
+/**
+ * Function which opens the read-only connection to the copied database. The
+ * expression indexes are rebuilt by VACUUM INTO, so the connection registers
+ * the Staff SQL functions.
+ */
+bool open_source_database(const std::string& db_filename, sqlite3** p_source)
+{
+    const int status = sqlite3_open_v2(db_filename.c_str(), p_source, SQLITE_OPEN_READONLY, nullptr);
+
+    if (status != SQLITE_OK)
+    {
+        std::cerr << "Error: opening the read-only connection to the database \"" << db_filename << "\" failed.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_source) << "\n";
+        return false;
+    }
+
+    sqlite3_busy_timeout(*p_source, k_busy_timeout_ms);
+
+    return register_staff_functions(*p_source);
+}
+
+/**
+ * Function which reads whether the database uses the WAL journal.
+ */
+bool read_wal_journal(sqlite3* db, bool& wal)
+{
+    sqlite3_stmt* stmt = nullptr;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA journal_mode;", -1, &stmt, nullptr) != SQLITE_OK ||
+        sqlite3_step(stmt) != SQLITE_ROW)
+    {
+        std::cerr << "Error: reading the journal mode of the backed up database failed.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(db) << "\n";
+        sqlite3_finalize(stmt);
+        return false;
+    }
+
+    const char* mode = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+    wal = (mode != nullptr && sqlite3_stricmp(mode, "wal") == 0);
+
+    sqlite3_finalize(stmt);
+
+    return true;
+}
+
+/**
+ * Function which replaces the target file by the completed temporary file,
+ * or removes the temporary file if the copy failed.
+ */
+bool finish_copy(const std::string& temp_filename, const std::string& filename, bool success)
+{
+    if (success && std::rename(temp_filename.c_str(), filename.c_str()) != 0)
+    {
+        std::cerr << "Error: renaming the file \"" << temp_filename << "\" to \"" << filename << "\" failed.\n";
+        success = false;
+    }
+
+    if (!success)
+    {
+        remove_database_files(temp_filename);
+    }
+
+    return success;
+}
+
+/**
+ * Function which copies the pages of the source into the destination step
+ * by step.
+ *
+ * @return True if all pages were copied, false otherwise.
+ */
+bool copy_pages(sqlite3* source, sqlite3* destination, const backup_options& options, backup_stats& stats)
+{
+    sqlite3_backup* backup = sqlite3_backup_init(destination, "main", source, "main");
+
+    if (backup == nullptr)
+    {
+        std::cerr << "Error: starting the backup failed.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(destination) << "\n";
+        return false;
+    }
+
+    const int step_pages = (options.step_pages > 0) ? options.step_pages : -1;
+    int last_remaining = -1;
+    bool cancelled = false;
+    int status;
+
+    do
+    {
+        status = sqlite3_backup_step(backup, step_pages);
+        ++stats.steps;
+
+        const bool busy = (status == SQLITE_BUSY || status == SQLITE_LOCKED);
+        const int remaining = sqlite3_backup_remaining(backup);
+
+        // The remaining pages grow only when the backup started over.
+        if (last_remaining >= 0 && remaining > last_remaining)
+        {
+            ++stats.restarts;
+        }
+
+        last_remaining = remaining;
+        stats.busy_steps += busy;
+        stats.pages = sqlite3_backup_pagecount(backup);
+
+        if (options.progress)
+        {
+            backup_progress progress;
+            progress.remaining_pages = remaining;
+            progress.total_pages = stats.pages;
+            progress.steps = stats.steps;
+
+            cancelled = !options.progress(progress);
+        }
+
+        if (!cancelled && (status == SQLITE_OK || busy))
+        {
+            const std::chrono::microseconds pause = busy ? std::max(options.step_pause, k_busy_pause)
+                                                         : options.step_pause;
+
+            if (pause.count() > 0)
+            {
+                std::this_thread::sleep_for(pause);
+            }
+        }
+    }
+    while (!cancelled && (status == SQLITE_OK || status == SQLITE_BUSY || status == SQLITE_LOCKED));
+
+    sqlite3_backup_finish(backup);
+
+    if (cancelled)
+    {
+        std::cerr << "Error: the backup was cancelled.\n";
+        return false;
+    }
+
+    if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error: copying the database pages failed.\n";
+        std::cerr << "Error message: " << sqlite3_errstr(status) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool backup_database(const std::string& db_filename,
+                     const std::string& backup_filename,
+                     const backup_options& options,
+                     backup_stats& stats)
+{
+    stats = backup_stats();
+
+    const steady_clock::time_point start = steady_clock::now();
+    const std::string temp_filename = backup_filename + ".tmp";
+    sqlite3* source = nullptr;
+    sqlite3* destination = nullptr;
+    bool wal = false;
+
+    bool success = open_source_database(db_filename, &source) && read_wal_journal(source, wal);
+
+    // The read transaction is kept open by the backup steps, so they read
+    // the same snapshot and the writes of the other connections do not
+    // restart the backup.
+    if (success && wal)
+    {
+        success = sqlite3_exec(source, "BEGIN; SELECT COUNT(*) FROM sqlite_master;", nullptr, nullptr,
+                               nullptr) == SQLITE_OK;
+
+        if (!success)
+        {
+            std::cerr << "Error: starting the read transaction of the backup failed.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(source) << "\n";
+        }
+    }
+
+    if (success)
+    {
+        remove_database_files(temp_filename);
+
+        if (sqlite3_open(temp_filename.c_str(), &destination) != SQLITE_OK)
+        {
+            std::cerr << "Error: opening the backup file \"" << temp_filename << "\" failed.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(destination) << "\n";
+            success = false;
+        }
+    }
+
+    success = success && copy_pages(source, destination, options, stats);
+
+    if (wal)
+    {
+        sqlite3_exec(source, "COMMIT;", nullptr, nullptr, nullptr);
+    }
+
+    sqlite3_close(destination);
+    sqlite3_close(source);
+
+    success = finish_copy(temp_filename, backup_filename, success);
+    stats.elapsed_seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    return success;
+}
+
+bool export_database(const std::string& db_filename, const std::string& export_filename, backup_stats& stats)
+{
+    stats = backup_stats();
+
+    const steady_clock::time_point start = steady_clock::now();
+    const std::string temp_filename = export_filename + ".tmp";
+    sqlite3* source = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+
+    // VACUUM INTO fails if the file is not empty.
+    remove_database_files(temp_filename);
+
+    bool success = open_source_database(db_filename, &source);
+
+    if (success)
+    {
+        success = sqlite3_prepare_v2(source, "PRAGMA page_count;", -1, &stmt, nullptr) == SQLITE_OK &&
+                  sqlite3_step(stmt) == SQLITE_ROW;
+        stats.pages = success ? sqlite3_column_int(stmt, 0) : 0;
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+
+        success = success && sqlite3_prepare_v2(source, "VACUUM INTO ?1;", -1, &stmt, nullptr) == SQLITE_OK;
+
+        if (success)
+        {
+            sqlite3_bind_text(stmt, 1, temp_filename.data(), static_cast<int>(temp_filename.size()), SQLITE_STATIC);
+            success = (sqlite3_step(stmt) == SQLITE_DONE);
+        }
+
+        if (!success)
+        {
+            std::cerr << "Error: exporting the database into the file \"" << temp_filename << "\" failed.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(source) << "\n";
+        }
+
+        sqlite3_finalize(stmt);
+    }
+
+    sqlite3_close(source);
+
+    stats.steps = 1;
+
+    success = finish_copy(temp_filename, export_filename, success);
+    stats.elapsed_seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+
+    return success;
+}
+
+/**
+ * Function which prints the statistics of a backup or an export.
+ *
+ * @param filename The written file.
+ * @param stats    The statistics.
+ */
+void print_backup_stats(const std::string& filename, const backup_stats& stats)
+{
+    std::cout << "Info: The database was copied into " << filename << " in " << stats.elapsed_seconds << " s (" \
+              << stats.steps << " steps";
+
+    if (stats.pages > 0)
+    {
+        std::cout << ", " << stats.pages << " pages";
+    }
+
+    std::cout << ", " << stats.busy_steps << " busy steps, " << stats.restarts << " restarts).\n";
+    std::cout << "-----------------------------------------------------------------------\n";
+}
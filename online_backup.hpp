@@ -0,0 +1,114 @@
+/**
+ * @file    online_backup.hpp
+ *
+ * @brief   Online backup and snapshot export of the database.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef ONLINE_BACKUP_HPP
+#define ONLINE_BACKUP_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// The default number of pages copied by a single backup step (4 MiB of the
+// default 4 KiB pages).
+constexpr int k_default_backup_step_pages = 1024;
+
+/**
+ * The progress of a running backup, reported after every step.
+ */
+struct backup_progress
+{
+    int remaining_pages = 0;
+    int total_pages = 0;
+    size_t steps = 0;
+};
+
+/**
+ * Function receiving the progress of the backup, the backup is cancelled if
+ * it returns false.
+ */
+using backup_progress_callback = std::function<bool(const backup_progress&)>;
+
+/**
+ * The options of the online backup.
+ */
+struct backup_options
+{
+    // The number of pages copied by a single step, a negative number copies
+    // the whole database in one step.
+    int step_pages = k_default_backup_step_pages;
+    // The pause after every step, which throttles the backup.
+    std::chrono::microseconds step_pause = std::chrono::microseconds(0);
+    backup_progress_callback progress;
+};
+
+/**
+ * The statistics of a backup or an export.
+ */
+struct backup_stats
+{
+    int pages = 0;
+    size_t steps = 0;
+    // The steps retried because the source database was locked.
+    size_t busy_steps = 0;
+    // The times the backup started over because another connection wrote
+    // the source database between the steps (never with the WAL journal).
+    size_t restarts = 0;
+    double elapsed_seconds = 0.0;
+};
+
+/**
+ * Function which copies the database into the backup file by the SQLite
+ * online backup API while the other connections keep using the database.
+ *
+ * The database is read by its own read-only connection, step_pages pages per
+ * step (sqlite3_backup_step) with the step_pause between the steps. With the
+ * WAL journal the backup holds a single read transaction, so the copy is the
+ * snapshot of the database at the start and the writers are never blocked
+ * (the WAL cannot be checkpointed behind the snapshot until the backup ends).
+ * With the rollback journals the source is locked only during a step, so the
+ * writers commit between the steps and the backup starts over after every
+ * commit of another connection. A completed backup is always a consistent
+ * copy of the database.
+ *
+ * The pages are written into a temporary file next to the backup file, which
+ * replaces the backup file only when the backup is complete.
+ *
+ * @param db_filename     The database file.
+ * @param backup_filename The backup file, an existing file is replaced.
+ * @param options         The step size, the pause and the progress callback.
+ * @param stats           The statistics of the backup.
+ * @return                True if the backup was completed successfully, false
+ *                        otherwise (also when it was cancelled).
+ */
+bool backup_database(const std::string& db_filename,
+                     const std::string& backup_filename,
+                     const backup_options& options,
+                     backup_stats& stats);
+
+/**
+ * Function which exports the snapshot of the database into the file by
+ * VACUUM INTO. The export runs in a single read transaction of its own
+ * read-only connection, so it is consistent and with the WAL journal it does
+ * not block the writers. Unlike the backup, the database is rebuilt: the
+ * free pages are omitted and the tables and indexes are written in order, so
+ * it takes longer. The file is written to a temporary file first like the
+ * backup.
+ *
+ * @param db_filename     The database file.
+ * @param export_filename The exported file, an existing file is replaced.
+ * @param stats           The statistics of the export, it has a single step
+ *                        and the pages of the exported database.
+ * @return                True if the database was exported successfully, false
+ *                        otherwise.
+ */
+bool export_database(const std::string& db_filename, const std::string& export_filename, backup_stats& stats);
+
+void print_backup_stats(const std::string& filename, const backup_stats& stats);
+
+#endif // ONLINE_BACKUP_HPP
@@ -0,0 +1,464 @@
+/**
+ * @file    output_sink.cpp
+ *
+ * @brief   Buffered output of the query results in several formats.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "output_sink.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+constexpr const char* k_null_text = "NULL";
+constexpr const char* k_tsv_null_text = "\\N";
+
+/**
+ * Function which checks whether a CSV value has to be quoted. The values
+ * with a separator, a quote, a line break or surrounding spaces are quoted,
+ * because the csv_reader trims unquoted values.
+ */
+bool csv_needs_quotes(std::string_view value)
+{
+    if (value.empty())
+    {
+        return false;
+    }
+
+    if (value.front() == ' ' || value.back() == ' ')
+    {
+        return true;
+    }
+
+    return value.find_first_of(",\"'\r\n") != std::string_view::npos;
+}
+
+} // namespace
+
+bool find_output_format(const std::string& name, output_format& format)
+{
+    if (name == "table")
+    {
+        format = output_format::table;
+    }
+    else if (name == "csv")
+    {
+        format = output_format::csv;
+    }
+    else if (name == "tsv")
+    {
+        format = output_format::tsv;
+    }
+    else if (name == "jsonl")
+    {
+        format = output_format::jsonl;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+output_sink::output_sink(int fd, output_format format, size_t buffer_size)
+  : fd_(fd), format_(format), buffer_(buffer_size > 0 ? buffer_size : 1), used_(0), failed_(false),
+    bytes_written_(0), write_calls_(0)
+{
+}
+
+output_sink::~output_sink()
+{
+    flush();
+}
+
+void output_sink::append(std::string_view text)
+{
+    if (text.size() > buffer_.size() - used_)
+    {
+        if (fd_ == k_memory_sink_fd)
+        {
+            grow(used_ + text.size());
+            std::memcpy(buffer_.data() + used_, text.data(), text.size());
+            used_ += text.size();
+            return;
+        }
+
+        flush();
+
+        // The text larger than the whole buffer is written directly.
+        if (text.size() > buffer_.size())
+        {
+            write_all(text.data(), text.size());
+            return;
+        }
+    }
+
+    std::memcpy(buffer_.data() + used_, text.data(), text.size());
+    used_ += text.size();
+}
+
+void output_sink::append(char c)
+{
+    if (used_ == buffer_.size())
+    {
+        if (fd_ == k_memory_sink_fd)
+        {
+            grow(used_ + 1);
+        }
+        else
+        {
+            flush();
+        }
+    }
+
+    buffer_[used_++] = c;
+}
+
+void output_sink::append_int(int64_t value)
+{
+    char digits[24];
+    const std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), value);
+
+    append(std::string_view(digits, static_cast<size_t>(result.ptr - digits)));
+}
+
+bool output_sink::flush()
+{
+    if (used_ > 0 && fd_ != k_memory_sink_fd)
+    {
+        write_all(buffer_.data(), used_);
+        used_ = 0;
+    }
+
+    return !failed_;
+}
+
+std::string_view output_sink::buffered() const
+{
+    return std::string_view(buffer_.data(), used_);
+}
+
+int output_sink::fd() const
+{
+    return fd_;
+}
+
+output_format output_sink::format() const
+{
+    return format_;
+}
+
+uint64_t output_sink::bytes_written() const
+{
+    return bytes_written_;
+}
+
+uint64_t output_sink::write_calls() const
+{
+    return write_calls_;
+}
+
+bool output_sink::write_all(const char* data, size_t size)
+{
+    while (size > 0 && !failed_)
+    {
+        const ssize_t written = ::write(fd_, data, size);
+        ++write_calls_;
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            std::cerr << "Error: writing the query output failed.\n";
+            std::cerr << "Error message: " << std::strerror(errno) << "\n";
+            failed_ = true;
+            break;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+        bytes_written_ += static_cast<uint64_t>(written);
+    }
+
+    return !failed_;
+}
+
+void output_sink::grow(size_t size)
+{
+    // The buffer is doubled, so appending is amortized constant time.
+    buffer_.resize(std::max(size, buffer_.size() * 2));
+}
+
+query_output::query_output(output_sink& sink, bool header)
+  : sink_(sink), header_(header), header_written_(false), column_(0), rows_(0)
+{
+    if (sink_.fd() == STDOUT_FILENO)
+    {
+        std::cout.flush();
+    }
+}
+
+void query_output::begin_row(sqlite3_stmt* stmt)
+{
+    std::vector<const char*> column_names;
+
+    if (!header_written_)
+    {
+        for (int i = 0; i < sqlite3_column_count(stmt); ++i)
+        {
+            column_names.push_back(sqlite3_column_name(stmt, i));
+        }
+    }
+
+    begin_row(column_names.data(), column_names.size());
+}
+
+void query_output::begin_row(const char* const* column_names, size_t column_count)
+{
+    begin_result(column_names, column_count);
+    column_ = 0;
+
+    if (sink_.format() == output_format::jsonl)
+    {
+        sink_.append('{');
+    }
+}
+
+void query_output::begin_result(const char* const* column_names, size_t column_count)
+{
+    if (!header_written_)
+    {
+        write_header(column_names, column_count);
+        header_written_ = true;
+    }
+}
+
+void query_output::write_text(std::string_view value)
+{
+    begin_cell();
+
+    if (value.data() == nullptr)
+    {
+        switch (sink_.format())
+        {
+            case output_format::table:
+                sink_.append(k_null_text);
+                break;
+            case output_format::csv:
+                break;
+            case output_format::tsv:
+                sink_.append(k_tsv_null_text);
+                break;
+            case output_format::jsonl:
+                sink_.append("null");
+                break;
+        }
+    }
+    else
+    {
+        write_escaped(value);
+    }
+
+    if (sink_.format() == output_format::table)
+    {
+        sink_.append(" | ");
+    }
+}
+
+void query_output::write_int(int64_t value)
+{
+    begin_cell();
+    sink_.append_int(value);
+
+    if (sink_.format() == output_format::table)
+    {
+        sink_.append(" | ");
+    }
+}
+
+void query_output::end_row()
+{
+    if (sink_.format() == output_format::jsonl)
+    {
+        sink_.append('}');
+    }
+
+    sink_.append('\n');
+    ++rows_;
+}
+
+bool query_output::finish()
+{
+    return sink_.flush();
+}
+
+size_t query_output::rows() const
+{
+    return rows_;
+}
+
+void query_output::write_header(const char* const* column_names, size_t column_count)
+{
+    if (sink_.format() == output_format::jsonl)
+    {
+        // The keys are escaped once per query.
+        json_keys_.clear();
+
+        for (size_t i = 0; i < column_count; ++i)
+        {
+            std::string key = "\"";
+
+            for (const char* c = column_names[i]; *c != '\0'; ++c)
+            {
+                if (*c == '"' || *c == '\\')
+                {
+                    key += '\\';
+                }
+
+                key += *c;
+            }
+
+            key += "\":";
+            json_keys_.push_back(std::move(key));
+        }
+
+        return;
+    }
+
+    if (!header_)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < column_count; ++i)
+    {
+        const std::string_view name = column_names[i];
+
+        switch (sink_.format())
+        {
+            case output_format::table:
+                sink_.append(name);
+                sink_.append(" | ");
+                break;
+            case output_format::csv:
+            case output_format::tsv:
+                column_ = i;
+                begin_cell();
+                write_escaped(name);
+                break;
+            case output_format::jsonl:
+                break;
+        }
+    }
+
+    sink_.append(sink_.format() == output_format::table ? "\n\n" : "\n");
+}
+
+void query_output::begin_cell()
+{
+    if (column_ > 0)
+    {
+        switch (sink_.format())
+        {
+            case output_format::table:
+                break;
+            case output_format::csv:
+                sink_.append(',');
+                break;
+            case output_format::tsv:
+                sink_.append('\t');
+                break;
+            case output_format::jsonl:
+                sink_.append(',');
+                break;
+        }
+    }
+
+    if (sink_.format() == output_format::jsonl && column_ < json_keys_.size())
+    {
+        sink_.append(json_keys_[column_]);
+    }
+
+    ++column_;
+}
+
+void query_output::write_escaped(std::string_view value)
+{
+    switch (sink_.format())
+    {
+        case output_format::table:
+            sink_.append(value);
+            break;
+        case output_format::csv:
+            if (!csv_needs_quotes(value))
+            {
+                sink_.append(value);
+                break;
+            }
+
+            sink_.append('"');
+
+            for (char c : value)
+            {
+                if (c == '"')
+                {
+                    sink_.append('"');
+                }
+
+                sink_.append(c);
+            }
+
+            sink_.append('"');
+            break;
+        case output_format::tsv:
+            for (char c : value)
+            {
+                switch (c)
+                {
+                    case '\t': sink_.append("\\t"); break;
+                    case '\n': sink_.append("\\n"); break;
+                    case '\r': sink_.append("\\r"); break;
+                    case '\\': sink_.append("\\\\"); break;
+                    default: sink_.append(c); break;
+                }
+            }
+            break;
+        case output_format::jsonl:
+            sink_.append('"');
+
+            for (char c : value)
+            {
+                const unsigned char u = static_cast<unsigned char>(c);
+
+                if (c == '"' || c == '\\')
+                {
+                    sink_.append('\\');
+                    sink_.append(c);
+                }
+                else if (u < 0x20)
+                {
+                    static const char k_hex[] = "0123456789abcdef";
+                    const char escaped[] = {'\\', 'u', '0', '0', k_hex[u >> 4], k_hex[u & 0x0f]};
+                    sink_.append(std::string_view(escaped, sizeof(escaped)));
+                }
+                else
+                {
+                    sink_.append(c);
+                }
+            }
+
+            sink_.append('"');
+            break;
+    }
+}
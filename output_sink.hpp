@@ -0,0 +1,183 @@
+/**
+ * @file    output_sink.hpp
+ *
+ * @brief   Buffered output of the query results in several formats.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef OUTPUT_SINK_HPP
+#define OUTPUT_SINK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unistd.h>
+#include <sqlite3.h>
+
+// The default size of the output buffer flushed by a single write call.
+constexpr size_t k_default_output_buffer_size = 256 * 1024;
+
+// The file descriptor of a sink which keeps the whole output in its buffer.
+constexpr int k_memory_sink_fd = -1;
+
+/**
+ * The formats of the printed query results.
+ */
+enum class output_format
+{
+    table, // The values separated by " | ", the headers followed by an empty line.
+    csv,   // RFC 4180, NULL is an empty field.
+    tsv,   // Tab, newline and backslash escaped by a backslash, NULL is \N.
+    jsonl  // One JSON object per row keyed by the column names.
+};
+
+/**
+ * Function which finds the output format by its name (table, csv, tsv or
+ * jsonl).
+ *
+ * @param name   The name of the format.
+ * @param format The found format.
+ * @return       True if the format exists, false otherwise.
+ */
+bool find_output_format(const std::string& name, output_format& format);
+
+/**
+ * The output buffered in a reusable buffer which is written to the file
+ * descriptor by write(2) when it is full or flushed.
+ *
+ * The sink does not share a buffer with std::cout, so the standard streams
+ * writing to the same file descriptor have to be flushed before the sink is
+ * written and the sink has to be flushed before they are used again (see
+ * query_output).
+ *
+ * The sink with the k_memory_sink_fd descriptor writes nothing, its buffer
+ * grows to hold the whole output, which is then read by buffered(). The
+ * results formatted by several threads are merged this way (see
+ * parallel_scan).
+ */
+class output_sink
+{
+public:
+    explicit output_sink(int fd = STDOUT_FILENO,
+                         output_format format = output_format::table,
+                         size_t buffer_size = k_default_output_buffer_size);
+    ~output_sink();
+
+    output_sink(const output_sink&) = delete;
+    output_sink& operator=(const output_sink&) = delete;
+
+    void append(std::string_view text);
+    void append(char c);
+    void append_int(int64_t value);
+
+    /**
+     * Writes the buffered output to the file descriptor.
+     *
+     * @return False if any write of the sink failed, true otherwise.
+     */
+    bool flush();
+
+    /**
+     * @return The output which was not written yet, the whole output of a
+     *         memory sink.
+     */
+    std::string_view buffered() const;
+
+    int fd() const;
+    output_format format() const;
+    uint64_t bytes_written() const;
+    uint64_t write_calls() const;
+
+private:
+    bool write_all(const char* data, size_t size);
+    void grow(size_t size);
+
+    int fd_;
+    output_format format_;
+    std::vector<char> buffer_;
+    size_t used_;
+    bool failed_;
+    uint64_t bytes_written_;
+    uint64_t write_calls_;
+};
+
+/**
+ * The output of a single query result into a sink.
+ *
+ * The header state is kept per query, so the results of concurrent queries
+ * can be formatted into separate sinks. The header is written before the
+ * first row only, so an empty result prints nothing. The parts of a single
+ * result formatted separately are written without the header, which is
+ * written once by begin_result. The rows are written
+ * cell by cell:
+ *
+ *     output.begin_row(stmt);
+ *     output.write_int(id);
+ *     output.write_text(name);
+ *     output.end_row();
+ */
+class query_output
+{
+public:
+    /**
+     * Flushes std::cout if the sink writes to stdout, so the result follows
+     * the previous messages. If header is false, the rows are written without
+     * the header.
+     */
+    explicit query_output(output_sink& sink, bool header = true);
+
+    query_output(const query_output&) = delete;
+    query_output& operator=(const query_output&) = delete;
+
+    /**
+     * Starts a row. The header is written from the column names of the
+     * statement before the first row.
+     */
+    void begin_row(sqlite3_stmt* stmt);
+
+    /**
+     * Starts a row. The header is written from the column names before the
+     * first row.
+     */
+    void begin_row(const char* const* column_names, size_t column_count);
+
+    /**
+     * Writes the header now unless it was already written, so the rows
+     * formatted by other query outputs can be appended to the sink.
+     */
+    void begin_result(const char* const* column_names, size_t column_count);
+
+    /**
+     * Writes a text cell, a view with a null data pointer is written as NULL.
+     */
+    void write_text(std::string_view value);
+    void write_int(int64_t value);
+    void end_row();
+
+    /**
+     * Flushes the sink, so std::cout can be used again.
+     *
+     * @return False if the output failed, true otherwise.
+     */
+    bool finish();
+
+    size_t rows() const;
+
+private:
+    void write_header(const char* const* column_names, size_t column_count);
+    void begin_cell();
+    void write_escaped(std::string_view value);
+
+    output_sink& sink_;
+    bool header_;
+    bool header_written_;
+    size_t column_;
+    size_t rows_;
+    // The escaped "name": prefixes of the JSON values.
+    std::vector<std::string> json_keys_;
+};
+
+#endif // OUTPUT_SINK_HPP
@@ -0,0 +1,487 @@
+/**
+ * @file    parallel_scan.cpp
+ *
+ * @brief   Parallel execution of the Staff queries over the ranges of IDs.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "parallel_scan.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "instrumentation.hpp"
+#include "row_cursor.hpp"
+#include "staff.hpp"
+#include "statement_cache.hpp"
+#include "table_schema.hpp"
+
+namespace
+{
+
+// The initial size of the memory sink of a range, it grows as needed.
+constexpr size_t k_range_buffer_size = 64 * 1024;
+
+/**
+ * The binding of the query parameters following the ID range (?1 and ?2).
+ */
+using filter_binder = std::function<void(sqlite3_stmt* stmt)>;
+
+/**
+ * The formatted results of the ID ranges shared by the read tasks and the
+ * merging thread.
+ */
+class range_results
+{
+public:
+    explicit range_results(size_t count)
+      : sinks_(count), statuses_(count, task_status::completed), finished_(count, false)
+    {
+    }
+
+    /**
+     * Stores the output of a range, called by the task before it completes.
+     */
+    void store(size_t range, std::unique_ptr<output_sink> sink)
+    {
+        sinks_[range] = std::move(sink);
+    }
+
+    /**
+     * Marks the range as finished, called by the completion callback.
+     */
+    void finish(size_t range, task_status status)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            statuses_[range] = status;
+            finished_[range] = true;
+            completed_.push_back(range);
+        }
+
+        changed_.notify_one();
+    }
+
+    /**
+     * Waits for the next range to be merged, the n-th range in the ID order
+     * or the next finished range in the completion order.
+     *
+     * @param order  The merge order.
+     * @param merged The number of the already merged ranges.
+     * @param sink   The output of the range, null if it failed.
+     * @return       The final state of the task of the range.
+     */
+    task_status next(merge_order order, size_t merged, std::unique_ptr<output_sink>& sink)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        size_t range = merged;
+
+        if (order == merge_order::by_id)
+        {
+            changed_.wait(lock, [this, merged] { return finished_[merged]; });
+        }
+        else
+        {
+            changed_.wait(lock, [this] { return !completed_.empty(); });
+            range = completed_.front();
+            completed_.pop_front();
+        }
+
+        // The sink was stored before the task finished, so it is not
+        // accessed by the task anymore.
+        sink = std::move(sinks_[range]);
+
+        return statuses_[range];
+    }
+
+private:
+    std::vector<std::unique_ptr<output_sink>> sinks_;
+    std::vector<task_status> statuses_;
+    std::vector<bool> finished_;
+    std::deque<size_t> completed_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+/**
+ * Function which splits the inclusive range [first, last] into at most count
+ * ranges of the same width.
+ */
+void split_range(int64_t first, int64_t last, size_t count, std::vector<id_range>& ranges)
+{
+    // The span is computed unsigned, so it does not overflow for any values.
+    const uint64_t span = static_cast<uint64_t>(last) - static_cast<uint64_t>(first);
+    const uint64_t width = span / std::max<uint64_t>(count, 1) + 1;
+
+    for (uint64_t offset = 0; offset <= span; offset += width)
+    {
+        const uint64_t end = std::min(span, offset + width - 1);
+        ranges.push_back({static_cast<int64_t>(static_cast<uint64_t>(first) + offset),
+                          static_cast<int64_t>(static_cast<uint64_t>(first) + end)});
+
+        if (end == span)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * Function which builds the query of an ID range. The range is bound to the
+ * parameters ?1 and ?2, the parameters of the filter follow them. The rows of
+ * every range are ordered by ID in both merge orders.
+ *
+ * If id_scan is false, the ID condition is excluded from the rowid search by
+ * the unary plus, so every range is searched by the index of the filter and
+ * the IDs are checked on the index entries. Otherwise the range is scanned by
+ * the rowid and the rows are already ordered.
+ */
+std::string range_query_sql(std::string_view table_name, std::string_view filter, bool id_scan)
+{
+    std::string sql = "SELECT ";
+    sql.append(get_table_sql(k_staff_schema).select_columns).append(" FROM ").append(table_name);
+    sql.append(id_scan ? " WHERE ID BETWEEN ?1 AND ?2" : " WHERE +ID BETWEEN ?1 AND ?2");
+
+    if (!filter.empty())
+    {
+        sql.append(" AND ").append(filter);
+    }
+
+    sql.append(" ORDER BY ID;");
+
+    return sql;
+}
+
+/**
+ * Function which queries a single ID range and formats its rows into a
+ * memory sink without the header.
+ */
+bool format_range(const std::string& sql,
+                  const filter_binder& bind_filter,
+                  const id_range& range,
+                  output_format format,
+                  sqlite3** p_db,
+                  std::unique_ptr<output_sink>& range_sink)
+{
+    cached_statement stmt(get_statement_cache(*p_db), sql);
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (parallel scan).\n";
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt.get(), 1, range.first);
+    sqlite3_bind_int64(stmt.get(), 2, range.last);
+
+    if (bind_filter)
+    {
+        bind_filter(stmt.get());
+    }
+
+    range_sink = std::make_unique<output_sink>(k_memory_sink_fd, format, k_range_buffer_size);
+    query_output output(*range_sink, false);
+    row_cursor<staff_row> cursor(stmt.get());
+
+    for (const staff_row& row : cursor)
+    {
+        print_query_result(row, output);
+    }
+
+    if (!cursor.ok())
+    {
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Function which splits the table into the ID ranges on a reader connection
+ * of the executor, its workers own all connections of the pool.
+ */
+bool find_id_ranges(async_executor& executor, std::string_view table_name, size_t count,
+                    std::vector<id_range>& ranges)
+{
+    std::future<task_status> done = executor.submit_read([table_name, count, &ranges](sqlite3** p_db)
+    {
+        return split_id_ranges(table_name, count, p_db, ranges);
+    });
+
+    return done.get() == task_status::completed;
+}
+
+/**
+ * Function which runs the Staff query over the ID ranges in parallel and
+ * merges the formatted ranges into the sink.
+ *
+ * @param executor    The started executor.
+ * @param table_name  The name of a Staff table.
+ * @param filter      The condition of the query, empty for all rows.
+ * @param bind_filter The binding of the parameters of the condition.
+ * @param id_scan     True if the ranges are scanned by the rowid, false if
+ *                    they are searched by the index of the condition.
+ * @param options     The number of ranges and the merge order.
+ * @param sink        The sink of the printed records.
+ * @return            True if all ranges were queried and written
+ *                    successfully, false otherwise.
+ */
+bool run_parallel_query(async_executor& executor,
+                        std::string_view table_name,
+                        std::string_view filter,
+                        const filter_binder& bind_filter,
+                        bool id_scan,
+                        const parallel_scan_options& options,
+                        output_sink& sink)
+{
+    scoped_timer timer(operation::parallel_scan);
+
+    std::vector<id_range> ranges;
+
+    if (!find_id_ranges(executor, table_name, options.ranges, ranges))
+    {
+        return false;
+    }
+
+    const std::string sql = range_query_sql(table_name, filter, id_scan);
+    const output_format format = sink.format();
+    range_results results(ranges.size());
+    cancellation cancel;
+
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        const id_range range = ranges[i];
+
+        executor.submit_read([&sql, &bind_filter, &results, range, format, i](sqlite3** p_db)
+        {
+            std::unique_ptr<output_sink> range_sink;
+            const bool formatted = format_range(sql, bind_filter, range, format, p_db, range_sink);
+            results.store(i, std::move(range_sink));
+
+            return formatted;
+        },
+        [&results, i](task_status status)
+        {
+            results.finish(i, status);
+        },
+        cancel);
+    }
+
+    const std::vector<const char*>& names = get_table_sql(k_staff_schema).column_names;
+    query_output output(sink);
+    bool ok = true;
+
+    // All ranges are waited for, even after a failure, because the tasks
+    // refer to the local state.
+    for (size_t merged = 0; merged < ranges.size(); ++merged)
+    {
+        std::unique_ptr<output_sink> range_sink;
+
+        if (results.next(options.order, merged, range_sink) != task_status::completed)
+        {
+            cancel.cancel();
+            ok = false;
+            continue;
+        }
+
+        if (ok && !range_sink->buffered().empty())
+        {
+            output.begin_result(names.data(), names.size());
+            sink.append(range_sink->buffered());
+        }
+    }
+
+    return output.finish() && ok;
+}
+
+} // namespace
+
+bool split_id_ranges(std::string_view table_name, size_t count, sqlite3** p_db, std::vector<id_range>& ranges)
+{
+    ranges.clear();
+
+    // The subqueries read a single rowid each, a query of both MIN and MAX
+    // would scan the whole table.
+    std::string sql = "SELECT (SELECT MIN(ID) FROM ";
+    sql.append(table_name).append("), (SELECT MAX(ID) FROM ").append(table_name).append(");");
+
+    cached_statement stmt(get_statement_cache(*p_db), sql);
+
+    if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW)
+    {
+        std::cerr << "Error: finding the ID ranges of table " << table_name << " failed.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    if (sqlite3_column_type(stmt.get(), 0) == SQLITE_NULL)
+    {
+        return true;
+    }
+
+    split_range(sqlite3_column_int64(stmt.get(), 0), sqlite3_column_int64(stmt.get(), 1), count, ranges);
+
+    return true;
+}
+
+bool parallel_print_table(async_executor& executor,
+                          std::string_view table_name,
+                          const parallel_scan_options& options,
+                          output_sink& sink)
+{
+    if (!run_parallel_query(executor, table_name, {}, filter_binder(), true, options, sink))
+    {
+        std::cerr << "Error: table " << table_name << " parallel select failed.\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+bool parallel_select_salary_threshold(async_executor& executor,
+                                      std::string_view table_name,
+                                      int threshold,
+                                      const parallel_scan_options& options,
+                                      output_sink& sink)
+{
+    const filter_binder bind_threshold = [threshold](sqlite3_stmt* stmt)
+    {
+        sqlite3_bind_int(stmt, 3, threshold);
+    };
+
+    if (!run_parallel_query(executor, table_name, "Salary >= ?3", bind_threshold, true, options, sink))
+    {
+        std::cerr << "Error: executing SQL statement failed (parallel salaries query).\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+bool parallel_select_by_last_name(async_executor& executor,
+                                  std::string_view table_name,
+                                  std::string_view last_name,
+                                  const parallel_scan_options& options,
+                                  output_sink& sink)
+{
+    const filter_binder bind_last_name = [last_name](sqlite3_stmt* stmt)
+    {
+        sqlite3_bind_text(stmt, 3, last_name.data(), static_cast<int>(last_name.size()), SQLITE_STATIC);
+    };
+
+    if (!run_parallel_query(executor, table_name, "LastName = ?3", bind_last_name, false, options,
+                            sink))
+    {
+        std::cerr << "Error: executing SQL statement failed (parallel last name query).\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+bool parallel_aggregate_salaries(async_executor& executor,
+                                 std::string_view table_name,
+                                 int64_t min_salary,
+                                 int64_t max_salary,
+                                 const parallel_scan_options& options,
+                                 salary_aggregate& result)
+{
+    scoped_timer timer(operation::parallel_scan);
+
+    result = salary_aggregate();
+
+    if (min_salary > max_salary)
+    {
+        return true;
+    }
+
+    // The salaries are searched by their index, so the salary range is split
+    // instead of the IDs. Every part reads its own part of the index.
+    std::vector<id_range> ranges;
+    split_range(min_salary, max_salary, options.ranges, ranges);
+
+    std::string sql = "SELECT COUNT(*), SUM(Salary), MIN(Salary), MAX(Salary) FROM ";
+    sql.append(table_name).append(" WHERE Salary BETWEEN ?1 AND ?2;");
+
+    std::vector<salary_aggregate> partials(ranges.size());
+    std::vector<std::future<task_status>> done;
+    done.reserve(ranges.size());
+
+    for (size_t i = 0; i < ranges.size(); ++i)
+    {
+        const id_range range = ranges[i];
+        salary_aggregate& partial = partials[i];
+
+        done.push_back(executor.submit_read([&sql, &partial, range](sqlite3** p_db)
+        {
+            cached_statement stmt(get_statement_cache(*p_db), sql);
+
+            if (!stmt)
+            {
+                std::cerr << "Error: preparing SQL statement failed (parallel salary aggregate).\n";
+                return false;
+            }
+
+            sqlite3_bind_int64(stmt.get(), 1, range.first);
+            sqlite3_bind_int64(stmt.get(), 2, range.last);
+
+            if (sqlite3_step(stmt.get()) != SQLITE_ROW)
+            {
+                std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+                return false;
+            }
+
+            partial.count = static_cast<uint64_t>(sqlite3_column_int64(stmt.get(), 0));
+            partial.sum = sqlite3_column_int64(stmt.get(), 1);
+            partial.min = sqlite3_column_int64(stmt.get(), 2);
+            partial.max = sqlite3_column_int64(stmt.get(), 3);
+
+            return true;
+        }));
+    }
+
+    // All tasks are waited for before the partials go out of scope.
+    bool ok = true;
+
+    for (std::future<task_status>& status : done)
+    {
+        ok = (status.get() == task_status::completed) && ok;
+    }
+
+    if (!ok)
+    {
+        std::cerr << "Error: executing SQL statement failed (parallel salary aggregate).\n";
+        return false;
+    }
+
+    for (const salary_aggregate& partial : partials)
+    {
+        if (partial.count == 0)
+        {
+            continue;
+        }
+
+        result.min = (result.count == 0) ? partial.min : std::min(result.min, partial.min);
+        result.max = (result.count == 0) ? partial.max : std::max(result.max, partial.max);
+        result.count += partial.count;
+        result.sum += partial.sum;
+    }
+
+    return true;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file    parallel_scan.hpp
+ *
+ * @brief   Parallel execution of the Staff queries over the ranges of IDs.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef PARALLEL_SCAN_HPP
+#define PARALLEL_SCAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <sqlite3.h>
+
+#include "async_executor.hpp"
+#include "output_sink.hpp"
+#include "staff_snapshot.hpp"
+
+// The default number of the ID ranges of a parallel query. There are more
+// ranges than reader connections, so the ranges finish in about the order of
+// their IDs and the ordered merge writes and frees them early.
+constexpr size_t k_default_scan_ranges = 16;
+
+/**
+ * The order in which the results of the ID ranges are merged.
+ */
+enum class merge_order
+{
+    by_id,     // The rows ordered by ID, the ranges are written in their order.
+    completion // The ranges are written as they finish, each one ordered by ID.
+};
+
+/**
+ * The options of the parallel queries.
+ */
+struct parallel_scan_options
+{
+    // The number of the ID ranges, each one is queried by a separate read
+    // task of the executor.
+    size_t ranges = k_default_scan_ranges;
+    merge_order order = merge_order::by_id;
+};
+
+/**
+ * The inclusive range of IDs (or of other integer values).
+ */
+struct id_range
+{
+    int64_t first = 0;
+    int64_t last = 0;
+};
+
+/**
+ * Function which splits the IDs between MIN(ID) and MAX(ID) of the table into
+ * ranges of the same width. The IDs of the Staff table are assigned by
+ * SQLite, so the rows are distributed evenly unless many rows were deleted.
+ *
+ * @param table_name The name of a table.
+ * @param count      The maximum number of the ranges.
+ * @param p_db       Database connection pointer.
+ * @param ranges     The ranges, no range if the table is empty.
+ * @return           True if the ranges were found successfully, false
+ *                   otherwise.
+ */
+bool split_id_ranges(std::string_view table_name, size_t count, sqlite3** p_db, std::vector<id_range>& ranges);
+
+/**
+ * The parallel variants of the print_table, select_salary_threshold and
+ * select_by_last_name functions.
+ *
+ * The query is run for every ID range by a read task of the executor, so the
+ * ranges are queried on all reader connections of its pool at once. Every
+ * task formats the rows of its range into a memory sink, the calling thread
+ * writes the header once and appends the formatted ranges to the sink in the
+ * order given by the options. The formatted output of a range is kept until
+ * it is written, so the ordered merge may buffer the ranges finished ahead of
+ * a slow one.
+ *
+ * The rows are equal to the rows of the serial queries, but ordered by ID.
+ * The table and the salary threshold ranges are scanned by the rowid. The
+ * last name query searches the (LastName, FirstName, PhoneNum) index in every
+ * range and checks the IDs on the index entries, so only the row reads are
+ * split and the index search is repeated per range. It pays off only for
+ * last names with many rows.
+ *
+ * @param executor   The started executor.
+ * @param table_name The name of a Staff table.
+ * @param options    The number of ranges and the merge order.
+ * @param sink       The sink of the printed records.
+ * @return           True if all ranges were queried and written successfully,
+ *                   false otherwise (the output may be incomplete).
+ */
+bool parallel_print_table(async_executor& executor,
+                          std::string_view table_name,
+                          const parallel_scan_options& options,
+                          output_sink& sink);
+bool parallel_select_salary_threshold(async_executor& executor,
+                                      std::string_view table_name,
+                                      int threshold,
+                                      const parallel_scan_options& options,
+                                      output_sink& sink);
+bool parallel_select_by_last_name(async_executor& executor,
+                                  std::string_view table_name,
+                                  std::string_view last_name,
+                                  const parallel_scan_options& options,
+                                  output_sink& sink);
+
+/**
+ * Function which aggregates the salaries in the range [min_salary, max_salary]
+ * in parallel. The salary range is split into parts of the same width, so
+ * every part is searched by the Salary index. Every part computes its partial
+ * COUNT, SUM, MIN and MAX, which are combined by the calling thread. The
+ * result is equal to the query:
+ *     SELECT COUNT(*), SUM(Salary), MIN(Salary), MAX(Salary) FROM Staff
+ *         WHERE Salary BETWEEN ? AND ?;
+ * (see aggregate_salaries), the MIN and MAX of an empty result are zero.
+ *
+ * @param executor   The started executor.
+ * @param table_name The name of a Staff table.
+ * @param min_salary The lowest included salary.
+ * @param max_salary The highest included salary.
+ * @param options    The number of the parts, the merge order is not used.
+ * @param result     The combined aggregate.
+ * @return           True if all ranges were aggregated successfully, false
+ *                   otherwise.
+ */
+bool parallel_aggregate_salaries(async_executor& executor,
+                                 std::string_view table_name,
+                                 int64_t min_salary,
+                                 int64_t max_salary,
+                                 const parallel_scan_options& options,
+                                 salary_aggregate& result);
+
+#endif // PARALLEL_SCAN_HPP
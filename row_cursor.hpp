@@ -0,0 +1,186 @@
+/**
+ * @file    row_cursor.hpp
+ *
+ * @brief   Typed cursor streaming the rows of a prepared statement.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef ROW_CURSOR_HPP
+#define ROW_CURSOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+#include <sqlite3.h>
+
+/**
+ * Function which reads a text column as a string view over the SQLite row
+ * buffer. The view is valid until the statement is stepped, reset or
+ * finalized. A NULL value is returned as a view with a null data pointer.
+ *
+ * @param stmt   The statement positioned on a row.
+ * @param column The index of the column.
+ * @return       The view of the column value.
+ */
+inline std::string_view column_text_view(sqlite3_stmt* stmt, int column)
+{
+    // The text has to be obtained before the length, so the length is the
+    // length of the text representation.
+    const unsigned char* text = sqlite3_column_text(stmt, column);
+
+    if (text == nullptr)
+    {
+        return std::string_view();
+    }
+
+    return std::string_view(reinterpret_cast<const char*>(text), static_cast<size_t>(sqlite3_column_bytes(stmt, column)));
+}
+
+/**
+ * The cursor over the result rows of a prepared statement.
+ *
+ * The rows are mapped by the static Row::read(sqlite3_stmt*, Row&) function
+ * into a single Row instance owned by the cursor, so no allocation is done
+ * per row. The columns are read natively (integers by sqlite3_column_int64,
+ * texts as views), so SQLite does not convert them to strings. The cursor is
+ * iterated by a range-for loop:
+ *
+ *     row_cursor<staff_row> cursor(stmt);
+ *
+ *     for (const staff_row& row : cursor)
+ *     {
+ *         ...
+ *     }
+ *
+ *     if (!cursor.ok()) ...
+ *
+ * A row (and the views in it) is valid only until the cursor advances.
+ */
+template <typename Row>
+class row_cursor
+{
+public:
+    explicit row_cursor(sqlite3_stmt* stmt)
+      : stmt_(stmt), status_(SQLITE_OK), row_()
+    {
+    }
+
+    row_cursor(const row_cursor&) = delete;
+    row_cursor& operator=(const row_cursor&) = delete;
+
+    class iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Row;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Row*;
+        using reference = const Row&;
+
+        iterator()
+          : cursor_(nullptr)
+        {
+        }
+
+        explicit iterator(row_cursor* cursor)
+          : cursor_(cursor)
+        {
+            advance();
+        }
+
+        reference operator*() const
+        {
+            return cursor_->row_;
+        }
+
+        pointer operator->() const
+        {
+            return &cursor_->row_;
+        }
+
+        iterator& operator++()
+        {
+            advance();
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const
+        {
+            return cursor_ == other.cursor_;
+        }
+
+        bool operator!=(const iterator& other) const
+        {
+            return cursor_ != other.cursor_;
+        }
+
+    private:
+        void advance()
+        {
+            if (cursor_ != nullptr && !cursor_->step())
+            {
+                cursor_ = nullptr;
+            }
+        }
+
+        row_cursor* cursor_;
+    };
+
+    /**
+     * Steps the statement to the first row. The cursor can be iterated only
+     * once.
+     */
+    iterator begin()
+    {
+        return iterator(this);
+    }
+
+    iterator end()
+    {
+        return iterator();
+    }
+
+    /**
+     * @return True if no error occurred while stepping the statement.
+     */
+    bool ok() const
+    {
+        return status_ == SQLITE_OK || status_ == SQLITE_ROW || status_ == SQLITE_DONE;
+    }
+
+    /**
+     * @return The result code of the last step.
+     */
+    int status() const
+    {
+        return status_;
+    }
+
+    sqlite3_stmt* statement() const
+    {
+        return stmt_;
+    }
+
+private:
+    bool step()
+    {
+        status_ = sqlite3_step(stmt_);
+
+        if (status_ != SQLITE_ROW)
+        {
+            return false;
+        }
+
+        Row::read(stmt_, row_);
+
+        return true;
+    }
+
+    sqlite3_stmt* stmt_;
+    int status_;
+    Row row_;
+};
+
+#endif // ROW_CURSOR_HPP
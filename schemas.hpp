@@ -0,0 +1,100 @@
+/**
+ * @file    schemas.hpp
+ *
+ * @brief   The schemas of the Staff table and of its related tables.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef SCHEMAS_HPP
+#define SCHEMAS_HPP
+
+#include <string_view>
+
+#include "table_schema.hpp"
+
+constexpr const char* k_staff_table_name = "Staff";
+constexpr const char* k_department_table_name = "Department";
+constexpr const char* k_payroll_table_name = "PayrollHistory";
+
+// Email can have a total length of 320 characters, so VARCHAR(320) data
+// type is used instead of VARCHAR(255) for the Email column.
+// https://www.mindbaz.com/en/email-deliverability/what-is-the-maximum-size-of-an-mail-address/
+
+// Linux's maximum path length is 4096 characters, so the VARCHAR(4096)
+// data type is used instead of VARCHAR(255) for the ProfileImage column.
+// https://unix.stackexchange.com/questions/32795/what-is-the-maximum-allowed-filename-and-folder-size-with-ecryptfs
+
+// The longest phone number is 15 characters, so the VARCHAR(20) data type
+// is used including reserving for spaces between numbers.
+// https://www.oreilly.com/library/view/regular-expressions-cookbook/9781449327453/ch04s03.html
+inline constexpr column_def k_staff_columns[] = {
+    {"ID",           column_type::integer, "INTEGER PRIMARY KEY AUTOINCREMENT"},
+    {"FirstName",    column_type::text,    "VARCHAR(255) NOT NULL"},
+    {"LastName",     column_type::text,    "VARCHAR(255) NOT NULL"},
+    {"Address",      column_type::text,    "VARCHAR(255) NOT NULL"},
+    {"Salary",       column_type::integer, "INTEGER NOT NULL"},
+    {"Email",        column_type::text,    "VARCHAR(320) NOT NULL UNIQUE"},
+    {"ProfileImage", column_type::text,    "VARCHAR(4096) UNIQUE"},
+    {"PhoneNum",     column_type::text,    "VARCHAR(20) NOT NULL UNIQUE"},
+    {"TimeZone",     column_type::text,    "VARCHAR(50)"}
+};
+
+// The columns of an inserted record in the order of the CSV values.
+inline constexpr std::string_view k_staff_record_names[] = {
+    "FirstName", "Address", "Salary", "LastName", "Email", "ProfileImage", "PhoneNum", "TimeZone"
+};
+
+inline constexpr auto k_staff_record = record_layout(k_staff_columns, k_staff_record_names);
+
+// The secondary indexes serving the salary threshold and last name queries.
+// The composite index covers the person existence check too.
+inline constexpr std::string_view k_staff_indexes[] = {
+    "Salary",
+    "LastName, FirstName, PhoneNum"
+};
+
+// A person of the input is identified by the Email. The names, addresses and
+// emails are searched by the type-ahead search (see search_staff).
+inline constexpr table_schema k_staff_schema =
+    make_table_schema(k_staff_table_name, k_staff_columns, k_staff_record, k_staff_indexes, "Email",
+                      "FirstName, LastName, Address, Email");
+
+// The departments of the company.
+inline constexpr column_def k_department_columns[] = {
+    {"ID",       column_type::integer, "INTEGER PRIMARY KEY AUTOINCREMENT"},
+    {"Name",     column_type::text,    "VARCHAR(255) NOT NULL UNIQUE"},
+    {"Location", column_type::text,    "VARCHAR(255)"},
+    {"Budget",   column_type::integer, "INTEGER NOT NULL"}
+};
+
+inline constexpr std::string_view k_department_record_names[] = {"Name", "Location", "Budget"};
+
+inline constexpr auto k_department_record = record_layout(k_department_columns, k_department_record_names);
+
+inline constexpr table_schema k_department_schema =
+    make_table_schema(k_department_table_name, k_department_columns, k_department_record, "Name");
+
+// The salary payments of the persons, each paid by a department.
+inline constexpr column_def k_payroll_columns[] = {
+    {"ID",           column_type::integer, "INTEGER PRIMARY KEY AUTOINCREMENT"},
+    {"StaffID",      column_type::integer, "INTEGER NOT NULL REFERENCES Staff (ID)"},
+    {"DepartmentID", column_type::integer, "INTEGER REFERENCES Department (ID)"},
+    {"PayDate",      column_type::text,    "VARCHAR(10) NOT NULL"},
+    {"Amount",       column_type::integer, "INTEGER NOT NULL"}
+};
+
+inline constexpr std::string_view k_payroll_record_names[] = {"StaffID", "DepartmentID", "PayDate", "Amount"};
+
+inline constexpr auto k_payroll_record = record_layout(k_payroll_columns, k_payroll_record_names);
+
+// The payment history of a person and the payments of a department.
+inline constexpr std::string_view k_payroll_indexes[] = {
+    "StaffID, PayDate",
+    "DepartmentID"
+};
+
+inline constexpr table_schema k_payroll_schema =
+    make_table_schema(k_payroll_table_name, k_payroll_columns, k_payroll_record, k_payroll_indexes);
+
+#endif // SCHEMAS_HPP
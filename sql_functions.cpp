@@ -0,0 +1,341 @@
+/**
+ * @file    sql_functions.cpp
+ *
+ * @brief   The SQL functions of the Staff reports run inside SQLite.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "sql_functions.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <new>
+
+namespace
+{
+
+// The functions depend on their arguments only and have no side effects.
+constexpr int k_function_flags = SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS;
+
+/**
+ * The state of the salary_percentile aggregate.
+ */
+struct percentile_state
+{
+    double percentile = 0.0;
+    std::vector<int64_t> values;
+};
+
+/**
+ * Function which returns the text argument of a function as a view, a view
+ * with a null data pointer for NULL.
+ */
+std::string_view value_text_view(sqlite3_value* value)
+{
+    const unsigned char* text = sqlite3_value_text(value);
+
+    if (text == nullptr)
+    {
+        return std::string_view();
+    }
+
+    return std::string_view(reinterpret_cast<const char*>(text), static_cast<size_t>(sqlite3_value_bytes(value)));
+}
+
+/**
+ * Function which returns the state of the aggregate, the state is created by
+ * the first step. The aggregate context holds only a pointer to the state.
+ *
+ * @param ctx    The context of the aggregate.
+ * @param create True if the missing state is created (in the steps), false
+ *               if it is not (in the final call).
+ * @return       The state, null if it does not exist or it was not created.
+ */
+template <typename State>
+State** aggregate_state(sqlite3_context* ctx, bool create)
+{
+    return static_cast<State**>(sqlite3_aggregate_context(ctx, create ? sizeof(State*) : 0));
+}
+
+void normalize_phone_function(sqlite3_context* ctx, int, sqlite3_value** argv)
+{
+    const std::string_view phone_num = value_text_view(argv[0]);
+
+    if (phone_num.data() == nullptr)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+
+    // The buffer is reused by the calls of the thread.
+    thread_local std::string normalized;
+    normalize_phone(phone_num, normalized);
+
+    sqlite3_result_text(ctx, normalized.data(), static_cast<int>(normalized.size()), SQLITE_TRANSIENT);
+}
+
+void email_domain_function(sqlite3_context* ctx, int, sqlite3_value** argv)
+{
+    const std::string_view domain = email_domain(value_text_view(argv[0]));
+
+    if (domain.data() == nullptr)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+
+    sqlite3_result_text(ctx, domain.data(), static_cast<int>(domain.size()), SQLITE_TRANSIENT);
+}
+
+void salary_percentile_step(sqlite3_context* ctx, int, sqlite3_value** argv)
+{
+    percentile_state** state = aggregate_state<percentile_state>(ctx, true);
+
+    if (state == nullptr)
+    {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+
+    if (*state == nullptr)
+    {
+        const double percentile = sqlite3_value_double(argv[1]);
+
+        if (sqlite3_value_type(argv[1]) == SQLITE_NULL || !(percentile >= 0.0 && percentile <= 100.0))
+        {
+            sqlite3_result_error(ctx, "salary_percentile: the percentile has to be in the range [0, 100]", -1);
+            return;
+        }
+
+        *state = new (std::nothrow) percentile_state();
+
+        if (*state == nullptr)
+        {
+            sqlite3_result_error_nomem(ctx);
+            return;
+        }
+
+        (*state)->percentile = percentile;
+    }
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    {
+        return;
+    }
+
+    try
+    {
+        (*state)->values.push_back(sqlite3_value_int64(argv[0]));
+    }
+    catch (const std::bad_alloc&)
+    {
+        sqlite3_result_error_nomem(ctx);
+    }
+}
+
+void salary_percentile_final(sqlite3_context* ctx)
+{
+    percentile_state** state = aggregate_state<percentile_state>(ctx, false);
+
+    if (state == nullptr || *state == nullptr)
+    {
+        sqlite3_result_null(ctx);
+        return;
+    }
+
+    if ((*state)->values.empty())
+    {
+        sqlite3_result_null(ctx);
+    }
+    else
+    {
+        sqlite3_result_int64(ctx, nearest_rank_percentile((*state)->values, (*state)->percentile));
+    }
+
+    delete *state;
+    *state = nullptr;
+}
+
+void salary_histogram_step(sqlite3_context* ctx, int, sqlite3_value** argv)
+{
+    salary_histogram** state = aggregate_state<salary_histogram>(ctx, true);
+
+    if (state == nullptr)
+    {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+
+    if (*state == nullptr)
+    {
+        const int64_t width = sqlite3_value_int64(argv[1]);
+
+        if (sqlite3_value_type(argv[1]) != SQLITE_INTEGER || width <= 0)
+        {
+            sqlite3_result_error(ctx, "salary_histogram: the bucket width has to be a positive integer", -1);
+            return;
+        }
+
+        *state = new (std::nothrow) salary_histogram(width);
+
+        if (*state == nullptr)
+        {
+            sqlite3_result_error_nomem(ctx);
+            return;
+        }
+    }
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+    {
+        return;
+    }
+
+    try
+    {
+        (*state)->add(sqlite3_value_int64(argv[0]));
+    }
+    catch (const std::bad_alloc&)
+    {
+        sqlite3_result_error_nomem(ctx);
+    }
+}
+
+void salary_histogram_final(sqlite3_context* ctx)
+{
+    salary_histogram** state = aggregate_state<salary_histogram>(ctx, false);
+
+    if (state == nullptr || *state == nullptr)
+    {
+        sqlite3_result_text(ctx, "[]", 2, SQLITE_STATIC);
+        return;
+    }
+
+    try
+    {
+        const std::string json = (*state)->json();
+        sqlite3_result_text(ctx, json.data(), static_cast<int>(json.size()), SQLITE_TRANSIENT);
+    }
+    catch (const std::bad_alloc&)
+    {
+        sqlite3_result_error_nomem(ctx);
+    }
+
+    delete *state;
+    *state = nullptr;
+}
+
+/**
+ * The registered SQL function, the scalar functions have no final call.
+ */
+struct sql_function
+{
+    const char* name;
+    int arguments;
+    void (*function)(sqlite3_context*, int, sqlite3_value**);
+    void (*step)(sqlite3_context*, int, sqlite3_value**);
+    void (*final)(sqlite3_context*);
+};
+
+const sql_function k_staff_functions[] = {
+    {"normalize_phone", 1, normalize_phone_function, nullptr, nullptr},
+    {"email_domain", 1, email_domain_function, nullptr, nullptr},
+    {"salary_percentile", 2, nullptr, salary_percentile_step, salary_percentile_final},
+    {"salary_histogram", 2, nullptr, salary_histogram_step, salary_histogram_final}
+};
+
+} // namespace
+
+bool register_staff_functions(sqlite3* db)
+{
+    for (const sql_function& function : k_staff_functions)
+    {
+        const int status = sqlite3_create_function_v2(db, function.name, function.arguments, k_function_flags,
+                                                      nullptr, function.function, function.step, function.final,
+                                                      nullptr);
+
+        if (status != SQLITE_OK)
+        {
+            std::cerr << "Error: registering the SQL function " << function.name << " failed.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(db) << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void normalize_phone(std::string_view phone_num, std::string& normalized)
+{
+    normalized.clear();
+
+    for (char c : phone_num)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            normalized += c;
+        }
+    }
+}
+
+std::string_view email_domain(std::string_view email)
+{
+    const size_t at = email.rfind('@');
+
+    if (email.data() == nullptr || at == std::string_view::npos)
+    {
+        return std::string_view();
+    }
+
+    return email.substr(at + 1);
+}
+
+int64_t nearest_rank_percentile(std::vector<int64_t>& values, double percentile)
+{
+    const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(values.size())));
+    const size_t index = std::max<size_t>(rank, 1) - 1;
+
+    // Only the value of the rank is needed, so the values are not sorted.
+    std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+
+    return values[index];
+}
+
+salary_histogram::salary_histogram(int64_t width)
+  : width_(width)
+{
+}
+
+void salary_histogram::add(int64_t salary)
+{
+    // The buckets of the negative salaries are rounded down too.
+    int64_t bucket = salary / width_;
+
+    if (salary % width_ < 0)
+    {
+        --bucket;
+    }
+
+    ++buckets_[bucket * width_];
+}
+
+std::string salary_histogram::json() const
+{
+    std::string json = "[";
+
+    for (const auto& bucket : buckets_)
+    {
+        json.append(json.size() > 1 ? ",[" : "[");
+        json.append(std::to_string(bucket.first)).append(",").append(std::to_string(bucket.second)).append("]");
+    }
+
+    json.append("]");
+
+    return json;
+}
+
+int64_t salary_histogram::width() const
+{
+    return width_;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file    sql_functions.hpp
+ *
+ * @brief   The SQL functions of the Staff reports run inside SQLite.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef SQL_FUNCTIONS_HPP
+#define SQL_FUNCTIONS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sqlite3.h>
+
+/**
+ * Function which registers the Staff SQL functions on the connection:
+ *
+ *     normalize_phone(phone)            The digits of the phone number, so
+ *                                       "555-010-0001" equals "5550100001".
+ *     email_domain(email)               The part of the email behind the
+ *                                       last '@', NULL without any '@'.
+ *     salary_percentile(salary, p)      The aggregate p-th percentile (0-100)
+ *                                       of the salaries by the nearest-rank
+ *                                       method, NULL for no salaries.
+ *     salary_histogram(salary, width)   The aggregate histogram of the
+ *                                       salaries as a JSON array of
+ *                                       [bucket start, count] pairs ordered
+ *                                       by the buckets of the given width.
+ *
+ * The NULL arguments are ignored by the aggregates and give NULL for the
+ * scalar functions. All functions are deterministic and innocuous, so they
+ * can be used in the expression indexes, e.g.:
+ *
+ *     CREATE INDEX idx_Staff_normalized_phone
+ *         ON Staff(normalize_phone(PhoneNum));
+ *
+ * The database with such an index can be written only by the connections
+ * which registered the functions.
+ *
+ * @param db Database connection.
+ * @return   True if all functions were registered successfully, false
+ *           otherwise.
+ */
+bool register_staff_functions(sqlite3* db);
+
+/**
+ * Function which writes the digits of the phone number into normalized.
+ */
+void normalize_phone(std::string_view phone_num, std::string& normalized);
+
+/**
+ * Function which returns the part of the email behind the last '@', a view
+ * with a null data pointer if the email has no '@'.
+ */
+std::string_view email_domain(std::string_view email);
+
+/**
+ * Function which returns the percentile (0-100) of the values by the
+ * nearest-rank method. The values are reordered.
+ *
+ * @param values     The non-empty values.
+ * @param percentile The percentile in the range [0, 100].
+ * @return           The smallest value which is greater or equal to the
+ *                   percentile of the values.
+ */
+int64_t nearest_rank_percentile(std::vector<int64_t>& values, double percentile);
+
+/**
+ * The histogram of the salaries in buckets of the same width.
+ */
+class salary_histogram
+{
+public:
+    explicit salary_histogram(int64_t width);
+
+    void add(int64_t salary);
+
+    /**
+     * @return The JSON array of [bucket start, count] pairs ordered by the
+     *         buckets, e.g. [[1000,98],[2000,102]].
+     */
+    std::string json() const;
+
+    int64_t width() const;
+
+private:
+    int64_t width_;
+    std::map<int64_t, uint64_t> buckets_;
+};
+
+#endif // SQL_FUNCTIONS_HPP
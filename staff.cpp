@@ -0,0 +1,1981 @@
+/**
+ * @file    staff.cpp
+ *
+ * @brief   The Staff table scheme and the database operations on it.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "staff.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio> // std::remove
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#include "arena.hpp"
+#include "connection_config.hpp"
+#include "csv_reader.hpp"
+#include "instrumentation.hpp"
+#include "lookup_cache.hpp"
+#include "output_sink.hpp"
+#include "row_cursor.hpp"
+#include "sql_functions.hpp"
+#include "statement_cache.hpp"
+#include "table_schema.hpp"
+
+namespace
+{
+
+// The separator of the values in the lookup cache keys.
+constexpr char k_key_separator = '\x1f';
+// The encoded length of a NULL text value.
+constexpr uint32_t k_null_length = UINT32_MAX;
+
+/**
+ * Function which builds the lookup cache key of the last name query. The key
+ * is built into a reused buffer, so the lookup does not allocate.
+ */
+const std::string& last_name_key(std::string_view table_name, std::string_view last_name)
+{
+    thread_local std::string key;
+
+    key.assign(1, 'L');
+    key.append(table_name.data(), table_name.size());
+    key += k_key_separator;
+    key.append(last_name.data(), last_name.size());
+
+    return key;
+}
+
+/**
+ * Function which builds the lookup cache key of the person existence check.
+ */
+const std::string& person_key(std::string_view table_name,
+                              std::string_view first_name,
+                              std::string_view last_name,
+                              std::string_view phone_num)
+{
+    thread_local std::string key;
+
+    key.assign(1, 'P');
+    key.append(table_name.data(), table_name.size());
+    key += k_key_separator;
+    key.append(first_name.data(), first_name.size());
+    key += k_key_separator;
+    key.append(last_name.data(), last_name.size());
+    key += k_key_separator;
+    key.append(phone_num.data(), phone_num.size());
+
+    return key;
+}
+
+/**
+ * The SQL text of a built-in query on the last used table. Every query keeps
+ * one per thread, so the repeated query finds its cached statement without
+ * building the text again.
+ */
+struct query_sql
+{
+    std::string table_name;
+    std::string columns_names;
+    std::string sql;
+};
+
+/**
+ * Function which returns the SQL text of the query, the text is built by the
+ * build function only if the table or the columns differ from the last call.
+ */
+template <typename Build>
+const std::string& memoized_sql(query_sql& last, std::string_view table_name, std::string_view columns_names,
+                                Build build)
+{
+    if (last.sql.empty() || last.table_name != table_name || last.columns_names != columns_names)
+    {
+        last.table_name.assign(table_name.data(), table_name.size());
+        last.columns_names.assign(columns_names.data(), columns_names.size());
+        last.sql = build();
+    }
+
+    return last.sql;
+}
+
+const std::string& memoized_sql(query_sql& last, std::string_view table_name,
+                                std::string (*build)(std::string_view table_name))
+{
+    return memoized_sql(last, table_name, {}, [build, table_name] { return build(table_name); });
+}
+
+void encode_int(arena_string& encoded, int64_t value)
+{
+    encoded.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void encode_text(arena_string& encoded, std::string_view value)
+{
+    const uint32_t length = value.data() ? static_cast<uint32_t>(value.size()) : k_null_length;
+
+    encoded.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    encoded.append(value.data(), value.data() ? value.size() : 0);
+}
+
+const char* decode_int(const char* p, int64_t& value)
+{
+    std::memcpy(&value, p, sizeof(value));
+    return p + sizeof(value);
+}
+
+const char* decode_text(const char* p, std::string_view& value)
+{
+    uint32_t length;
+    std::memcpy(&length, p, sizeof(length));
+    p += sizeof(length);
+
+    if (length == k_null_length)
+    {
+        value = std::string_view();
+        return p;
+    }
+
+    value = std::string_view(p, length);
+    return p + length;
+}
+
+/**
+ * Function which appends the compact encoding of the record (the integers
+ * followed by the length-prefixed texts) to the cached value.
+ */
+void encode_staff_row(arena_string& encoded, const staff_row& row)
+{
+    encode_int(encoded, row.id);
+    encode_int(encoded, row.salary);
+    encode_text(encoded, row.first_name);
+    encode_text(encoded, row.last_name);
+    encode_text(encoded, row.address);
+    encode_text(encoded, row.email);
+    encode_text(encoded, row.profile_image);
+    encode_text(encoded, row.phone_num);
+    encode_text(encoded, row.time_zone);
+}
+
+/**
+ * Function which decodes the record, the texts are views into the encoding.
+ */
+const char* decode_staff_row(const char* p, staff_row& row)
+{
+    p = decode_int(p, row.id);
+    p = decode_int(p, row.salary);
+    p = decode_text(p, row.first_name);
+    p = decode_text(p, row.last_name);
+    p = decode_text(p, row.address);
+    p = decode_text(p, row.email);
+    p = decode_text(p, row.profile_image);
+    p = decode_text(p, row.phone_num);
+    p = decode_text(p, row.time_zone);
+
+    return p;
+}
+
+/**
+ * The paged queries, the tags of their continuation tokens are given by the
+ * order of the values.
+ */
+enum class page_kind
+{
+    table,    // Ordered by ID.
+    salary,   // Ordered by (Salary, ID).
+    last_name // Ordered by (FirstName, PhoneNum) within a last name.
+};
+
+constexpr char k_page_tags[] = {'t', 's', 'n'};
+constexpr char k_token_separator = '.';
+constexpr char k_hex_digits[] = "0123456789abcdef";
+
+/**
+ * The key of the last row of a page, the next page starts behind it.
+ */
+struct page_key
+{
+    int64_t id = 0;
+    int64_t salary = 0;
+    std::string last_name;
+    std::string first_name;
+    std::string phone_num;
+};
+
+void append_token_int(std::string& token, int64_t value)
+{
+    token += k_token_separator;
+    token.append(std::to_string(value));
+}
+
+/**
+ * Function which appends the text to the token in hexadecimal digits, so the
+ * token contains only the separators, letters and digits.
+ */
+void append_token_text(std::string& token, std::string_view text)
+{
+    token += k_token_separator;
+
+    for (unsigned char c : text)
+    {
+        token += k_hex_digits[c >> 4];
+        token += k_hex_digits[c & 0x0f];
+    }
+}
+
+/**
+ * Function which removes the next value (behind its separator) from the
+ * token.
+ */
+bool next_token_value(std::string_view& token, std::string_view& value)
+{
+    if (token.empty() || token[0] != k_token_separator)
+    {
+        return false;
+    }
+
+    const size_t end = token.find(k_token_separator, 1);
+
+    value = token.substr(1, end == std::string_view::npos ? std::string_view::npos : end - 1);
+    token.remove_prefix(value.size() + 1);
+
+    return true;
+}
+
+bool read_token_int(std::string_view& token, int64_t& value)
+{
+    std::string_view digits;
+
+    if (!next_token_value(token, digits) || digits.empty())
+    {
+        return false;
+    }
+
+    const char* end = digits.data() + digits.size();
+    const std::from_chars_result result = std::from_chars(digits.data(), end, value);
+
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+/**
+ * Function which returns the value of the lowercase hexadecimal digit, -1
+ * for any other character.
+ */
+int hex_digit_value(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+bool read_token_text(std::string_view& token, std::string& text)
+{
+    std::string_view digits;
+
+    if (!next_token_value(token, digits) || digits.size() % 2 != 0)
+    {
+        return false;
+    }
+
+    text.clear();
+
+    for (size_t i = 0; i < digits.size(); i += 2)
+    {
+        const int high = hex_digit_value(digits[i]);
+        const int low = hex_digit_value(digits[i + 1]);
+
+        if (high < 0 || low < 0)
+        {
+            return false;
+        }
+
+        text += static_cast<char>(high << 4 | low);
+    }
+
+    return true;
+}
+
+/**
+ * Function which builds the continuation token of the page ending by the
+ * row, e.g. "s.3500.42" for the salary 3500 and the ID 42.
+ */
+void make_page_token(page_kind kind, const staff_row& row, std::string& token)
+{
+    token.assign(1, k_page_tags[static_cast<size_t>(kind)]);
+
+    switch (kind)
+    {
+        case page_kind::table:
+            append_token_int(token, row.id);
+            break;
+        case page_kind::salary:
+            append_token_int(token, row.salary);
+            append_token_int(token, row.id);
+            break;
+        case page_kind::last_name:
+            append_token_text(token, row.last_name);
+            append_token_text(token, row.first_name);
+            append_token_text(token, row.phone_num);
+            break;
+    }
+}
+
+/**
+ * Function which reads the key from the continuation token of the query.
+ *
+ * @return True if the token was made by the same kind of query, false
+ *         otherwise.
+ */
+bool parse_page_token(page_kind kind, std::string_view token, page_key& key)
+{
+    if (token.empty() || token[0] != k_page_tags[static_cast<size_t>(kind)])
+    {
+        return false;
+    }
+
+    token.remove_prefix(1);
+
+    bool parsed = false;
+
+    switch (kind)
+    {
+        case page_kind::table:
+            parsed = read_token_int(token, key.id);
+            break;
+        case page_kind::salary:
+            parsed = read_token_int(token, key.salary) && read_token_int(token, key.id);
+            break;
+        case page_kind::last_name:
+            parsed = read_token_text(token, key.last_name) && read_token_text(token, key.first_name) &&
+                     read_token_text(token, key.phone_num);
+            break;
+    }
+
+    return parsed && token.empty();
+}
+
+/**
+ * Function which checks the page size and reads the key of the page behind
+ * the continuation token, the first page has no token.
+ */
+bool read_page_key(page_kind kind, std::string_view token, size_t limit, page_key& key, const char* query_name)
+{
+    if (limit == 0)
+    {
+        std::cerr << "Error: the page size of the " << query_name << " has to be positive.\n";
+        return false;
+    }
+
+    if (!token.empty() && !parse_page_token(kind, token, key))
+    {
+        std::cerr << "Error: the continuation token of the " << query_name << " is not valid.\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Function which steps the page query and writes the first limit rows into
+ * the sink. The query fetches one more row, which shows that the next page
+ * exists, so the token of the next page is made from the last written row.
+ *
+ * @param stmt       The prepared page query with all parameters bound.
+ * @param kind       The paged query.
+ * @param limit      The number of rows on the page.
+ * @param p_db       Database connection pointer.
+ * @param sink       The sink of the printed records.
+ * @param next_token The token of the next page, empty for the last page.
+ * @return           True if the page was written successfully, false
+ *                   otherwise.
+ */
+bool print_staff_page(sqlite3_stmt* stmt, page_kind kind, size_t limit, sqlite3** p_db, output_sink& sink,
+                      std::string& next_token)
+{
+    query_output output(sink);
+    row_cursor<staff_row> cursor(stmt);
+    thread_local std::string last_token;
+    size_t printed = 0;
+
+    next_token.clear();
+
+    for (const staff_row& row : cursor)
+    {
+        if (printed == limit)
+        {
+            next_token = last_token;
+            break;
+        }
+
+        print_query_result(row, output);
+
+        // The views of the row are not valid after the next step.
+        if (++printed == limit)
+        {
+            make_page_token(kind, row, last_token);
+        }
+    }
+
+    if (!output.finish())
+    {
+        return false;
+    }
+
+    if (!cursor.ok())
+    {
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Function which returns the bound LIMIT of the page query, one row more
+ * than the page shows whether there is a next page.
+ */
+sqlite3_int64 page_fetch_limit(size_t limit)
+{
+    return static_cast<sqlite3_int64>(std::min<size_t>(limit, INT64_MAX - 1) + 1);
+}
+
+} // namespace
+
+/**
+ * Function check if the file containing the database scheme already exists.
+ * 
+ * @param db_filename Name of the file containing the database scheme.
+ * @return            True if the database exists, false otherwise.
+ */
+bool database_exists(const std::string& db_filename)
+{
+    boost::filesystem::path path_to_db(db_filename);
+
+    return boost::filesystem::exists(path_to_db);
+}
+
+/**
+ * Function which creates the database scheme.
+ * 
+ * If the file containing the scheme already exists, this database is used 
+ * instead of creating a new one. The Staff SQL functions are registered on
+ * the opened connection (see register_staff_functions). If a connection
+ * profile is given, its pragmas are applied to the opened connection.
+ * 
+ * @param db_filename  Name of the file containing the database scheme.
+ * @param profile_name The name of the connection profile, empty for the 
+ *                     SQLite defaults.
+ * @param p_db         Database connection pointer.
+ * @return             True if all sub-tasks were done successfully, false if 
+ *                     an error occurs.
+ */
+bool create_database(const std::string& db_filename, const std::string& profile_name, sqlite3** p_db)
+{
+    // Check if the database already exists. If yes, load the database from the file.
+    if (database_exists(db_filename))
+    {
+        std::cout << "The database \"" << db_filename << "\" already exists. Loading an existing database.\n";
+
+        int status = sqlite3_open(db_filename.c_str(), p_db);
+
+        if (status != SQLITE_OK)
+        {
+            std::cerr << "Error: loading the database \"" << db_filename << "\" failed.\n";
+            return false;
+        }
+
+        std::cout << "Info: The database \"" << db_filename << "\" loaded successfully.\n";
+    }
+    else
+    {
+        // The database does not exist. Create a new one.
+        int status = sqlite3_open(db_filename.c_str(), p_db);
+    
+        if (status != SQLITE_OK)
+        {
+            std::cerr << "Error: creating the database \"" << db_filename << "\" failed.\n";
+            return false;
+        }
+
+        std::cout << "Info: The database \"" << db_filename << "\" created successfully.\n";
+    }
+
+    if (!register_staff_functions(*p_db))
+    {
+        return false;
+    }
+
+    connection_profile profile;
+
+    if (!profile_name.empty())
+    {
+        if (!find_connection_profile(profile_name, profile))
+        {
+            std::cerr << "Error: unknown connection profile \"" << profile_name << "\".\n";
+            return false;
+        }
+
+        if (!apply_connection_profile(profile, p_db))
+        {
+            return false;
+        }
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * Function which creates the chosen custom table.
+ * 
+ * If the table already exists in the database, do not create a new one. The
+ * secondary indexes are created in both cases if they do not exist yet, so an
+ * existing database obtains the indexes added to the scheme later.
+ * 
+ * @param table_name    The name of a table to create.
+ * @param table_columns Comma-separated list of table columns headers.
+ * @param table_indexes The list of secondary indexes, each given as 
+ *                      a comma-separated list of indexed columns.
+ * @param p_db          Database connection pointer.
+ * @return              True if all sub-tasks were done successfully, false if 
+ *                      an error occurs.
+ */
+bool create_table(std::string_view table_name,
+                  std::string_view table_columns,
+                  const std::vector<std::string>& table_indexes,
+                  sqlite3** p_db)
+{
+    char* err_msg = nullptr;    
+
+    const std::string table_exists_sql = "SELECT name FROM sqlite_master WHERE type='table' AND name=?;";
+
+    cached_statement stmt(get_statement_cache(*p_db), table_exists_sql);
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (table existence check).\n";
+        return false;
+    }
+
+    sqlite3_bind_text(stmt.get(), 1, table_name.data(), static_cast<int>(table_name.size()), SQLITE_STATIC);
+
+    int status = sqlite3_step(stmt.get());
+    sqlite3_reset(stmt.get());
+
+    if (status == SQLITE_ROW)
+    {
+        // The table already exists. Use this table instead of creating a new one.
+        std::cout << "The table \"" << table_name << "\" already exists. The new table was not created.\n";
+    }
+    else if (status == SQLITE_DONE)
+    {
+        // The table does not exist: create it.
+        std::string create_table_sql = "CREATE TABLE ";
+        create_table_sql.append(table_name).append(" (").append(table_columns).append(");");
+
+        status = sqlite3_exec(*p_db, create_table_sql.c_str(), nullptr, 0, &err_msg);
+
+        if (status != SQLITE_OK)
+        {
+            std::cerr << "Error: executing SQL statement failed (table creation).\n";
+            std::cerr << "Error message: " << err_msg << "\n";
+            sqlite3_free(err_msg);
+            return false;
+        }
+
+        std::cout << "Info: The table was created successfully.\n";
+    }
+    else
+    {
+        std::cerr << "Error: executing SQL statement failed (table existence check).\n";
+        return false;
+    }
+
+    for (const std::string& index_columns : table_indexes)
+    {
+        std::string index_name = "idx_";
+        index_name.append(table_name).append("_").append(index_columns);
+
+        for (size_t pos = index_name.find(", "); pos != std::string::npos; pos = index_name.find(", ", pos))
+        {
+            index_name.replace(pos, 2, "_");
+        }
+
+        std::string create_index_sql = "CREATE INDEX IF NOT EXISTS " + index_name + " ON ";
+        create_index_sql.append(table_name).append(" (").append(index_columns).append(");");
+
+        status = sqlite3_exec(*p_db, create_index_sql.c_str(), nullptr, nullptr, &err_msg);
+
+        if (status != SQLITE_OK)
+        {
+            std::cerr << "Error: executing SQL statement failed (index " << index_name << " creation).\n";
+            std::cerr << "Error message: " << err_msg << "\n";
+            sqlite3_free(err_msg);
+            return false;
+        }
+    }
+
+    if (!table_indexes.empty())
+    {
+        std::cout << "Info: The table indexes were created successfully.\n";
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+    
+    return true;
+}
+
+/**
+ * The functions building the SQL text of the built-in queries. The same text is
+ * used by the queries and by the query plan check, so the checked plans are
+ * the plans of the executed statements.
+ * 
+ * @param table_name The name of a table on which the query runs.
+ * @return           The SQL text of the query.
+ */
+std::string person_exists_sql(std::string_view table_name)
+{
+    std::string sql = "SELECT COUNT(*) FROM ";
+    sql.append(table_name).append(" WHERE FirstName = ? AND LastName = ? AND PhoneNum = ?;");
+
+    return sql;
+}
+
+std::string select_salary_sql(std::string_view table_name)
+{
+    std::string sql = "SELECT ";
+    sql.append(get_table_sql(k_staff_schema).select_columns).append(" FROM ").append(table_name);
+    sql.append(" WHERE Salary >= ?;");
+
+    return sql;
+}
+
+std::string select_last_name_sql(std::string_view table_name)
+{
+    std::string sql = "SELECT ";
+    sql.append(get_table_sql(k_staff_schema).select_columns).append(" FROM ").append(table_name);
+    sql.append(" WHERE LastName = ?;");
+
+    return sql;
+}
+
+std::string search_sql(std::string_view table_name)
+{
+    // The page is selected from the search table first, so only the rows of
+    // the page are read from the table. All matches are ranked by the BM25
+    // rank of the index, the LIMIT keeps only the best limit + offset of them
+    // in the sorter. The rank ties are ordered by the ID, so the pages do not
+    // overlap.
+    const std::string search_table = search_table_name(table_name);
+
+    std::string sql = "SELECT ";
+    sql.append(get_table_sql(k_staff_schema).select_columns).append(" FROM ").append(table_name);
+    sql.append(" JOIN (SELECT rowid AS MatchID, rank AS MatchRank FROM ").append(search_table);
+    sql.append(" WHERE ").append(search_table).append(" MATCH ?1");
+    sql.append(" ORDER BY rank, rowid LIMIT ?2 OFFSET ?3) ON ID = MatchID ORDER BY MatchRank, ID;");
+
+    return sql;
+}
+
+std::string table_page_sql(std::string_view table_name, bool after_key)
+{
+    // The parameters have fixed numbers, so the first page leaves the key
+    // parameter unused.
+    std::string sql = "SELECT ";
+    sql.append(get_table_sql(k_staff_schema).select_columns).append(" FROM ").append(table_name);
+    sql.append(after_key ? " WHERE ID > ?1" : "").append(" ORDER BY ID LIMIT ?2;");
+
+    return sql;
+}
+
+std::string salary_page_sql(std::string_view table_name, bool after_key)
+{
+    // The Salary index holds the IDs too, so the (Salary, ID) key is sought
+    // in it and the rows are not sorted.
+    std::string sql = "SELECT ";
+    sql.append(get_table_sql(k_staff_schema).select_columns).append(" FROM ").append(table_name);
+    sql.append(after_key ? " WHERE (Salary, ID) > (?2, ?3)" : " WHERE Salary >= ?1");
+    sql.append(" ORDER BY Salary, ID LIMIT ?4;");
+
+    return sql;
+}
+
+std::string last_name_page_sql(std::string_view table_name, bool after_key)
+{
+    // The phone numbers are unique, so the (FirstName, PhoneNum) key of the
+    // (LastName, FirstName, PhoneNum) index identifies the row.
+    std::string sql = "SELECT ";
+    sql.append(get_table_sql(k_staff_schema).select_columns).append(" FROM ").append(table_name);
+    sql.append(" WHERE LastName = ?1").append(after_key ? " AND (FirstName, PhoneNum) > (?2, ?3)" : "");
+    sql.append(" ORDER BY FirstName, PhoneNum LIMIT ?4;");
+
+    return sql;
+}
+
+std::string update_phone_number_sql(std::string_view table_name)
+{
+    std::string sql = "UPDATE ";
+    sql.append(table_name).append(" SET PhoneNum = ? WHERE ID = ?;");
+
+    return sql;
+}
+
+/**
+ * The function checks if the records with a person already exist in the table.
+ * 
+ * The person is checked based on the FirstName, LastName and PhoneNum which 
+ * has to be unique in the table, so the person too. The result is read 
+ * through the lookup cache of the connection.
+ * 
+ * @param table_name The name of a table in which the person will be searched.
+ * @param cols       The parsed values in the same order as table headers.
+ * @param p_db       Database connection pointer.
+ * @return           True if a person already exists, false otherwise.
+ */
+bool person_exists(std::string_view table_name, const field_list& cols, sqlite3** p_db)
+{
+    scoped_timer timer(operation::person_exists);
+
+    if (cols.size() != k_expected_cols) {
+        std::cerr << "Error: unexpected number of columns.\n";
+        return false;
+    }
+
+    const std::string_view first_name = cols[k_first_name_idx];
+    const std::string_view last_name = cols[k_last_name_idx];
+    const std::string_view phone_num = cols[k_phone_num_idx];
+
+    lookup_cache& cache = get_lookup_cache(*p_db);
+    const std::string& key = person_key(table_name, first_name, last_name, phone_num);
+
+    if (const std::string* exists = cache.find(key))
+    {
+        return (*exists)[0] == '1';
+    }
+
+    thread_local query_sql last_sql;
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql, table_name, person_exists_sql));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (person existence check).\n";
+        return false;
+    }
+
+    // Bind parameters.
+    sqlite3_bind_text(stmt.get(), 1, first_name.data(), static_cast<int>(first_name.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 2, last_name.data(), static_cast<int>(last_name.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 3, phone_num.data(), static_cast<int>(phone_num.size()), SQLITE_STATIC);
+
+    int status = sqlite3_step(stmt.get());
+
+    if (status != SQLITE_ROW) {
+        std::cerr << "Error: executing SQL statement failed (person existence check).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    int person_count = sqlite3_column_int(stmt.get(), 0);
+
+    cache.insert(key, (person_count > 0) ? "1" : "0");
+
+    return (person_count > 0);
+}
+
+/**
+ * The function builds the INSERT statement with one parameter per table column.
+ * 
+ * @param table_name          The name of a table into which the records will 
+ *                            be inserted.
+ * @param table_columns_names Comma-separated list of table headers.
+ * @param conflict_clause     The optional conflict clause appended to the 
+ *                            statement (e.g. "ON CONFLICT DO NOTHING").
+ * @return                    The SQL text of the statement.
+ */
+std::string build_insert_sql(std::string_view table_name,
+                             std::string_view table_columns_names,
+                             std::string_view conflict_clause)
+{
+    std::string insert_record_sql = "INSERT INTO ";
+    insert_record_sql.append(table_name).append(" (").append(table_columns_names).append(") VALUES (?");
+
+    // One parameter per listed column.
+    for (char c : table_columns_names)
+    {
+        if (c == ',')
+        {
+            insert_record_sql += ", ?";
+        }
+    }
+
+    insert_record_sql += ")";
+
+    if (!conflict_clause.empty())
+    {
+        insert_record_sql.append(" ").append(conflict_clause);
+    }
+
+    return insert_record_sql + ";";
+}
+
+/**
+ * The function binds the parsed values to the parameters of the INSERT 
+ * statement of the Staff record columns by the code generated from the
+ * k_staff_schema (see the bind_record function). Empty integer values are
+ * bound as NULL, empty text values as empty strings. The values are bound
+ * statically (no copy is made), so the memory the 
+ * slices point into has to outlive the execution of the statement.
+ * 
+ * @param stmt The prepared INSERT statement.
+ * @param cols The parsed values in the same order as table headers.
+ */
+void bind_record_values(sqlite3_stmt* stmt, const field_list& cols)
+{
+    bind_record(stmt, k_staff_schema, cols);
+}
+
+/**
+ * The function inserts a record with a person into the table.
+ * 
+ * If the person already exists in the table, nothing is done.
+ * @param table_name           The name of a table into which the person will 
+ *                             be inserted.
+ * @param table_columns_values Comma-separated list of table headers.
+ * @param columns_values       Comma-separated list of values in the same order
+ *                             as table headers.
+ * @param p_db                 Database connection pointer.
+ * @return                     True if all sub-tasks were done successfully, false if 
+ *                             an error occurs.
+ */
+bool insert_table_record(std::string_view table_name, std::string_view table_columns_names,
+                         std::string_view columns_values, sqlite3** p_db)
+{
+    scoped_timer timer(operation::insert_record);
+
+    // The record is split in place, so the values are parsed from a copy. The
+    // copy and the slices are allocated from the arena of the call.
+    scratch_arena arena;
+    arena_string record(columns_values, arena.resource());
+    field_list cols(arena.resource());
+
+    if (!split_csv_record(&record[0], &record[0] + record.size(), cols))
+    {
+        std::cerr << "Error: malformed quoted value in the record.\n";
+        return false;
+    }
+
+    // Check if the person exists in the table.
+    if (person_exists(table_name, cols, p_db))
+    {
+        std::cout << "The inserted person already exists.\n";
+    }
+    else
+    {
+        // The person is not in the table, insert the record.
+        if (cols.size() != k_expected_cols) {
+            return false;
+        }
+
+        thread_local query_sql last_sql;
+        cached_statement stmt(get_statement_cache(*p_db),
+                              memoized_sql(last_sql, table_name, table_columns_names, [&]
+                              {
+                                  return build_insert_sql(table_name, table_columns_names, "");
+                              }));
+
+        if (!stmt)
+        {
+            std::cerr << "Error: preparing SQL statement failed (record insertion).\n";
+            return false;
+        }
+
+        bind_record_values(stmt.get(), cols);
+
+        int status = sqlite3_step(stmt.get());
+
+        if (status != SQLITE_DONE) {
+            std::cerr << "Error: inserting record into the " << table_name << " table.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            return false;
+        }
+
+        // The inserted person changes only the lookups of its own keys.
+        lookup_cache& cache = get_lookup_cache(*p_db);
+        cache.erase(person_key(table_name, cols[k_first_name_idx], cols[k_last_name_idx], cols[k_phone_num_idx]));
+        cache.erase(last_name_key(table_name, cols[k_last_name_idx]));
+
+        std::cout << "Info: The record was inserted successfully into the " << table_name << " table.\n";
+    }
+    
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The function validates a parsed record before it is inserted into the table.
+ * 
+ * Besides the number of columns, the NOT NULL columns, the salary, the email 
+ * and the phone number formats are checked.
+ * 
+ * @param cols   The parsed values in the same order as table headers.
+ * @param reason The reason of the rejection if the record is not valid.
+ * @return       True if the record is valid, false otherwise.
+ */
+bool validate_staff_record(const field_list& cols, std::string& reason)
+{
+    if (cols.size() != k_expected_cols)
+    {
+        reason = "unexpected number of columns";
+        return false;
+    }
+
+    if (cols[k_first_name_idx].empty() || cols[k_last_name_idx].empty() || cols[k_address_idx].empty())
+    {
+        reason = "missing name or address";
+        return false;
+    }
+
+    const std::string_view salary = cols[k_salary_idx];
+    size_t digits_start = (!salary.empty() && salary[0] == '-') ? 1 : 0;
+
+    if (salary.size() == digits_start || salary.find_first_not_of("0123456789", digits_start) != std::string_view::npos)
+    {
+        reason = "invalid salary";
+        return false;
+    }
+
+    // The email has to contain exactly one '@' with a non-empty local part 
+    // and a dot in the domain part.
+    const std::string_view email = cols[k_email_idx];
+    const size_t at_pos = email.find('@');
+
+    if (email.size() > k_max_email_length || at_pos == 0 || at_pos == std::string_view::npos ||
+        email.find('@', at_pos + 1) != std::string_view::npos ||
+        email.find('.', at_pos + 1) == std::string_view::npos)
+    {
+        reason = "invalid email";
+        return false;
+    }
+
+    // The phone number contains digits optionally separated by spaces, 
+    // dashes or parentheses and prefixed by '+'.
+    const std::string_view phone_num = cols[k_phone_num_idx];
+
+    if (phone_num.size() > k_max_phone_num_length ||
+        phone_num.find_first_of("0123456789") == std::string_view::npos ||
+        phone_num.find_first_not_of("0123456789 -()+") != std::string_view::npos)
+    {
+        reason = "invalid phone number";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * The function executes a single transaction control statement (BEGIN, COMMIT
+ * or ROLLBACK).
+ * 
+ * @param sql  The transaction control statement.
+ * @param p_db Database connection pointer.
+ * @return     True if the statement was executed successfully, false otherwise.
+ */
+bool exec_transaction_statement(const char* sql, sqlite3** p_db)
+{
+    char* err_msg = nullptr;
+
+    int status = sqlite3_exec(*p_db, sql, nullptr, nullptr, &err_msg);
+
+    if (status != SQLITE_OK)
+    {
+        std::cerr << "Error: executing SQL statement failed (" << sql << ").\n";
+        std::cerr << "Error message: " << err_msg << "\n";
+        sqlite3_free(err_msg);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * The function loads all records from the input stream into the table.
+ * 
+ * Unlike the insert_table_record function, the records are inserted in chunks
+ * of chunk_size rows, each wrapped in an explicit transaction, by a single 
+ * prepared INSERT statement with bound parameters. The input is read by the 
+ * streaming CSV reader and the field slices are bound directly from its buffer. Duplicate persons are not 
+ * looked up before the insertion, they are skipped by the ON CONFLICT DO 
+ * NOTHING clause against the UNIQUE constraints of the table.
+ * 
+ * The table, its record columns and the types the values are bound with are
+ * given by the schema, so any of the known tables can be loaded.
+ * 
+ * If an error occurs, the currently opened chunk is rolled back. The chunks 
+ * committed before stay in the table.
+ * 
+ * @param schema     The schema of a table into which the records will be
+ *                   inserted.
+ * @param input      The input stream with one comma-separated list of values
+ *                   per record.
+ * @param chunk_size The number of rows committed in one transaction.
+ * @param p_db       Database connection pointer.
+ * @param stats      The collected statistics of the load.
+ * @return           True if all records were processed successfully, false if
+ *                   an error occurs.
+ */
+bool bulk_load_table(const table_schema& schema,
+                     std::istream& input,
+                     size_t chunk_size,
+                     sqlite3** p_db,
+                     bulk_load_stats& stats)
+{
+    scoped_timer timer(operation::bulk_load);
+
+    // Any cached lookup may be changed by the loaded records.
+    get_lookup_cache(*p_db).invalidate_all();
+
+    const table_sql& sql = get_table_sql(schema);
+    cached_statement stmt(get_statement_cache(*p_db), sql.insert + " ON CONFLICT DO NOTHING;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (bulk insert).\n";
+        return false;
+    }
+
+    if (chunk_size == 0)
+    {
+        chunk_size = k_default_chunk_size;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    size_t rows_in_chunk = 0;
+    bool success = exec_transaction_statement("BEGIN;", p_db);
+    csv_reader reader(input);
+    field_list cols;
+
+    while (success && reader.next(cols))
+    {
+        ++stats.rows_read;
+
+        if (cols.size() != schema.record_column_count)
+        {
+            std::cerr << "Error: unexpected number of columns on the input line " << reader.line_number() << ".\n";
+            success = false;
+            break;
+        }
+
+        bind_record(stmt.get(), schema, cols);
+
+        int status = sqlite3_step(stmt.get());
+
+        if (status != SQLITE_DONE)
+        {
+            std::cerr << "Error: inserting record into the " << schema.name << " table (input line " \
+                      << reader.line_number() << ").\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            success = false;
+            break;
+        }
+
+        // Zero changes mean the record violates a UNIQUE constraint, so the 
+        // record (e.g. the person) is already stored in the table.
+        if (sqlite3_changes(*p_db) > 0)
+        {
+            ++stats.rows_inserted;
+        }
+        else
+        {
+            ++stats.rows_skipped;
+        }
+
+        sqlite3_reset(stmt.get());
+
+        if (++rows_in_chunk == chunk_size)
+        {
+            success = exec_transaction_statement("COMMIT;", p_db) && exec_transaction_statement("BEGIN;", p_db);
+
+            if (success)
+            {
+                ++stats.chunks_committed;
+                rows_in_chunk = 0;
+            }
+        }
+    }
+
+    if (success && reader.failed())
+    {
+        std::cerr << "Error: malformed quoted value in the record on the input line " \
+                  << reader.line_number() << ".\n";
+        success = false;
+    }
+
+    if (success)
+    {
+        success = exec_transaction_statement("COMMIT;", p_db);
+
+        if (success && rows_in_chunk > 0)
+        {
+            ++stats.chunks_committed;
+        }
+    }
+    else if (!sqlite3_get_autocommit(*p_db))
+    {
+        exec_transaction_statement("ROLLBACK;", p_db);
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start_time;
+    stats.elapsed_seconds = elapsed.count();
+
+    return success;
+}
+
+/**
+ * The function prints the statistics of the bulk load to stdout.
+ * 
+ * @param stats The statistics collected by the bulk_load_table function.
+ */
+void print_bulk_load_stats(const bulk_load_stats& stats)
+{
+    const double rows_per_second = (stats.elapsed_seconds > 0.0) ?
+        static_cast<double>(stats.rows_read) / stats.elapsed_seconds : 0.0;
+
+    std::cout << "Info: Bulk load finished. Rows read: " << stats.rows_read \
+              << ", inserted: " << stats.rows_inserted \
+              << ", skipped (already exist): " << stats.rows_skipped \
+              << ", committed chunks: " << stats.chunks_committed << ".\n";
+    std::cout << "Info: Bulk load took " << stats.elapsed_seconds << " s (" \
+              << static_cast<size_t>(rows_per_second) << " rows/s).\n";
+    std::cout << "-----------------------------------------------------------------------\n";
+}
+
+/**
+ * The function maps the current row of a statement selecting the Staff
+ * table columns into the staff_row. The integer columns are read
+ * natively and the text columns as views over the row buffer.
+ * 
+ * @param stmt The statement positioned on a row.
+ * @param row  The record to be filled.
+ */
+void staff_row::read(sqlite3_stmt* stmt, staff_row& row)
+{
+    row.id = sqlite3_column_int64(stmt, k_id_col);
+    row.first_name = column_text_view(stmt, k_first_name_col);
+    row.last_name = column_text_view(stmt, k_last_name_col);
+    row.address = column_text_view(stmt, k_address_col);
+    row.salary = sqlite3_column_int64(stmt, k_salary_col);
+    row.email = column_text_view(stmt, k_email_col);
+    row.profile_image = column_text_view(stmt, k_profile_image_col);
+    row.phone_num = column_text_view(stmt, k_phone_num_col);
+    row.time_zone = column_text_view(stmt, k_time_zone_col);
+}
+
+/**
+ * The function which writes a table record into the query output.
+ * 
+ * It is expected that this function is called only from the print_staff_rows
+ * function. The table headers are written by the query output before the 
+ * first record.
+ * 
+ * @param row    The table record.
+ * @param output The output of the query.
+ */
+void print_query_result(const staff_row& row, query_output& output)
+{
+    static const std::vector<const char*>& names = get_table_sql(k_staff_schema).column_names;
+
+    output.begin_row(names.data(), names.size());
+    output.write_int(row.id);
+    output.write_text(row.first_name);
+    output.write_text(row.last_name);
+    output.write_text(row.address);
+    output.write_int(row.salary);
+    output.write_text(row.email);
+    output.write_text(row.profile_image);
+    output.write_text(row.phone_num);
+    output.write_text(row.time_zone);
+    output.end_row();
+}
+
+/**
+ * The function steps the prepared query and writes all obtained table records
+ * into the sink by the print_query_result function. The rows are streamed by 
+ * the typed row cursor, so the integer columns are not converted to strings
+ * by SQLite. The sink is flushed when the result ends.
+ * 
+ * @param stmt         The prepared statement selecting the Staff columns with
+ *                     all parameters bound.
+ * @param p_db         Database connection pointer.
+ * @param sink         The sink of the printed records.
+ * @param encoded_rows If not null, the compact encoding of the records is
+ *                     appended to it (see print_encoded_rows).
+ * @return             True if the query was executed successfully, false 
+ *                     otherwise.
+ */
+bool print_staff_rows(sqlite3_stmt* stmt, sqlite3** p_db, output_sink& sink, arena_string* encoded_rows)
+{
+    query_output output(sink);
+    row_cursor<staff_row> cursor(stmt);
+
+    for (const staff_row& row : cursor)
+    {
+        print_query_result(row, output);
+
+        if (encoded_rows != nullptr)
+        {
+            encode_staff_row(*encoded_rows, row);
+        }
+    }
+
+    if (!output.finish())
+    {
+        return false;
+    }
+
+    if (!cursor.ok())
+    {
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * The function writes the records encoded by print_staff_rows into the sink.
+ * 
+ * @param encoded_rows The compact encoding of the records.
+ * @param sink         The sink of the printed records.
+ * @return             True if the records were written successfully, false
+ *                     otherwise.
+ */
+bool print_encoded_rows(std::string_view encoded_rows, output_sink& sink)
+{
+    query_output output(sink);
+    staff_row row;
+
+    const char* p = encoded_rows.data();
+    const char* end = p + encoded_rows.size();
+
+    while (p < end)
+    {
+        p = decode_staff_row(p, row);
+        print_query_result(row, output);
+    }
+
+    return output.finish();
+}
+
+/**
+ * The function executes the SQL statement for printing the complete table to 
+ * the sink. The selected columns and the way they are read are given by the
+ * schema of the table (see find_table_schema).
+ * 
+ * @param table_name    The name of a table to print.
+ * @param p_db          Database connection pointer.
+ * @param sink          The sink of the printed records.
+ */
+bool print_table(std::string_view table_name, sqlite3** p_db, output_sink& sink)
+{
+    scoped_timer timer(operation::print_table);
+
+    const table_schema* schema = find_table_schema(table_name);
+
+    if (schema == nullptr)
+    {
+        std::cerr << "Error: table " << table_name << " has no known schema.\n";
+        return false;
+    }
+
+    cached_statement stmt(get_statement_cache(*p_db), get_table_sql(*schema).select);
+
+    if (!stmt || !print_schema_rows(stmt.get(), *schema, p_db, sink))
+    {
+        std::cerr << "Error: table " << table_name << " select failed.\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The function executes the query to obtain records with people, who have a 
+ * salary greater or equal to a specific threshold provided by the parameter.
+ * 
+ * @param table_name    The name of a table.
+ * @param threshold     Salary threshold value.
+ * @param p_db          Database connection pointer.
+ * @param sink          The sink of the printed records.
+ */
+bool select_salary_threshold(std::string_view table_name, int threshold, sqlite3** p_db, output_sink& sink)
+{
+    scoped_timer timer(operation::select_salary);
+
+    thread_local query_sql last_sql;
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql, table_name, select_salary_sql));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (salaries query).\n";
+        return false;
+    }
+
+    sqlite3_bind_int(stmt.get(), 1, threshold);
+
+    if (!print_staff_rows(stmt.get(), p_db, sink))
+    {
+        std::cerr << "Error: executing SQL statement failed (salaries query).\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The function runs a query to obtain people who have a specific last name.
+ * 
+ * The records are read through the lookup cache of the connection, so a 
+ * repeated query is answered without SQLite.
+ * 
+ * @param table_name Name of a table in which the people will be searched.
+ * @param last_name  Searched last name.
+ * @param p_db       Database connection pointer.
+ * @param sink       The sink of the printed records.
+*/
+bool select_by_last_name(std::string_view table_name, std::string_view last_name, sqlite3** p_db,
+                         output_sink& sink)
+{
+    scoped_timer timer(operation::select_last_name);
+
+    lookup_cache& cache = get_lookup_cache(*p_db);
+    const std::string& key = last_name_key(table_name, last_name);
+
+    if (const std::string* encoded_rows = cache.find(key))
+    {
+        if (!print_encoded_rows(*encoded_rows, sink))
+        {
+            return false;
+        }
+
+        std::cout << "-----------------------------------------------------------------------\n";
+
+        return true;
+    }
+
+    thread_local query_sql last_sql;
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql, table_name, select_last_name_sql));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (last name query).\n";
+        return false;
+    }
+
+    sqlite3_bind_text(stmt.get(), 1, last_name.data(), static_cast<int>(last_name.size()), SQLITE_STATIC);
+
+    // The records are encoded into the arena of the query and copied into
+    // the cache once, only if the cache is enabled.
+    scratch_arena arena;
+    arena_string encoded_rows(arena.resource());
+    const bool cached = (cache.budget() > 0);
+
+    if (!print_staff_rows(stmt.get(), p_db, sink, cached ? &encoded_rows : nullptr))
+    {
+        std::cerr << "Error: executing SQL statement failed (last name query).\n";
+        return false;
+    }
+
+    if (cached)
+    {
+        cache.insert(key, std::string(encoded_rows));
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The function builds the FTS5 query of the type-ahead search. Every word of
+ * the text (a sequence of letters and digits) becomes a quoted prefix term,
+ * so the query matches the rows with a word starting with each of the words,
+ * e.g. "jo sl" becomes "jo"* "sl"*.
+ * 
+ * @param text  The searched text.
+ * @param query The FTS5 query.
+ * @return      True if the text has any word, false otherwise.
+ */
+bool build_prefix_query(std::string_view text, std::string& query)
+{
+    query.clear();
+
+    // The bytes of the UTF-8 sequences are kept in the words, like the
+    // unicode61 tokenizer of the index does.
+    const auto is_word_char = [](char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || static_cast<unsigned char>(c) >= 0x80;
+    };
+
+    size_t pos = 0;
+
+    while (pos < text.size())
+    {
+        while (pos < text.size() && !is_word_char(text[pos]))
+        {
+            ++pos;
+        }
+
+        const size_t start = pos;
+
+        while (pos < text.size() && is_word_char(text[pos]))
+        {
+            ++pos;
+        }
+
+        if (pos > start)
+        {
+            query.append(query.empty() ? "\"" : " \"").append(text.substr(start, pos - start)).append("\"*");
+        }
+    }
+
+    return !query.empty();
+}
+
+/**
+ * The function runs the ranked type-ahead search of the persons whose first
+ * name, last name, address or email has words starting with all words of the
+ * text (see build_prefix_query). The persons are ranked by the BM25 score of
+ * the full-text index, the page of the results is given by the limit and the
+ * offset. A short prefix may match most of the table, so its search ranks
+ * all those rows and takes longer than the search of a full word.
+ * 
+ * @param table_name Name of a table in which the people will be searched.
+ * @param text       The searched text, e.g. "sl" or "john sloan".
+ * @param limit      The maximum number of the printed persons.
+ * @param offset     The number of the skipped best ranked persons.
+ * @param p_db       Database connection pointer.
+ * @param sink       The sink of the printed records.
+ * @return           True if the search was done successfully (a text without
+ *                   any word prints nothing), false otherwise.
+ */
+bool search_staff(std::string_view table_name, std::string_view text, size_t limit, size_t offset, sqlite3** p_db,
+                  output_sink& sink)
+{
+    scoped_timer timer(operation::search);
+
+    thread_local std::string query;
+
+    if (!build_prefix_query(text, query))
+    {
+        std::cout << "-----------------------------------------------------------------------\n";
+        return true;
+    }
+
+    thread_local query_sql last_sql;
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql, table_name, search_sql));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (search query).\n";
+        return false;
+    }
+
+    sqlite3_bind_text(stmt.get(), 1, query.data(), static_cast<int>(query.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt.get(), 2, static_cast<sqlite3_int64>(limit));
+    sqlite3_bind_int64(stmt.get(), 3, static_cast<sqlite3_int64>(offset));
+
+    if (!print_staff_rows(stmt.get(), p_db, sink))
+    {
+        std::cerr << "Error: executing SQL statement failed (search query).\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The paged variants of the print_table, select_salary_threshold and
+ * select_by_last_name functions. Every call prints a single page of the
+ * persons, ordered by ID, by (Salary, ID) and by (FirstName, PhoneNum)
+ * respectively.
+ *
+ * The pages are found by the keyset pagination: the continuation token
+ * holds the key of the last printed person and the next page is sought
+ * behind it in the index, so a deep page costs as much as the first one
+ * (unlike OFFSET, which steps over all skipped rows). The token is opaque,
+ * it is valid only for the same query (and the same threshold or last name)
+ * and stays valid when the table changes, the rows inserted or deleted
+ * behind the key are observed by the next pages.
+ *
+ * @param table_name Name of a table from which the persons are printed.
+ * @param token      The continuation token returned for the previous page,
+ *                   empty for the first page.
+ * @param limit      The maximum number of persons on the page.
+ * @param p_db       Database connection pointer.
+ * @param sink       The sink of the printed records.
+ * @param next_token The token of the next page, empty if this page is the
+ *                   last one.
+ * @return           True if the page was printed successfully, false
+ *                   otherwise (e.g. for an invalid token).
+ */
+bool print_table_page(std::string_view table_name, std::string_view token, size_t limit, sqlite3** p_db,
+                      output_sink& sink, std::string& next_token)
+{
+    scoped_timer timer(operation::page_query);
+
+    page_key key;
+
+    if (!read_page_key(page_kind::table, token, limit, key, "table page query"))
+    {
+        return false;
+    }
+
+    const bool after_key = !token.empty();
+
+    thread_local query_sql last_sql[2];
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql[after_key], table_name, {}, [&]
+    {
+        return table_page_sql(table_name, after_key);
+    }));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (table page query).\n";
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt.get(), 1, key.id);
+    sqlite3_bind_int64(stmt.get(), 2, page_fetch_limit(limit));
+
+    if (!print_staff_page(stmt.get(), page_kind::table, limit, p_db, sink, next_token))
+    {
+        std::cerr << "Error: executing SQL statement failed (table page query).\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+bool select_salary_threshold_page(std::string_view table_name, int threshold, std::string_view token, size_t limit,
+                                  sqlite3** p_db, output_sink& sink, std::string& next_token)
+{
+    scoped_timer timer(operation::page_query);
+
+    page_key key;
+
+    if (!read_page_key(page_kind::salary, token, limit, key, "salary page query"))
+    {
+        return false;
+    }
+
+    if (!token.empty() && key.salary < threshold)
+    {
+        std::cerr << "Error: the continuation token of the salary page query is not valid.\n";
+        return false;
+    }
+
+    const bool after_key = !token.empty();
+
+    thread_local query_sql last_sql[2];
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql[after_key], table_name, {}, [&]
+    {
+        return salary_page_sql(table_name, after_key);
+    }));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (salary page query).\n";
+        return false;
+    }
+
+    sqlite3_bind_int(stmt.get(), 1, threshold);
+    sqlite3_bind_int64(stmt.get(), 2, key.salary);
+    sqlite3_bind_int64(stmt.get(), 3, key.id);
+    sqlite3_bind_int64(stmt.get(), 4, page_fetch_limit(limit));
+
+    if (!print_staff_page(stmt.get(), page_kind::salary, limit, p_db, sink, next_token))
+    {
+        std::cerr << "Error: executing SQL statement failed (salary page query).\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+bool select_by_last_name_page(std::string_view table_name, std::string_view last_name, std::string_view token,
+                              size_t limit, sqlite3** p_db, output_sink& sink, std::string& next_token)
+{
+    scoped_timer timer(operation::page_query);
+
+    page_key key;
+
+    if (!read_page_key(page_kind::last_name, token, limit, key, "last name page query"))
+    {
+        return false;
+    }
+
+    if (!token.empty() && key.last_name != last_name)
+    {
+        std::cerr << "Error: the continuation token of the last name page query is not valid.\n";
+        return false;
+    }
+
+    const bool after_key = !token.empty();
+
+    thread_local query_sql last_sql[2];
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql[after_key], table_name, {}, [&]
+    {
+        return last_name_page_sql(table_name, after_key);
+    }));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (last name page query).\n";
+        return false;
+    }
+
+    sqlite3_bind_text(stmt.get(), 1, last_name.data(), static_cast<int>(last_name.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 2, key.first_name.data(), static_cast<int>(key.first_name.size()), SQLITE_STATIC);
+    sqlite3_bind_text(stmt.get(), 3, key.phone_num.data(), static_cast<int>(key.phone_num.size()), SQLITE_STATIC);
+    sqlite3_bind_int64(stmt.get(), 4, page_fetch_limit(limit));
+
+    if (!print_staff_page(stmt.get(), page_kind::last_name, limit, p_db, sink, next_token))
+    {
+        std::cerr << "Error: executing SQL statement failed (last name page query).\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * Function which updates the phone numbers of the persons identified by the 
+ * primary key (ID) by a single prepared UPDATE statement.
+ * 
+ * The updates are applied inside one transaction (unless the connection is
+ * already in a transaction). The new phone number has to be unique in the 
+ * table, so the update violating the UNIQUE constraint on PhoneNum fails 
+ * without affecting the other updates and it is reported as a conflict. No
+ * lookup of the phone number is done before the update. The cached lookups
+ * of the connection are invalidated before the first update, so they are
+ * not stale after any outcome.
+ * 
+ * @param table_name Name of a table in which the phone numbers are updated.
+ * @param updates    The updates, the status of each one is set.
+ * @param count      The number of the updates in the array.
+ * @param p_db       Database connection pointer.
+ * @return           True if all updates were applied or reported, false if
+ *                   an error occurs. The own transaction is then rolled
+ *                   back, in the transaction of the caller the preceding
+ *                   updates stay applied and the caller decides.
+ */
+bool update_phone_numbers(std::string_view table_name, std::vector<phone_update>& updates, sqlite3** p_db)
+{
+    return update_phone_numbers(table_name, updates.data(), updates.size(), p_db);
+}
+
+bool update_phone_numbers(std::string_view table_name, phone_update* updates, size_t count, sqlite3** p_db)
+{
+    scoped_timer timer(operation::update_phone);
+
+    thread_local query_sql last_sql;
+    cached_statement stmt(get_statement_cache(*p_db), memoized_sql(last_sql, table_name, update_phone_number_sql));
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (phone number update).\n";
+        return false;
+    }
+
+    const bool own_transaction = (sqlite3_get_autocommit(*p_db) != 0);
+
+    if (own_transaction && !exec_transaction_statement("BEGIN;", p_db))
+    {
+        return false;
+    }
+
+    // The updated persons are not known without a lookup, so all cached
+    // lookups are invalidated. It is done before the first update, so a
+    // failed batch leaves no stale lookups either.
+    get_lookup_cache(*p_db).invalidate_all();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        phone_update& update = updates[i];
+
+        sqlite3_bind_text(stmt.get(), 1, update.phone_num.data(), static_cast<int>(update.phone_num.size()),
+                          SQLITE_STATIC);
+        sqlite3_bind_int64(stmt.get(), 2, update.person_id);
+
+        const int status = sqlite3_step(stmt.get());
+
+        if (status == SQLITE_DONE)
+        {
+            update.status = (sqlite3_changes(*p_db) > 0) ? phone_update_status::updated 
+                                                         : phone_update_status::not_found;
+        }
+        else if (sqlite3_extended_errcode(*p_db) == SQLITE_CONSTRAINT_UNIQUE)
+        {
+            // Only the failed statement is rolled back by the constraint.
+            update.status = phone_update_status::conflict;
+        }
+        else
+        {
+            std::cerr << "Error: executing SQL statement failed (phone number update).\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+
+            if (own_transaction)
+            {
+                exec_transaction_statement("ROLLBACK;", p_db);
+            }
+
+            return false;
+        }
+
+        sqlite3_reset(stmt.get());
+    }
+
+    return !own_transaction || exec_transaction_statement("COMMIT;", p_db);
+}
+
+/**
+ * Function for executing a query which updates a phone number to a specific 
+ * person identified by the primary key (ID).
+ * 
+ * The phone number has to be unique in the table for each person, so the 
+ * update is aborted if the new phone number is already in the table (see 
+ * update_phone_numbers).
+ * 
+ * @param table_name       Name of a table in which the person will be searched and 
+ *                         in which will be the phone number updated.
+ * @param person_id        The identifier of a person in the table.
+ * @param new_phone_number The new phone number which replaces the previous one.
+ * @param p_db             Database connection pointer.
+ */
+bool update_phone_number(std::string_view table_name,
+                         const int person_id,
+                         std::string_view new_phone_number,
+                         sqlite3** p_db)
+{
+    phone_update update = {person_id, std::string(new_phone_number), phone_update_status::pending};
+
+    if (!update_phone_numbers(table_name, &update, 1, p_db))
+    {
+        return false;
+    }
+
+    switch (update.status)
+    {
+        case phone_update_status::updated:
+            std::cout << "Info: phone number updated successfully.\n";
+            break;
+        case phone_update_status::conflict:
+            // The phone number is already in the table.
+            std::cout << "Phone number already exists in the table. Update aborted." << std::endl;
+            break;
+        default:
+            std::cout << "Info: no person with ID = " << person_id << ", the phone number was not updated.\n";
+            break;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The function which deletes the table from the database.
+ *
+ * @param table_name Name of a table to delete.
+ * @param p_db       Database connection pointer. 
+ */
+bool drop_table(std::string_view table_name, sqlite3** p_db)
+{
+    char* err_msg = nullptr;
+    std::string drop_sql;
+
+    // The search table is not dropped with the table, only its triggers are.
+    const table_schema* schema = find_table_schema(table_name);
+
+    if (schema != nullptr && !schema->search.empty())
+    {
+        drop_sql.append("DROP TABLE IF EXISTS ").append(get_table_sql(*schema).search_table).append("; ");
+    }
+
+    drop_sql.append("DROP TABLE IF EXISTS ").append(table_name).append(";");
+
+    int status = sqlite3_exec(*p_db, drop_sql.c_str(), nullptr, nullptr, &err_msg);
+
+    if (status != SQLITE_OK)
+    {
+        std::cerr << "Error: executing SQL statement failed (table drop).\n";
+        std::cerr << "Error message: " << err_msg << "\n";
+        sqlite3_free(err_msg);
+        return false;
+    }
+
+    get_lookup_cache(*p_db).clear();
+
+    std::cout << "Info: Table dropped successfully.\n";
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The function which closes the database connection. All cached prepared 
+ * statements of the connection are finalized before.
+ * 
+ * @param p_db Database connection pointer.
+ */
+void close_database(sqlite3** p_db)
+{
+    if (*p_db == nullptr)
+    {
+        return;
+    }
+
+    release_statement_cache(*p_db);
+    release_lookup_cache(*p_db);
+    sqlite3_close(*p_db);
+    *p_db = nullptr;
+}
+
+/**
+ * The function which deletes the whole database (the file *.db from the system).
+ * 
+ * @param db_filename The name of a file containing the database including the .db extension.
+ */
+bool delete_database(const std::string& db_filename)
+{
+    if (std::remove(db_filename.c_str()) == 0)
+    {
+        std::cout << "Info: Database file '" << db_filename << "' deleted successfully.\n";
+    }
+    else
+    {
+        std::cerr << "Error: deleting database file '" << db_filename << "' failed.\n";
+        return false;
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return true;
+}
+
+/**
+ * The function checks the query plans of the built-in queries by EXPLAIN QUERY
+ * PLAN and prints them to stdout.
+ * 
+ * Every query has to look up its rows by an index or by the primary key. A 
+ * plan containing a full table scan (or a full scan of an index) fails the 
+ * check, so a scheme change can't silently bring the scans back.
+ * 
+ * @param table_name The name of a table on which the queries run.
+ * @param p_db       Database connection pointer.
+ * @return           True if all queries use an index, false otherwise.
+ */
+bool check_query_plans(std::string_view table_name, sqlite3** p_db)
+{
+    const std::vector<std::pair<std::string, std::string>> queries = {
+        {"person existence check", person_exists_sql(table_name)},
+        {"salaries query", select_salary_sql(table_name)},
+        {"last name query", select_last_name_sql(table_name)},
+        {"table page query", table_page_sql(table_name, true)},
+        {"salary page query", salary_page_sql(table_name, true)},
+        {"last name page query", last_name_page_sql(table_name, true)},
+        {"phone number update", update_phone_number_sql(table_name)}
+    };
+
+    bool all_indexed = true;
+
+    for (const auto& query : queries)
+    {
+        const std::string explain_sql = "EXPLAIN QUERY PLAN " + query.second;
+
+        sqlite3_stmt* stmt;
+        int status = sqlite3_prepare_v2(*p_db, explain_sql.c_str(), -1, &stmt, nullptr);
+
+        if (status != SQLITE_OK)
+        {
+            std::cerr << "Error: preparing SQL statement failed (" << query.first << " plan).\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            return false;
+        }
+
+        bool uses_index = false;
+        bool uses_scan = false;
+
+        std::cout << "Query plan (" << query.first << "): " << query.second << "\n";
+
+        while ((status = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            // The fourth column contains the human-readable plan step.
+            const char* detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+            const std::string step = detail ? detail : "";
+
+            std::cout << "  " << step << "\n";
+
+            if (step.compare(0, 5, "SCAN ") == 0)
+            {
+                uses_scan = true;
+            }
+            else if (step.compare(0, 7, "SEARCH ") == 0)
+            {
+                uses_index = true;
+            }
+        }
+
+        sqlite3_finalize(stmt);
+
+        if (status != SQLITE_DONE)
+        {
+            std::cerr << "Error: executing SQL statement failed (" << query.first << " plan).\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            return false;
+        }
+
+        if (!uses_index || uses_scan)
+        {
+            std::cerr << "Error: the " << query.first << " does not use an index.\n";
+            all_indexed = false;
+        }
+    }
+
+    if (all_indexed)
+    {
+        std::cout << "Info: All built-in queries use an index.\n";
+    }
+
+    std::cout << "-----------------------------------------------------------------------\n";
+
+    return all_indexed;
+}
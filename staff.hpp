@@ -0,0 +1,181 @@
+/**
+ * @file    staff.hpp
+ *
+ * @brief   The Staff table scheme and the database operations on it.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef STAFF_HPP
+#define STAFF_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sqlite3.h>
+
+#include "arena.hpp"
+#include "output_sink.hpp"
+#include "schemas.hpp"
+
+// The expected number of provided columns to save record into a table.
+constexpr int k_expected_cols = static_cast<int>(k_staff_schema.record_column_count);
+// Indexes of the columns containing the specific attributes.
+constexpr int k_first_name_idx = static_cast<int>(k_staff_schema.record_index("FirstName"));
+constexpr int k_address_idx = static_cast<int>(k_staff_schema.record_index("Address"));
+constexpr int k_salary_idx = static_cast<int>(k_staff_schema.record_index("Salary"));
+constexpr int k_last_name_idx = static_cast<int>(k_staff_schema.record_index("LastName"));
+constexpr int k_email_idx = static_cast<int>(k_staff_schema.record_index("Email"));
+constexpr int k_profile_image_idx = static_cast<int>(k_staff_schema.record_index("ProfileImage"));
+constexpr int k_phone_num_idx = static_cast<int>(k_staff_schema.record_index("PhoneNum"));
+constexpr int k_time_zone_idx = static_cast<int>(k_staff_schema.record_index("TimeZone"));
+// The maximum lengths of the validated columns (see k_staff_columns).
+constexpr size_t k_max_email_length = 320;
+constexpr size_t k_max_phone_num_length = 20;
+// The default number of rows committed in a single transaction by the bulk loader.
+constexpr size_t k_default_chunk_size = 10000;
+
+// The default number of the persons on a page of the type-ahead search.
+constexpr size_t k_default_search_limit = 20;
+
+// The default number of the persons on a page of the paged queries.
+constexpr size_t k_default_page_size = 100;
+
+/**
+ * The typed view of a single Staff table record read by the row_cursor.
+ * 
+ * The text columns point into the SQLite row buffer and are valid only until
+ * the cursor advances. A NULL value is a view with a null data pointer.
+ */
+struct staff_row
+{
+    // The positions of the columns in the table columns (see k_staff_schema).
+    enum column
+    {
+        k_id_col = k_staff_schema.column_index("ID"),
+        k_first_name_col = k_staff_schema.column_index("FirstName"),
+        k_last_name_col = k_staff_schema.column_index("LastName"),
+        k_address_col = k_staff_schema.column_index("Address"),
+        k_salary_col = k_staff_schema.column_index("Salary"),
+        k_email_col = k_staff_schema.column_index("Email"),
+        k_profile_image_col = k_staff_schema.column_index("ProfileImage"),
+        k_phone_num_col = k_staff_schema.column_index("PhoneNum"),
+        k_time_zone_col = k_staff_schema.column_index("TimeZone")
+    };
+
+    int64_t id = 0;
+    std::string_view first_name;
+    std::string_view last_name;
+    std::string_view address;
+    int64_t salary = 0;
+    std::string_view email;
+    std::string_view profile_image;
+    std::string_view phone_num;
+    std::string_view time_zone;
+
+    /**
+     * Maps the current row of the statement selecting the table columns.
+     */
+    static void read(sqlite3_stmt* stmt, staff_row& row);
+};
+
+/**
+ * Statistics collected by the bulk loader.
+ */
+struct bulk_load_stats
+{
+    size_t rows_read = 0;
+    size_t rows_inserted = 0;
+    size_t rows_skipped = 0;
+    size_t chunks_committed = 0;
+    double elapsed_seconds = 0.0;
+};
+
+/**
+ * The result of a single phone number update.
+ */
+enum class phone_update_status
+{
+    pending,   // The update was not applied yet.
+    updated,
+    conflict,  // The phone number belongs to another person (UNIQUE PhoneNum).
+    not_found  // No person has the ID.
+};
+
+/**
+ * The phone number update of a person identified by the ID.
+ */
+struct phone_update
+{
+    int64_t person_id = 0;
+    std::string phone_num;
+    phone_update_status status = phone_update_status::pending;
+};
+
+// Database and table lifecycle.
+bool database_exists(const std::string& db_filename);
+bool create_database(const std::string& db_filename, const std::string& profile_name, sqlite3** p_db);
+bool create_table(std::string_view table_name,
+                  std::string_view table_columns,
+                  const std::vector<std::string>& table_indexes,
+                  sqlite3** p_db);
+bool drop_table(std::string_view table_name, sqlite3** p_db);
+void close_database(sqlite3** p_db);
+bool delete_database(const std::string& db_filename);
+bool exec_transaction_statement(const char* sql, sqlite3** p_db);
+
+// The SQL text of the built-in queries.
+std::string person_exists_sql(std::string_view table_name);
+std::string select_salary_sql(std::string_view table_name);
+std::string select_last_name_sql(std::string_view table_name);
+std::string search_sql(std::string_view table_name);
+std::string table_page_sql(std::string_view table_name, bool after_key);
+std::string salary_page_sql(std::string_view table_name, bool after_key);
+std::string last_name_page_sql(std::string_view table_name, bool after_key);
+std::string update_phone_number_sql(std::string_view table_name);
+std::string build_insert_sql(std::string_view table_name,
+                             std::string_view table_columns_names,
+                             std::string_view conflict_clause);
+
+// Records insertion.
+bool person_exists(std::string_view table_name, const field_list& cols, sqlite3** p_db);
+void bind_record_values(sqlite3_stmt* stmt, const field_list& cols);
+bool validate_staff_record(const field_list& cols, std::string& reason);
+bool insert_table_record(std::string_view table_name, std::string_view table_columns_names,
+                         std::string_view columns_values, sqlite3** p_db);
+bool bulk_load_table(const table_schema& schema,
+                     std::istream& input,
+                     size_t chunk_size,
+                     sqlite3** p_db,
+                     bulk_load_stats& stats);
+void print_bulk_load_stats(const bulk_load_stats& stats);
+
+// Queries.
+void print_query_result(const staff_row& row, query_output& output);
+bool print_staff_rows(sqlite3_stmt* stmt, sqlite3** p_db, output_sink& sink, arena_string* encoded_rows = nullptr);
+bool print_encoded_rows(std::string_view encoded_rows, output_sink& sink);
+bool print_table(std::string_view table_name, sqlite3** p_db, output_sink& sink);
+bool select_salary_threshold(std::string_view table_name, int threshold, sqlite3** p_db, output_sink& sink);
+bool select_by_last_name(std::string_view table_name, std::string_view last_name, sqlite3** p_db,
+                         output_sink& sink);
+bool build_prefix_query(std::string_view text, std::string& query);
+bool search_staff(std::string_view table_name, std::string_view text, size_t limit, size_t offset, sqlite3** p_db,
+                  output_sink& sink);
+bool print_table_page(std::string_view table_name, std::string_view token, size_t limit, sqlite3** p_db,
+                      output_sink& sink, std::string& next_token);
+bool select_salary_threshold_page(std::string_view table_name, int threshold, std::string_view token, size_t limit,
+                                  sqlite3** p_db, output_sink& sink, std::string& next_token);
+bool select_by_last_name_page(std::string_view table_name, std::string_view last_name, std::string_view token,
+                              size_t limit, sqlite3** p_db, output_sink& sink, std::string& next_token);
+bool update_phone_numbers(std::string_view table_name, std::vector<phone_update>& updates, sqlite3** p_db);
+bool update_phone_numbers(std::string_view table_name, phone_update* updates, size_t count, sqlite3** p_db);
+bool update_phone_number(std::string_view table_name,
+                         const int person_id,
+                         std::string_view new_phone_number,
+                         sqlite3** p_db);
+bool check_query_plans(std::string_view table_name, sqlite3** p_db);
+
+#endif // STAFF_HPP
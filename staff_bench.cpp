@@ -0,0 +1,3249 @@
+/**
+ * @file    staff_bench.cpp
+ *
+ * @brief   Benchmarks of the Staff table operations.
+ *
+ * The results are printed to stdout as JSON, the log messages of the Staff
+ * operations are redirected to stderr.
+ *
+ * @author  David Chocholaty
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sqlite3.h>
+
+#include "allocation_hook.hpp"
+#include "async_executor.hpp"
+#include "binary_snapshot.hpp"
+#include "connection_config.hpp"
+#include "connection_pool.hpp"
+#include "group_commit_writer.hpp"
+#include "import_pipeline.hpp"
+#include "incremental_import.hpp"
+#include "instrumentation.hpp"
+#include "lookup_cache.hpp"
+#include "online_backup.hpp"
+#include "output_sink.hpp"
+#include "parallel_scan.hpp"
+#include "row_cursor.hpp"
+#include "sql_functions.hpp"
+#include "staff.hpp"
+#include "staff_snapshot.hpp"
+#include "statement_cache.hpp"
+#include "table_schema.hpp"
+
+namespace
+{
+
+using steady_clock = std::chrono::steady_clock;
+
+// The number of distinct last names of the generated persons.
+constexpr size_t k_distinct_last_names = 1000;
+
+// The number of updates applied by a single batched phone number update.
+constexpr size_t k_phone_update_batch_size = 1000;
+
+// The size of the output buffer of a single asynchronous lookup.
+constexpr size_t k_async_sink_buffer_size = 4096;
+
+// The salary range of the columnar scans, it matches about a third of the
+// generated salaries.
+constexpr int64_t k_scan_min_salary = 4000;
+constexpr int64_t k_scan_max_salary = 6999;
+
+// Every k_duplicate_email_interval-th insert of the group commit suite
+// repeats the Email of the first person and fails on the UNIQUE constraint.
+constexpr size_t k_duplicate_email_interval = 100;
+
+const char* const k_time_zones[] = {"PST", "MST", "CST", "EST", "UTC"};
+
+/**
+ * The benchmark options obtained from the command line arguments.
+ */
+struct bench_options
+{
+    std::string suite = "ops";
+    std::string db_filename = "staff_bench.db";
+    size_t rows = 100000;
+    double duration_seconds = 2.0;
+    std::vector<size_t> threads = {1, 2, 4, 8};
+    std::vector<size_t> scales = {1000, 10000, 100000};
+    size_t iterations = 200;
+    size_t scan_iterations = 5;
+    // The window of the group commit writer in microseconds.
+    size_t window_us = 0;
+    bool instrument = false;
+};
+
+/**
+ * The synthetic record of a person. The values are generated from the
+ * record number, so the Email, PhoneNum and ProfileImage are unique.
+ */
+struct staff_record
+{
+    std::string values[k_expected_cols];
+    field_list cols;
+
+    void generate(size_t number, std::mt19937_64& random)
+    {
+        values[k_first_name_idx] = "First" + std::to_string(number);
+        values[k_address_idx] = std::to_string(number % 9999 + 1) + " Synthetic Street";
+        values[k_salary_idx] = std::to_string(1000 + random() % 9000);
+        values[k_last_name_idx] = "Last" + std::to_string(number % k_distinct_last_names);
+        values[k_email_idx] = "person" + std::to_string(number) + "@example.com";
+        values[k_profile_image_idx] = "staff/profiles/" + std::to_string(number) + "/avatar.png";
+
+        char phone_num[32];
+        std::snprintf(phone_num, sizeof(phone_num), "%03zu-%03zu-%04zu",
+                      number / 10000000 % 1000, number / 10000 % 1000, number % 10000);
+        values[k_phone_num_idx] = phone_num;
+        values[k_time_zone_idx] = k_time_zones[number % (sizeof(k_time_zones) / sizeof(k_time_zones[0]))];
+
+        cols.assign(std::begin(values), std::end(values));
+    }
+
+    /**
+     * Writes the generated values as a CSV line. The values do not contain
+     * any separator, so they are not quoted.
+     */
+    void write_csv(std::ostream& output) const
+    {
+        for (int i = 0; i < k_expected_cols; ++i)
+        {
+            output << (i > 0 ? "," : "") << values[i];
+        }
+
+        output << "\n";
+    }
+};
+
+/**
+ * The latency samples of a single benchmarked operation.
+ */
+struct operation_samples
+{
+    std::string name;
+    // The unit of the throughput, the items are either rows or operations.
+    std::string unit;
+    std::vector<double> seconds;
+    size_t items = 0;
+
+    /**
+     * Returns the latency of the percentile (0-100) in microseconds by the
+     * nearest-rank method.
+     */
+    double percentile_us(double percentile) const
+    {
+        if (seconds.empty())
+        {
+            return 0.0;
+        }
+
+        std::vector<double> sorted = seconds;
+        std::sort(sorted.begin(), sorted.end());
+
+        const size_t rank = static_cast<size_t>(std::ceil(percentile / 100.0 * sorted.size()));
+
+        return sorted[std::max<size_t>(rank, 1) - 1] * 1e6;
+    }
+
+    double total_seconds() const
+    {
+        double total = 0.0;
+
+        for (double value : seconds)
+        {
+            total += value;
+        }
+
+        return total;
+    }
+};
+
+double seconds_since(steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(steady_clock::now() - start).count();
+}
+
+void remove_database(const std::string& db_filename)
+{
+    std::remove(db_filename.c_str());
+    std::remove((db_filename + "-wal").c_str());
+    std::remove((db_filename + "-shm").c_str());
+}
+
+/**
+ * Function which inserts the generated records [first, first + count) in
+ * transactions of k_default_chunk_size rows.
+ */
+bool insert_generated_rows(size_t first, size_t count, sqlite3** p_db)
+{
+    cached_statement stmt(get_statement_cache(*p_db),
+                          get_table_sql(k_staff_schema).insert + " ON CONFLICT DO NOTHING;");
+
+    if (!stmt || !exec_transaction_statement("BEGIN;", p_db))
+    {
+        return false;
+    }
+
+    std::mt19937_64 random(first);
+    staff_record record;
+
+    for (size_t i = first; i < first + count; ++i)
+    {
+        record.generate(i, random);
+        bind_record_values(stmt.get(), record.cols);
+
+        if (sqlite3_step(stmt.get()) != SQLITE_DONE)
+        {
+            std::cerr << "Error: inserting generated record failed.\n";
+            std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+            exec_transaction_statement("ROLLBACK;", p_db);
+            return false;
+        }
+
+        sqlite3_reset(stmt.get());
+
+        if ((i - first + 1) % k_default_chunk_size == 0 &&
+            !(exec_transaction_statement("COMMIT;", p_db) && exec_transaction_statement("BEGIN;", p_db)))
+        {
+            return false;
+        }
+    }
+
+    return exec_transaction_statement("COMMIT;", p_db);
+}
+
+/**
+ * Function which writes a CSV file with the generated records [0, rows).
+ */
+bool write_generated_csv(const std::string& csv_filename, size_t rows)
+{
+    std::ofstream output(csv_filename, std::ios::binary | std::ios::trunc);
+
+    if (!output.is_open())
+    {
+        std::cerr << "Error: creating the generated CSV file \"" << csv_filename << "\" failed.\n";
+        return false;
+    }
+
+    std::mt19937_64 random(0);
+    staff_record record;
+
+    for (size_t i = 0; i < rows; ++i)
+    {
+        record.generate(i, random);
+        record.write_csv(output);
+    }
+
+    return static_cast<bool>(output.flush());
+}
+
+/**
+ * Function which writes the CSV file with the departments. The budgets are
+ * in whole units.
+ */
+bool write_department_csv(const std::string& csv_filename, size_t departments)
+{
+    std::ofstream output(csv_filename, std::ios::binary | std::ios::trunc);
+
+    if (!output.is_open())
+    {
+        std::cerr << "Error: creating the generated CSV file \"" << csv_filename << "\" failed.\n";
+        return false;
+    }
+
+    for (size_t i = 0; i < departments; ++i)
+    {
+        output << "Department" << i << ",Building " << i % 10 << "," << 100000 + i * 1000 << "\n";
+    }
+
+    return static_cast<bool>(output.flush());
+}
+
+/**
+ * Function which writes the CSV file with the payroll history. The payments
+ * cycle over the persons and the departments by their generated IDs, so every
+ * payment refers to an existing person and department.
+ */
+bool write_payroll_csv(const std::string& csv_filename, size_t payments, size_t persons, size_t departments)
+{
+    std::ofstream output(csv_filename, std::ios::binary | std::ios::trunc);
+
+    if (!output.is_open())
+    {
+        std::cerr << "Error: creating the generated CSV file \"" << csv_filename << "\" failed.\n";
+        return false;
+    }
+
+    char pay_date[16];
+
+    for (size_t i = 0; i < payments; ++i)
+    {
+        std::snprintf(pay_date, sizeof(pay_date), "%04zu-%02zu-01", 2000 + i / persons / 12 % 100,
+                      i / persons % 12 + 1);
+        output << i % persons + 1 << "," << i % departments + 1 << "," << pay_date << "," \
+               << 1000 + i % 9000 << "\n";
+    }
+
+    return static_cast<bool>(output.flush());
+}
+
+/**
+ * Function which writes the CSV file with the generated persons, the persons
+ * for which the changed function returns true have their salary raised. The
+ * rest of the records are equal to the records of the write_generated_csv
+ * function.
+ */
+bool write_changed_csv(const std::string& csv_filename, size_t rows, const std::function<bool(size_t)>& changed)
+{
+    std::ofstream output(csv_filename, std::ios::binary | std::ios::trunc);
+
+    if (!output.is_open())
+    {
+        std::cerr << "Error: creating the generated CSV file \"" << csv_filename << "\" failed.\n";
+        return false;
+    }
+
+    std::mt19937_64 random(0);
+    staff_record record;
+
+    for (size_t i = 0; i < rows; ++i)
+    {
+        record.generate(i, random);
+
+        if (changed(i))
+        {
+            record.values[k_salary_idx] = std::to_string(std::stoll(record.values[k_salary_idx]) + 1);
+        }
+
+        record.write_csv(output);
+    }
+
+    return static_cast<bool>(output.flush());
+}
+
+/**
+ * Function which runs the operation repeatedly and records the latency of
+ * every run. The operation returns the number of processed items.
+ */
+bool time_operation(operation_samples& samples, size_t iterations, const std::function<bool(size_t&)>& operation)
+{
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        size_t items = 0;
+        const steady_clock::time_point start = steady_clock::now();
+
+        if (!operation(items))
+        {
+            std::cerr << "Error: the benchmarked operation " << samples.name << " failed.\n";
+            return false;
+        }
+
+        samples.seconds.push_back(seconds_since(start));
+        samples.items += items;
+    }
+
+    return true;
+}
+
+void write_operation_json(const operation_samples& samples, std::ostream& json)
+{
+    json << "{\"name\": \"" << samples.name << "\", \"samples\": " << samples.seconds.size() \
+         << ", \"p50_us\": " << samples.percentile_us(50.0) << ", \"p99_us\": " << samples.percentile_us(99.0) \
+         << ", \"throughput\": " << static_cast<double>(samples.items) / samples.total_seconds() \
+         << ", \"unit\": \"" << samples.unit << "/s\"}";
+}
+
+/**
+ * Function which benchmarks the Staff table operations on a database with
+ * the given number of generated rows.
+ */
+bool run_ops_scale(const bench_options& options, size_t rows, int null_fd, std::ostream& json)
+{
+    const std::string csv_filename = options.db_filename + ".csv";
+
+    remove_database(options.db_filename);
+
+    if (!write_generated_csv(csv_filename, rows))
+    {
+        return false;
+    }
+
+    sqlite3* p_db = nullptr;
+    output_sink sink(null_fd);
+    std::vector<operation_samples> results(7);
+
+    if (!create_database(options.db_filename, durable_profile().name, &p_db) ||
+        (options.instrument && !enable_statement_profiling(p_db)) ||
+        !create_table(k_staff_schema, &p_db))
+    {
+        close_database(&p_db);
+        return false;
+    }
+
+    // The import of the whole CSV file by the bulk loader.
+    results[0].name = "import";
+    results[0].unit = "rows";
+
+    bool success = time_operation(results[0], 1, [&](size_t& items)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+
+        items = rows;
+
+        return bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats) &&
+               stats.rows_inserted == rows;
+    });
+
+    std::mt19937_64 random(rows);
+
+    // The salary threshold query returns a random part of the table.
+    results[1].name = "salary_threshold";
+    results[1].unit = "queries";
+
+    success = success && time_operation(results[1], options.scan_iterations, [&](size_t& items)
+    {
+        items = 1;
+        return select_salary_threshold(k_staff_table_name, 1000 + static_cast<int>(random() % 9000), &p_db, sink);
+    });
+
+    // The lookups answered by SQLite only.
+    results[2].name = "last_name_lookup_uncached";
+    results[2].unit = "queries";
+
+    lookup_cache& lookups = get_lookup_cache(p_db);
+    const size_t lookup_budget = lookups.budget();
+    lookups.set_budget(0);
+
+    success = success && time_operation(results[2], options.iterations, [&](size_t& items)
+    {
+        items = 1;
+        return select_by_last_name(k_staff_table_name, "Last" + std::to_string(random() % k_distinct_last_names),
+                                   &p_db, sink);
+    });
+
+    lookups.set_budget(lookup_budget);
+
+    // The same lookups read through the lookup cache.
+    results[3].name = "last_name_lookup";
+    results[3].unit = "queries";
+
+    success = success && time_operation(results[3], options.iterations, [&](size_t& items)
+    {
+        items = 1;
+        return select_by_last_name(k_staff_table_name, "Last" + std::to_string(random() % k_distinct_last_names),
+                                   &p_db, sink);
+    });
+
+    // The new phone numbers have a different shape than the generated ones,
+    // so they never collide.
+    results[4].name = "phone_update";
+    results[4].unit = "updates";
+    size_t update_number = 0;
+
+    success = success && time_operation(results[4], options.iterations, [&](size_t& items)
+    {
+        char phone_num[32];
+        std::snprintf(phone_num, sizeof(phone_num), "9-%08zu", update_number++);
+
+        items = 1;
+        return update_phone_number(k_staff_table_name, static_cast<int>(random() % rows) + 1, phone_num, &p_db);
+    });
+
+    // The batches of updates applied in one transaction by one statement.
+    results[5].name = "phone_update_batch";
+    results[5].unit = "updates";
+    std::vector<phone_update> updates(k_phone_update_batch_size);
+
+    success = success && time_operation(results[5], options.scan_iterations, [&](size_t& items)
+    {
+        for (phone_update& update : updates)
+        {
+            char phone_num[32];
+            std::snprintf(phone_num, sizeof(phone_num), "9-%08zu", update_number++);
+
+            update.person_id = static_cast<int64_t>(random() % rows) + 1;
+            update.phone_num = phone_num;
+        }
+
+        items = updates.size();
+        return update_phone_numbers(k_staff_table_name, updates, &p_db);
+    });
+
+    results[6].name = "full_print";
+    results[6].unit = "rows";
+
+    success = success && time_operation(results[6], options.scan_iterations, [&](size_t& items)
+    {
+        items = rows;
+        return print_table(k_staff_table_name, &p_db, sink);
+    });
+
+    close_database(&p_db);
+    remove_database(options.db_filename);
+    std::remove(csv_filename.c_str());
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"rows\": " << rows << ", \"operations\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}";
+
+    return true;
+}
+
+/**
+ * The benchmark of the Staff table operations (import, salary threshold
+ * query, last name lookup, phone number update and full table print) for
+ * every number of generated rows. The printed records are written to
+ * /dev/null, so the formatting is measured without the terminal.
+ */
+bool run_ops_suite(const bench_options& options, std::ostream& json)
+{
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    if (null_fd < 0)
+    {
+        std::cerr << "Error: opening /dev/null failed.\n";
+        return false;
+    }
+
+    json << "{\"suite\": \"ops\", \"iterations\": " << options.iterations \
+         << ", \"scan_iterations\": " << options.scan_iterations << ", \"results\": [";
+
+    bool success = true;
+
+    for (size_t i = 0; i < options.scales.size() && success; ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        success = run_ops_scale(options, options.scales[i], null_fd, json);
+    }
+
+    json << "]}\n";
+    close(null_fd);
+
+    return success;
+}
+
+/**
+ * The read scaling benchmark of the connection pool. For every thread count
+ * the readers run last name lookups through the pool query API while a
+ * background writer keeps inserting new rows.
+ */
+bool run_pool_suite(const bench_options& options, std::ostream& json)
+{
+    size_t max_threads = 1;
+
+    for (size_t threads : options.threads)
+    {
+        max_threads = std::max(max_threads, threads);
+    }
+
+    remove_database(options.db_filename);
+
+    connection_pool pool;
+
+    if (!pool.open(options.db_filename, max_threads, durable_profile()))
+    {
+        return false;
+    }
+
+    {
+        connection_lease writer = pool.acquire_writer();
+
+        if (!create_table(k_staff_schema, writer.get()) ||
+            !insert_generated_rows(0, options.rows, writer.get()))
+        {
+            return false;
+        }
+    }
+
+    const std::string lookup_sql = select_last_name_sql(k_staff_table_name);
+    size_t next_row = options.rows;
+
+    json << "{\"suite\": \"pool\", \"rows\": " << options.rows \
+         << ", \"duration_s\": " << options.duration_seconds << ", \"results\": [";
+
+    for (size_t t = 0; t < options.threads.size(); ++t)
+    {
+        const size_t thread_count = options.threads[t];
+        std::atomic<bool> stop(false);
+        std::atomic<bool> failed(false);
+        std::atomic<size_t> writer_inserts(0);
+        std::vector<size_t> queries(thread_count, 0);
+
+        // The background writer inserts one row per transaction.
+        std::thread writer([&]()
+        {
+            while (!stop)
+            {
+                connection_lease lease = pool.acquire_writer();
+
+                if (!insert_generated_rows(next_row++, 1, lease.get()))
+                {
+                    failed = true;
+                    return;
+                }
+
+                ++writer_inserts;
+            }
+        });
+
+        std::vector<std::thread> readers;
+        const steady_clock::time_point start = steady_clock::now();
+
+        for (size_t r = 0; r < thread_count; ++r)
+        {
+            readers.emplace_back([&, r]()
+            {
+                std::mt19937_64 random(r);
+                std::string last_name;
+
+                while (!stop)
+                {
+                    last_name = "Last" + std::to_string(random() % k_distinct_last_names);
+                    size_t rows = 0;
+
+                    const bool success = pool.query(lookup_sql,
+                        [&last_name](sqlite3_stmt* stmt)
+                        {
+                            return sqlite3_bind_text(stmt, 1, last_name.data(), static_cast<int>(last_name.size()),
+                                                     SQLITE_STATIC) == SQLITE_OK;
+                        },
+                        [&rows](sqlite3_stmt*)
+                        {
+                            ++rows;
+                            return true;
+                        });
+
+                    if (!success || rows == 0)
+                    {
+                        failed = true;
+                        return;
+                    }
+
+                    ++queries[r];
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::duration<double>(options.duration_seconds));
+        stop = true;
+
+        for (std::thread& reader : readers)
+        {
+            reader.join();
+        }
+
+        writer.join();
+
+        const double elapsed = seconds_since(start);
+
+        if (failed)
+        {
+            std::cerr << "Error: the pool benchmark failed.\n";
+            return false;
+        }
+
+        size_t total_queries = 0;
+
+        for (size_t count : queries)
+        {
+            total_queries += count;
+        }
+
+        json << (t > 0 ? ", " : "") << "{\"threads\": " << thread_count \
+             << ", \"read_qps\": " << static_cast<double>(total_queries) / elapsed \
+             << ", \"writer_inserts_per_s\": " << static_cast<double>(writer_inserts) / elapsed << "}";
+    }
+
+    json << "]}\n";
+
+    pool.close();
+    remove_database(options.db_filename);
+
+    return true;
+}
+
+/**
+ * Function which aggregates the salaries in the scanned range by a single SQL
+ * query.
+ */
+bool sql_aggregate_salaries(sqlite3** p_db, salary_aggregate& aggregate)
+{
+    cached_statement stmt(get_statement_cache(*p_db),
+        "SELECT COUNT(*), SUM(Salary), MIN(Salary), MAX(Salary) FROM " + std::string(k_staff_table_name) \
+        + " WHERE Salary BETWEEN " + std::to_string(k_scan_min_salary) + " AND " \
+        + std::to_string(k_scan_max_salary) + ";");
+
+    if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW)
+    {
+        return false;
+    }
+
+    aggregate = salary_aggregate();
+    aggregate.count = static_cast<uint64_t>(sqlite3_column_int64(stmt.get(), 0));
+
+    if (aggregate.count > 0)
+    {
+        aggregate.sum = sqlite3_column_int64(stmt.get(), 1);
+        aggregate.min = sqlite3_column_int64(stmt.get(), 2);
+        aggregate.max = sqlite3_column_int64(stmt.get(), 3);
+    }
+
+    return true;
+}
+
+/**
+ * Function which computes the scan results by the SQL queries equal to the
+ * snapshot scans.
+ */
+bool sql_salary_scans(sqlite3** p_db, salary_aggregate& aggregate, std::vector<int64_t>& ids,
+                      std::vector<time_zone_aggregate>& groups)
+{
+    const std::string range = " FROM " + std::string(k_staff_table_name) + " WHERE Salary BETWEEN " \
+                              + std::to_string(k_scan_min_salary) + " AND " + std::to_string(k_scan_max_salary);
+
+    cached_statement ids_stmt(get_statement_cache(*p_db), "SELECT ID" + range + " ORDER BY ID;");
+    cached_statement groups_stmt(get_statement_cache(*p_db),
+        "SELECT TimeZone, COUNT(*), SUM(Salary), MIN(Salary), MAX(Salary)" + range + " GROUP BY TimeZone;");
+
+    if (!ids_stmt || !groups_stmt || !sql_aggregate_salaries(p_db, aggregate))
+    {
+        std::cerr << "Error: the SQL salary scans failed.\n";
+        return false;
+    }
+
+    ids.clear();
+
+    while (sqlite3_step(ids_stmt.get()) == SQLITE_ROW)
+    {
+        ids.push_back(sqlite3_column_int64(ids_stmt.get(), 0));
+    }
+
+    groups.clear();
+
+    while (sqlite3_step(groups_stmt.get()) == SQLITE_ROW)
+    {
+        time_zone_aggregate group;
+        group.is_null = sqlite3_column_type(groups_stmt.get(), 0) == SQLITE_NULL;
+
+        if (!group.is_null)
+        {
+            group.time_zone = reinterpret_cast<const char*>(sqlite3_column_text(groups_stmt.get(), 0));
+        }
+
+        group.salaries.count = static_cast<uint64_t>(sqlite3_column_int64(groups_stmt.get(), 1));
+        group.salaries.sum = sqlite3_column_int64(groups_stmt.get(), 2);
+        group.salaries.min = sqlite3_column_int64(groups_stmt.get(), 3);
+        group.salaries.max = sqlite3_column_int64(groups_stmt.get(), 4);
+        groups.push_back(std::move(group));
+    }
+
+    return true;
+}
+
+bool equal_aggregates(const salary_aggregate& a, const salary_aggregate& b)
+{
+    return a.count == b.count && a.sum == b.sum && a.min == b.min && a.max == b.max;
+}
+
+bool equal_groups(const std::vector<time_zone_aggregate>& a, const std::vector<time_zone_aggregate>& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].is_null != b[i].is_null || a[i].time_zone != b[i].time_zone ||
+            !equal_aggregates(a[i].salaries, b[i].salaries))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The benchmark of the analytical salary scans (aggregate, ID selection and
+ * aggregate grouped by the time zone) answered by SQLite and by the columnar
+ * snapshot with every supported instruction set. The snapshot results are
+ * checked to be equal to the SQL results.
+ */
+bool run_columnar_suite(const bench_options& options, std::ostream& json)
+{
+    const std::string csv_filename = options.db_filename + ".csv";
+
+    remove_database(options.db_filename);
+
+    if (!write_generated_csv(csv_filename, options.rows))
+    {
+        return false;
+    }
+
+    sqlite3* p_db = nullptr;
+    bool success = create_database(options.db_filename, durable_profile().name, &p_db) &&
+                   create_table(k_staff_schema, &p_db);
+
+    if (success)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+
+        // Some time zones are cleared, so the NULL group is covered.
+        success = bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats) &&
+                  exec_transaction_statement("UPDATE Staff SET TimeZone = NULL WHERE ID % 97 = 0;", &p_db);
+    }
+
+    std::remove(csv_filename.c_str());
+
+    std::vector<operation_samples> results;
+    salary_aggregate sql_aggregate;
+    std::vector<int64_t> sql_ids;
+    std::vector<time_zone_aggregate> sql_groups;
+
+    operation_samples sql_samples;
+    sql_samples.name = "sql";
+    sql_samples.unit = "rows";
+
+    success = success && time_operation(sql_samples, options.scan_iterations, [&](size_t& items)
+    {
+        items = options.rows;
+        return sql_salary_scans(&p_db, sql_aggregate, sql_ids, sql_groups);
+    });
+
+    results.push_back(sql_samples);
+
+    staff_snapshot snapshot;
+    operation_samples build_samples;
+    build_samples.name = "snapshot_build";
+    build_samples.unit = "rows";
+
+    success = success && time_operation(build_samples, 1, [&](size_t& items)
+    {
+        items = options.rows;
+        return build_staff_snapshot(k_staff_table_name, &p_db, snapshot);
+    });
+
+    results.push_back(build_samples);
+
+    const simd_level levels[] = {simd_level::scalar, simd_level::sse42, simd_level::avx2};
+    const simd_level supported = detect_simd_level();
+
+    for (simd_level level : levels)
+    {
+        if (!success || static_cast<int>(level) > static_cast<int>(supported))
+        {
+            continue;
+        }
+
+        set_simd_level(level);
+
+        salary_aggregate aggregate;
+        std::vector<int64_t> ids;
+        std::vector<time_zone_aggregate> groups;
+
+        operation_samples samples;
+        samples.name = std::string("snapshot_") + simd_level_name(level);
+        samples.unit = "rows";
+
+        success = time_operation(samples, options.scan_iterations, [&](size_t& items)
+        {
+            items = snapshot.size();
+            aggregate = aggregate_salaries(snapshot, k_scan_min_salary, k_scan_max_salary);
+            select_salary_range(snapshot, k_scan_min_salary, k_scan_max_salary, ids);
+            group_salaries_by_time_zone(snapshot, k_scan_min_salary, k_scan_max_salary, groups);
+            return true;
+        });
+
+        if (success && (!equal_aggregates(aggregate, sql_aggregate) || ids != sql_ids ||
+                        !equal_groups(groups, sql_groups)))
+        {
+            std::cerr << "Error: the " << simd_level_name(level) << " snapshot scans differ from the SQL scans.\n";
+            success = false;
+        }
+
+        results.push_back(samples);
+    }
+
+    set_simd_level(supported);
+    close_database(&p_db);
+    remove_database(options.db_filename);
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"suite\": \"columnar\", \"rows\": " << options.rows \
+         << ", \"scan_iterations\": " << options.scan_iterations \
+         << ", \"matched_rows\": " << sql_aggregate.count << ", \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}\n";
+
+    return true;
+}
+
+/**
+ * Function which creates an empty benchmark database with the Staff table.
+ */
+bool create_staff_database(const bench_options& options, sqlite3** p_db)
+{
+    remove_database(options.db_filename);
+
+    return create_database(options.db_filename, durable_profile().name, p_db) &&
+           create_table(k_staff_schema, p_db);
+}
+
+/**
+ * Function which prints the persons with the last name from the mapped
+ * snapshot, the first query served without SQLite.
+ */
+bool print_snapshot_last_name(const binary_snapshot& snapshot, std::string_view last_name, output_sink& sink)
+{
+    query_output output(sink);
+    staff_row row;
+
+    for (size_t i = 0; i < snapshot.rows(); ++i)
+    {
+        snapshot.read_row(i, row);
+
+        if (row.last_name == last_name)
+        {
+            print_query_result(row, output);
+        }
+    }
+
+    return output.finish() && output.rows() > 0;
+}
+
+/**
+ * Function which benchmarks the startup paths for the given number of
+ * generated rows. Every path ends by the first last name lookup:
+ * - csv: the table is created and loaded from the CSV file by the bulk
+ *   loader,
+ * - snapshot_load: the table is created and loaded from the verified binary
+ *   snapshot,
+ * - snapshot_mapped: the query is served straight from the verified mapped
+ *   snapshot,
+ * - snapshot_mapped_unverified: the same without the checksum verification.
+ */
+bool run_startup_scale(const bench_options& options, size_t rows, int null_fd, std::ostream& json)
+{
+    const std::string csv_filename = options.db_filename + ".csv";
+    const std::string snapshot_filename = options.db_filename + ".snapshot";
+    const std::string last_name = "Last1";
+
+    if (!write_generated_csv(csv_filename, rows))
+    {
+        return false;
+    }
+
+    sqlite3* p_db = nullptr;
+    output_sink sink(null_fd);
+    std::vector<operation_samples> results(5);
+
+    results[0].name = "csv";
+    results[0].unit = "rows";
+
+    bool success = time_operation(results[0], 1, [&](size_t& items)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+
+        items = rows;
+
+        return create_staff_database(options, &p_db) &&
+               bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats) &&
+               select_by_last_name(k_staff_table_name, last_name, &p_db, sink);
+    });
+
+    results[1].name = "snapshot_write";
+    results[1].unit = "rows";
+
+    success = success && time_operation(results[1], 1, [&](size_t& items)
+    {
+        return write_binary_snapshot(k_staff_table_name, snapshot_filename, &p_db, items);
+    });
+
+    close_database(&p_db);
+
+    results[2].name = "snapshot_load";
+    results[2].unit = "rows";
+
+    success = success && time_operation(results[2], 1, [&](size_t& items)
+    {
+        binary_snapshot snapshot;
+        bulk_load_stats stats;
+
+        items = rows;
+
+        return create_staff_database(options, &p_db) &&
+               snapshot.open(snapshot_filename) &&
+               load_binary_snapshot(snapshot, k_staff_table_name, k_default_chunk_size, &p_db, stats) &&
+               select_by_last_name(k_staff_table_name, last_name, &p_db, sink);
+    });
+
+    close_database(&p_db);
+
+    results[3].name = "snapshot_mapped";
+    results[3].unit = "rows";
+
+    success = success && time_operation(results[3], 1, [&](size_t& items)
+    {
+        binary_snapshot snapshot;
+
+        items = rows;
+        return snapshot.open(snapshot_filename) && print_snapshot_last_name(snapshot, last_name, sink);
+    });
+
+    results[4].name = "snapshot_mapped_unverified";
+    results[4].unit = "rows";
+
+    success = success && time_operation(results[4], 1, [&](size_t& items)
+    {
+        binary_snapshot snapshot;
+
+        items = rows;
+        return snapshot.open(snapshot_filename, false) && print_snapshot_last_name(snapshot, last_name, sink);
+    });
+
+    std::ifstream csv_file(csv_filename, std::ios::binary | std::ios::ate);
+    std::ifstream snapshot_file(snapshot_filename, std::ios::binary | std::ios::ate);
+    const std::streamoff csv_bytes = csv_file.tellg();
+    const std::streamoff snapshot_bytes = snapshot_file.tellg();
+
+    remove_database(options.db_filename);
+    std::remove(csv_filename.c_str());
+    std::remove(snapshot_filename.c_str());
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"rows\": " << rows << ", \"csv_bytes\": " << csv_bytes \
+         << ", \"snapshot_bytes\": " << snapshot_bytes << ", \"operations\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}";
+
+    return true;
+}
+
+/**
+ * The benchmark of the startup from the CSV file and from the binary snapshot
+ * for every number of generated rows.
+ */
+bool run_startup_suite(const bench_options& options, std::ostream& json)
+{
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    if (null_fd < 0)
+    {
+        std::cerr << "Error: opening /dev/null failed.\n";
+        return false;
+    }
+
+    json << "{\"suite\": \"startup\", \"results\": [";
+
+    bool success = true;
+
+    for (size_t i = 0; i < options.scales.size() && success; ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        success = run_startup_scale(options, options.scales[i], null_fd, json);
+    }
+
+    json << "]}\n";
+    close(null_fd);
+
+    return success;
+}
+
+/**
+ * The generated input of a single table of the tables suite.
+ */
+struct table_input
+{
+    const table_schema* schema;
+    std::string csv_filename;
+    size_t rows;
+};
+
+/**
+ * Function which loads the Staff table and its related tables generated at
+ * the same scale by the bulk loader driven by their schemas. The loaded
+ * payments are then joined with their persons and departments.
+ */
+bool run_tables_scale(const bench_options& options, size_t rows, std::ostream& json)
+{
+    const size_t departments = rows / 100 + 1;
+    std::vector<table_input> inputs = {
+        {&k_staff_schema, options.db_filename + ".staff.csv", rows},
+        {&k_department_schema, options.db_filename + ".department.csv", departments},
+        {&k_payroll_schema, options.db_filename + ".payroll.csv", rows}
+    };
+
+    remove_database(options.db_filename);
+
+    sqlite3* p_db = nullptr;
+    std::vector<operation_samples> results(inputs.size() + 1);
+
+    bool success = write_generated_csv(inputs[0].csv_filename, rows) &&
+                   write_department_csv(inputs[1].csv_filename, departments) &&
+                   write_payroll_csv(inputs[2].csv_filename, rows, rows, departments) &&
+                   create_database(options.db_filename, bulk_load_profile().name, &p_db);
+
+    for (size_t i = 0; i < inputs.size() && success; ++i)
+    {
+        success = create_table(*inputs[i].schema, &p_db);
+    }
+
+    for (size_t i = 0; i < inputs.size() && success; ++i)
+    {
+        const table_input& input = inputs[i];
+
+        results[i].name = std::string(input.schema->name);
+        results[i].unit = "rows";
+
+        success = time_operation(results[i], 1, [&](size_t& items)
+        {
+            std::ifstream file(input.csv_filename, std::ios::binary);
+            bulk_load_stats stats;
+
+            items = input.rows;
+
+            return bulk_load_table(*input.schema, file, k_default_chunk_size, &p_db, stats) &&
+                   stats.rows_inserted == input.rows;
+        });
+    }
+
+    results.back().name = "join";
+    results.back().unit = "rows";
+
+    success = success && time_operation(results.back(), 1, [&](size_t& items)
+    {
+        cached_statement stmt(get_statement_cache(p_db),
+            "SELECT COUNT(*), SUM(p.Amount) FROM PayrollHistory p JOIN Staff s ON s.ID = p.StaffID "
+            "JOIN Department d ON d.ID = p.DepartmentID;");
+
+        if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW)
+        {
+            std::cerr << "Error: the join of the loaded tables failed.\n";
+            return false;
+        }
+
+        items = static_cast<size_t>(sqlite3_column_int64(stmt.get(), 0));
+
+        if (items != rows)
+        {
+            std::cerr << "Error: the join of the loaded tables returned " << items << " payments instead of " \
+                      << rows << ".\n";
+            return false;
+        }
+
+        return true;
+    });
+
+    close_database(&p_db);
+    remove_database(options.db_filename);
+
+    for (const table_input& input : inputs)
+    {
+        std::remove(input.csv_filename.c_str());
+    }
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"rows\": " << rows << ", \"departments\": " << departments << ", \"operations\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}";
+
+    return true;
+}
+
+/**
+ * The benchmark of the loading of the Staff, Department and PayrollHistory
+ * tables for every number of generated rows.
+ */
+bool run_tables_suite(const bench_options& options, std::ostream& json)
+{
+    json << "{\"suite\": \"tables\", \"results\": [";
+
+    bool success = true;
+
+    for (size_t i = 0; i < options.scales.size() && success; ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        success = run_tables_scale(options, options.scales[i], json);
+    }
+
+    json << "]}\n";
+
+    return success;
+}
+
+/**
+ * The result of a single import of the incremental suite.
+ */
+struct incremental_round
+{
+    std::string name;
+    double seconds = 0.0;
+    size_t rows_read = 0;
+    size_t rows_written = 0;
+    incremental_import_stats stats;
+};
+
+/**
+ * Function which imports the CSV file incrementally and records the result.
+ */
+bool run_incremental_round(const std::string& name, const std::string& csv_filename, size_t max_applied_chunks,
+                           sqlite3** p_db, std::vector<incremental_round>& rounds)
+{
+    incremental_import_options import_options;
+    incremental_round round;
+
+    import_options.max_applied_chunks = max_applied_chunks;
+    round.name = name;
+
+    if (!incremental_import(k_staff_schema, csv_filename, import_options, p_db, round.stats))
+    {
+        return false;
+    }
+
+    round.seconds = round.stats.elapsed_seconds;
+    round.rows_read = round.stats.rows_read;
+    round.rows_written = round.stats.rows_inserted + round.stats.rows_updated;
+    rounds.push_back(round);
+
+    return true;
+}
+
+/**
+ * The benchmark of the nightly re-import of the Staff table. The table is
+ * loaded from --rows generated persons, then the same feed is imported again
+ * by the bulk loader (every record is looked up by its UNIQUE constraints)
+ * and incrementally. The incremental import is then repeated with the
+ * unchanged feed, with 2 % of the persons changed in a single block, with 2 %
+ * of the persons changed all over the feed, and with an interrupted and
+ * resumed run. The stored salaries are checked at the end.
+ */
+bool run_incremental_suite(const bench_options& options, std::ostream& json)
+{
+    const std::string csv_filename = options.db_filename + ".csv";
+    const std::string changed_filename = options.db_filename + ".changed.csv";
+    const size_t rows = std::max<size_t>(options.rows, 100);
+    const size_t block_begin = rows / 2;
+    const size_t block_end = block_begin + rows / 50;
+
+    remove_database(options.db_filename);
+
+    sqlite3* p_db = nullptr;
+    std::vector<incremental_round> rounds;
+
+    bool success = write_generated_csv(csv_filename, rows) &&
+                   create_database(options.db_filename, durable_profile().name, &p_db) &&
+                   create_table(k_staff_schema, &p_db);
+
+    if (success)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+
+        success = bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats);
+    }
+
+    // The full re-import, every record is skipped by the ON CONFLICT clause.
+    if (success)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+        incremental_round round;
+
+        success = bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats);
+
+        round.name = "full_reimport";
+        round.seconds = stats.elapsed_seconds;
+        round.rows_read = stats.rows_read;
+        round.rows_written = stats.rows_inserted;
+        rounds.push_back(round);
+    }
+
+    success = success &&
+              run_incremental_round("first_incremental", csv_filename, 0, &p_db, rounds) &&
+              run_incremental_round("unchanged", csv_filename, 0, &p_db, rounds) &&
+              write_changed_csv(changed_filename, rows, [&](size_t i)
+              {
+                  return i >= block_begin && i < block_end;
+              }) &&
+              run_incremental_round("block_changed_2pct", changed_filename, 0, &p_db, rounds) &&
+              write_changed_csv(changed_filename, rows, [](size_t i) { return i % 50 == 7; }) &&
+              run_incremental_round("scattered_changed_2pct", changed_filename, 0, &p_db, rounds);
+
+    // The original feed imported again, stopped after a half of the changed
+    // chunks and resumed.
+    if (success)
+    {
+        const size_t changed_chunks = rounds.back().stats.chunks_applied;
+
+        success = run_incremental_round("interrupted", csv_filename, std::max<size_t>(changed_chunks / 2, 1),
+                                        &p_db, rounds) &&
+                  run_incremental_round("resumed", csv_filename, 0, &p_db, rounds);
+
+        if (success && (!rounds.back().stats.resumed || !rounds[rounds.size() - 2].stats.interrupted))
+        {
+            std::cerr << "Error: the interrupted incremental import was not resumed.\n";
+            success = false;
+        }
+    }
+
+    // The stored salaries have to be equal to the original feed again.
+    if (success)
+    {
+        cached_statement stmt(get_statement_cache(p_db), "SELECT COUNT(*), SUM(Salary) FROM Staff;");
+        std::mt19937_64 random(0);
+        staff_record record;
+        int64_t salaries = 0;
+
+        for (size_t i = 0; i < rows; ++i)
+        {
+            record.generate(i, random);
+            salaries += std::stoll(record.values[k_salary_idx]);
+        }
+
+        success = stmt && sqlite3_step(stmt.get()) == SQLITE_ROW &&
+                  static_cast<size_t>(sqlite3_column_int64(stmt.get(), 0)) == rows &&
+                  sqlite3_column_int64(stmt.get(), 1) == salaries;
+
+        if (!success)
+        {
+            std::cerr << "Error: the incrementally imported salaries differ from the feed.\n";
+        }
+    }
+
+    close_database(&p_db);
+    remove_database(options.db_filename);
+    std::remove(csv_filename.c_str());
+    std::remove(changed_filename.c_str());
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"suite\": \"incremental\", \"rows\": " << rows << ", \"chunk_rows\": " \
+         << k_default_checkpoint_rows << ", \"imports\": [";
+
+    for (size_t i = 0; i < rounds.size(); ++i)
+    {
+        const incremental_round& round = rounds[i];
+
+        json << (i > 0 ? ", " : "") << "{\"name\": \"" << round.name << "\", \"seconds\": " << round.seconds \
+             << ", \"rows_read\": " << round.rows_read << ", \"rows_written\": " << round.rows_written \
+             << ", \"chunks_skipped\": " << round.stats.chunks_skipped \
+             << ", \"chunks_applied\": " << round.stats.chunks_applied << "}";
+    }
+
+    json << "]}\n";
+
+    return true;
+}
+
+/**
+ * The query of the parallel suite run serially on a single connection or in
+ * parallel on the executor. The query writes its rows into the sink or
+ * computes the salary aggregate.
+ */
+struct parallel_query
+{
+    std::string name;
+    std::function<bool(sqlite3** p_db, output_sink& sink, salary_aggregate& aggregate)> serial;
+    std::function<bool(async_executor& executor, const parallel_scan_options& options, output_sink& sink,
+                       salary_aggregate& aggregate)> parallel;
+};
+
+/**
+ * Function which times a query of the parallel suite. The output of the last
+ * run is described by the written bytes and the aggregate, so the parallel
+ * results can be compared with the serial ones (the rows of the parallel
+ * queries are ordered differently).
+ */
+bool time_parallel_query(operation_samples& samples, size_t iterations, size_t rows, output_sink& sink,
+                         uint64_t& bytes, salary_aggregate& aggregate,
+                         const std::function<bool(output_sink& sink, salary_aggregate& aggregate)>& query)
+{
+    return time_operation(samples, iterations, [&](size_t& items)
+    {
+        const uint64_t written = sink.bytes_written();
+        items = rows;
+
+        if (!query(sink, aggregate))
+        {
+            return false;
+        }
+
+        bytes = sink.bytes_written() - written;
+
+        return true;
+    });
+}
+
+/**
+ * The benchmark of the parallel queries over the ID ranges. Every query is
+ * timed serially on a single connection and then on the executor for every
+ * number of reader workers, in the ID order and in the completion order. The
+ * parallel results are checked against the serial ones.
+ */
+bool run_parallel_suite(const bench_options& options, std::ostream& json)
+{
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    if (null_fd < 0)
+    {
+        std::cerr << "Error: opening /dev/null failed.\n";
+        return false;
+    }
+
+    const std::string last_name = "Last" + std::to_string(k_distinct_last_names / 2);
+    const std::vector<parallel_query> queries = {
+        {"print_table",
+         [](sqlite3** p_db, output_sink& sink, salary_aggregate&)
+         {
+             return print_table(k_staff_table_name, p_db, sink);
+         },
+         [](async_executor& executor, const parallel_scan_options& scan, output_sink& sink, salary_aggregate&)
+         {
+             return parallel_print_table(executor, k_staff_table_name, scan, sink);
+         }},
+        {"select_salary",
+         [](sqlite3** p_db, output_sink& sink, salary_aggregate&)
+         {
+             return select_salary_threshold(k_staff_table_name, k_scan_max_salary, p_db, sink);
+         },
+         [](async_executor& executor, const parallel_scan_options& scan, output_sink& sink, salary_aggregate&)
+         {
+             return parallel_select_salary_threshold(executor, k_staff_table_name, k_scan_max_salary, scan,
+                                                     sink);
+         }},
+        {"select_last_name",
+         [&last_name](sqlite3** p_db, output_sink& sink, salary_aggregate&)
+         {
+             return select_by_last_name(k_staff_table_name, last_name, p_db, sink);
+         },
+         [&last_name](async_executor& executor, const parallel_scan_options& scan, output_sink& sink,
+                      salary_aggregate&)
+         {
+             return parallel_select_by_last_name(executor, k_staff_table_name, last_name, scan, sink);
+         }},
+        {"aggregate_salaries",
+         [](sqlite3** p_db, output_sink&, salary_aggregate& aggregate)
+         {
+             return sql_aggregate_salaries(p_db, aggregate);
+         },
+         [](async_executor& executor, const parallel_scan_options& scan, output_sink&,
+            salary_aggregate& aggregate)
+         {
+             return parallel_aggregate_salaries(executor, k_staff_table_name, k_scan_min_salary,
+                                                k_scan_max_salary, scan, aggregate);
+         }}};
+
+    std::vector<operation_samples> serial(queries.size());
+    std::vector<uint64_t> serial_bytes(queries.size());
+    std::vector<salary_aggregate> serial_aggregates(queries.size());
+
+    sqlite3* p_db = nullptr;
+    bool success = create_staff_database(options, &p_db) && insert_generated_rows(0, options.rows, &p_db);
+
+    // The repeated last name query is not answered by the lookup cache.
+    if (success)
+    {
+        get_lookup_cache(p_db).set_budget(0);
+    }
+
+    for (size_t q = 0; q < queries.size() && success; ++q)
+    {
+        output_sink sink(null_fd);
+        serial[q].name = queries[q].name;
+        serial[q].unit = "rows";
+
+        success = time_parallel_query(serial[q], options.scan_iterations, options.rows, sink, serial_bytes[q],
+                                      serial_aggregates[q], [&](output_sink& out, salary_aggregate& aggregate)
+        {
+            return queries[q].serial(&p_db, out, aggregate);
+        });
+    }
+
+    close_database(&p_db);
+
+    if (success)
+    {
+        json << "{\"suite\": \"parallel\", \"rows\": " << options.rows << ", \"ranges\": " \
+             << k_default_scan_ranges << ", \"serial\": [";
+
+        for (size_t q = 0; q < serial.size(); ++q)
+        {
+            json << (q > 0 ? ", " : "");
+            write_operation_json(serial[q], json);
+        }
+
+        json << "], \"results\": [";
+    }
+
+    const merge_order orders[] = {merge_order::by_id, merge_order::completion};
+
+    for (size_t t = 0; t < options.threads.size() && success; ++t)
+    {
+        connection_pool pool;
+        async_executor executor;
+        std::vector<operation_samples> results;
+
+        success = pool.open(options.db_filename, options.threads[t], durable_profile()) && executor.start(pool);
+
+        for (size_t q = 0; q < queries.size() && success; ++q)
+        {
+            for (merge_order order : orders)
+            {
+                parallel_scan_options scan;
+                scan.order = order;
+
+                output_sink sink(null_fd);
+                uint64_t bytes = 0;
+                salary_aggregate aggregate;
+                operation_samples samples;
+                samples.name = queries[q].name + (order == merge_order::by_id ? "" : "_unordered");
+                samples.unit = "rows";
+
+                success = time_parallel_query(samples, options.scan_iterations, options.rows, sink, bytes,
+                                              aggregate, [&](output_sink& out, salary_aggregate& result)
+                {
+                    return queries[q].parallel(executor, scan, out, result);
+                });
+
+                if (success && (bytes != serial_bytes[q] || !equal_aggregates(aggregate, serial_aggregates[q])))
+                {
+                    std::cerr << "Error: the parallel " << samples.name << " differs from the serial query.\n";
+                    success = false;
+                }
+
+                results.push_back(samples);
+
+                // The merge order does not apply to the aggregate.
+                if (queries[q].name == "aggregate_salaries")
+                {
+                    break;
+                }
+            }
+        }
+
+        executor.stop();
+
+        if (!success)
+        {
+            break;
+        }
+
+        json << (t > 0 ? ", " : "") << "{\"threads\": " << options.threads[t] << ", \"operations\": [";
+
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            json << (i > 0 ? ", " : "");
+            write_operation_json(results[i], json);
+        }
+
+        json << "]}";
+    }
+
+    if (success)
+    {
+        json << "]}\n";
+    }
+
+    close(null_fd);
+    remove_database(options.db_filename);
+
+    return success;
+}
+
+/**
+ * The results of the payroll reports of the functions suite.
+ */
+struct payroll_report
+{
+    std::map<std::string, int64_t> domains;
+    std::vector<int64_t> percentiles;
+    std::string histogram;
+
+    bool operator==(const payroll_report& other) const
+    {
+        return domains == other.domains && percentiles == other.percentiles && histogram == other.histogram;
+    }
+};
+
+// The reported salary percentiles and the width of the histogram buckets.
+const double k_report_percentiles[] = {50.0, 90.0, 99.0};
+constexpr int64_t k_histogram_width = 1000;
+
+/**
+ * Function which computes the payroll report by the SQL functions inside
+ * SQLite, only the results are read.
+ */
+bool sql_payroll_report(sqlite3** p_db, payroll_report& report)
+{
+    report = payroll_report();
+
+    cached_statement domains_stmt(get_statement_cache(*p_db),
+        "SELECT email_domain(Email) AS Domain, COUNT(*) FROM Staff GROUP BY Domain;");
+    cached_statement salaries_stmt(get_statement_cache(*p_db),
+        "SELECT salary_percentile(Salary, 50), salary_percentile(Salary, 90), salary_percentile(Salary, 99), " \
+        "salary_histogram(Salary, " + std::to_string(k_histogram_width) + ") FROM Staff;");
+
+    if (!domains_stmt || !salaries_stmt)
+    {
+        return false;
+    }
+
+    int status;
+
+    while ((status = sqlite3_step(domains_stmt.get())) == SQLITE_ROW)
+    {
+        const std::string domain(column_text_view(domains_stmt.get(), 0));
+        report.domains[domain] = sqlite3_column_int64(domains_stmt.get(), 1);
+    }
+
+    if (status != SQLITE_DONE || sqlite3_step(salaries_stmt.get()) != SQLITE_ROW)
+    {
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    for (int i = 0; i < 3; ++i)
+    {
+        report.percentiles.push_back(sqlite3_column_int64(salaries_stmt.get(), i));
+    }
+
+    report.histogram = std::string(column_text_view(salaries_stmt.get(), 3));
+
+    return true;
+}
+
+/**
+ * The state of the payroll report computed from the text rows.
+ */
+struct callback_report
+{
+    std::map<std::string, int64_t> domains;
+    std::vector<int64_t> salaries;
+    salary_histogram histogram{k_histogram_width};
+};
+
+/**
+ * The sqlite3_exec callback of the report, it gets every column as text.
+ */
+int payroll_report_callback(void* data, int, char** argv, char**)
+{
+    callback_report& state = *static_cast<callback_report*>(data);
+    const char* email = argv[staff_row::k_email_col];
+    const std::string_view domain = email_domain(email != nullptr ? email : "");
+
+    if (domain.data() != nullptr)
+    {
+        ++state.domains[std::string(domain)];
+    }
+
+    if (argv[staff_row::k_salary_col] != nullptr)
+    {
+        const int64_t salary = std::strtoll(argv[staff_row::k_salary_col], nullptr, 10);
+        state.salaries.push_back(salary);
+        state.histogram.add(salary);
+    }
+
+    return 0;
+}
+
+/**
+ * Function which computes the payroll report by post-processing all rows
+ * converted to text in the sqlite3_exec callback.
+ */
+bool callback_payroll_report(sqlite3** p_db, payroll_report& report)
+{
+    static const std::string sql = "SELECT " + std::string(get_table_sql(k_staff_schema).select_columns) \
+                                   + " FROM Staff;";
+    callback_report state;
+    char* err_msg = nullptr;
+
+    if (sqlite3_exec(*p_db, sql.c_str(), payroll_report_callback, &state, &err_msg) != SQLITE_OK)
+    {
+        std::cerr << "Error message: " << err_msg << "\n";
+        sqlite3_free(err_msg);
+        return false;
+    }
+
+    report = payroll_report();
+    report.domains = std::move(state.domains);
+
+    for (double percentile : k_report_percentiles)
+    {
+        report.percentiles.push_back(state.salaries.empty()
+                                     ? 0 : nearest_rank_percentile(state.salaries, percentile));
+    }
+
+    report.histogram = state.histogram.json();
+
+    return true;
+}
+
+/**
+ * The sqlite3_exec callback of the phone number lookup by a full scan.
+ */
+int phone_lookup_callback(void* data, int, char** argv, char**)
+{
+    auto& lookup = *static_cast<std::pair<std::string, int64_t>*>(data);
+    thread_local std::string normalized;
+
+    const char* phone_num = argv[staff_row::k_phone_num_col];
+    normalize_phone(phone_num != nullptr ? phone_num : "", normalized);
+
+    if (normalized == lookup.first)
+    {
+        lookup.second = std::strtoll(argv[staff_row::k_id_col], nullptr, 10);
+    }
+
+    return 0;
+}
+
+/**
+ * The benchmark of the SQL functions. The payroll report (the persons per
+ * email domain, the salary percentiles and the salary histogram) and the
+ * lookup of a person by the normalized phone number are computed inside
+ * SQLite by the SQL functions and by post-processing the text rows of the
+ * sqlite3_exec callbacks. The results of both ways are checked to be equal.
+ */
+bool run_functions_suite(const bench_options& options, std::ostream& json)
+{
+    sqlite3* p_db = nullptr;
+
+    // The persons are spread over several email domains. The expression
+    // indexes serve the grouping by the domain without a sort and the lookup
+    // by the normalized phone number.
+    bool success = create_staff_database(options, &p_db) && insert_generated_rows(0, options.rows, &p_db) &&
+                   exec_transaction_statement(
+                       "UPDATE Staff SET Email = replace(Email, '@example.com', '@example' || (ID % 7) || '.com');",
+                       &p_db) &&
+                   exec_transaction_statement(
+                       "CREATE INDEX idx_Staff_email_domain ON Staff(email_domain(Email));", &p_db) &&
+                   exec_transaction_statement(
+                       "CREATE INDEX idx_Staff_normalized_phone ON Staff(normalize_phone(PhoneNum));", &p_db);
+
+    std::vector<operation_samples> results;
+    payroll_report sql_report;
+    payroll_report callback_report_result;
+
+    operation_samples sql_samples;
+    sql_samples.name = "report_sql_functions";
+    sql_samples.unit = "rows";
+
+    success = success && time_operation(sql_samples, options.scan_iterations, [&](size_t& items)
+    {
+        items = options.rows;
+        return sql_payroll_report(&p_db, sql_report);
+    });
+
+    results.push_back(sql_samples);
+
+    operation_samples callback_samples;
+    callback_samples.name = "report_callback";
+    callback_samples.unit = "rows";
+
+    success = success && time_operation(callback_samples, options.scan_iterations, [&](size_t& items)
+    {
+        items = options.rows;
+        return callback_payroll_report(&p_db, callback_report_result);
+    });
+
+    results.push_back(callback_samples);
+
+    if (success && !(sql_report == callback_report_result))
+    {
+        std::cerr << "Error: the payroll report of the SQL functions differs from the callback report.\n";
+        success = false;
+    }
+
+    // The phone numbers are searched without the dashes.
+    std::mt19937_64 random(options.rows);
+    std::vector<std::pair<std::string, int64_t>> lookups;
+
+    for (size_t i = 0; i < options.iterations; ++i)
+    {
+        const size_t number = random() % options.rows;
+        char phone_num[32];
+        std::snprintf(phone_num, sizeof(phone_num), "%03zu%03zu%04zu",
+                      number / 10000000 % 1000, number / 10000 % 1000, number % 10000);
+        lookups.emplace_back(phone_num, static_cast<int64_t>(number) + 1);
+    }
+
+    operation_samples index_samples;
+    index_samples.name = "phone_lookup_expression_index";
+    index_samples.unit = "ops";
+    size_t lookup = 0;
+
+    success = success && time_operation(index_samples, options.iterations, [&](size_t& items)
+    {
+        cached_statement stmt(get_statement_cache(p_db), "SELECT ID FROM Staff WHERE normalize_phone(PhoneNum) = ?;");
+        const std::pair<std::string, int64_t>& expected = lookups[lookup++ % lookups.size()];
+
+        items = 1;
+        sqlite3_bind_text(stmt.get(), 1, expected.first.data(), static_cast<int>(expected.first.size()),
+                          SQLITE_STATIC);
+
+        return stmt && sqlite3_step(stmt.get()) == SQLITE_ROW && sqlite3_column_int64(stmt.get(), 0) == expected.second;
+    });
+
+    results.push_back(index_samples);
+
+    operation_samples scan_samples;
+    scan_samples.name = "phone_lookup_callback";
+    scan_samples.unit = "ops";
+    lookup = 0;
+
+    // The full scans are slow, so only the scan iterations are timed.
+    success = success && time_operation(scan_samples, options.scan_iterations, [&](size_t& items)
+    {
+        static const std::string sql = "SELECT " + std::string(get_table_sql(k_staff_schema).select_columns) \
+                                       + " FROM Staff;";
+        const std::pair<std::string, int64_t>& expected = lookups[lookup++ % lookups.size()];
+        std::pair<std::string, int64_t> found(expected.first, 0);
+
+        items = 1;
+
+        return sqlite3_exec(p_db, sql.c_str(), phone_lookup_callback, &found, nullptr) == SQLITE_OK &&
+               found.second == expected.second;
+    });
+
+    results.push_back(scan_samples);
+
+    close_database(&p_db);
+    remove_database(options.db_filename);
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"suite\": \"functions\", \"rows\": " << options.rows << ", \"domains\": " \
+         << sql_report.domains.size() << ", \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}\n";
+
+    return true;
+}
+
+/**
+ * Function which counts the persons printed in the table format into the
+ * memory sink (the header is followed by an empty line).
+ */
+size_t count_printed_rows(const output_sink& sink)
+{
+    const std::string_view printed = sink.buffered();
+    const size_t lines = static_cast<size_t>(std::count(printed.begin(), printed.end(), '\n'));
+
+    return lines > 2 ? lines - 2 : 0;
+}
+
+/**
+ * The benchmark of the type-ahead search. It loads --rows persons through
+ * the triggers filling the full-text index and times the first page of the
+ * search for every prefix of several words, from a single character to the
+ * full word, and a later page. The index is then checked to follow an update
+ * and a delete of a person.
+ */
+bool run_search_suite(const bench_options& options, std::ostream& json)
+{
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    if (null_fd < 0)
+    {
+        std::cerr << "Error: opening /dev/null failed.\n";
+        return false;
+    }
+
+    const std::string csv_filename = options.db_filename + ".csv";
+    sqlite3* p_db = nullptr;
+    double load_seconds = 0.0;
+
+    bool success = write_generated_csv(csv_filename, options.rows) && create_staff_database(options, &p_db);
+
+    if (success)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+        const steady_clock::time_point start = steady_clock::now();
+
+        success = bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats);
+        load_seconds = seconds_since(start);
+    }
+
+    std::remove(csv_filename.c_str());
+
+    // The words of a first name, a last name and an address, the address word
+    // is in every row.
+    const std::string words[] = {"First" + std::to_string(options.rows / 2),
+                                 "Last" + std::to_string(k_distinct_last_names / 2),
+                                 "Synthetic"};
+    std::vector<std::pair<std::string, size_t>> searches;
+
+    for (const std::string& word : words)
+    {
+        for (size_t length = 1; length <= word.size(); ++length)
+        {
+            searches.emplace_back(word.substr(0, length), 0);
+        }
+    }
+
+    searches.emplace_back(words[1] + " " + words[0].substr(0, 3), 0);
+    searches.emplace_back(words[1], 10 * k_default_search_limit);
+
+    std::vector<operation_samples> results;
+
+    for (const std::pair<std::string, size_t>& search : searches)
+    {
+        if (!success)
+        {
+            break;
+        }
+
+        output_sink sink(null_fd);
+        operation_samples samples;
+        samples.name = search.first + " offset " + std::to_string(search.second);
+        samples.unit = "searches";
+
+        success = time_operation(samples, options.iterations, [&](size_t& items)
+        {
+            items = 1;
+            return search_staff(k_staff_table_name, search.first, k_default_search_limit, search.second, &p_db,
+                                sink);
+        });
+
+        results.push_back(samples);
+    }
+
+    // The updated and deleted persons are found by their new values only.
+    size_t updated_rows = 0;
+    size_t deleted_rows = 0;
+
+    if (success)
+    {
+        output_sink updated(k_memory_sink_fd);
+        output_sink deleted(k_memory_sink_fd);
+
+        success = exec_transaction_statement("UPDATE Staff SET LastName = 'Zyxwvut' WHERE ID = 1;", &p_db) &&
+                  search_staff(k_staff_table_name, "zyxw", k_default_search_limit, 0, &p_db, updated) &&
+                  exec_transaction_statement("DELETE FROM Staff WHERE ID = 1;", &p_db) &&
+                  search_staff(k_staff_table_name, "zyxw", k_default_search_limit, 0, &p_db, deleted);
+
+        updated_rows = count_printed_rows(updated);
+        deleted_rows = count_printed_rows(deleted);
+
+        if (success && (updated_rows != 1 || deleted_rows != 0))
+        {
+            std::cerr << "Error: the search index does not follow the updated and deleted persons.\n";
+            success = false;
+        }
+    }
+
+    close_database(&p_db);
+    close(null_fd);
+    remove_database(options.db_filename);
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"suite\": \"search\", \"rows\": " << options.rows << ", \"limit\": " << k_default_search_limit \
+         << ", \"load_rows_per_second\": " << static_cast<double>(options.rows) / load_seconds \
+         << ", \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}\n";
+
+    return true;
+}
+
+// The page size of the pages suite, so 100000 persons have 10000 pages.
+constexpr size_t k_bench_page_size = 10;
+// The timed pages of the pages suite, the pages behind the last one are not
+// timed.
+const size_t k_bench_page_numbers[] = {1, 10, 100, 1000, 10000};
+
+/**
+ * A paged query of the pages suite: the page printed by the continuation
+ * token and the OFFSET query printing the same rows (its parameters are the
+ * limit and the offset).
+ */
+struct paged_query
+{
+    std::string name;
+    std::function<bool(std::string_view token, output_sink& sink, std::string& next_token)> page;
+    std::string offset_sql;
+};
+
+/**
+ * Function which prints the page of the OFFSET query.
+ */
+bool print_offset_page(const std::string& offset_sql, size_t page_number, sqlite3** p_db, output_sink& sink)
+{
+    cached_statement stmt(get_statement_cache(*p_db), offset_sql);
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (offset page query).\n";
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt.get(), 1, static_cast<sqlite3_int64>(k_bench_page_size));
+    sqlite3_bind_int64(stmt.get(), 2, static_cast<sqlite3_int64>((page_number - 1) * k_bench_page_size));
+
+    return print_staff_rows(stmt.get(), p_db, sink);
+}
+
+/**
+ * Function which reads all pages of the query by their continuation tokens
+ * and keeps the tokens of the timed pages.
+ *
+ * @param query  The paged query.
+ * @param walk   The time of the walk and the number of read rows.
+ * @param tokens The tokens of the timed pages up to the last page.
+ * @return       True if all pages were read successfully, false otherwise.
+ */
+bool walk_pages(const paged_query& query, operation_samples& walk, std::map<size_t, std::string>& tokens)
+{
+    std::string token;
+    std::string next_token;
+    size_t page_number = 1;
+    const steady_clock::time_point start = steady_clock::now();
+
+    for (;; ++page_number)
+    {
+        if (std::find(std::begin(k_bench_page_numbers), std::end(k_bench_page_numbers), page_number) !=
+            std::end(k_bench_page_numbers))
+        {
+            tokens[page_number] = token;
+        }
+
+        output_sink sink(k_memory_sink_fd);
+
+        if (!query.page(token, sink, next_token))
+        {
+            return false;
+        }
+
+        walk.items += count_printed_rows(sink);
+
+        if (next_token.empty())
+        {
+            break;
+        }
+
+        token.swap(next_token);
+    }
+
+    walk.seconds.push_back(seconds_since(start));
+
+    return true;
+}
+
+/**
+ * The benchmark of the keyset pagination. It loads --rows persons, reads all
+ * pages of the table ordered by ID, of the salary threshold query ordered by
+ * (Salary, ID) and of a last name, and then times the pages 1, 10, ...,
+ * 10000 of every query read by the continuation token and by OFFSET. Every
+ * timed page has to print the same rows both ways and the walks have to read
+ * all rows of the queries.
+ */
+bool run_pages_suite(const bench_options& options, std::ostream& json)
+{
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    if (null_fd < 0)
+    {
+        std::cerr << "Error: opening /dev/null failed.\n";
+        return false;
+    }
+
+    const std::string csv_filename = options.db_filename + ".csv";
+    sqlite3* p_db = nullptr;
+
+    bool success = write_generated_csv(csv_filename, options.rows) && create_staff_database(options, &p_db);
+
+    if (success)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+
+        success = bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats);
+    }
+
+    std::remove(csv_filename.c_str());
+
+    const std::string last_name = "Last" + std::to_string(k_distinct_last_names / 2);
+    const std::string select_columns = "SELECT " + std::string(get_table_sql(k_staff_schema).select_columns) + \
+                                       " FROM " + std::string(k_staff_table_name);
+    size_t last_name_rows = 0;
+
+    if (success)
+    {
+        output_sink sink(k_memory_sink_fd);
+
+        success = select_by_last_name(k_staff_table_name, last_name, &p_db, sink);
+        last_name_rows = count_printed_rows(sink);
+    }
+
+    const paged_query queries[] = {
+        {"table", [&](std::string_view token, output_sink& sink, std::string& next_token)
+            {
+                return print_table_page(k_staff_table_name, token, k_bench_page_size, &p_db, sink, next_token);
+            },
+            select_columns + " ORDER BY ID LIMIT ?1 OFFSET ?2;"},
+        {"salary", [&](std::string_view token, output_sink& sink, std::string& next_token)
+            {
+                return select_salary_threshold_page(k_staff_table_name, 0, token, k_bench_page_size, &p_db, sink,
+                                                    next_token);
+            },
+            select_columns + " WHERE Salary >= 0 ORDER BY Salary, ID LIMIT ?1 OFFSET ?2;"},
+        {"last_name", [&](std::string_view token, output_sink& sink, std::string& next_token)
+            {
+                return select_by_last_name_page(k_staff_table_name, last_name, token, k_bench_page_size, &p_db, sink,
+                                                next_token);
+            },
+            select_columns + " WHERE LastName = '" + last_name + "' ORDER BY FirstName, PhoneNum LIMIT ?1 OFFSET ?2;"}
+    };
+    const size_t expected_rows[] = {options.rows, options.rows, last_name_rows};
+
+    std::vector<operation_samples> results;
+
+    for (size_t i = 0; success && i < std::size(queries); ++i)
+    {
+        const paged_query& query = queries[i];
+        operation_samples walk;
+        std::map<size_t, std::string> tokens;
+
+        walk.name = query.name + " walk";
+        walk.unit = "rows";
+        success = walk_pages(query, walk, tokens);
+
+        if (success && walk.items != expected_rows[i])
+        {
+            std::cerr << "Error: the pages of the " << query.name << " query have " << walk.items \
+                      << " rows instead of " << expected_rows[i] << ".\n";
+            success = false;
+        }
+
+        results.push_back(walk);
+
+        for (const auto& page : tokens)
+        {
+            if (!success)
+            {
+                break;
+            }
+
+            // The page has to be the same both ways.
+            output_sink keyset_page(k_memory_sink_fd);
+            output_sink offset_page(k_memory_sink_fd);
+            std::string next_token;
+
+            success = query.page(page.second, keyset_page, next_token) &&
+                      print_offset_page(query.offset_sql, page.first, &p_db, offset_page);
+
+            if (success && keyset_page.buffered() != offset_page.buffered())
+            {
+                std::cerr << "Error: the page " << page.first << " of the " << query.name \
+                          << " query differs from its OFFSET page.\n";
+                success = false;
+            }
+
+            output_sink sink(null_fd);
+            operation_samples keyset;
+            operation_samples offset;
+            keyset.name = query.name + " page " + std::to_string(page.first) + " keyset";
+            keyset.unit = "pages";
+            offset.name = query.name + " page " + std::to_string(page.first) + " offset";
+            offset.unit = "pages";
+
+            success = success && time_operation(keyset, options.iterations, [&](size_t& items)
+            {
+                items = 1;
+                return query.page(page.second, sink, next_token);
+            });
+
+            success = success && time_operation(offset, options.scan_iterations, [&](size_t& items)
+            {
+                items = 1;
+                return print_offset_page(query.offset_sql, page.first, &p_db, sink);
+            });
+
+            results.push_back(keyset);
+            results.push_back(offset);
+        }
+    }
+
+    close_database(&p_db);
+    close(null_fd);
+    remove_database(options.db_filename);
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"suite\": \"pages\", \"rows\": " << options.rows << ", \"page_size\": " << k_bench_page_size \
+         << ", \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}\n";
+
+    return true;
+}
+
+/**
+ * A way of copying the database timed by the backup suite.
+ */
+struct backup_round
+{
+    std::string name;
+    std::function<bool(const std::string& db_filename, const std::string& filename, backup_stats& stats)> copy;
+};
+
+/**
+ * Function which counts the persons in the copied database and checks its
+ * integrity.
+ */
+bool check_database_copy(const std::string& filename, size_t& rows)
+{
+    sqlite3* db = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+    bool success = false;
+
+    if (sqlite3_open_v2(filename.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK &&
+        sqlite3_prepare_v2(db, "SELECT (SELECT COUNT(*) FROM Staff), (SELECT quick_check FROM pragma_quick_check);", -1,
+                           &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        const char* check = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+
+        rows = static_cast<size_t>(sqlite3_column_int64(stmt, 0));
+        success = (check != nullptr && std::strcmp(check, "ok") == 0);
+    }
+
+    if (!success)
+    {
+        std::cerr << "Error: the database copy \"" << filename << "\" is not valid.\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(db) << "\n";
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+
+    return success;
+}
+
+/**
+ * The benchmark of the online backup. It loads --rows persons and, while a
+ * background writer keeps inserting durable records one per transaction,
+ * copies the database repeatedly for --duration seconds by the online backup
+ * (by 1024 pages per step, throttled by a pause after every step, and in a
+ * single step) and by VACUUM INTO. The latencies of the writes during the
+ * copies are compared to the writes alone. Every copy is checked to hold at
+ * least the loaded persons and to pass the integrity check.
+ */
+bool run_backup_suite(const bench_options& options, std::ostream& json)
+{
+    const std::string csv_filename = options.db_filename + ".csv";
+    const std::string copy_filename = options.db_filename + ".copy";
+    sqlite3* p_db = nullptr;
+
+    bool success = write_generated_csv(csv_filename, options.rows) && create_staff_database(options, &p_db);
+
+    if (success)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+
+        success = bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats);
+    }
+
+    std::remove(csv_filename.c_str());
+
+    backup_options throttled;
+    throttled.step_pages = 256;
+    throttled.step_pause = std::chrono::microseconds(2000);
+
+    backup_options single_step;
+    single_step.step_pages = -1;
+
+    const auto backup_round_copy = [](const backup_options& backup)
+    {
+        return [backup](const std::string& db_filename, const std::string& filename, backup_stats& stats)
+        {
+            return backup_database(db_filename, filename, backup, stats);
+        };
+    };
+
+    const backup_round rounds[] = {
+        {"writes alone", nullptr},
+        {"backup", backup_round_copy(backup_options())},
+        {"backup throttled", backup_round_copy(throttled)},
+        {"backup single step", backup_round_copy(single_step)},
+        {"vacuum into", export_database}
+    };
+
+    std::vector<operation_samples> results;
+    size_t next_row = options.rows;
+    int database_pages = 0;
+
+    for (const backup_round& round : rounds)
+    {
+        if (!success)
+        {
+            break;
+        }
+
+        std::atomic<bool> stop(false);
+        std::atomic<bool> failed(false);
+        operation_samples writes;
+        operation_samples copies;
+        writes.name = round.name + " writes";
+        writes.unit = "writes";
+        copies.name = round.name + " copies";
+        copies.unit = "pages";
+
+        // The background writer inserts one durable row per transaction.
+        std::thread writer([&]()
+        {
+            while (!stop)
+            {
+                const steady_clock::time_point start = steady_clock::now();
+
+                if (!insert_generated_rows(next_row++, 1, &p_db))
+                {
+                    failed = true;
+                    return;
+                }
+
+                writes.seconds.push_back(seconds_since(start));
+                ++writes.items;
+            }
+        });
+
+        const steady_clock::time_point start = steady_clock::now();
+
+        while (success && seconds_since(start) < options.duration_seconds)
+        {
+            if (!round.copy)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+
+            backup_stats stats;
+            size_t copied_rows = 0;
+
+            success = round.copy(options.db_filename, copy_filename, stats) &&
+                      check_database_copy(copy_filename, copied_rows);
+
+            if (success && copied_rows < options.rows)
+            {
+                std::cerr << "Error: the database copy has " << copied_rows << " persons instead of at least " \
+                          << options.rows << ".\n";
+                success = false;
+            }
+
+            copies.seconds.push_back(stats.elapsed_seconds);
+            copies.items += static_cast<size_t>(stats.pages);
+            database_pages = std::max(database_pages, stats.pages);
+        }
+
+        stop = true;
+        writer.join();
+        success = success && !failed;
+
+        results.push_back(writes);
+
+        if (round.copy)
+        {
+            results.push_back(copies);
+        }
+    }
+
+    close_database(&p_db);
+    remove_database(options.db_filename);
+    remove_database(copy_filename);
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"suite\": \"backup\", \"rows\": " << options.rows << ", \"database_pages\": " << database_pages \
+         << ", \"duration_s\": " << options.duration_seconds << ", \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "");
+        write_operation_json(results[i], json);
+    }
+
+    json << "]}\n";
+
+    return true;
+}
+
+/**
+ * The throughput of the lookups and phone number updates run through the
+ * asynchronous executor by a single submitting thread.
+ */
+struct async_round
+{
+    double read_qps = 0.0;
+    double write_ops = 0.0;
+    uint64_t write_batches = 0;
+    size_t failed = 0;
+};
+
+/**
+ * Function which submits the lookups and then the phone number updates to
+ * the executor and waits for all of them.
+ */
+bool run_async_round(async_executor& executor, size_t lookups, size_t updates, size_t rows, int null_fd,
+                     size_t& update_number, async_round& round)
+{
+    std::vector<std::unique_ptr<output_sink>> sinks;
+    std::vector<std::future<task_status>> results;
+    std::mt19937_64 random(lookups);
+
+    for (size_t i = 0; i < lookups; ++i)
+    {
+        sinks.emplace_back(new output_sink(null_fd, output_format::table, k_async_sink_buffer_size));
+    }
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t i = 0; i < lookups; ++i)
+    {
+        results.push_back(executor.submit_read(select_by_last_name_task(
+            k_staff_table_name, "Last" + std::to_string(random() % k_distinct_last_names), *sinks[i])));
+    }
+
+    for (std::future<task_status>& result : results)
+    {
+        round.failed += (result.get() != task_status::completed);
+    }
+
+    round.read_qps = static_cast<double>(lookups) / seconds_since(start);
+    results.clear();
+
+    const uint64_t batches_before = executor.write_batches();
+    start = steady_clock::now();
+
+    for (size_t i = 0; i < updates; ++i)
+    {
+        char phone_num[32];
+        std::snprintf(phone_num, sizeof(phone_num), "8-%08zu", update_number++);
+
+        results.push_back(executor.submit_write(update_phone_number_task(
+            k_staff_table_name, static_cast<int>(random() % rows) + 1, phone_num)));
+    }
+
+    for (std::future<task_status>& result : results)
+    {
+        round.failed += (result.get() != task_status::completed);
+    }
+
+    round.write_ops = static_cast<double>(updates) / seconds_since(start);
+    round.write_batches = executor.write_batches() - batches_before;
+
+    return round.failed == 0;
+}
+
+/**
+ * The benchmark of the asynchronous executor. The same lookups and durable
+ * phone number updates are run synchronously on a single connection and then
+ * submitted to the executor for every number of reader workers. The updates
+ * submitted together are committed in group commits.
+ */
+bool run_async_suite(const bench_options& options, std::ostream& json)
+{
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    if (null_fd < 0)
+    {
+        std::cerr << "Error: opening /dev/null failed.\n";
+        return false;
+    }
+
+    const size_t lookups = options.iterations * 50;
+    const size_t updates = options.iterations * 5;
+    size_t update_number = 0;
+    bool success = true;
+
+    remove_database(options.db_filename);
+
+    // The synchronous baseline, the updates are committed one by one.
+    {
+        connection_pool pool;
+        output_sink sink(null_fd);
+        std::mt19937_64 random(lookups);
+
+        success = pool.open(options.db_filename, 1, durable_profile());
+
+        connection_lease writer = pool.acquire_writer();
+
+        success = success && create_table(k_staff_schema, writer.get()) &&
+                  insert_generated_rows(0, options.rows, writer.get());
+
+        steady_clock::time_point start = steady_clock::now();
+
+        for (size_t i = 0; i < lookups && success; ++i)
+        {
+            success = select_by_last_name(k_staff_table_name,
+                                          "Last" + std::to_string(random() % k_distinct_last_names),
+                                          writer.get(), sink);
+        }
+
+        const double read_qps = static_cast<double>(lookups) / seconds_since(start);
+        start = steady_clock::now();
+
+        for (size_t i = 0; i < updates && success; ++i)
+        {
+            char phone_num[32];
+            std::snprintf(phone_num, sizeof(phone_num), "8-%08zu", update_number++);
+
+            success = update_phone_number(k_staff_table_name, static_cast<int>(random() % options.rows) + 1,
+                                          phone_num, writer.get());
+        }
+
+        const double write_ops = static_cast<double>(updates) / seconds_since(start);
+
+        json << "{\"suite\": \"async\", \"rows\": " << options.rows << ", \"lookups\": " << lookups \
+             << ", \"updates\": " << updates << ", \"sync\": {\"read_qps\": " << read_qps \
+             << ", \"write_ops\": " << write_ops << "}, \"results\": [";
+    }
+
+    for (size_t t = 0; t < options.threads.size() && success; ++t)
+    {
+        connection_pool pool;
+        async_executor executor;
+        async_round round;
+
+        success = pool.open(options.db_filename, options.threads[t], durable_profile()) &&
+                  executor.start(pool) &&
+                  run_async_round(executor, lookups, updates, options.rows, null_fd, update_number, round);
+
+        executor.stop();
+
+        if (!success)
+        {
+            std::cerr << "Error: the async benchmark failed (" << round.failed << " failed tasks).\n";
+            break;
+        }
+
+        json << (t > 0 ? ", " : "") << "{\"threads\": " << options.threads[t] \
+             << ", \"read_qps\": " << round.read_qps << ", \"write_ops\": " << round.write_ops \
+             << ", \"write_batches\": " << round.write_batches << "}";
+    }
+
+    json << "]}\n";
+    close(null_fd);
+    remove_database(options.db_filename);
+
+    return success;
+}
+
+/**
+ * The throughput of the concurrent inserts of a single thread count.
+ */
+struct insert_round
+{
+    double write_ops = 0.0;
+    size_t constraint_failures = 0;
+    size_t other_failures = 0;
+};
+
+/**
+ * Function which runs the inserts [first, first + writes) by the threads. The
+ * insert of the record number is performed by the insert function returning
+ * the extended SQLite result code of the insert.
+ */
+void run_concurrent_inserts(size_t threads, size_t first, size_t writes,
+                            const std::function<int(std::vector<std::string>)>& insert, insert_round& round)
+{
+    std::atomic<size_t> next_write(0);
+    std::atomic<size_t> constraint_failures(0);
+    std::atomic<size_t> other_failures(0);
+    std::vector<std::thread> inserters;
+
+    steady_clock::time_point start = steady_clock::now();
+
+    for (size_t t = 0; t < threads; ++t)
+    {
+        inserters.emplace_back([&, t]()
+        {
+            std::mt19937_64 random(first + t);
+            staff_record record;
+
+            for (size_t i = next_write++; i < writes; i = next_write++)
+            {
+                record.generate(first + i, random);
+
+                if (i % k_duplicate_email_interval == k_duplicate_email_interval - 1)
+                {
+                    record.values[k_email_idx] = "person0@example.com";
+                }
+
+                const int result = insert(std::vector<std::string>(std::begin(record.values),
+                                                                   std::end(record.values)));
+
+                if (result == SQLITE_CONSTRAINT_UNIQUE)
+                {
+                    ++constraint_failures;
+                }
+                else if (result != SQLITE_OK)
+                {
+                    ++other_failures;
+                }
+            }
+        });
+    }
+
+    for (std::thread& inserter : inserters)
+    {
+        inserter.join();
+    }
+
+    round.write_ops = static_cast<double>(writes) / seconds_since(start);
+    round.constraint_failures = constraint_failures;
+    round.other_failures = other_failures;
+}
+
+/**
+ * The benchmark of the group commit writer. For every thread count the
+ * threads insert the durable records, at first each insert is committed by
+ * itself on the shared writer connection and then the inserts are submitted
+ * to the group commit writer. Every k_duplicate_email_interval-th insert
+ * violates the UNIQUE Email constraint, the failure has to be reported to
+ * its submitter alone.
+ */
+bool run_group_commit_suite(const bench_options& options, std::ostream& json)
+{
+    const size_t writes = options.iterations * 10;
+    const size_t expected_failures = writes / k_duplicate_email_interval;
+    size_t first = std::max<size_t>(options.rows, 1);
+    connection_pool pool;
+
+    remove_database(options.db_filename);
+
+    bool success = pool.open(options.db_filename, 1, durable_profile());
+
+    {
+        connection_lease writer = pool.acquire_writer();
+
+        success = success && create_table(k_staff_schema, writer.get()) &&
+                  insert_generated_rows(0, first, writer.get());
+    }
+
+    json << "{\"suite\": \"group_commit\", \"rows\": " << first << ", \"writes\": " << writes \
+         << ", \"window_us\": " << options.window_us << ", \"results\": [";
+
+    for (size_t t = 0; t < options.threads.size() && success; ++t)
+    {
+        insert_round autocommit;
+        insert_round grouped;
+        group_commit_stats stats;
+
+        // The baseline, the inserts are serialized on the writer connection
+        // and every insert is committed by itself.
+        {
+            connection_lease writer = pool.acquire_writer();
+            std::mutex writer_mutex;
+
+            run_concurrent_inserts(options.threads[t], first, writes, [&](std::vector<std::string> values)
+            {
+                std::lock_guard<std::mutex> lock(writer_mutex);
+                current_task_error() = task_error();
+
+                if (insert_values_task(k_staff_schema, std::move(values))(writer.get()))
+                {
+                    return SQLITE_OK;
+                }
+
+                const int own_error_code = current_task_error().error_code;
+
+                return (own_error_code != SQLITE_OK) ? own_error_code : sqlite3_extended_errcode(writer.handle());
+            }, autocommit);
+
+            first += writes;
+        }
+
+        {
+            connection_lease writer = pool.acquire_writer();
+            group_commit_writer group_writer;
+            group_commit_options group_options;
+
+            group_options.window = std::chrono::microseconds(options.window_us);
+            group_writer.start(writer.get(), group_options);
+
+            run_concurrent_inserts(options.threads[t], first, writes, [&](std::vector<std::string> values)
+            {
+                return group_writer.insert_record(k_staff_schema, std::move(values)).error_code;
+            }, grouped);
+
+            group_writer.stop();
+            stats = group_writer.stats();
+            first += writes;
+        }
+
+        for (const insert_round* round : {&autocommit, &grouped})
+        {
+            if (round->constraint_failures != expected_failures || round->other_failures != 0)
+            {
+                std::cerr << "Error: the group commit benchmark reported " << round->constraint_failures \
+                          << " constraint failures (expected " << expected_failures << ") and " \
+                          << round->other_failures << " other failures.\n";
+                success = false;
+            }
+        }
+
+        json << (t > 0 ? ", " : "") << "{\"threads\": " << options.threads[t] \
+             << ", \"autocommit_ops\": " << autocommit.write_ops \
+             << ", \"group_commit_ops\": " << grouped.write_ops \
+             << ", \"groups\": " << stats.groups << ", \"largest_group\": " << stats.largest_group \
+             << ", \"constraint_failures\": " << grouped.constraint_failures << "}";
+    }
+
+    json << "]}\n";
+    pool.close();
+    remove_database(options.db_filename);
+
+    return success;
+}
+
+/**
+ * The C++ heap allocations of a single benchmarked operation.
+ */
+struct allocation_samples
+{
+    std::string name;
+    std::string unit;
+    uint64_t allocations = 0;
+    size_t items = 0;
+};
+
+/**
+ * Function which runs the operation repeatedly and counts the heap
+ * allocations made while it runs. The operation sets the number of processed
+ * items.
+ */
+bool count_allocations(allocation_samples& samples, size_t iterations,
+                       const std::function<bool(size_t&)>& operation)
+{
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        size_t items = 0;
+        const uint64_t before = heap_allocations();
+
+        if (!operation(items))
+        {
+            std::cerr << "Error: the benchmarked operation \"" << samples.name << "\" failed.\n";
+            return false;
+        }
+
+        samples.allocations += heap_allocations() - before;
+        samples.items += items;
+    }
+
+    return true;
+}
+
+/**
+ * The benchmark of the heap allocations of the Staff operations. The
+ * allocations are counted by the allocation hook, so only the C++ allocations
+ * are reported, SQLite allocates by its own allocator. The
+ * import and the per-row operations are expected to allocate (almost)
+ * nothing per row once their buffers and statements are warmed up.
+ */
+bool run_alloc_suite(const bench_options& options, std::ostream& json)
+{
+    const std::string csv_filename = options.db_filename + ".csv";
+    const size_t rows = options.rows;
+    const int null_fd = open("/dev/null", O_WRONLY);
+
+    if (null_fd < 0)
+    {
+        std::cerr << "Error: opening /dev/null failed.\n";
+        return false;
+    }
+
+    remove_database(options.db_filename);
+
+    sqlite3* p_db = nullptr;
+    output_sink sink(null_fd);
+    std::vector<allocation_samples> results(8);
+
+    bool success = write_generated_csv(csv_filename, rows) &&
+                   create_database(options.db_filename, bulk_load_profile().name, &p_db) &&
+                   create_table(k_staff_schema, &p_db);
+
+    results[0].name = "import";
+    results[0].unit = "row";
+
+    success = success && count_allocations(results[0], 1, [&](size_t& items)
+    {
+        std::ifstream input(csv_filename, std::ios::binary);
+        bulk_load_stats stats;
+
+        items = rows;
+
+        return bulk_load_table(k_staff_schema, input, k_default_chunk_size, &p_db, stats) &&
+               stats.rows_inserted == rows;
+    });
+
+    // The same rows imported again by the pipeline are all skipped, so the
+    // pipeline stages are measured without the index maintenance.
+    results[1].name = "import_pipeline";
+    results[1].unit = "row";
+
+    success = success && count_allocations(results[1], 1, [&](size_t& items)
+    {
+        import_pipeline_options pipeline_options;
+        import_pipeline_stats stats;
+
+        pipeline_options.parser_threads = 2;
+        items = rows;
+
+        return run_import_pipeline(csv_filename,
+                                   get_table_sql(k_staff_schema).insert + " ON CONFLICT DO NOTHING;",
+                                   validate_staff_record, bind_record_values, pipeline_options, &p_db, stats) &&
+               stats.rows_skipped == rows;
+    });
+
+    // The inserted records and the looked up names are prepared before, so
+    // only the operations themselves are counted.
+    std::vector<std::string> records;
+    std::vector<std::string> last_names;
+    std::mt19937_64 random(rows);
+    staff_record record;
+
+    for (size_t i = 0; i < options.iterations; ++i)
+    {
+        std::ostringstream line;
+
+        record.generate(rows + i, random);
+        record.write_csv(line);
+        records.push_back(line.str());
+        records.back().pop_back();
+        last_names.push_back("Last" + std::to_string(random() % k_distinct_last_names));
+    }
+
+    results[2].name = "insert_record";
+    results[2].unit = "call";
+    size_t record_number = 0;
+    const std::string& staff_columns = get_table_sql(k_staff_schema).record_columns;
+
+    success = success && count_allocations(results[2], options.iterations, [&](size_t& items)
+    {
+        items = 1;
+        return insert_table_record(k_staff_table_name, staff_columns, records[record_number++], &p_db);
+    });
+
+    results[3].name = "person_exists";
+    results[3].unit = "call";
+    record.generate(0, random);
+
+    success = success && count_allocations(results[3], options.iterations, [&](size_t& items)
+    {
+        items = 1;
+        return person_exists(k_staff_table_name, record.cols, &p_db);
+    });
+
+    lookup_cache& lookups = get_lookup_cache(p_db);
+    const size_t lookup_budget = lookups.budget();
+    size_t lookup_number = 0;
+
+    lookups.set_budget(0);
+
+    results[4].name = "last_name_lookup_uncached";
+    results[4].unit = "query";
+
+    success = success && count_allocations(results[4], options.iterations, [&](size_t& items)
+    {
+        items = 1;
+        return select_by_last_name(k_staff_table_name, last_names[lookup_number++ % last_names.size()], &p_db,
+                                   sink);
+    });
+
+    lookups.set_budget(lookup_budget);
+
+    results[5].name = "last_name_lookup";
+    results[5].unit = "query";
+
+    success = success && count_allocations(results[5], options.iterations, [&](size_t& items)
+    {
+        items = 1;
+        return select_by_last_name(k_staff_table_name, last_names[lookup_number++ % last_names.size()], &p_db,
+                                   sink);
+    });
+
+    results[6].name = "phone_update";
+    results[6].unit = "update";
+    std::vector<std::string> phone_nums;
+
+    for (size_t i = 0; i < options.iterations; ++i)
+    {
+        char phone_num[32];
+        std::snprintf(phone_num, sizeof(phone_num), "9-%08zu", i);
+        phone_nums.push_back(phone_num);
+    }
+
+    size_t update_number = 0;
+
+    success = success && count_allocations(results[6], options.iterations, [&](size_t& items)
+    {
+        items = 1;
+        return update_phone_number(k_staff_table_name, static_cast<int>(random() % rows) + 1,
+                                   phone_nums[update_number++], &p_db);
+    });
+
+    results[7].name = "full_print";
+    results[7].unit = "row";
+
+    success = success && count_allocations(results[7], 1, [&](size_t& items)
+    {
+        items = rows + options.iterations;
+        return print_table(k_staff_table_name, &p_db, sink);
+    });
+
+    close_database(&p_db);
+    close(null_fd);
+    remove_database(options.db_filename);
+    std::remove(csv_filename.c_str());
+
+    if (!success)
+    {
+        return false;
+    }
+
+    json << "{\"suite\": \"alloc\", \"rows\": " << rows << ", \"operations\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        json << (i > 0 ? ", " : "") << "{\"name\": \"" << results[i].name << "\", \"allocations\": " \
+             << results[i].allocations << ", \"per_" << results[i].unit << "\": " \
+             << static_cast<double>(results[i].allocations) / static_cast<double>(results[i].items) << "}";
+    }
+
+    json << "]}\n";
+
+    return true;
+}
+
+void print_usage(const char* program_name)
+{
+    std::cerr << "Usage: " << program_name << " [options]\n\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --suite <name>      The benchmark suite: ops, pool, async, group_commit, columnar,\n";
+    std::cerr << "                      startup, alloc, tables, incremental, parallel, functions,\n";
+    std::cerr << "                      search, pages or backup (default: ops).\n";
+    std::cerr << "  --scales <list>     Comma-separated list of generated rows of the ops, startup and\n";
+    std::cerr << "                      tables suites (default: 1e3,1e4,1e5).\n";
+    std::cerr << "  --iterations <n>    The number of timed point operations per scale (default: 200).\n";
+    std::cerr << "  --scan-iterations <n>\n";
+    std::cerr << "                      The number of timed full scans per scale (default: 5).\n";
+    std::cerr << "  --rows <n>          The number of generated rows of the pool, async, group_commit,\n";
+    std::cerr << "                      columnar, alloc, incremental, parallel, functions, search, pages\n";
+    std::cerr << "                      and backup suites (default: 100000).\n";
+    std::cerr << "  --duration <s>      The duration of a timed run in seconds (default: 2).\n";
+    std::cerr << "  --window <us>       The group commit window in microseconds (default: 0).\n";
+    std::cerr << "  --threads <list>    Comma-separated list of thread counts (default: 1,2,4,8).\n";
+    std::cerr << "  --db <file>         The benchmark database file (default: staff_bench.db).\n";
+    std::cerr << "  --instrument        Print the latencies of the operations and statements to stderr\n";
+    std::cerr << "                      at exit.\n";
+}
+
+bool parse_size_list(const char* text, std::vector<size_t>& values)
+{
+    values.clear();
+    std::stringstream ss(text);
+    std::string item;
+
+    while (std::getline(ss, item, ','))
+    {
+        // The values may be written in the scientific notation (e.g. 1e6).
+        char* end = nullptr;
+        const double value = std::strtod(item.c_str(), &end);
+
+        if (item.empty() || *end != '\0' || value < 1.0)
+        {
+            return false;
+        }
+
+        values.push_back(static_cast<size_t>(value));
+    }
+
+    return !values.empty();
+}
+
+bool parse_arguments(int argc, char** argv, bench_options& options)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--instrument") == 0)
+        {
+            options.instrument = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Error: unknown or incomplete argument \"" << argv[i] << "\".\n";
+            return false;
+        }
+
+        const char* name = argv[i];
+        const char* value = argv[++i];
+        char* end = nullptr;
+
+        if (std::strcmp(name, "--suite") == 0)
+        {
+            options.suite = value;
+        }
+        else if (std::strcmp(name, "--db") == 0)
+        {
+            options.db_filename = value;
+        }
+        else if (std::strcmp(name, "--rows") == 0)
+        {
+            options.rows = static_cast<size_t>(std::strtod(value, &end));
+
+            if (*end != '\0' || options.rows == 0)
+            {
+                std::cerr << "Error: invalid number of rows \"" << value << "\".\n";
+                return false;
+            }
+        }
+        else if (std::strcmp(name, "--duration") == 0)
+        {
+            options.duration_seconds = std::strtod(value, &end);
+
+            if (*end != '\0' || options.duration_seconds <= 0.0)
+            {
+                std::cerr << "Error: invalid duration \"" << value << "\".\n";
+                return false;
+            }
+        }
+        else if (std::strcmp(name, "--iterations") == 0 || std::strcmp(name, "--scan-iterations") == 0)
+        {
+            const size_t iterations = static_cast<size_t>(std::strtod(value, &end));
+
+            if (*end != '\0' || iterations == 0)
+            {
+                std::cerr << "Error: invalid number of iterations \"" << value << "\".\n";
+                return false;
+            }
+
+            (std::strcmp(name, "--iterations") == 0 ? options.iterations : options.scan_iterations) = iterations;
+        }
+        else if (std::strcmp(name, "--window") == 0)
+        {
+            options.window_us = static_cast<size_t>(std::strtod(value, &end));
+
+            if (*end != '\0')
+            {
+                std::cerr << "Error: invalid group commit window \"" << value << "\".\n";
+                return false;
+            }
+        }
+        else if (std::strcmp(name, "--scales") == 0)
+        {
+            if (!parse_size_list(value, options.scales))
+            {
+                std::cerr << "Error: invalid list of scales \"" << value << "\".\n";
+                return false;
+            }
+        }
+        else if (std::strcmp(name, "--threads") == 0)
+        {
+            if (!parse_size_list(value, options.threads))
+            {
+                std::cerr << "Error: invalid list of thread counts \"" << value << "\".\n";
+                return false;
+            }
+        }
+        else
+        {
+            std::cerr << "Error: unknown argument \"" << name << "\".\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    bench_options options;
+
+    if (!parse_arguments(argc, argv, options))
+    {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Only the JSON results go to stdout.
+    std::ostream json(std::cout.rdbuf());
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    if (options.instrument)
+    {
+        set_instrumentation_enabled(true);
+        dump_instrumentation_at_exit();
+    }
+
+    bool success = false;
+
+    if (options.suite == "ops")
+    {
+        success = run_ops_suite(options, json);
+    }
+    else if (options.suite == "pool")
+    {
+        success = run_pool_suite(options, json);
+    }
+    else if (options.suite == "async")
+    {
+        success = run_async_suite(options, json);
+    }
+    else if (options.suite == "group_commit")
+    {
+        success = run_group_commit_suite(options, json);
+    }
+    else if (options.suite == "startup")
+    {
+        success = run_startup_suite(options, json);
+    }
+    else if (options.suite == "alloc")
+    {
+        success = run_alloc_suite(options, json);
+    }
+    else if (options.suite == "columnar")
+    {
+        success = run_columnar_suite(options, json);
+    }
+    else if (options.suite == "tables")
+    {
+        success = run_tables_suite(options, json);
+    }
+    else if (options.suite == "incremental")
+    {
+        success = run_incremental_suite(options, json);
+    }
+    else if (options.suite == "parallel")
+    {
+        success = run_parallel_suite(options, json);
+    }
+    else if (options.suite == "functions")
+    {
+        success = run_functions_suite(options, json);
+    }
+    else if (options.suite == "search")
+    {
+        success = run_search_suite(options, json);
+    }
+    else if (options.suite == "pages")
+    {
+        success = run_pages_suite(options, json);
+    }
+    else if (options.suite == "backup")
+    {
+        success = run_backup_suite(options, json);
+    }
+    else
+    {
+        std::cerr << "Error: unknown benchmark suite \"" << options.suite << "\".\n";
+    }
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,489 @@
+/**
+ * @file    staff_snapshot.cpp
+ *
+ * @brief   Columnar in-memory snapshot of the Staff table for analytical scans.
+ *
+ * The scan kernels are compiled for several instruction sets by the target
+ * attributes and the best one supported by the CPU is selected at runtime, so
+ * the binary does not require AVX2.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "staff_snapshot.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STAFF_SNAPSHOT_X86 1
+#endif
+
+#include "row_cursor.hpp"
+#include "statement_cache.hpp"
+
+namespace
+{
+
+/**
+ * The row of the query materializing the snapshot.
+ */
+struct snapshot_row
+{
+    int64_t id = 0;
+    int64_t salary = 0;
+    std::string_view time_zone;
+
+    static void read(sqlite3_stmt* stmt, snapshot_row& row)
+    {
+        row.id = sqlite3_column_int64(stmt, 0);
+        row.salary = sqlite3_column_int64(stmt, 1);
+        row.time_zone = column_text_view(stmt, 2);
+    }
+};
+
+/**
+ * The partial aggregate of a kernel. The sum wraps around like the SIMD
+ * additions do, the minimum and maximum are valid only if count > 0.
+ */
+struct partial_aggregate
+{
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    int64_t min = std::numeric_limits<int64_t>::max();
+    int64_t max = std::numeric_limits<int64_t>::min();
+
+    void add(int64_t value)
+    {
+        ++count;
+        sum += static_cast<uint64_t>(value);
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+};
+
+using aggregate_kernel = partial_aggregate (*)(const int64_t*, size_t, int64_t, int64_t);
+// The kernel sets the bit i of the bitmap if the value i is in the range.
+using filter_kernel = void (*)(const int64_t*, size_t, int64_t, int64_t, uint64_t*);
+
+partial_aggregate aggregate_scalar(const int64_t* values, size_t count, int64_t low, int64_t high)
+{
+    partial_aggregate result;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (values[i] >= low && values[i] <= high)
+        {
+            result.add(values[i]);
+        }
+    }
+
+    return result;
+}
+
+void filter_scalar(const int64_t* values, size_t count, int64_t low, int64_t high, uint64_t* bitmap)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (values[i] >= low && values[i] <= high)
+        {
+            bitmap[i / 64] |= uint64_t(1) << (i % 64);
+        }
+    }
+}
+
+#ifdef STAFF_SNAPSHOT_X86
+
+__attribute__((target("sse4.2")))
+partial_aggregate aggregate_sse42(const int64_t* values, size_t count, int64_t low, int64_t high)
+{
+    const __m128i v_low = _mm_set1_epi64x(low);
+    const __m128i v_high = _mm_set1_epi64x(high);
+    __m128i v_count = _mm_setzero_si128();
+    __m128i v_sum = _mm_setzero_si128();
+    __m128i v_min = _mm_set1_epi64x(std::numeric_limits<int64_t>::max());
+    __m128i v_max = _mm_set1_epi64x(std::numeric_limits<int64_t>::min());
+
+    size_t i = 0;
+
+    for (; i + 2 <= count; i += 2)
+    {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        const __m128i outside = _mm_or_si128(_mm_cmpgt_epi64(v_low, x), _mm_cmpgt_epi64(x, v_high));
+        const __m128i inside = _mm_xor_si128(outside, _mm_set1_epi64x(-1));
+
+        // The inside lanes are -1, so they are subtracted.
+        v_count = _mm_sub_epi64(v_count, inside);
+        v_sum = _mm_add_epi64(v_sum, _mm_and_si128(inside, x));
+        v_min = _mm_blendv_epi8(v_min, x, _mm_and_si128(inside, _mm_cmpgt_epi64(v_min, x)));
+        v_max = _mm_blendv_epi8(v_max, x, _mm_and_si128(inside, _mm_cmpgt_epi64(x, v_max)));
+    }
+
+    alignas(16) int64_t lanes[4][2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[0]), v_count);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[1]), v_sum);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[2]), v_min);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes[3]), v_max);
+
+    partial_aggregate result = aggregate_scalar(values + i, count - i, low, high);
+
+    for (int lane = 0; lane < 2; ++lane)
+    {
+        result.count += static_cast<uint64_t>(lanes[0][lane]);
+        result.sum += static_cast<uint64_t>(lanes[1][lane]);
+        result.min = std::min(result.min, lanes[2][lane]);
+        result.max = std::max(result.max, lanes[3][lane]);
+    }
+
+    return result;
+}
+
+__attribute__((target("sse4.2")))
+void filter_sse42(const int64_t* values, size_t count, int64_t low, int64_t high, uint64_t* bitmap)
+{
+    const __m128i v_low = _mm_set1_epi64x(low);
+    const __m128i v_high = _mm_set1_epi64x(high);
+
+    size_t i = 0;
+
+    for (; i + 64 <= count; i += 64)
+    {
+        uint64_t word = 0;
+
+        for (size_t j = 0; j < 64; j += 2)
+        {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + j));
+            const __m128i outside = _mm_or_si128(_mm_cmpgt_epi64(v_low, x), _mm_cmpgt_epi64(x, v_high));
+            const uint64_t outside_bits = static_cast<uint64_t>(_mm_movemask_pd(_mm_castsi128_pd(outside)));
+
+            word |= (~outside_bits & 0x3) << j;
+        }
+
+        bitmap[i / 64] = word;
+    }
+
+    filter_scalar(values + i, count - i, low, high, bitmap + i / 64);
+}
+
+__attribute__((target("avx2")))
+partial_aggregate aggregate_avx2(const int64_t* values, size_t count, int64_t low, int64_t high)
+{
+    const __m256i v_low = _mm256_set1_epi64x(low);
+    const __m256i v_high = _mm256_set1_epi64x(high);
+    __m256i v_count = _mm256_setzero_si256();
+    __m256i v_sum = _mm256_setzero_si256();
+    __m256i v_min = _mm256_set1_epi64x(std::numeric_limits<int64_t>::max());
+    __m256i v_max = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+        const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi64(v_low, x), _mm256_cmpgt_epi64(x, v_high));
+        const __m256i inside = _mm256_xor_si256(outside, _mm256_set1_epi64x(-1));
+
+        // The inside lanes are -1, so they are subtracted.
+        v_count = _mm256_sub_epi64(v_count, inside);
+        v_sum = _mm256_add_epi64(v_sum, _mm256_and_si256(inside, x));
+        v_min = _mm256_blendv_epi8(v_min, x, _mm256_and_si256(inside, _mm256_cmpgt_epi64(v_min, x)));
+        v_max = _mm256_blendv_epi8(v_max, x, _mm256_and_si256(inside, _mm256_cmpgt_epi64(x, v_max)));
+    }
+
+    alignas(32) int64_t lanes[4][4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[0]), v_count);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[1]), v_sum);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[2]), v_min);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes[3]), v_max);
+
+    partial_aggregate result = aggregate_scalar(values + i, count - i, low, high);
+
+    for (int lane = 0; lane < 4; ++lane)
+    {
+        result.count += static_cast<uint64_t>(lanes[0][lane]);
+        result.sum += static_cast<uint64_t>(lanes[1][lane]);
+        result.min = std::min(result.min, lanes[2][lane]);
+        result.max = std::max(result.max, lanes[3][lane]);
+    }
+
+    return result;
+}
+
+__attribute__((target("avx2")))
+void filter_avx2(const int64_t* values, size_t count, int64_t low, int64_t high, uint64_t* bitmap)
+{
+    const __m256i v_low = _mm256_set1_epi64x(low);
+    const __m256i v_high = _mm256_set1_epi64x(high);
+
+    size_t i = 0;
+
+    for (; i + 64 <= count; i += 64)
+    {
+        uint64_t word = 0;
+
+        for (size_t j = 0; j < 64; j += 4)
+        {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i + j));
+            const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi64(v_low, x), _mm256_cmpgt_epi64(x, v_high));
+            const uint64_t outside_bits = static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(outside)));
+
+            word |= (~outside_bits & 0xf) << j;
+        }
+
+        bitmap[i / 64] = word;
+    }
+
+    filter_scalar(values + i, count - i, low, high, bitmap + i / 64);
+}
+
+#endif // STAFF_SNAPSHOT_X86
+
+std::atomic<int>& active_level()
+{
+    static std::atomic<int> level(static_cast<int>(detect_simd_level()));
+    return level;
+}
+
+aggregate_kernel select_aggregate_kernel()
+{
+#ifdef STAFF_SNAPSHOT_X86
+    switch (get_simd_level())
+    {
+        case simd_level::avx2:
+            return aggregate_avx2;
+        case simd_level::sse42:
+            return aggregate_sse42;
+        default:
+            break;
+    }
+#endif
+
+    return aggregate_scalar;
+}
+
+filter_kernel select_filter_kernel()
+{
+#ifdef STAFF_SNAPSHOT_X86
+    switch (get_simd_level())
+    {
+        case simd_level::avx2:
+            return filter_avx2;
+        case simd_level::sse42:
+            return filter_sse42;
+        default:
+            break;
+    }
+#endif
+
+    return filter_scalar;
+}
+
+/**
+ * Function which computes the bitmap of the rows with the salary in the
+ * range.
+ */
+void filter_salaries(const staff_snapshot& snapshot, int64_t min_salary, int64_t max_salary,
+                     std::vector<uint64_t>& bitmap)
+{
+    bitmap.assign((snapshot.size() + 63) / 64, 0);
+
+    if (min_salary <= max_salary)
+    {
+        select_filter_kernel()(snapshot.salaries.data(), snapshot.size(), min_salary, max_salary, bitmap.data());
+    }
+}
+
+salary_aggregate finish_aggregate(const partial_aggregate& partial)
+{
+    salary_aggregate result;
+
+    if (partial.count > 0)
+    {
+        result.count = partial.count;
+        result.sum = static_cast<int64_t>(partial.sum);
+        result.min = partial.min;
+        result.max = partial.max;
+    }
+
+    return result;
+}
+
+} // namespace
+
+bool build_staff_snapshot(const std::string& table_name, sqlite3** p_db, staff_snapshot& snapshot)
+{
+    snapshot = staff_snapshot();
+
+    cached_statement stmt(get_statement_cache(*p_db),
+                          "SELECT ID, Salary, TimeZone FROM " + table_name + " ORDER BY ID;");
+
+    if (!stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (snapshot build).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    std::unordered_map<std::string, uint32_t> codes;
+    row_cursor<snapshot_row> cursor(stmt.get());
+
+    for (const snapshot_row& row : cursor)
+    {
+        uint32_t code = k_null_code;
+
+        if (row.time_zone.data() != nullptr)
+        {
+            auto inserted = codes.emplace(std::string(row.time_zone), static_cast<uint32_t>(codes.size()));
+
+            if (inserted.second)
+            {
+                snapshot.time_zone_dictionary.push_back(inserted.first->first);
+            }
+
+            code = inserted.first->second;
+        }
+
+        snapshot.ids.push_back(row.id);
+        snapshot.salaries.push_back(row.salary);
+        snapshot.time_zone_codes.push_back(code);
+    }
+
+    if (!cursor.ok())
+    {
+        std::cerr << "Error: executing SQL statement failed (snapshot build).\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        snapshot = staff_snapshot();
+        return false;
+    }
+
+    return true;
+}
+
+simd_level detect_simd_level()
+{
+#ifdef STAFF_SNAPSHOT_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return simd_level::avx2;
+    }
+
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return simd_level::sse42;
+    }
+#endif
+
+    return simd_level::scalar;
+}
+
+simd_level set_simd_level(simd_level level)
+{
+    const simd_level supported = detect_simd_level();
+    const simd_level used = (static_cast<int>(level) < static_cast<int>(supported)) ? level : supported;
+
+    active_level().store(static_cast<int>(used), std::memory_order_relaxed);
+
+    return used;
+}
+
+simd_level get_simd_level()
+{
+    return static_cast<simd_level>(active_level().load(std::memory_order_relaxed));
+}
+
+const char* simd_level_name(simd_level level)
+{
+    switch (level)
+    {
+        case simd_level::avx2:
+            return "avx2";
+        case simd_level::sse42:
+            return "sse4.2";
+        default:
+            return "scalar";
+    }
+}
+
+salary_aggregate aggregate_salaries(const staff_snapshot& snapshot, int64_t min_salary, int64_t max_salary)
+{
+    if (min_salary > max_salary)
+    {
+        return salary_aggregate();
+    }
+
+    return finish_aggregate(select_aggregate_kernel()(snapshot.salaries.data(), snapshot.size(),
+                                                      min_salary, max_salary));
+}
+
+void select_salary_range(const staff_snapshot& snapshot, int64_t min_salary, int64_t max_salary,
+                         std::vector<int64_t>& ids)
+{
+    std::vector<uint64_t> bitmap;
+    filter_salaries(snapshot, min_salary, max_salary, bitmap);
+
+    ids.clear();
+
+    for (size_t w = 0; w < bitmap.size(); ++w)
+    {
+        for (uint64_t word = bitmap[w]; word != 0; word &= word - 1)
+        {
+            ids.push_back(snapshot.ids[w * 64 + static_cast<size_t>(__builtin_ctzll(word))]);
+        }
+    }
+}
+
+void group_salaries_by_time_zone(const staff_snapshot& snapshot, int64_t min_salary, int64_t max_salary,
+                                 std::vector<time_zone_aggregate>& groups)
+{
+    std::vector<uint64_t> bitmap;
+    filter_salaries(snapshot, min_salary, max_salary, bitmap);
+
+    // The last partial aggregate belongs to the NULL time zone.
+    const size_t null_group = snapshot.time_zone_dictionary.size();
+    std::vector<partial_aggregate> partials(null_group + 1);
+
+    for (size_t w = 0; w < bitmap.size(); ++w)
+    {
+        for (uint64_t word = bitmap[w]; word != 0; word &= word - 1)
+        {
+            const size_t row = w * 64 + static_cast<size_t>(__builtin_ctzll(word));
+            const uint32_t code = snapshot.time_zone_codes[row];
+
+            partials[code == k_null_code ? null_group : code].add(snapshot.salaries[row]);
+        }
+    }
+
+    groups.clear();
+
+    for (size_t code = 0; code < partials.size(); ++code)
+    {
+        if (partials[code].count == 0)
+        {
+            continue;
+        }
+
+        time_zone_aggregate group;
+        group.is_null = (code == null_group);
+        group.time_zone = group.is_null ? std::string() : snapshot.time_zone_dictionary[code];
+        group.salaries = finish_aggregate(partials[code]);
+        groups.push_back(std::move(group));
+    }
+
+    // The order of SQLite GROUP BY, NULL first and then by the value.
+    std::sort(groups.begin(), groups.end(),
+              [](const time_zone_aggregate& a, const time_zone_aggregate& b)
+              {
+                  if (a.is_null != b.is_null)
+                  {
+                      return a.is_null;
+                  }
+
+                  return a.time_zone < b.time_zone;
+              });
+}
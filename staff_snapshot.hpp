@@ -0,0 +1,118 @@
+/**
+ * @file    staff_snapshot.hpp
+ *
+ * @brief   Columnar in-memory snapshot of the Staff table for analytical scans.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef STAFF_SNAPSHOT_HPP
+#define STAFF_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+
+// The dictionary code of a NULL value.
+constexpr uint32_t k_null_code = std::numeric_limits<uint32_t>::max();
+
+/**
+ * The instruction sets of the scan kernels.
+ */
+enum class simd_level
+{
+    scalar,
+    sse42,
+    avx2
+};
+
+/**
+ * The structure-of-arrays copy of the analytical Staff columns. The row i of
+ * the snapshot is stored at the index i of every column, the rows are in the
+ * ID order. The TimeZone values are dictionary-encoded.
+ */
+struct staff_snapshot
+{
+    std::vector<int64_t> ids;
+    std::vector<int64_t> salaries;
+    std::vector<uint32_t> time_zone_codes;
+    std::vector<std::string> time_zone_dictionary;
+
+    size_t size() const
+    {
+        return ids.size();
+    }
+};
+
+/**
+ * The aggregate of the salaries of the matching rows. The minimum and the
+ * maximum are zero if no row matches.
+ */
+struct salary_aggregate
+{
+    uint64_t count = 0;
+    int64_t sum = 0;
+    int64_t min = 0;
+    int64_t max = 0;
+};
+
+/**
+ * The aggregate of the salaries of a single time zone.
+ */
+struct time_zone_aggregate
+{
+    std::string time_zone;
+    bool is_null = false;
+    salary_aggregate salaries;
+};
+
+/**
+ * Function which materializes the ID, Salary and TimeZone columns of the
+ * table into the snapshot.
+ *
+ * @param table_name The name of a table.
+ * @param p_db       Database connection pointer.
+ * @param snapshot   The built snapshot.
+ * @return           True if the snapshot was built successfully, false
+ *                   otherwise.
+ */
+bool build_staff_snapshot(const std::string& table_name, sqlite3** p_db, staff_snapshot& snapshot);
+
+/**
+ * Returns the best instruction set supported by the CPU.
+ */
+simd_level detect_simd_level();
+
+/**
+ * Limits the instruction set used by the scan kernels, the level not
+ * supported by the CPU is lowered to the supported one.
+ *
+ * @param level The highest allowed instruction set.
+ * @return      The instruction set used from now on.
+ */
+simd_level set_simd_level(simd_level level);
+simd_level get_simd_level();
+const char* simd_level_name(simd_level level);
+
+/**
+ * The scans of the salaries in the range [min_salary, max_salary].
+ *
+ * The results are equal to the SQL queries:
+ *     SELECT COUNT(*), SUM(Salary), MIN(Salary), MAX(Salary) FROM Staff
+ *         WHERE Salary BETWEEN ? AND ?;
+ *     SELECT ID FROM Staff WHERE Salary BETWEEN ? AND ? ORDER BY ID;
+ *     SELECT TimeZone, COUNT(*), SUM(Salary), MIN(Salary), MAX(Salary)
+ *         FROM Staff WHERE Salary BETWEEN ? AND ? GROUP BY TimeZone;
+ * The groups are ordered like the SQLite GROUP BY output, the NULL time zone
+ * first and then by the time zone, the empty groups are omitted.
+ */
+salary_aggregate aggregate_salaries(const staff_snapshot& snapshot, int64_t min_salary, int64_t max_salary);
+void select_salary_range(const staff_snapshot& snapshot, int64_t min_salary, int64_t max_salary,
+                         std::vector<int64_t>& ids);
+void group_salaries_by_time_zone(const staff_snapshot& snapshot, int64_t min_salary, int64_t max_salary,
+                                 std::vector<time_zone_aggregate>& groups);
+
+#endif // STAFF_SNAPSHOT_HPP
@@ -0,0 +1,172 @@
+/**
+ * @file    statement_cache.cpp
+ *
+ * @brief   Connection-scoped LRU cache of prepared SQLite statements.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "statement_cache.hpp"
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+#include "connection_registry.hpp"
+
+namespace
+{
+
+// The caches of all opened connections.
+connection_registry<statement_cache> registry;
+std::atomic<size_t> registry_capacity(k_default_statement_cache_capacity);
+
+} // namespace
+
+statement_cache::statement_cache(sqlite3* db, size_t capacity)
+  : db_(db), capacity_(capacity > 0 ? capacity : 1), hits_(0), misses_(0)
+{
+}
+
+statement_cache::~statement_cache()
+{
+    clear();
+}
+
+statement_cache::entry* statement_cache::checkout(const std::string& sql)
+{
+    auto it = index_.find(sql);
+
+    // A statement in use is not shared, the SQL text gets another entry.
+    if (it != index_.end() && it->second->users == 0)
+    {
+        ++hits_;
+
+        // Move the entry to the front of the LRU list.
+        lru_.splice(lru_.begin(), lru_, it->second);
+
+        entry& cached = *it->second;
+        ++cached.users;
+
+        return &cached;
+    }
+
+    ++misses_;
+
+    sqlite3_stmt* stmt = nullptr;
+    int status = sqlite3_prepare_v3(db_, sql.c_str(), static_cast<int>(sql.size()), SQLITE_PREPARE_PERSISTENT,
+                                    &stmt, nullptr);
+
+    if (status != SQLITE_OK)
+    {
+        std::cerr << "Error: preparing SQL statement failed (" << sql << ").\n";
+        std::cerr << "Error message: " << sqlite3_errmsg(db_) << "\n";
+        sqlite3_finalize(stmt);
+        return nullptr;
+    }
+
+    evict(capacity_ - 1);
+
+    lru_.push_front(entry{sql, stmt, 1});
+    index_[sql] = lru_.begin();
+
+    return &lru_.front();
+}
+
+void statement_cache::release(entry* used)
+{
+    sqlite3_reset(used->stmt);
+    sqlite3_clear_bindings(used->stmt);
+    --used->users;
+
+    // The cache grew over its capacity while the statements were in use.
+    if (lru_.size() > capacity_)
+    {
+        evict(capacity_);
+    }
+}
+
+void statement_cache::evict(size_t max_size)
+{
+    auto it = lru_.end();
+
+    while (lru_.size() > max_size && it != lru_.begin())
+    {
+        --it;
+
+        if (it->users > 0)
+        {
+            continue;
+        }
+
+        // The index may point to a newer entry of the same SQL text.
+        auto indexed = index_.find(it->sql);
+
+        if (indexed != index_.end() && indexed->second == it)
+        {
+            index_.erase(indexed);
+        }
+
+        sqlite3_finalize(it->stmt);
+        it = lru_.erase(it);
+    }
+}
+
+void statement_cache::clear()
+{
+    for (const entry& cached : lru_)
+    {
+        sqlite3_finalize(cached.stmt);
+    }
+
+    lru_.clear();
+    index_.clear();
+}
+
+size_t statement_cache::size() const
+{
+    return lru_.size();
+}
+
+size_t statement_cache::capacity() const
+{
+    return capacity_;
+}
+
+uint64_t statement_cache::hits() const
+{
+    return hits_;
+}
+
+uint64_t statement_cache::misses() const
+{
+    return misses_;
+}
+
+cached_statement::cached_statement(statement_cache& cache, const std::string& sql)
+  : cache_(cache), entry_(cache.checkout(sql))
+{
+}
+
+cached_statement::~cached_statement()
+{
+    if (entry_ != nullptr)
+    {
+        cache_.release(entry_);
+    }
+}
+
+void set_statement_cache_capacity(size_t capacity)
+{
+    registry_capacity = capacity;
+}
+
+statement_cache& get_statement_cache(sqlite3* db)
+{
+    return registry.get(db, [db] { return std::make_unique<statement_cache>(db, registry_capacity.load()); });
+}
+
+void release_statement_cache(sqlite3* db)
+{
+    registry.release(db);
+}
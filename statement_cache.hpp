@@ -0,0 +1,151 @@
+/**
+ * @file    statement_cache.hpp
+ *
+ * @brief   Connection-scoped LRU cache of prepared SQLite statements.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef STATEMENT_CACHE_HPP
+#define STATEMENT_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <sqlite3.h>
+
+// The default maximum number of prepared statements kept per connection.
+constexpr size_t k_default_statement_cache_capacity = 32;
+
+/**
+ * The LRU cache of prepared statements keyed by the SQL text.
+ *
+ * The cache owns all its statements and finalizes them when an entry is
+ * evicted, when the cache is cleared and when the cache is destroyed. The
+ * statements are checked out by the cached_statement wrapper. A checked out
+ * statement is never evicted, so the cache may grow over its capacity while
+ * more statements are in use at once, and it shrinks back when they are
+ * returned. A statement checked out again while it is in use (e.g. by a
+ * nested query) is prepared once more, so the users do not share it.
+ */
+class statement_cache
+{
+public:
+    statement_cache(sqlite3* db, size_t capacity);
+    ~statement_cache();
+
+    statement_cache(const statement_cache&) = delete;
+    statement_cache& operator=(const statement_cache&) = delete;
+
+    /**
+     * Finalizes all cached statements. No statement may be checked out.
+     */
+    void clear();
+
+    size_t size() const;
+    size_t capacity() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    friend class cached_statement;
+
+    struct entry
+    {
+        std::string sql;
+        sqlite3_stmt* stmt;
+        // The number of the cached_statement wrappers using the statement.
+        size_t users;
+    };
+
+    /**
+     * Returns the entry of the prepared statement for the SQL text and marks
+     * it as used. If the statement is not cached yet (or it is in use), it is
+     * prepared and the least recently used statements not in use may be
+     * evicted.
+     *
+     * @param sql The SQL text of the statement.
+     * @return    The entry, nullptr if the preparation failed.
+     */
+    entry* checkout(const std::string& sql);
+
+    /**
+     * Returns the statement of the entry to the cache. The statement is reset
+     * and its bindings are cleared.
+     */
+    void release(entry* used);
+
+    /**
+     * Finalizes the least recently used statements not in use until the
+     * cache has at most the given number of statements.
+     */
+    void evict(size_t max_size);
+
+    sqlite3* db_;
+    size_t capacity_;
+    uint64_t hits_;
+    uint64_t misses_;
+    // The most recently used statement is at the front of the list.
+    std::list<entry> lru_;
+    std::unordered_map<std::string, std::list<entry>::iterator> index_;
+};
+
+/**
+ * The RAII wrapper of a statement acquired from the statement cache.
+ *
+ * The statement is reset and its bindings are cleared when the wrapper goes
+ * out of scope, so the statement does not hold any lock or any reference to
+ * the bound values after the operation ends.
+ */
+class cached_statement
+{
+public:
+    cached_statement(statement_cache& cache, const std::string& sql);
+    ~cached_statement();
+
+    cached_statement(const cached_statement&) = delete;
+    cached_statement& operator=(const cached_statement&) = delete;
+
+    sqlite3_stmt* get() const
+    {
+        return entry_ ? entry_->stmt : nullptr;
+    }
+
+    explicit operator bool() const
+    {
+        return entry_ != nullptr;
+    }
+
+private:
+    statement_cache& cache_;
+    statement_cache::entry* entry_;
+};
+
+/**
+ * Sets the capacity used for the statement caches created from now on.
+ *
+ * @param capacity The maximum number of statements cached per connection.
+ */
+void set_statement_cache_capacity(size_t capacity);
+
+/**
+ * Returns the statement cache of the database connection. The cache is
+ * created on the first use. The caches recently looked up by the thread are
+ * returned without a lock (see connection_registry).
+ *
+ * @param db Database connection.
+ * @return   The statement cache bound to the connection.
+ */
+statement_cache& get_statement_cache(sqlite3* db);
+
+/**
+ * Finalizes all statements of the database connection and destroys its cache.
+ * It has to be called before the connection is closed.
+ *
+ * @param db Database connection.
+ */
+void release_statement_cache(sqlite3* db);
+
+#endif // STATEMENT_CACHE_HPP
@@ -0,0 +1,441 @@
+/**
+ * @file    table_schema.cpp
+ *
+ * @brief   Compile-time description of the tables and the code generated from it.
+ *
+ * @author  David Chocholaty
+ */
+
+#include "table_schema.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "row_cursor.hpp"
+#include "schemas.hpp"
+#include "staff.hpp"
+#include "statement_cache.hpp"
+
+namespace
+{
+
+// The schemas of all known tables.
+const table_schema* const k_table_schemas[] = {&k_staff_schema, &k_department_schema, &k_payroll_schema};
+
+constexpr size_t k_table_schema_count = sizeof(k_table_schemas) / sizeof(k_table_schemas[0]);
+
+// The SQL text generated for the known schemas, in the order of
+// k_table_schemas. Each slot is written once, so it is read without a lock.
+std::once_flag table_sql_once[k_table_schema_count];
+std::unique_ptr<table_sql> table_sql_slots[k_table_schema_count];
+
+// The SQL text generated for any other schema.
+std::mutex registry_mutex;
+std::unordered_map<const table_schema*, std::unique_ptr<table_sql>> registry;
+
+/**
+ * Function which parses the whole value as a decimal integer.
+ */
+bool parse_integer(std::string_view value, int64_t& number)
+{
+    const char* end = value.data() + value.size();
+    const std::from_chars_result result = std::from_chars(value.data(), end, number);
+
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+/**
+ * Function which writes the current row of the statement selecting the table
+ * columns (see table_sql::select) into the query output. The integer columns
+ * are read natively and the text columns as views over the row buffer.
+ *
+ * @param stmt   The statement positioned on a row.
+ * @param schema The table schema.
+ * @param sql    The SQL text generated from the schema.
+ * @param output The output of the query.
+ */
+void print_schema_row(sqlite3_stmt* stmt, const table_schema& schema, const table_sql& sql, query_output& output)
+{
+    output.begin_row(sql.column_names.data(), sql.column_names.size());
+
+    for (size_t i = 0; i < schema.column_count; ++i)
+    {
+        const int column = static_cast<int>(i);
+
+        if (schema.columns[i].type == column_type::integer && sqlite3_column_type(stmt, column) != SQLITE_NULL)
+        {
+            output.write_int(sqlite3_column_int64(stmt, column));
+        }
+        else
+        {
+            output.write_text(column_text_view(stmt, column));
+        }
+    }
+
+    output.end_row();
+}
+
+/**
+ * Function which checks if the column is one of the comma-separated columns.
+ */
+bool is_listed_column(std::string_view columns, std::string_view column)
+{
+    while (!columns.empty())
+    {
+        const size_t comma = columns.find(',');
+        std::string_view listed = columns.substr(0, comma);
+
+        while (!listed.empty() && listed.front() == ' ')
+        {
+            listed.remove_prefix(1);
+        }
+
+        while (!listed.empty() && listed.back() == ' ')
+        {
+            listed.remove_suffix(1);
+        }
+
+        if (listed == column)
+        {
+            return true;
+        }
+
+        columns = (comma == std::string_view::npos) ? std::string_view() : columns.substr(comma + 1);
+    }
+
+    return false;
+}
+
+/**
+ * Function which generates the upsert of the table, see table_sql::upsert.
+ */
+std::string generate_upsert_sql(const table_schema& schema, const std::string& insert)
+{
+    if (schema.key.empty())
+    {
+        return insert + " ON CONFLICT DO NOTHING";
+    }
+
+    std::string assignments;
+    std::string changes;
+
+    for (size_t i = 0; i < schema.record_column_count; ++i)
+    {
+        const std::string_view column = schema.record_column(i).name;
+
+        if (is_listed_column(schema.key, column))
+        {
+            continue;
+        }
+
+        const char* separator = assignments.empty() ? "" : ", ";
+
+        assignments.append(separator).append(column).append(" = excluded.").append(column);
+        changes.append(changes.empty() ? "" : " OR ").append(column).append(" IS NOT excluded.").append(column);
+    }
+
+    std::string upsert = insert;
+    upsert.append(" ON CONFLICT (").append(schema.key).append(")");
+
+    if (assignments.empty())
+    {
+        return upsert + " DO NOTHING";
+    }
+
+    upsert.append(" DO UPDATE SET ").append(assignments).append(" WHERE ").append(changes);
+
+    return upsert;
+}
+
+/**
+ * Function which prefixes every one of the comma-separated columns, e.g.
+ * "new.FirstName, new.LastName".
+ */
+std::string prefixed_columns(std::string_view columns, std::string_view prefix)
+{
+    std::string prefixed;
+
+    while (!columns.empty())
+    {
+        const size_t comma = columns.find(',');
+        std::string_view column = columns.substr(0, comma);
+
+        while (!column.empty() && column.front() == ' ')
+        {
+            column.remove_prefix(1);
+        }
+
+        prefixed.append(prefixed.empty() ? "" : ", ").append(prefix).append(column);
+        columns = (comma == std::string_view::npos) ? std::string_view() : columns.substr(comma + 1);
+    }
+
+    return prefixed;
+}
+
+/**
+ * Function which generates the full-text search index of the table, see
+ * table_sql::search_index.
+ *
+ * The FTS5 table stores only the index, the indexed values are read from the
+ * table by the rowid. The triggers insert the values of the inserted rows
+ * into the index and remove the old values of the deleted rows, the updated
+ * rows are removed and inserted again. The prefix indexes of one to three
+ * characters serve the short prefixes of the type-ahead search.
+ */
+void generate_search_sql(const table_schema& schema, table_sql& sql)
+{
+    const std::string table(schema.name);
+    const std::string& search = sql.search_table;
+    const std::string columns(schema.search);
+    const std::string insert_new = "INSERT INTO " + search + " (rowid, " + columns + ") VALUES (new.rowid, " \
+                                   + prefixed_columns(schema.search, "new.") + ");";
+    const std::string delete_old = "INSERT INTO " + search + " (" + search + ", rowid, " + columns + \
+                                   ") VALUES ('delete', old.rowid, " + prefixed_columns(schema.search, "old.") + ");";
+
+    sql.search_index.push_back("CREATE VIRTUAL TABLE IF NOT EXISTS " + search + " USING fts5(" + columns + \
+                               ", content='" + table + "', content_rowid='rowid', prefix='1 2 3');");
+    sql.search_index.push_back("CREATE TRIGGER IF NOT EXISTS " + search + "Insert AFTER INSERT ON " + table + \
+                               " BEGIN " + insert_new + " END;");
+    sql.search_index.push_back("CREATE TRIGGER IF NOT EXISTS " + search + "Delete AFTER DELETE ON " + table + \
+                               " BEGIN " + delete_old + " END;");
+    sql.search_index.push_back("CREATE TRIGGER IF NOT EXISTS " + search + "Update AFTER UPDATE OF " + columns + \
+                               " ON " + table + " BEGIN " + delete_old + " " + insert_new + " END;");
+}
+
+/**
+ * Function which creates the full-text search index of the table (see
+ * generate_search_sql). The index created for a table with rows is built
+ * from them.
+ */
+bool create_search_index(const table_sql& sql, sqlite3** p_db)
+{
+    cached_statement exists_stmt(get_statement_cache(*p_db), "SELECT 1 FROM sqlite_master WHERE name = ?;");
+
+    if (!exists_stmt)
+    {
+        std::cerr << "Error: preparing SQL statement failed (search index existence check).\n";
+        return false;
+    }
+
+    sqlite3_bind_text(exists_stmt.get(), 1, sql.search_table.data(), static_cast<int>(sql.search_table.size()),
+                      SQLITE_STATIC);
+
+    const bool exists = (sqlite3_step(exists_stmt.get()) == SQLITE_ROW);
+    std::vector<std::string> statements = sql.search_index;
+
+    if (!exists)
+    {
+        statements.push_back("INSERT INTO " + sql.search_table + " (" + sql.search_table + ") VALUES ('rebuild');");
+    }
+
+    for (const std::string& statement : statements)
+    {
+        char* err_msg = nullptr;
+
+        if (sqlite3_exec(*p_db, statement.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
+        {
+            std::cerr << "Error: executing SQL statement failed (search index creation).\n";
+            std::cerr << "Error message: " << err_msg << "\n";
+            sqlite3_free(err_msg);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Function which generates the SQL text of the table.
+ */
+std::unique_ptr<table_sql> generate_table_sql(const table_schema& schema)
+{
+    std::unique_ptr<table_sql> sql(new table_sql());
+
+    for (size_t i = 0; i < schema.column_count; ++i)
+    {
+        const column_def& column = schema.columns[i];
+        const char* separator = (i > 0) ? ", " : "";
+
+        sql->column_definitions.append(separator).append(column.name).append(" ").append(column.declaration);
+        sql->select_columns.append(separator).append(column.name);
+        // The names are the string literals of the schema.
+        sql->column_names.push_back(column.name.data());
+    }
+
+    for (size_t i = 0; i < schema.index_count; ++i)
+    {
+        sql->indexes.emplace_back(schema.indexes[i]);
+    }
+
+    std::string placeholders;
+
+    for (size_t i = 0; i < schema.record_column_count; ++i)
+    {
+        const char* separator = (i > 0) ? ", " : "";
+
+        sql->record_columns.append(separator).append(schema.record_column(i).name);
+        placeholders.append(separator).append("?");
+    }
+
+    sql->select = "SELECT " + sql->select_columns + " FROM ";
+    sql->select.append(schema.name);
+
+    sql->insert = "INSERT INTO ";
+    sql->insert.append(schema.name).append(" (").append(sql->record_columns).append(") VALUES (");
+    sql->insert.append(placeholders).append(")");
+
+    sql->upsert = generate_upsert_sql(schema, sql->insert);
+
+    if (!schema.search.empty())
+    {
+        sql->search_table = search_table_name(schema.name);
+        generate_search_sql(schema, *sql);
+    }
+
+    return sql;
+}
+
+} // namespace
+
+const table_sql& get_table_sql(const table_schema& schema)
+{
+    for (size_t i = 0; i < k_table_schema_count; ++i)
+    {
+        if (k_table_schemas[i] == &schema)
+        {
+            std::call_once(table_sql_once[i], [&schema, i] { table_sql_slots[i] = generate_table_sql(schema); });
+            return *table_sql_slots[i];
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::unique_ptr<table_sql>& sql = registry[&schema];
+
+    if (!sql)
+    {
+        sql = generate_table_sql(schema);
+    }
+
+    return *sql;
+}
+
+const table_schema* find_table_schema(std::string_view table_name)
+{
+    for (const table_schema* schema : k_table_schemas)
+    {
+        if (schema->name == table_name)
+        {
+            return schema;
+        }
+    }
+
+    return nullptr;
+}
+
+std::string search_table_name(std::string_view table_name)
+{
+    return std::string(table_name) + "Search";
+}
+
+/**
+ * The function creates the table and its secondary indexes described by the
+ * schema (see the create_table function). The full-text search index of the
+ * search columns is created with its triggers too.
+ *
+ * @param schema The table schema.
+ * @param p_db   Database connection pointer.
+ * @return       True if all sub-tasks were done successfully, false if an
+ *               error occurs.
+ */
+bool create_table(const table_schema& schema, sqlite3** p_db)
+{
+    const table_sql& sql = get_table_sql(schema);
+
+    if (!create_table(schema.name, sql.column_definitions, sql.indexes, p_db))
+    {
+        return false;
+    }
+
+    return sql.search_table.empty() || create_search_index(sql, p_db);
+}
+
+/**
+ * The function binds the record values to the parameters of the INSERT
+ * statement of the table (see table_sql::insert). The values of the integer
+ * columns are bound as integers, so SQLite does not convert them, a value
+ * which is not an integer is bound as text and the column affinity decides.
+ * An empty value of an integer column is bound as NULL, an empty value of a
+ * text column as an empty string like the records inserted by the SQL text,
+ * so it still satisfies NOT NULL and is checked by UNIQUE. The text values
+ * are bound statically, so the memory the slices point into has to outlive
+ * the execution of the statement.
+ *
+ * @param stmt   The prepared INSERT statement.
+ * @param schema The table schema.
+ * @param cols   The record values in the order of the record columns.
+ */
+void bind_record(sqlite3_stmt* stmt, const table_schema& schema, const field_list& cols)
+{
+    for (size_t i = 0; i < schema.record_column_count; ++i)
+    {
+        const std::string_view value = cols[i];
+        const int param = static_cast<int>(i) + 1;
+        const bool integer = (schema.record_column(i).type == column_type::integer);
+        int64_t number = 0;
+
+        if (integer && value.empty())
+        {
+            sqlite3_bind_null(stmt, param);
+        }
+        else if (integer && parse_integer(value, number))
+        {
+            sqlite3_bind_int64(stmt, param, number);
+        }
+        else
+        {
+            // An empty view may have no data, which SQLite would bind as NULL.
+            sqlite3_bind_text(stmt, param, value.empty() ? "" : value.data(), static_cast<int>(value.size()),
+                              SQLITE_STATIC);
+        }
+    }
+}
+
+/**
+ * The function steps the prepared query selecting the table columns and
+ * writes all obtained rows into the sink. The sink is flushed when the result
+ * ends.
+ *
+ * @param stmt   The prepared statement with all parameters bound.
+ * @param schema The table schema.
+ * @param p_db   Database connection pointer.
+ * @param sink   The sink of the printed records.
+ * @return       True if the query was executed successfully, false otherwise.
+ */
+bool print_schema_rows(sqlite3_stmt* stmt, const table_schema& schema, sqlite3** p_db, output_sink& sink)
+{
+    const table_sql& sql = get_table_sql(schema);
+    query_output output(sink);
+    int status;
+
+    while ((status = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        print_schema_row(stmt, schema, sql, output);
+    }
+
+    if (!output.finish())
+    {
+        return false;
+    }
+
+    if (status != SQLITE_DONE)
+    {
+        std::cerr << "Error message: " << sqlite3_errmsg(*p_db) << "\n";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,225 @@
+/**
+ * @file    table_schema.hpp
+ *
+ * @brief   Compile-time description of the tables and the code generated from it.
+ *
+ * @author  David Chocholaty
+ */
+
+#ifndef TABLE_SCHEMA_HPP
+#define TABLE_SCHEMA_HPP
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sqlite3.h>
+
+#include "arena.hpp"
+#include "output_sink.hpp"
+
+/**
+ * The type of the values of a column. The integer values are bound and read
+ * natively, the text values as slices.
+ */
+enum class column_type
+{
+    integer,
+    text
+};
+
+/**
+ * The description of a single table column.
+ */
+struct column_def
+{
+    std::string_view name;
+    column_type type;
+    // The SQL type and the constraints of the column.
+    std::string_view declaration;
+};
+
+/**
+ * The compile-time description of a table.
+ *
+ * The columns are listed in the order of the CREATE TABLE and SELECT
+ * statements. The record columns are the positions of the inserted columns in
+ * the order of the values of an input record (a CSV line), the columns
+ * generated by SQLite (the INTEGER PRIMARY KEY) are not among them. The
+ * schemas are constexpr objects (see schemas.hpp), so the positions of the
+ * columns are resolved by the compiler.
+ */
+struct table_schema
+{
+    std::string_view name;
+    const column_def* columns;
+    size_t column_count;
+    const size_t* record_columns;
+    size_t record_column_count;
+    // The secondary indexes, each given as a comma-separated list of columns.
+    const std::string_view* indexes;
+    size_t index_count;
+    // The comma-separated columns of a UNIQUE constraint identifying a record
+    // of the input, the conflict target of the upsert. Empty if the records
+    // are only inserted.
+    std::string_view key;
+    // The comma-separated text columns of the full-text search index. Empty
+    // if the table is not searched.
+    std::string_view search;
+
+    /**
+     * Returns the position of the column in the table columns. An unknown
+     * column fails the compilation of a constant expression.
+     */
+    constexpr size_t column_index(std::string_view column) const
+    {
+        for (size_t i = 0; i < column_count; ++i)
+        {
+            if (columns[i].name == column)
+            {
+                return i;
+            }
+        }
+
+        throw std::logic_error("unknown column");
+    }
+
+    /**
+     * Returns the position of the column in the input record. An unknown
+     * column fails the compilation of a constant expression.
+     */
+    constexpr size_t record_index(std::string_view column) const
+    {
+        for (size_t i = 0; i < record_column_count; ++i)
+        {
+            if (columns[record_columns[i]].name == column)
+            {
+                return i;
+            }
+        }
+
+        throw std::logic_error("unknown record column");
+    }
+
+    constexpr const column_def& record_column(size_t i) const
+    {
+        return columns[record_columns[i]];
+    }
+};
+
+/**
+ * Function which resolves the names of the record columns to their positions
+ * in the table columns at compile time.
+ *
+ * @param columns The table columns.
+ * @param names   The names of the record columns in the order of the input.
+ * @return        The positions of the record columns.
+ */
+template <size_t N, size_t M>
+constexpr std::array<size_t, M> record_layout(const column_def (&columns)[N], const std::string_view (&names)[M])
+{
+    std::array<size_t, M> layout = {};
+
+    for (size_t i = 0; i < M; ++i)
+    {
+        layout[i] = N;
+
+        for (size_t j = 0; j < N; ++j)
+        {
+            if (columns[j].name == names[i])
+            {
+                layout[i] = j;
+            }
+        }
+
+        if (layout[i] == N)
+        {
+            throw std::logic_error("unknown record column");
+        }
+    }
+
+    return layout;
+}
+
+template <size_t N, size_t M, size_t K>
+constexpr table_schema make_table_schema(std::string_view name,
+                                         const column_def (&columns)[N],
+                                         const std::array<size_t, M>& record,
+                                         const std::string_view (&indexes)[K],
+                                         std::string_view key = {},
+                                         std::string_view search = {})
+{
+    return {name, columns, N, record.data(), M, indexes, K, key, search};
+}
+
+template <size_t N, size_t M>
+constexpr table_schema make_table_schema(std::string_view name,
+                                         const column_def (&columns)[N],
+                                         const std::array<size_t, M>& record,
+                                         std::string_view key = {},
+                                         std::string_view search = {})
+{
+    return {name, columns, N, record.data(), M, nullptr, 0, key, search};
+}
+
+/**
+ * The SQL text and the column names generated from a table schema.
+ */
+struct table_sql
+{
+    // The column definitions of the CREATE TABLE statement.
+    std::string column_definitions;
+    std::vector<std::string> indexes;
+    // The comma-separated list of the table columns.
+    std::string select_columns;
+    // The comma-separated list of the record columns.
+    std::string record_columns;
+    // SELECT of all table columns (without any condition).
+    std::string select;
+    // INSERT of a record with one parameter per record column.
+    std::string insert;
+    // INSERT of a record (the same parameters) updating the record with the
+    // same key instead. An unchanged record is not written. Without a key,
+    // the records which violate a constraint are skipped.
+    std::string upsert;
+    // The null-terminated column names, the header of the printed records.
+    std::vector<const char*> column_names;
+    // The FTS5 external-content table indexing the search columns and the
+    // triggers keeping it in sync with the table, empty without any search
+    // columns (see search_table_name).
+    std::string search_table;
+    std::vector<std::string> search_index;
+};
+
+/**
+ * Returns the SQL text of the table. It is generated once, on the first use.
+ * The SQL text of the schemas of schemas.hpp is then returned without any
+ * lock, so the function can be called on the hot paths.
+ *
+ * @param schema The table schema.
+ * @return       The generated SQL text, valid until the program ends.
+ */
+const table_sql& get_table_sql(const table_schema& schema);
+
+/**
+ * Finds the schema of the table by its name.
+ *
+ * @param table_name The name of a table.
+ * @return           The schema, nullptr if the table is not known.
+ */
+const table_schema* find_table_schema(std::string_view table_name);
+
+/**
+ * Returns the name of the full-text search table of the table, e.g.
+ * StaffSearch.
+ */
+std::string search_table_name(std::string_view table_name);
+
+// The code generated from the schema.
+bool create_table(const table_schema& schema, sqlite3** p_db);
+void bind_record(sqlite3_stmt* stmt, const table_schema& schema, const field_list& cols);
+bool print_schema_rows(sqlite3_stmt* stmt, const table_schema& schema, sqlite3** p_db, output_sink& sink);
+
+#endif // TABLE_SCHEMA_HPP